@@ -0,0 +1,335 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "cipher.hpp"
+#include "random.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using sse::crypto::Cipher;
+using sse::crypto::Key;
+
+// The first argument is the Cipher mode (the value of Cipher::Mode), the
+// second one the plaintext length, from 32 B to 16 MB. The short lengths
+// correspond to typical index entries.
+static void Cipher_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t mode : {0, 1, 2}) {
+        for (int64_t len : {32, 64, 100, 1024, 16384, 1 << 20, 1 << 24}) {
+            b->Args({mode, len});
+        }
+    }
+}
+
+static Cipher::Mode cipher_mode(const int64_t arg)
+{
+    return static_cast<Cipher::Mode>(arg);
+}
+
+static void Cipher_encrypt(benchmark::State& state)
+{
+    if (!Cipher::is_available(cipher_mode(state.range(0)))) {
+        state.SkipWithError("Mode not supported by the CPU");
+        return;
+    }
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::string in = sse::crypto::random_string(state.range(1));
+    std::string       out;
+
+    for (auto _ : state) {
+        cipher.encrypt(in, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(1));
+}
+BENCHMARK(Cipher_encrypt)->Apply(Cipher_args);
+
+static void Cipher_decrypt(benchmark::State& state)
+{
+    if (!Cipher::is_available(cipher_mode(state.range(0)))) {
+        state.SkipWithError("Mode not supported by the CPU");
+        return;
+    }
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    std::string ct;
+    std::string out;
+    cipher.encrypt(sse::crypto::random_string(state.range(1)), ct);
+
+    for (auto _ : state) {
+        cipher.decrypt(ct, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(1));
+}
+BENCHMARK(Cipher_decrypt)->Apply(Cipher_args);
+
+// Streaming encryption from and to memory buffers. The first argument is the
+// payload size, the second one the chunk size.
+static void Cipher_encrypt_stream(benchmark::State& state)
+{
+    Cipher cipher((Key<Cipher::kKeySize>()));
+
+    const size_t      len        = state.range(0);
+    const size_t      chunk_size = state.range(1);
+    const std::string in         = sse::crypto::random_string(len);
+    std::string out(Cipher::stream_ciphertext_length(len, chunk_size), 0);
+
+    for (auto _ : state) {
+        size_t in_pos  = 0;
+        size_t out_pos = 0;
+        cipher.encrypt_stream(
+            [&in, &in_pos](uint8_t* buf, size_t n) {
+                n = std::min(n, in.size() - in_pos);
+                memcpy(buf, in.data() + in_pos, n);
+                in_pos += n;
+                return n;
+            },
+            [&out, &out_pos](const uint8_t* buf, size_t n) {
+                memcpy(&out[out_pos], buf, n);
+                out_pos += n;
+            },
+            chunk_size);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(len));
+}
+BENCHMARK(Cipher_encrypt_stream)
+    ->Args({1 << 20, 1 << 12})
+    ->Args({1 << 20, 1 << 16})
+    ->Args({1 << 24, 1 << 16})
+    ->Args({1 << 24, 1 << 20})
+    ->Unit(benchmark::kMicrosecond);
+
+// Encryption of 100000 entries of 64 bytes, with repeated calls to encrypt
+// and with encrypt_batch. The first argument is the Cipher mode, the second
+// one the number of threads of encrypt_batch.
+static const size_t kBatchEntries = 100000;
+static const size_t kBatchEntryLength = 64;
+
+static void Cipher_encrypt_loop(benchmark::State& state)
+{
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::vector<std::string> in(
+        kBatchEntries, sse::crypto::random_string(kBatchEntryLength));
+    std::vector<std::string> out(in.size());
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < in.size(); i++) {
+            cipher.encrypt(in[i], out[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(Cipher_encrypt_loop)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void Cipher_encrypt_batch(benchmark::State& state)
+{
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::vector<std::string> in(
+        kBatchEntries, sse::crypto::random_string(kBatchEntryLength));
+    std::vector<uint8_t> arena;
+    std::vector<size_t>  offsets;
+
+    for (auto _ : state) {
+        cipher.encrypt_batch(
+            in, arena, offsets, static_cast<unsigned int>(state.range(1)));
+        benchmark::DoNotOptimize(arena.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+static void Cipher_batch_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t mode : {0, 1}) {
+        for (int64_t n_threads : {1, 2, 4, 8}) {
+            b->Args({mode, n_threads});
+        }
+    }
+}
+BENCHMARK(Cipher_encrypt_batch)
+    ->Apply(Cipher_batch_args)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Decryption of 100000 entries of 64 bytes, a given percentage of which have
+// been tampered with, with repeated calls to decrypt (catching the exceptions)
+// and with decrypt_batch. The first argument is the Cipher mode, the second
+// one the percentage of invalid entries, the third one the number of threads
+// of decrypt_batch.
+static std::vector<std::string> batch_ciphertexts(Cipher&       cipher,
+                                                  const int64_t invalid_pct)
+{
+    std::vector<std::string> ct(kBatchEntries);
+    for (size_t i = 0; i < ct.size(); i++) {
+        cipher.encrypt(sse::crypto::random_string(kBatchEntryLength), ct[i]);
+        if (int64_t(i % 100) < invalid_pct) {
+            ct[i].back() ^= 0x01;
+        }
+    }
+    return ct;
+}
+
+static void Cipher_decrypt_loop(benchmark::State& state)
+{
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::vector<std::string> in
+        = batch_ciphertexts(cipher, state.range(1));
+    std::vector<std::string> out(in.size());
+
+    for (auto _ : state) {
+        size_t n_valid = 0;
+        for (size_t i = 0; i < in.size(); i++) {
+            try {
+                cipher.decrypt(in[i], out[i]);
+                n_valid++;
+            } catch (const std::runtime_error&) {
+            }
+        }
+        benchmark::DoNotOptimize(n_valid);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(Cipher_decrypt_loop)
+    ->Args({0, 0})
+    ->Args({0, 10})
+    ->Args({0, 50})
+    ->Args({1, 0})
+    ->Args({1, 10})
+    ->Args({1, 50})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void Cipher_decrypt_batch(benchmark::State& state)
+{
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::vector<std::string> in
+        = batch_ciphertexts(cipher, state.range(1));
+    std::vector<uint8_t>  arena;
+    std::vector<size_t>   offsets;
+    std::vector<uint64_t> status;
+
+    for (auto _ : state) {
+        size_t n_valid = cipher.decrypt_batch(
+            in,
+            arena,
+            offsets,
+            status,
+            static_cast<unsigned int>(state.range(2)));
+        benchmark::DoNotOptimize(n_valid);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+static void Cipher_decrypt_batch_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t mode : {0, 1}) {
+        for (int64_t invalid_pct : {0, 10, 50}) {
+            for (int64_t n_threads : {1, 4}) {
+                b->Args({mode, invalid_pct, n_threads});
+            }
+        }
+    }
+}
+BENCHMARK(Cipher_decrypt_batch)
+    ->Apply(Cipher_decrypt_batch_args)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Encryption of a document collection with encrypt_records. The document
+// sizes are skewed: most of them are a few hundred bytes long, and one in
+// 64 is between 64 kB and 1 MB. The first argument is the Cipher mode, the
+// second one the number of threads.
+static std::vector<Cipher::Record> document_collection()
+{
+    std::vector<Cipher::Record> records;
+    size_t                      state = 1;
+    for (uint64_t id = 0; id < 20000; id++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const size_t r   = (state >> 33);
+        const size_t len = (id % 64 == 0) ? (1 << 16) + r % (15 << 16)
+                                          : 64 + r % 1024;
+        records.emplace_back(id, std::string(len, 'a'));
+    }
+    return records;
+}
+
+static void Cipher_encrypt_records(benchmark::State& state)
+{
+    if (!Cipher::is_available(cipher_mode(state.range(0)))) {
+        state.SkipWithError("Mode not supported by the CPU");
+        return;
+    }
+    Cipher cipher(Key<Cipher::kKeySize>(), cipher_mode(state.range(0)));
+
+    const std::vector<Cipher::Record> records = document_collection();
+    size_t                            checksum = 0;
+    Cipher::BulkStats                 stats;
+
+    for (auto _ : state) {
+        stats = cipher.encrypt_records(
+            records,
+            [&checksum](uint64_t id, const uint8_t* ct, size_t len) {
+                checksum += id + ct[len - 1];
+            },
+            static_cast<unsigned int>(state.range(1)));
+    }
+    benchmark::DoNotOptimize(checksum);
+
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(stats.records));
+    state.SetBytesProcessed(int64_t(state.iterations())
+                            * int64_t(stats.plaintext_bytes));
+    state.counters["engine_MBps"] = stats.bytes_per_second() / 1e6;
+}
+static void Cipher_records_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t mode : {0, 1, 2}) {
+        for (int64_t n_threads : {1, 2, 4, 8}) {
+            b->Args({mode, n_threads});
+        }
+    }
+}
+BENCHMARK(Cipher_encrypt_records)
+    ->Apply(Cipher_records_args)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,168 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "cipher.hpp"
+#include "deterministic_cipher.hpp"
+#include "random.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+using sse::crypto::Cipher;
+using sse::crypto::DeterministicCipher;
+using sse::crypto::Key;
+
+// The first argument is the ciphertext expansion, the second one the
+// plaintext length, from 8 B (a document identifier) to 1 MB.
+static void DeterministicCipher_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t expansion : {4, 8, 16}) {
+        for (int64_t len : {8, 16, 32, 64, 100, 1024, 16384, 1 << 20}) {
+            b->Args({expansion, len});
+        }
+    }
+}
+
+// Reports the size of the ciphertexts, and their overhead over the plaintext
+static void set_size_counters(benchmark::State& state,
+                              const size_t      plaintext_len,
+                              const size_t      ciphertext_len)
+{
+    state.counters["ct_bytes"] = static_cast<double>(ciphertext_len);
+    state.counters["overhead_bytes"]
+        = static_cast<double>(ciphertext_len - plaintext_len);
+}
+
+static void DeterministicCipher_encrypt(benchmark::State& state)
+{
+    if (!DeterministicCipher::is_available()) {
+        state.SkipWithError("AES not supported by the CPU");
+        return;
+    }
+    DeterministicCipher cipher(static_cast<unsigned>(state.range(0)));
+
+    const std::string label = sse::crypto::random_string(8);
+    const std::string in    = sse::crypto::random_string(state.range(1));
+    std::string       out;
+
+    for (auto _ : state) {
+        cipher.encrypt(label, in, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(1));
+    set_size_counters(state, in.size(), out.size());
+}
+BENCHMARK(DeterministicCipher_encrypt)->Apply(DeterministicCipher_args);
+
+static void DeterministicCipher_decrypt(benchmark::State& state)
+{
+    if (!DeterministicCipher::is_available()) {
+        state.SkipWithError("AES not supported by the CPU");
+        return;
+    }
+    DeterministicCipher cipher(static_cast<unsigned>(state.range(0)));
+
+    const std::string label = sse::crypto::random_string(8);
+    const std::string ct
+        = cipher.encrypt(label, sse::crypto::random_string(state.range(1)));
+    std::string out;
+
+    for (auto _ : state) {
+        cipher.decrypt(label, ct, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(1));
+}
+BENCHMARK(DeterministicCipher_decrypt)->Apply(DeterministicCipher_args);
+
+// Storage cost of an index of 100000 entries of 8 bytes (e.g. document
+// identifiers), for the randomized Cipher modes (first argument: the value of
+// Cipher::Mode) and for DeterministicCipher (first argument: 3, second
+// argument: the expansion). The entries are encrypted under distinct labels,
+// as in an encrypted index where the label is derived from the keyword and a
+// counter.
+static const size_t kIndexEntries     = 100000;
+static const size_t kIndexEntryLength = 8;
+
+static void Index_size(benchmark::State& state)
+{
+    const std::vector<std::string> in(
+        kIndexEntries, sse::crypto::random_string(kIndexEntryLength));
+    std::vector<std::string> out(in.size());
+
+    const bool deterministic = (state.range(0) == 3);
+    if (deterministic && !DeterministicCipher::is_available()) {
+        state.SkipWithError("AES not supported by the CPU");
+        return;
+    }
+    if (!deterministic
+        && !Cipher::is_available(static_cast<Cipher::Mode>(state.range(0)))) {
+        state.SkipWithError("Mode not supported by the CPU");
+        return;
+    }
+
+    if (deterministic) {
+        DeterministicCipher cipher(static_cast<unsigned>(state.range(1)));
+        std::string         label(sizeof(uint64_t), 0x00);
+
+        for (auto _ : state) {
+            for (size_t i = 0; i < in.size(); i++) {
+                memcpy(&label[0], &i, sizeof(i));
+                cipher.encrypt(label, in[i], out[i]);
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+    } else {
+        Cipher cipher(Key<Cipher::kKeySize>(),
+                      static_cast<Cipher::Mode>(state.range(0)));
+
+        for (auto _ : state) {
+            for (size_t i = 0; i < in.size(); i++) {
+                cipher.encrypt(in[i], out[i]);
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+
+    size_t total = 0;
+    for (const auto& ct : out) {
+        total += ct.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+    state.counters["index_bytes"] = static_cast<double>(total);
+    set_size_counters(state, kIndexEntryLength, total / out.size());
+}
+BENCHMARK(Index_size)
+    ->Args({0, 0})
+    ->Args({1, 0})
+    ->Args({2, 0})
+    ->Args({3, 4})
+    ->Args({3, 8})
+    ->Args({3, 16})
+    ->Unit(benchmark::kMillisecond);
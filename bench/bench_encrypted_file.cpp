@@ -0,0 +1,149 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "encrypted_file.hpp"
+#include "random.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+using sse::crypto::EncryptedFileReader;
+using sse::crypto::EncryptedFileWriter;
+using sse::crypto::Key;
+
+// The argument is the chunk size
+static void EncryptedFile_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t chunk_size : {4096, 16384, 65536}) {
+        b->Arg(chunk_size);
+    }
+}
+
+static const size_t kFileSize = 64 << 20;
+
+static std::string temporary_path()
+{
+    char path[] = "/tmp/sse_crypto_bench_XXXXXX";
+    int  fd     = mkstemp(path);
+    if (fd != -1) {
+        close(fd);
+    }
+    return path;
+}
+
+// Writes kFileSize random bytes, by calls of 1 MB
+static void write_file(const uint8_t*     key,
+                       const std::string& path,
+                       const std::string& content,
+                       const size_t       chunk_size)
+{
+    uint8_t key_copy[EncryptedFileWriter::kKeySize];
+    std::copy(key, key + sizeof(key_copy), key_copy);
+
+    EncryptedFileWriter writer(
+        Key<EncryptedFileWriter::kKeySize>(key_copy), path, chunk_size);
+
+    const size_t kWriteSize = 1 << 20;
+    for (size_t i = 0; i < kFileSize; i += kWriteSize) {
+        writer.write(reinterpret_cast<const uint8_t*>(content.data()) + i,
+                     kWriteSize);
+    }
+    writer.close();
+}
+
+static void EncryptedFile_write(benchmark::State& state)
+{
+    const std::string path    = temporary_path();
+    const std::string content = sse::crypto::random_string(kFileSize);
+    uint8_t           key[EncryptedFileWriter::kKeySize];
+    sse::crypto::random_bytes(sizeof(key), key);
+
+    for (auto _ : state) {
+        write_file(key, path, content, static_cast<size_t>(state.range(0)));
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * kFileSize);
+    unlink(path.c_str());
+}
+BENCHMARK(EncryptedFile_write)
+    ->Apply(EncryptedFile_args)
+    ->Unit(benchmark::kMillisecond);
+
+// Random aligned 4 kB reads: only the chunk(s) containing the page are
+// authenticated, and only the page is decrypted.
+static void EncryptedFile_random_read(benchmark::State& state)
+{
+    const std::string path = temporary_path();
+    uint8_t           key[EncryptedFileWriter::kKeySize];
+    sse::crypto::random_bytes(sizeof(key), key);
+    write_file(key,
+               path,
+               sse::crypto::random_string(kFileSize),
+               static_cast<size_t>(state.range(0)));
+
+    EncryptedFileReader reader(Key<EncryptedFileReader::kKeySize>(key), path);
+
+    const size_t                          kReadSize = 4096;
+    std::mt19937_64                       gen(0);
+    std::uniform_int_distribution<size_t> dist(0,
+                                               kFileSize / kReadSize - 1);
+    uint8_t                               out[kReadSize];
+
+    for (auto _ : state) {
+        reader.read(dist(gen) * kReadSize, kReadSize, out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * kReadSize);
+    unlink(path.c_str());
+}
+BENCHMARK(EncryptedFile_random_read)->Apply(EncryptedFile_args);
+
+// Reference point for the random reads: decrypting the whole file
+static void EncryptedFile_full_read(benchmark::State& state)
+{
+    const std::string path = temporary_path();
+    uint8_t           key[EncryptedFileWriter::kKeySize];
+    sse::crypto::random_bytes(sizeof(key), key);
+    write_file(key,
+               path,
+               sse::crypto::random_string(kFileSize),
+               static_cast<size_t>(state.range(0)));
+
+    EncryptedFileReader reader(Key<EncryptedFileReader::kKeySize>(key), path);
+    std::string         out(kFileSize, 0x00);
+
+    for (auto _ : state) {
+        reader.read(0, kFileSize, reinterpret_cast<uint8_t*>(&out[0]));
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * kFileSize);
+    unlink(path.c_str());
+}
+BENCHMARK(EncryptedFile_full_read)
+    ->Apply(EncryptedFile_args)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,324 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "aez/aez.h"
+#include "prp.hpp"
+#include "random.hpp"
+#include "small_domain_prp.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+
+using sse::crypto::Prp;
+using sse::crypto::SmallDomainPrp;
+
+static std::vector<uint64_t> random_inputs(size_t n, uint64_t domain_size)
+{
+    std::vector<uint64_t> in(n);
+    sse::crypto::random_bytes(n * sizeof(uint64_t),
+                              reinterpret_cast<uint8_t*>(in.data()));
+    for (auto& x : in) {
+        x %= domain_size;
+    }
+    return in;
+}
+
+// Domain sizes: 2^10, 10^6, 2^24+1 (worst case for cycle walking: the
+// Feistel domain is almost 4 times larger than N), 2^40 and 2^63-1
+static void SmallDomainPrp_domain_args(benchmark::internal::Benchmark* b)
+{
+    b->Arg(1 << 10)
+        ->Arg(1000000)
+        ->Arg((1 << 24) + 1)
+        ->Arg(int64_t(1) << 40)
+        ->Arg(INT64_MAX);
+}
+
+static void SmallDomainPrp_encrypt(benchmark::State& state)
+{
+    const uint64_t domain_size = static_cast<uint64_t>(state.range(0));
+
+    SmallDomainPrp              prp(domain_size);
+    const std::vector<uint64_t> in = random_inputs(1024, domain_size);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prp.encrypt(in[i]));
+        i = (i + 1) % in.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(SmallDomainPrp_encrypt)->Apply(SmallDomainPrp_domain_args);
+
+static void SmallDomainPrp_encrypt_batch(benchmark::State& state)
+{
+    const uint64_t domain_size = static_cast<uint64_t>(state.range(0));
+
+    SmallDomainPrp              prp(domain_size);
+    const std::vector<uint64_t> in = random_inputs(4096, domain_size);
+    std::vector<uint64_t>       out(in.size());
+
+    for (auto _ : state) {
+        prp.encrypt(in.data(), in.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(SmallDomainPrp_encrypt_batch)
+    ->Apply(SmallDomainPrp_domain_args)
+    ->Unit(benchmark::kMicrosecond);
+
+static void SmallDomainPrp_decrypt_batch(benchmark::State& state)
+{
+    const uint64_t domain_size = static_cast<uint64_t>(state.range(0));
+
+    SmallDomainPrp              prp(domain_size);
+    const std::vector<uint64_t> in = random_inputs(4096, domain_size);
+    std::vector<uint64_t>       out(in.size());
+
+    for (auto _ : state) {
+        prp.decrypt(in.data(), in.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(SmallDomainPrp_decrypt_batch)
+    ->Apply(SmallDomainPrp_domain_args)
+    ->Unit(benchmark::kMicrosecond);
+
+static void SmallDomainPrp_permutation(benchmark::State& state)
+{
+    const uint64_t domain_size = static_cast<uint64_t>(state.range(0));
+
+    SmallDomainPrp prp(domain_size);
+
+    for (auto _ : state) {
+        std::vector<uint64_t> perm = prp.permutation();
+        benchmark::DoNotOptimize(perm.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(domain_size));
+}
+BENCHMARK(SmallDomainPrp_permutation)
+    ->RangeMultiplier(16)
+    ->Range(1 << 8, 1 << 20)
+    ->Unit(benchmark::kMillisecond);
+
+// Baseline: cycle walking over Prp::encrypt_64, which is only practical when
+// the domain size is close to 2^64
+static void Prp_cycle_walk_64(benchmark::State& state)
+{
+    const uint64_t domain_size = static_cast<uint64_t>(state.range(0));
+
+    Prp                         prp;
+    const std::vector<uint64_t> in = random_inputs(1024, domain_size);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        uint64_t x = prp.encrypt_64(in[i]);
+        while (x >= domain_size) {
+            x = prp.encrypt_64(x);
+        }
+        benchmark::DoNotOptimize(x);
+        i = (i + 1) % in.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(Prp_cycle_walk_64)->Arg(INT64_MAX);
+
+// The integer benchmarks take the Prp backend as first argument: 0 for AEZ, 1
+// for the Feistel network.
+static Prp::Backend prp_backend(const int64_t arg)
+{
+    return (arg == 0) ? Prp::Backend::kAEZ : Prp::Backend::kFeistel;
+}
+
+static void Prp_backend_args(benchmark::internal::Benchmark* b)
+{
+    b->Arg(0)->Arg(1);
+}
+
+static void Prp_backend_batch_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t backend : {0, 1}) {
+        for (int64_t n = 8; n <= (1 << 15); n *= 8) {
+            b->Args({backend, n});
+        }
+    }
+}
+
+static void Prp_encrypt_32(benchmark::State& state)
+{
+    Prp                   prp(prp_backend(state.range(0)));
+    std::vector<uint32_t> in(1024);
+    sse::crypto::random_bytes(in.size() * sizeof(uint32_t),
+                              reinterpret_cast<uint8_t*>(in.data()));
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prp.encrypt(in[i]));
+        i = (i + 1) % in.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(Prp_encrypt_32)->Apply(Prp_backend_args);
+
+static void Prp_encrypt_64(benchmark::State& state)
+{
+    Prp                         prp(prp_backend(state.range(0)));
+    const std::vector<uint64_t> in = random_inputs(1024, UINT64_MAX);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prp.encrypt_64(in[i]));
+        i = (i + 1) % in.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(Prp_encrypt_64)->Apply(Prp_backend_args);
+
+static void Prp_encrypt_64_batch(benchmark::State& state)
+{
+    Prp                         prp(prp_backend(state.range(0)));
+    const std::vector<uint64_t> in = random_inputs(state.range(1), UINT64_MAX);
+    std::vector<uint64_t>       out(in.size());
+
+    for (auto _ : state) {
+        prp.encrypt_64_batch(in.data(), in.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(Prp_encrypt_64_batch)
+    ->Apply(Prp_backend_batch_args)
+    ->Unit(benchmark::kMicrosecond);
+
+static void Prp_decrypt_64_batch(benchmark::State& state)
+{
+    Prp                         prp(prp_backend(state.range(0)));
+    const std::vector<uint64_t> in = random_inputs(state.range(1), UINT64_MAX);
+    std::vector<uint64_t>       out(in.size());
+
+    for (auto _ : state) {
+        prp.decrypt_64_batch(in.data(), in.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(Prp_decrypt_64_batch)
+    ->Apply(Prp_backend_batch_args)
+    ->Unit(benchmark::kMicrosecond);
+
+static void Prp_encrypt_32_batch(benchmark::State& state)
+{
+    Prp                   prp(prp_backend(state.range(0)));
+    std::vector<uint32_t> in(state.range(1));
+    std::vector<uint32_t> out(in.size());
+    sse::crypto::random_bytes(in.size() * sizeof(uint32_t),
+                              reinterpret_cast<uint8_t*>(in.data()));
+
+    for (auto _ : state) {
+        prp.encrypt_batch(in.data(), in.size(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(in.size()));
+}
+BENCHMARK(Prp_encrypt_32_batch)
+    ->Apply(Prp_backend_batch_args)
+    ->Unit(benchmark::kMicrosecond);
+
+// Wide-block encryption throughput, for each implementation of the AEZ core
+// passes. The first argument is the implementation (AEZ_IMPL_*), the second
+// the input length.
+static void Prp_encrypt_string(benchmark::State& state)
+{
+    if (aez_set_core_impl(static_cast<int>(state.range(0))) != 0) {
+        state.SkipWithError("Implementation not supported by the CPU");
+        return;
+    }
+
+    Prp               prp;
+    const std::string in = sse::crypto::random_string(state.range(1));
+    std::string       out;
+
+    for (auto _ : state) {
+        prp.encrypt(in, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations())
+                            * int64_t(state.range(1)));
+
+    aez_set_core_impl(AEZ_IMPL_AUTO);
+}
+
+static void Prp_encrypt_string_args(benchmark::internal::Benchmark* b)
+{
+    for (int impl : {AEZ_IMPL_REFERENCE, AEZ_IMPL_VAES256, AEZ_IMPL_VAES512}) {
+        for (int64_t len = 64; len <= (1 << 20); len *= 4) {
+            b->Args({impl, len});
+        }
+    }
+}
+BENCHMARK(Prp_encrypt_string)->Apply(Prp_encrypt_string_args);
+
+// Same as Prp_encrypt_string, on the raw AEZ encryption function, without the
+// allocations and copies of the std::string interface
+static void AEZ_encrypt(benchmark::State& state)
+{
+    if (aez_set_core_impl(static_cast<int>(state.range(0))) != 0) {
+        state.SkipWithError("Implementation not supported by the CPU");
+        return;
+    }
+
+    std::array<uint8_t, 48> key;
+    sse::crypto::random_bytes(key);
+    aez_ctx_t ctx;
+    aez_setup(key.data(), static_cast<unsigned>(key.size()), &ctx);
+
+    const char        iv[16] = {0x00};
+    const std::string in     = sse::crypto::random_string(state.range(1));
+    std::string       out(in.size(), 0x00);
+
+    for (auto _ : state) {
+        aez_encrypt(&ctx,
+                    iv,
+                    16,
+                    0,
+                    in.data(),
+                    static_cast<unsigned>(in.size()),
+                    &out[0]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations())
+                            * int64_t(state.range(1)));
+
+    aez_set_core_impl(AEZ_IMPL_AUTO);
+}
+BENCHMARK(AEZ_encrypt)->Apply(Prp_encrypt_string_args);
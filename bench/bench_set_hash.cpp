@@ -19,15 +19,20 @@
 //
 
 #include "hash.hpp"
+#include "lt_hash.hpp"
 #include "random.hpp"
 #include "set_hash.hpp"
 
 #include <benchmark/benchmark.h>
 
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <vector>
 
 
+using sse::crypto::ConcurrentSetHash;
+using sse::crypto::LtHash;
 using sse::crypto::SetHash;
 
 template<typename SH>
@@ -72,6 +77,16 @@ BENCHMARK_TEMPLATE(SetHash_insert, SetHash)
     ->Unit(benchmark::kMicrosecond)
     ->Complexity(benchmark::oN);
 
+BENCHMARK_TEMPLATE(SetHash_insert, LtHash)
+    ->Apply(SetHash_insert_args)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(SetHash_insert, LtHash)
+    ->RangeMultiplier(2)
+    ->Ranges({{1 << 4, 1 << 14}, {32, 32}})
+    ->Unit(benchmark::kMicrosecond)
+    ->Complexity(benchmark::oN);
+
 
 template<typename SH>
 static void SetHash_batch_construct(benchmark::State& state)
@@ -104,3 +119,302 @@ BENCHMARK_TEMPLATE(SetHash_batch_construct, SetHash)
     ->Ranges({{1 << 4, 1 << 14}, {32, 32}})
     ->Unit(benchmark::kMicrosecond)
     ->Complexity(benchmark::oN);
+
+BENCHMARK_TEMPLATE(SetHash_batch_construct, LtHash)
+    ->Apply(SetHash_insert_args)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(SetHash_batch_construct, LtHash)
+    ->RangeMultiplier(2)
+    ->Ranges({{1 << 4, 1 << 14}, {32, 32}})
+    ->Unit(benchmark::kMicrosecond)
+    ->Complexity(benchmark::oN);
+
+
+// Cross-backend benchmarks: the first argument is the backend (0 for
+// kEd25519, 1 for kRistretto255)
+static SetHash::Backend bench_backend(const benchmark::State& state)
+{
+    return state.range(0) == 0 ? SetHash::Backend::kEd25519
+                               : SetHash::Backend::kRistretto255;
+}
+
+// Batched construction from a range of elements (which are not copied): the
+// arguments are the number of elements and their size
+static void SetHash_range_construct(benchmark::State&      state,
+                                    const SetHash::Backend backend)
+{
+    std::vector<std::string> samples(state.range(0));
+    for (auto& e : samples) {
+        e = sse::crypto::random_string(state.range(1));
+    }
+
+    for (auto _ : state) {
+        SetHash a(samples.begin(), samples.end(), backend);
+        benchmark::DoNotOptimize(a);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(state.range(0)));
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK_CAPTURE(SetHash_range_construct,
+                  ed25519,
+                  SetHash::Backend::kEd25519)
+    ->RangeMultiplier(4)
+    ->Ranges({{1 << 4, 1 << 16}, {32, 32}})
+    ->Unit(benchmark::kMicrosecond)
+    ->Complexity(benchmark::oN);
+
+BENCHMARK_CAPTURE(SetHash_range_construct,
+                  ristretto255,
+                  SetHash::Backend::kRistretto255)
+    ->RangeMultiplier(4)
+    ->Ranges({{1 << 4, 1 << 16}, {32, 32}})
+    ->Unit(benchmark::kMicrosecond)
+    ->Complexity(benchmark::oN);
+
+// Hashing of the elements before their mapping to the curve: one by one
+// (first argument: 0) or with the multi-buffer hash (first argument: 1)
+static void SetHash_element_hashing(benchmark::State& state)
+{
+    constexpr size_t kNumElements = 1024;
+    constexpr size_t kHashLength  = 32;
+
+    std::vector<std::string>          samples(kNumElements);
+    std::vector<const unsigned char*> elements(kNumElements);
+    std::vector<size_t>               lengths(kNumElements);
+    for (size_t i = 0; i < kNumElements; i++) {
+        samples[i]  = sse::crypto::random_string(state.range(1));
+        elements[i] = reinterpret_cast<const unsigned char*>(samples[i].data());
+        lengths[i]  = samples[i].size();
+    }
+    std::vector<unsigned char> hashes(kNumElements * kHashLength);
+
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (size_t i = 0; i < kNumElements; i++) {
+                sse::crypto::Hash::hash(elements[i],
+                                        lengths[i],
+                                        kHashLength,
+                                        hashes.data() + i * kHashLength);
+            }
+        } else {
+            sse::crypto::Hash::hash_many(elements.data(),
+                                         lengths.data(),
+                                         kNumElements,
+                                         kHashLength,
+                                         hashes.data());
+        }
+        benchmark::DoNotOptimize(hashes.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * kNumElements);
+    state.SetBytesProcessed(int64_t(state.iterations()) * kNumElements
+                            * state.range(1));
+}
+
+static void SetHash_element_hashing_args(benchmark::internal::Benchmark* b)
+{
+    for (int mode = 0; mode <= 1; mode++)
+        for (int es : {16, 128, 1024})
+            b->Args({mode, es});
+}
+
+BENCHMARK(SetHash_element_hashing)
+    ->Apply(SetHash_element_hashing_args)
+    ->Unit(benchmark::kMicrosecond);
+
+static void SetHash_backend_insert(benchmark::State& state)
+{
+    std::vector<std::string> samples(1024);
+    for (auto& e : samples) {
+        e = sse::crypto::random_string(32);
+    }
+
+    SetHash a(bench_backend(state));
+    size_t  i = 0;
+    for (auto _ : state) {
+        a.add_element(samples[i++ % samples.size()]);
+    }
+    benchmark::DoNotOptimize(a.data());
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(SetHash_backend_insert)->Arg(0)->Arg(1);
+
+// Union of two set hashes
+static void SetHash_backend_merge(benchmark::State& state)
+{
+    SetHash a(bench_backend(state)), b(bench_backend(state));
+    a.add_element(sse::crypto::random_string(32));
+    b.add_element(sse::crypto::random_string(32));
+
+    for (auto _ : state) {
+        a.add_set(b);
+    }
+    benchmark::DoNotOptimize(a.data());
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(SetHash_backend_merge)->Arg(0)->Arg(1);
+
+static void SetHash_backend_serialize(benchmark::State& state)
+{
+    SetHash a(bench_backend(state));
+    a.add_element(sse::crypto::random_string(32));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.serialize());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(SetHash_backend_serialize)->Arg(0)->Arg(1);
+
+// LtHash counterparts of the backend benchmarks: the digest is the compact
+// export, compared to SetHash::serialize()
+static void LtHash_insert(benchmark::State& state)
+{
+    std::vector<std::string> samples(1024);
+    for (auto& e : samples) {
+        e = sse::crypto::random_string(32);
+    }
+
+    LtHash a;
+    size_t i = 0;
+    for (auto _ : state) {
+        a.add_element(samples[i++ % samples.size()]);
+    }
+    benchmark::DoNotOptimize(a.digest());
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(LtHash_insert);
+
+static void LtHash_merge(benchmark::State& state)
+{
+    LtHash a, b;
+    a.add_element(sse::crypto::random_string(32));
+    b.add_element(sse::crypto::random_string(32));
+
+    for (auto _ : state) {
+        a.add_set(b);
+    }
+    benchmark::DoNotOptimize(a.digest());
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(LtHash_merge);
+
+static void LtHash_digest(benchmark::State& state)
+{
+    LtHash a;
+    a.add_element(sse::crypto::random_string(32));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.digest());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(LtHash_digest);
+
+// Insertion of an element with multiplicity state.range(1): add_element
+// called state.range(1) times (first argument: 0), or once with the count
+// (first argument: 1)
+static void SetHash_insert_count_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t method : {0, 1}) {
+        for (int64_t count : {1, 4, 16, 64, 1024}) {
+            b->Args({method, count});
+        }
+    }
+}
+
+static void SetHash_insert_count(benchmark::State& state)
+{
+    const std::string e     = sse::crypto::random_string(32);
+    const uint64_t    count = static_cast<uint64_t>(state.range(1));
+    SetHash           a;
+
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (uint64_t i = 0; i < count; i++) {
+                a.add_element(e);
+            }
+        } else {
+            a.add_element(e, count);
+        }
+    }
+    benchmark::DoNotOptimize(a.data());
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(1));
+}
+BENCHMARK(SetHash_insert_count)
+    ->Apply(SetHash_insert_count_args)
+    ->Unit(benchmark::kMicrosecond);
+
+// Insertion of 256 elements with multiplicities in [1, state.range(1)]: one
+// add_element(e, count) call per element (first argument: 0), or a single
+// add_counts call (first argument: 1)
+static void SetHash_add_counts_args(benchmark::internal::Benchmark* b)
+{
+    for (int64_t method : {0, 1}) {
+        for (int64_t max_count : {16, 1024, 1 << 20}) {
+            b->Args({method, max_count});
+        }
+    }
+}
+
+static void SetHash_add_counts(benchmark::State& state)
+{
+    std::map<std::string, uint64_t> counts;
+    for (size_t i = 0; i < 256; i++) {
+        counts[sse::crypto::random_string(32)]
+            = 1 + (i * 7919) % static_cast<uint64_t>(state.range(1));
+    }
+    SetHash a;
+
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (const auto& c : counts) {
+                a.add_element(c.first, c.second);
+            }
+        } else {
+            a.add_counts(counts);
+        }
+    }
+    benchmark::DoNotOptimize(a.data());
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * int64_t(counts.size()));
+}
+BENCHMARK(SetHash_add_counts)
+    ->Apply(SetHash_add_counts_args)
+    ->Unit(benchmark::kMillisecond);
+
+// Concurrent insertions in a single set hash: a SetHash protected by a mutex
+// (the first argument is 0) or a ConcurrentSetHash (the first argument is 1)
+static void SetHash_concurrent_insert(benchmark::State& state)
+{
+    static std::mutex        mtx;
+    static SetHash           locked_hash;
+    static ConcurrentSetHash concurrent_hash;
+
+    std::vector<std::string> samples(1024);
+    for (auto& e : samples) {
+        e = sse::crypto::random_string(32);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const std::string& e = samples[i++ % samples.size()];
+        if (state.range(0) == 0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            locked_hash.add_element(e);
+        } else {
+            concurrent_hash.add_element(e);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+BENCHMARK(SetHash_concurrent_insert)
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
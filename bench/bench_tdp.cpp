@@ -18,14 +18,23 @@
 // along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "random.hpp"
+#include "tdp.hpp"
+#include "tdp_impl/rsa_multi_buffer.hpp"
 #include "tdp_impl/tdp_impl_mbedtls.hpp"
 #include "tdp_impl/tdp_impl_openssl.hpp"
 
+#include <array>
+#include <vector>
+
 #include <benchmark/benchmark.h>
 
+using sse::crypto::RsaMultiBuffer;
+using sse::crypto::Tdp;
 using sse::crypto::TdpImpl_mbedTLS;
 using sse::crypto::TdpImpl_OpenSSL;
 using sse::crypto::TdpInverseImpl_mbedTLS;
+using sse::crypto::TdpInverse;
 using sse::crypto::TdpInverseImpl_OpenSSL;
 using sse::crypto::TdpMultPoolImpl_mbedTLS;
 using sse::crypto::TdpMultPoolImpl_OpenSSL;
@@ -42,6 +51,13 @@ void Tdp_key_generation(benchmark::State& state)
 
 #define MAX_POOL_SIZE 0x7E
 
+#define MAX_EVAL_BATCH_SIZE 1024
+#define MAX_INVERT_BATCH_SIZE 64
+
+#define MIN_CHAIN_LENGTH 1000
+#define MAX_CHAIN_LENGTH 100000
+#define MAX_PARALLEL_CHAIN_LENGTH 1000000
+
 BENCHMARK_TEMPLATE(Tdp_key_generation, TdpInverseImpl_mbedTLS)
     ->Unit(benchmark::kMicrosecond)
     ->Iterations(20);
@@ -78,10 +94,20 @@ public:
         message = tdp_.sample();
     }
 
-    std::string                    message;
-    typename IMPL::TdpInverseImpl  tdp_inv_;
-    typename IMPL::TdpImpl         tdp_;
-    typename IMPL::TdpMultPoolImpl tdp_mult_;
+    // fills batch with n random messages
+    void sample_batch(const size_t n)
+    {
+        batch.resize(n);
+        for (auto& m : batch) {
+            m = tdp_.sample_array();
+        }
+    }
+
+    std::string                                         message;
+    std::vector<std::array<uint8_t, Tdp::kMessageSize>> batch;
+    typename IMPL::TdpInverseImpl                       tdp_inv_;
+    typename IMPL::TdpImpl                              tdp_;
+    typename IMPL::TdpMultPoolImpl                      tdp_mult_;
 };
 
 #define EVAL_BENCH_AUX(NAME, IMPL)                                             \
@@ -141,6 +167,82 @@ public:
 
 #define INVERT_MULT_BENCH(LIB) INVERT_MULT_BENCH_AUX(LIB, LIB##_Impl)
 
+#define EVAL_BATCH_BENCH_AUX(NAME, IMPL)                                       \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_eval_batch, IMPL)        \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        sample_batch(st.range(0));                                             \
+        for (auto _ : st) {                                                    \
+            tdp_.eval_batch(batch.data(), batch.data(), batch.size());         \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(0));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Benchmark, NAME##_eval_batch)                     \
+        ->RangeMultiplier(4)                                                   \
+        ->Range(1, MAX_EVAL_BATCH_SIZE);
+
+#define EVAL_BATCH_BENCH(LIB) EVAL_BATCH_BENCH_AUX(LIB, LIB##_Impl)
+
+#define INVERT_BATCH_BENCH_AUX(NAME, IMPL)                                     \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_invert_batch, IMPL)      \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        sample_batch(st.range(0));                                             \
+        for (auto _ : st) {                                                    \
+            tdp_inv_.invert_batch(batch.data(), batch.data(), batch.size());   \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(0));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Benchmark, NAME##_invert_batch)                   \
+        ->RangeMultiplier(4)                                                   \
+        ->Range(1, MAX_INVERT_BATCH_SIZE);
+
+#define INVERT_BATCH_BENCH(LIB) INVERT_BATCH_BENCH_AUX(LIB, LIB##_Impl)
+
+// Walk of a chain of length st.range(0), as in Sophos' search: with a loop
+// of eval calls, and with eval_chain
+#define EVAL_LOOP_BENCH_AUX(NAME, IMPL)                                        \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_eval_loop, IMPL)         \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        for (auto _ : st) {                                                    \
+            std::string v = message;                                           \
+            for (int64_t i = 0; i < st.range(0); i++) {                        \
+                tdp_.eval(v, v);                                               \
+                benchmark::DoNotOptimize(v.data());                            \
+            }                                                                  \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(0));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Benchmark, NAME##_eval_loop)                      \
+        ->RangeMultiplier(10)                                                  \
+        ->Range(MIN_CHAIN_LENGTH, MAX_CHAIN_LENGTH)                            \
+        ->Unit(benchmark::kMillisecond);
+
+#define EVAL_LOOP_BENCH(LIB) EVAL_LOOP_BENCH_AUX(LIB, LIB##_Impl)
+
+#define EVAL_CHAIN_BENCH_AUX(NAME, IMPL)                                       \
+    BENCHMARK_TEMPLATE_DEFINE_F(Tdp_Benchmark, NAME##_eval_chain, IMPL)        \
+    (benchmark::State & st)                                                    \
+    {                                                                          \
+        sample_batch(1);                                                       \
+        for (auto _ : st) {                                                    \
+            tdp_.eval_chain(                                                   \
+                batch[0],                                                      \
+                st.range(0),                                                   \
+                [](const std::array<uint8_t, Tdp::kMessageSize>& v) {          \
+                    benchmark::DoNotOptimize(v.data());                        \
+                });                                                            \
+        }                                                                      \
+        st.SetItemsProcessed(int64_t(st.iterations()) * st.range(0));          \
+    }                                                                          \
+    BENCHMARK_REGISTER_F(Tdp_Benchmark, NAME##_eval_chain)                     \
+        ->RangeMultiplier(10)                                                  \
+        ->Range(MIN_CHAIN_LENGTH, MAX_CHAIN_LENGTH)                            \
+        ->Unit(benchmark::kMillisecond);
+
+#define EVAL_CHAIN_BENCH(LIB) EVAL_CHAIN_BENCH_AUX(LIB, LIB##_Impl)
+
 EVAL_BENCH(mbedTLS);
 EVAL_BENCH(OpenSSL);
 
@@ -152,3 +254,135 @@ INVERT_BENCH(OpenSSL);
 
 INVERT_MULT_BENCH(mbedTLS);
 INVERT_MULT_BENCH(OpenSSL);
+
+EVAL_BATCH_BENCH(mbedTLS);
+EVAL_BATCH_BENCH(OpenSSL);
+
+INVERT_BATCH_BENCH(mbedTLS);
+INVERT_BATCH_BENCH(OpenSSL);
+
+EVAL_LOOP_BENCH(mbedTLS);
+EVAL_LOOP_BENCH(OpenSSL);
+
+EVAL_CHAIN_BENCH(mbedTLS);
+EVAL_CHAIN_BENCH(OpenSSL);
+
+
+// Batches spread among several threads, with the default backend.
+// The arguments are the batch size and the number of threads.
+static void Tdp_eval_batch_threads(benchmark::State& state)
+{
+    TdpInverse tdp_inv;
+    Tdp        tdp(tdp_inv.public_key());
+
+    std::vector<std::array<uint8_t, Tdp::kMessageSize>> batch(state.range(0));
+    for (auto& m : batch) {
+        m = tdp.sample_array();
+    }
+
+    for (auto _ : state) {
+        tdp.eval_batch(batch.data(),
+                       batch.data(),
+                       batch.size(),
+                       static_cast<unsigned int>(state.range(1)));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void Tdp_invert_batch_threads(benchmark::State& state)
+{
+    TdpInverse tdp_inv;
+
+    std::vector<std::array<uint8_t, Tdp::kMessageSize>> batch(state.range(0));
+    for (auto& m : batch) {
+        m = tdp_inv.sample_array();
+    }
+
+    for (auto _ : state) {
+        tdp_inv.invert_batch(batch.data(),
+                             batch.data(),
+                             batch.size(),
+                             static_cast<unsigned int>(state.range(1)));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(Tdp_eval_batch_threads)
+    ->Args({MAX_EVAL_BATCH_SIZE, 1})
+    ->Args({MAX_EVAL_BATCH_SIZE, 2})
+    ->Args({MAX_EVAL_BATCH_SIZE, 4})
+    ->Args({MAX_EVAL_BATCH_SIZE, 8})
+    ->UseRealTime();
+BENCHMARK(Tdp_invert_batch_threads)
+    ->Args({MAX_INVERT_BATCH_SIZE, 1})
+    ->Args({MAX_INVERT_BATCH_SIZE, 2})
+    ->Args({MAX_INVERT_BATCH_SIZE, 4})
+    ->Args({MAX_INVERT_BATCH_SIZE, 8})
+    ->UseRealTime();
+
+// Chain of length state.range(0), cut among state.range(1) threads with the
+// trapdoor. One thread stands for the serial walk.
+static void Tdp_eval_chain_parallel(benchmark::State& state)
+{
+    TdpInverse tdp_inv;
+
+    auto start = tdp_inv.sample_array();
+
+    for (auto _ : state) {
+        auto chain = tdp_inv.eval_chain_parallel(
+            start,
+            static_cast<size_t>(state.range(0)),
+            static_cast<unsigned int>(state.range(1)));
+        benchmark::DoNotOptimize(chain.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void chain_parallel_arguments(benchmark::internal::Benchmark* b)
+{
+    for (int64_t n = MIN_CHAIN_LENGTH; n <= MAX_PARALLEL_CHAIN_LENGTH;
+         n *= 10) {
+        for (int64_t threads : {1, 2, 4, 8}) {
+            b->Args({n, threads});
+        }
+    }
+}
+
+BENCHMARK(Tdp_eval_chain_parallel)
+    ->Apply(chain_parallel_arguments)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// The multi-buffer kernel alone, on RsaMultiBuffer::kLanes messages. Compare
+// its items_per_second with the ones of the mbedTLS_eval and OpenSSL_eval
+// benchmarks (the batches of the backends go through the kernel).
+static void RsaMultiBuffer_eval(benchmark::State& state)
+{
+    // the kernel runs in the same time with any odd modulus of the right size
+    std::array<uint8_t, RsaMultiBuffer::kModulusSize> n;
+    sse::crypto::random_bytes(n);
+    n[0] |= 0x80;
+    n[n.size() - 1] |= 0x01;
+    const uint8_t e[] = {0x01, 0x00, 0x01};
+
+    RsaMultiBuffer mb;
+    mb.set_key(n.data(), n.size(), e, sizeof(e));
+    if (!mb.enabled()) {
+        state.SkipWithError("No multi-buffer kernel in this build");
+        return;
+    }
+
+    std::vector<std::array<uint8_t, Tdp::kMessageSize>> batch(
+        RsaMultiBuffer::kLanes);
+    for (auto& m : batch) {
+        sse::crypto::random_bytes(m);
+    }
+
+    for (auto _ : state) {
+        mb.eval(batch.data(), batch.data(), RsaMultiBuffer::kLanes);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations())
+                            * RsaMultiBuffer::kLanes);
+}
+
+BENCHMARK(RsaMultiBuffer_eval);
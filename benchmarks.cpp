@@ -18,6 +18,24 @@
 // along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "src/utils.hpp"
+
 #include <benchmark/benchmark.h>
 
-BENCHMARK_MAIN();
+// The library has to be initialized before running the benchmarks (e.g. to
+// detect the availability of the Prp class), so we cannot use BENCHMARK_MAIN
+
+int main(int argc, char** argv)
+{
+    sse::crypto::init_crypto_lib();
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    ::benchmark::RunSpecifiedBenchmarks();
+
+    sse::crypto::cleanup_crypto_lib();
+
+    return 0;
+}
@@ -272,6 +272,273 @@ static block aez_hash(const aez_ctx_t *ctx, const char *n, unsigned nbytes, unsi
     return vxor(sum,delta3);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Runtime selection of the core passes implementation                       */
+/* ------------------------------------------------------------------------- */
+
+/* pass_one and pass_two process the message in independent 32-byte pairs of
+ * blocks. On CPUs with VAES (Ice Lake, Zen 3 and later), the main loops of
+ * these passes (8 pairs per iteration) can be run on 256 or 512 bits
+ * registers, i.e. on 2 or 4 pairs per AES instruction: the even and odd
+ * blocks of the pairs are de-interleaved in separate registers, and
+ * re-interleaved before being stored. The wide functions are compiled with
+ * function-level target attributes, so that the rest of the file does not
+ * require VAES, and are only used when both the CPU and the OS support them.
+ * The output is identical to the reference code. */
+
+#if __AES__ && (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__clang__) && __clang_major__ >= 8) || \
+     (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 9))
+#define AEZ_VAES 1
+#else
+#define AEZ_VAES 0
+#endif
+
+#if AEZ_VAES
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+static int aez_detect_core_impl(void) {
+    unsigned eax, ebx, ecx, edx, xcr0, xcr0_hi;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 27))) {
+        return AEZ_IMPL_REFERENCE;                      /* no OSXSAVE */
+    }
+    __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0 & 0x06) != 0x06 || __get_cpuid_max(0, NULL) < 7) {
+        return AEZ_IMPL_REFERENCE;                      /* no YMM state */
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (!(ecx & (1u << 9)) || !(ebx & (1u << 5))) {
+        return AEZ_IMPL_REFERENCE;                      /* no VAES/AVX2 */
+    }
+    if ((ebx & (1u << 16)) && (xcr0 & 0xe6) == 0xe6) {
+        return AEZ_IMPL_VAES512;                        /* AVX512F, ZMM state */
+    }
+    return AEZ_IMPL_VAES256;
+}
+
+#define AEZ_TARGET_VAES256 __attribute__((target("aes,vaes,avx2")))
+#define AEZ_TARGET_VAES512 __attribute__((target("aes,vaes,avx512f")))
+
+AEZ_TARGET_VAES256
+static __m256i aes4_256(__m256i in, __m256i a, __m256i b, __m256i c, __m256i d) {
+    in = _mm256_aesenc_epi128(in,a);
+    in = _mm256_aesenc_epi128(in,b);
+    in = _mm256_aesenc_epi128(in,c);
+    return _mm256_aesenc_epi128(in,d);
+}
+
+/* Offsets of the pairs (2k, 2k+1) of a group w.r.t. its base: (2k)I, (2k+1)I */
+AEZ_TARGET_VAES256
+static void deltas_256(const aez_ctx_t *ctx, __m256i delta[4]) {
+    block d[8];
+    unsigned k;
+    d[0] = zero;
+    d[1] = ctx->I[0];
+    d[2] = ctx->I[1];
+    d[3] = vxor(ctx->I[0], ctx->I[1]);
+    for (k=0; k<4; k++) {
+        d[4+k] = vxor(d[k], ctx->I[2]);
+    }
+    for (k=0; k<4; k++) {
+        delta[k] = _mm256_loadu_si256((const __m256i*)(d+2*k));
+    }
+}
+
+AEZ_TARGET_VAES256
+static block fold_256(__m256i x) {
+    return vxor(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x,1));
+}
+
+AEZ_TARGET_VAES256
+static block pass_one_vaes256(const aez_ctx_t *ctx, const block *src, unsigned groups, block *dst, block *Ifordoubling) {
+    const __m256i I = _mm256_broadcastsi128_si256(ctx->I[0]);
+    const __m256i L = _mm256_broadcastsi128_si256(ctx->L);
+    const __m256i J = _mm256_broadcastsi128_si256(ctx->J[0]);
+    __m256i delta[4], sum = _mm256_setzero_si256();
+    __m256i z0, z1, base, o, e, x, y;
+    block ifd = *Ifordoubling;
+    unsigned k;
+    deltas_256(ctx, delta);
+    for (; groups; groups--, src += 16, dst += 16) {
+        base = _mm256_broadcastsi128_si256(bswap16(ifd));
+        ifd = double_block(ifd);
+        for (k=0; k<4; k++) {
+            z0 = _mm256_loadu_si256((const __m256i*)(src+4*k));
+            z1 = _mm256_loadu_si256((const __m256i*)(src+4*k+2));
+            e = _mm256_permute2x128_si256(z0, z1, 0x20);   /* even blocks */
+            o = _mm256_permute2x128_si256(z0, z1, 0x31);   /* odd blocks  */
+            x = aes4_256(_mm256_xor_si256(o, _mm256_xor_si256(base, delta[k])), J, I, L, e);
+            y = aes4_256(x, J, I, L, o);
+            sum = _mm256_xor_si256(sum, y);
+            _mm256_storeu_si256((__m256i*)(dst+4*k), _mm256_permute2x128_si256(x, y, 0x20));
+            _mm256_storeu_si256((__m256i*)(dst+4*k+2), _mm256_permute2x128_si256(x, y, 0x31));
+        }
+    }
+    *Ifordoubling = ifd;
+    return fold_256(sum);
+}
+
+AEZ_TARGET_VAES256
+static block pass_two_vaes256(const aez_ctx_t *ctx, block s, unsigned groups, block *dst, block *Ifordoubling) {
+    const __m256i I = _mm256_broadcastsi128_si256(ctx->I[0]);
+    const __m256i L = _mm256_broadcastsi128_si256(ctx->L);
+    const __m256i J = _mm256_broadcastsi128_si256(ctx->J[0]);
+    const __m256i S = _mm256_broadcastsi128_si256(s);
+    __m256i delta[4], sum = _mm256_setzero_si256();
+    __m256i z0, z1, base, off, fs, t, a, b, c;
+    block ifd = *Ifordoubling;
+    unsigned k;
+    deltas_256(ctx, delta);
+    for (; groups; groups--, dst += 16) {
+        base = _mm256_broadcastsi128_si256(bswap16(ifd));
+        ifd = double_block(ifd);
+        for (k=0; k<4; k++) {
+            off = _mm256_xor_si256(base, delta[k]);
+            z0 = _mm256_loadu_si256((const __m256i*)(dst+4*k));
+            z1 = _mm256_loadu_si256((const __m256i*)(dst+4*k+2));
+            fs = aes4_256(_mm256_xor_si256(S, off), L, I, J, L);
+            t = _mm256_xor_si256(_mm256_permute2x128_si256(z0, z1, 0x20), fs);
+            a = _mm256_xor_si256(_mm256_permute2x128_si256(z0, z1, 0x31), fs);
+            sum = _mm256_xor_si256(sum, t);
+            b = aes4_256(a, J, I, L, t);
+            c = aes4_256(_mm256_xor_si256(b, off), J, I, L, a);
+            _mm256_storeu_si256((__m256i*)(dst+4*k), _mm256_permute2x128_si256(c, b, 0x20));
+            _mm256_storeu_si256((__m256i*)(dst+4*k+2), _mm256_permute2x128_si256(c, b, 0x31));
+        }
+    }
+    *Ifordoubling = ifd;
+    return fold_256(sum);
+}
+
+AEZ_TARGET_VAES512
+static __m512i aes4_512(__m512i in, __m512i a, __m512i b, __m512i c, __m512i d) {
+    in = _mm512_aesenc_epi128(in,a);
+    in = _mm512_aesenc_epi128(in,b);
+    in = _mm512_aesenc_epi128(in,c);
+    return _mm512_aesenc_epi128(in,d);
+}
+
+/* Offsets of the pairs 0..3 and 4..7 of a group w.r.t. its base */
+AEZ_TARGET_VAES512
+static void deltas_512(const aez_ctx_t *ctx, __m512i *delta_lo, __m512i *delta_hi) {
+    block d[4];
+    d[0] = zero;
+    d[1] = ctx->I[0];
+    d[2] = ctx->I[1];
+    d[3] = vxor(ctx->I[0], ctx->I[1]);
+    *delta_lo = _mm512_loadu_si512((const void*)d);
+    *delta_hi = _mm512_xor_si512(*delta_lo, _mm512_broadcast_i32x4(ctx->I[2]));
+}
+
+AEZ_TARGET_VAES512
+static block fold_512(__m512i x) {
+    __m256i y = _mm256_xor_si256(_mm512_castsi512_si256(x), _mm512_extracti64x4_epi64(x,1));
+    return vxor(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y,1));
+}
+
+AEZ_TARGET_VAES512
+static block pass_one_vaes512(const aez_ctx_t *ctx, const block *src, unsigned groups, block *dst, block *Ifordoubling) {
+    const __m512i I = _mm512_broadcast_i32x4(ctx->I[0]);
+    const __m512i L = _mm512_broadcast_i32x4(ctx->L);
+    const __m512i J = _mm512_broadcast_i32x4(ctx->J[0]);
+    const __m512i even  = _mm512_set_epi64(13,12, 9, 8, 5, 4, 1, 0);
+    const __m512i odd   = _mm512_set_epi64(15,14,11,10, 7, 6, 3, 2);
+    const __m512i il_lo = _mm512_set_epi64(11,10, 3, 2, 9, 8, 1, 0);
+    const __m512i il_hi = _mm512_set_epi64(15,14, 7, 6,13,12, 5, 4);
+    __m512i delta[2], sum = _mm512_setzero_si512();
+    __m512i z0, z1, base, o, e, x, y;
+    block ifd = *Ifordoubling;
+    unsigned k;
+    deltas_512(ctx, delta, delta+1);
+    for (; groups; groups--, src += 16, dst += 16) {
+        base = _mm512_broadcast_i32x4(bswap16(ifd));
+        ifd = double_block(ifd);
+        for (k=0; k<2; k++) {
+            z0 = _mm512_loadu_si512((const void*)(src+8*k));
+            z1 = _mm512_loadu_si512((const void*)(src+8*k+4));
+            e = _mm512_permutex2var_epi64(z0, even, z1);
+            o = _mm512_permutex2var_epi64(z0, odd, z1);
+            x = aes4_512(_mm512_xor_si512(o, _mm512_xor_si512(base, delta[k])), J, I, L, e);
+            y = aes4_512(x, J, I, L, o);
+            sum = _mm512_xor_si512(sum, y);
+            _mm512_storeu_si512((void*)(dst+8*k), _mm512_permutex2var_epi64(x, il_lo, y));
+            _mm512_storeu_si512((void*)(dst+8*k+4), _mm512_permutex2var_epi64(x, il_hi, y));
+        }
+    }
+    *Ifordoubling = ifd;
+    return fold_512(sum);
+}
+
+AEZ_TARGET_VAES512
+static block pass_two_vaes512(const aez_ctx_t *ctx, block s, unsigned groups, block *dst, block *Ifordoubling) {
+    const __m512i I = _mm512_broadcast_i32x4(ctx->I[0]);
+    const __m512i L = _mm512_broadcast_i32x4(ctx->L);
+    const __m512i J = _mm512_broadcast_i32x4(ctx->J[0]);
+    const __m512i S = _mm512_broadcast_i32x4(s);
+    const __m512i even  = _mm512_set_epi64(13,12, 9, 8, 5, 4, 1, 0);
+    const __m512i odd   = _mm512_set_epi64(15,14,11,10, 7, 6, 3, 2);
+    const __m512i il_lo = _mm512_set_epi64(11,10, 3, 2, 9, 8, 1, 0);
+    const __m512i il_hi = _mm512_set_epi64(15,14, 7, 6,13,12, 5, 4);
+    __m512i delta[2], sum = _mm512_setzero_si512();
+    __m512i z0, z1, base, off, fs, t, a, b, c;
+    block ifd = *Ifordoubling;
+    unsigned k;
+    deltas_512(ctx, delta, delta+1);
+    for (; groups; groups--, dst += 16) {
+        base = _mm512_broadcast_i32x4(bswap16(ifd));
+        ifd = double_block(ifd);
+        for (k=0; k<2; k++) {
+            off = _mm512_xor_si512(base, delta[k]);
+            z0 = _mm512_loadu_si512((const void*)(dst+8*k));
+            z1 = _mm512_loadu_si512((const void*)(dst+8*k+4));
+            fs = aes4_512(_mm512_xor_si512(S, off), L, I, J, L);
+            t = _mm512_xor_si512(_mm512_permutex2var_epi64(z0, even, z1), fs);
+            a = _mm512_xor_si512(_mm512_permutex2var_epi64(z0, odd, z1), fs);
+            sum = _mm512_xor_si512(sum, t);
+            b = aes4_512(a, J, I, L, t);
+            c = aes4_512(_mm512_xor_si512(b, off), J, I, L, a);
+            _mm512_storeu_si512((void*)(dst+8*k), _mm512_permutex2var_epi64(c, il_lo, b));
+            _mm512_storeu_si512((void*)(dst+8*k+4), _mm512_permutex2var_epi64(c, il_hi, b));
+        }
+    }
+    *Ifordoubling = ifd;
+    return fold_512(sum);
+}
+
+#else
+
+static int aez_detect_core_impl(void) { return AEZ_IMPL_REFERENCE; }
+
+#endif /* AEZ_VAES */
+
+/* AUTO: not resolved yet. Contexts are shared between threads, so the
+ * variable is only accessed atomically (relaxed ordering is enough: every
+ * value it can hold is a valid implementation, and detection is idempotent) */
+static int aez_core_impl_ = AEZ_IMPL_AUTO;
+
+int aez_core_impl(void) {
+    int impl = __atomic_load_n(&aez_core_impl_, __ATOMIC_RELAXED);
+    if (impl == AEZ_IMPL_AUTO) {
+        impl = aez_detect_core_impl();
+        __atomic_store_n(&aez_core_impl_, impl, __ATOMIC_RELAXED);
+    }
+    return impl;
+}
+
+int aez_set_core_impl(int impl) {
+    int best = aez_detect_core_impl();
+    if (impl == AEZ_IMPL_AUTO) {
+        impl = best;
+    }
+    if (impl < AEZ_IMPL_REFERENCE || impl > best) {
+        return -1;
+    }
+    __atomic_store_n(&aez_core_impl_, impl, __ATOMIC_RELAXED);
+    return 0;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static block pass_one(const aez_ctx_t *ctx, const block *src, unsigned bytes, block *dst) {
@@ -279,6 +546,18 @@ static block pass_one(const aez_ctx_t *ctx, const block *src, unsigned bytes, bl
     block I=ctx->I[0], L=ctx->L, J=ctx->J[0];
     block Ifordoubling = double_block(bswap16(ctx->I[2]));  /* I8 */
     offset = bswap16(Ifordoubling);
+#if AEZ_VAES
+    if (bytes >= 16*16 && aez_core_impl() != AEZ_IMPL_REFERENCE) {
+        unsigned groups = bytes / (16*16);
+        if (aez_core_impl() == AEZ_IMPL_VAES512) {
+            sum = pass_one_vaes512(ctx, src, groups, dst, &Ifordoubling);
+        } else {
+            sum = pass_one_vaes256(ctx, src, groups, dst, &Ifordoubling);
+        }
+        offset = bswap16(Ifordoubling);
+        bytes -= groups*16*16; dst += groups*16; src += groups*16;
+    }
+#endif
     while (bytes >= 16*16) {
         o0 = offset;
         o1 = vxor(o0,ctx->I[0]);
@@ -349,6 +628,18 @@ static block pass_two(const aez_ctx_t *ctx, block s, unsigned bytes, block *dst)
     block I=ctx->I[0], L=ctx->L, J=ctx->J[0];
     block Ifordoubling = double_block(bswap16(ctx->I[2]));  /* I8 */
     offset = bswap16(Ifordoubling);
+#if AEZ_VAES
+    if (bytes >= 16*16 && aez_core_impl() != AEZ_IMPL_REFERENCE) {
+        unsigned groups = bytes / (16*16);
+        if (aez_core_impl() == AEZ_IMPL_VAES512) {
+            sum = pass_two_vaes512(ctx, s, groups, dst, &Ifordoubling);
+        } else {
+            sum = pass_two_vaes256(ctx, s, groups, dst, &Ifordoubling);
+        }
+        offset = bswap16(Ifordoubling);
+        bytes -= groups*16*16; dst += groups*16;
+    }
+#endif
     while (bytes >= 16*16) {
         o0 = offset;
         o1 = vxor(o0,ctx->I[0]);
@@ -483,7 +774,8 @@ static int cipher_aez_core(const aez_ctx_t *ctx, block t, int d, const char *src
     if (d || !abytes) {
         final1 = loadu(src+(bytes-32)+16);
     } else {
-        final1 = zero_pad(loadu(src+(bytes-32)+16), abytes);
+        /* the abytes zero bytes are not part of src: do not read them */
+        final1 = load_partial(src+(bytes-32)+16, 16-abytes);
     }
     final0 = aes4(vxor(final1, ctx->I[d]), J, I, L, final0);
     final1 = vxor(final1, aes((const block*)ctx, final0, ctx->J[d]));
@@ -629,11 +921,130 @@ static int cipher_aez_tiny(const aez_ctx_t *ctx, block t, int d, const char *src
 
 /* ------------------------------------------------------------------------- */
 
-void aez_encrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
-                 unsigned abytes,
-                 const char *src, unsigned bytes, char *dst) {
+/* Multi-message version of cipher_aez_tiny, restricted to abytes == 0 and
+ * 0 < bytes < 32: enciphers (d == 0) or deciphers (d == 1) count messages of
+ * the same length, stored contiguously, under the same tweak t. The Feistel
+ * rounds of up to AEZ_TINY_LANES messages are interleaved: they are
+ * independent, so the AES pipeline is kept full instead of waiting on the
+ * serial aes4 chain of a single message. The output is identical to calling
+ * cipher_aez_tiny on each message. src and dst may alias. */
+#define AEZ_TINY_LANES 8
+static void cipher_aez_tiny_lanes(const aez_ctx_t *ctx, block t, int d, const char *src, unsigned bytes, unsigned count, char *dst) {
+    block l[AEZ_TINY_LANES], r[AEZ_TINY_LANES], buf[AEZ_TINY_LANES][2];
+    block tmp, one, rcon, rcon_init, mask_10, mask_ff;
+    block I=ctx->I[0], L=ctx->L, J=ctx->J[0], t_orig = t;
+    unsigned rnds, lanes, i, k;
+
+    /* create 10* padding masks, common to all the messages */
+    mask_ff = loadu(pad+16-bytes/2);
+    mask_10 = loadu(pad+32-bytes/2);
+    if (bytes&1) {  /* Odd length. Deal with nibbles. */
+        mask_10 = sll4(mask_10);
+        ((char*)&mask_ff)[bytes/2] = (char)0xf0;
+    }
+
+    /* Add tweak offset into t, and determine the number of rounds */
+    if (bytes >= 16) {
+        t = vxor3(t, ctx->I[1], ctx->I[2]);             /* (0,6) offset */
+        rnds = 8;
+    } else {
+        t = vxor4(t, ctx->I[0], ctx->I[1], ctx->I[2]);  /* (0,7) offset */
+        if (bytes>=3) {
+            rnds = 10;
+        } else if (bytes==2) {
+            rnds = 16;
+        } else {
+            rnds = 24;
+        }
+    }
+
+    if (!d) {
+        one = zero_set_byte(1,15);
+        rcon_init = zero;
+    } else {
+        one = zero_set_byte(-1,15);
+        rcon_init = zero_set_byte((char)(rnds-1),15);
+    }
+
+    while (count > 0) {
+        lanes = (count < AEZ_TINY_LANES ? count : AEZ_TINY_LANES);
+
+        /* load src into buf, zero pad, and load l/r */
+        for (k=0; k<lanes; k++, src+=bytes) {
+            if (bytes >= 16) {
+                buf[k][0] = load(src);
+                buf[k][1] = zero_pad(load_partial(src+16,bytes-16),32-bytes);
+            } else {
+                buf[k][0] = zero_pad(load_partial(src,bytes),16-bytes);
+                buf[k][1] = zero;
+            }
+            l[k] = buf[k][0];
+            r[k] = loadu((char*)buf[k]+bytes/2);
+            if (bytes&1) {
+                r[k] = bswap16(srl4(bswap16(r[k])));
+            }
+            r[k] = vor(vand(r[k], mask_ff), mask_10);
+
+            if ((d) && (bytes < 16)) {
+                tmp = vor(l[k], loadu(pad+32));
+                tmp = aes4(vxor4(tmp,t_orig,ctx->I[0],ctx->I[1]), J, I, L, zero);
+                tmp = vand(tmp, loadu(pad+32));
+                l[k] = vxor(l[k], tmp);
+            }
+        }
+
+        /* Feistel */
+        rcon = rcon_init;
+        for (i=0; i<rnds; i+=2) {
+            for (k=0; k<lanes; k++) {
+                l[k] = vor(vand(aes4(vxor3(t,r[k],rcon), J, I, L, l[k]), mask_ff), mask_10);
+            }
+            rcon = vadd(rcon,one);
+            for (k=0; k<lanes; k++) {
+                r[k] = vor(vand(aes4(vxor3(t,l[k],rcon), J, I, L, r[k]), mask_ff), mask_10);
+            }
+            rcon = vadd(rcon,one);
+        }
+
+        for (k=0; k<lanes; k++, dst+=bytes) {
+            buf[k][0] = r[k];
+            if (bytes&1) {
+                l[k] = bswap16(sll4(bswap16(l[k])));
+                tmp = vand(loadu((char*)buf[k]+bytes/2), zero_set_byte((char)0xf0,0));
+                l[k] = vor(l[k], tmp);
+            }
+            storeu((char*)buf[k]+bytes/2, l[k]);
+            if ((!d) && (bytes < 16)) {
+                tmp = vor(zero_pad(buf[k][0], 16-bytes), loadu(pad+32));
+                tmp = aes4(vxor4(tmp,t_orig,ctx->I[0],ctx->I[1]), J, I, L, zero);
+                buf[k][0] = vxor(buf[k][0], vand(tmp, loadu(pad+32)));
+            }
+            for (i=0; i<bytes; i++) {
+                dst[i] = ((char*)buf[k])[i];
+            }
+        }
+        count -= lanes;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* The tweak block computed from the nonce only depends on the key, the nonce
+ * and abytes. Callers using a constant nonce can compute it once with
+ * aez_setup_tweak and use the *_tweak entry points, which skip aez_hash. The
+ * tweak is read and written with unaligned accesses. */
+void aez_setup_tweak(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
+                     unsigned abytes, block *tweak) {
+    storeu(tweak, aez_hash(ctx, n, nbytes, abytes));
+}
+
+/* ------------------------------------------------------------------------- */
+
+void aez_encrypt_tweak(const aez_ctx_t *ctx, const block *tweak,
+                       unsigned abytes,
+                       const char *src, unsigned bytes, char *dst) {
     
-    block t = aez_hash(ctx, n, nbytes, abytes);
+    block t = loadu(tweak);
     if (bytes==0) {
         unsigned i;
         t = aes((const block*)ctx, t, vxor(ctx->J[0], ctx->J[1]));
@@ -647,24 +1058,217 @@ void aez_encrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
     }
 }
 
+void aez_encrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
+                 unsigned abytes,
+                 const char *src, unsigned bytes, char *dst) {
+    
+    block t = aez_hash(ctx, n, nbytes, abytes);
+    aez_encrypt_tweak(ctx, &t, abytes, src, bytes, dst);
+}
+
 /* ------------------------------------------------------------------------- */
 
-int aez_decrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
-                unsigned abytes,
-                const char *src, unsigned bytes, char *dst) {
+int aez_decrypt_tweak(const aez_ctx_t *ctx, const block *tweak,
+                      unsigned abytes,
+                      const char *src, unsigned bytes, char *dst) {
     
     block t;
     if (bytes < abytes) {
         return -1;
     }
-    t = aez_hash(ctx, n, nbytes, abytes);
+    t = loadu(tweak);
     if (bytes==abytes) {
         block claimed = zero_pad(load_partial(src,abytes), 16-abytes);
         t = zero_pad(aes((const block*)ctx, t, vxor(ctx->J[0], ctx->J[1])), 16-abytes);
-        return is_zero(vandnot(t, claimed)) - 1;  /* is_zero return 0 or 1 */
+        return is_zero(vxor(t, claimed)) - 1;  /* is_zero return 0 or 1 */
     }
     if (bytes < 32) {
         return cipher_aez_tiny(ctx, t, 1, src, bytes, abytes, dst);
     }
     return cipher_aez_core(ctx, t, 1, src, bytes, abytes, dst);
 }
+
+int aez_decrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
+                unsigned abytes,
+                const char *src, unsigned bytes, char *dst) {
+    
+    block t = aez_hash(ctx, n, nbytes, abytes);
+    return aez_decrypt_tweak(ctx, &t, abytes, src, bytes, dst);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Enciphers (d == 0) or deciphers (d == 1) count messages of bytes bytes
+ * each, stored contiguously, with the same tweak and without authenticator
+ * (abytes == 0). Short messages go through the interleaved tiny cipher. The
+ * tweak must have been computed with abytes == 0. */
+static void aez_batch(const aez_ctx_t *ctx, const block *tweak, int d,
+                      const char *src, unsigned bytes, unsigned count,
+                      char *dst) {
+    block t;
+    unsigned i;
+    if (bytes==0 || count==0) {
+        return;
+    }
+    t = loadu(tweak);
+    if (bytes < 32) {
+        cipher_aez_tiny_lanes(ctx, t, d, src, bytes, count, dst);
+    } else {
+        for (i=0; i<count; i++, src+=bytes, dst+=bytes) {
+            cipher_aez_core(ctx, t, d, src, bytes, 0, dst);
+        }
+    }
+}
+
+void aez_encrypt_batch(const aez_ctx_t *ctx, const block *tweak,
+                       const char *src, unsigned bytes, unsigned count,
+                       char *dst) {
+    aez_batch(ctx, tweak, 0, src, bytes, count, dst);
+}
+
+void aez_decrypt_batch(const aez_ctx_t *ctx, const block *tweak,
+                       const char *src, unsigned bytes, unsigned count,
+                       char *dst) {
+    aez_batch(ctx, tweak, 1, src, bytes, count, dst);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Evaluates AEZ's AES10 (round keys I,J,L,I,J,L,I,J,L,I) on nblocks 16-byte
+ * blocks, whitened with 7J, an offset that aez_encrypt/aez_decrypt never use.
+ * This exposes the AES core of the context as a fixed-width block cipher for
+ * constructions built on top of AEZ's key schedule (e.g. small-domain
+ * Feistel networks). Blocks are processed four at a time so that the
+ * independent AES evaluations fill the AES pipeline. src and dst may alias. */
+void aez_aes10_blocks(const aez_ctx_t *ctx, const char *src, unsigned nblocks,
+                      char *dst) {
+    const block w = vxor3(ctx->J[0], ctx->J[1], ctx->J[2]);
+    while (nblocks >= 4) {
+        block b0 = loadu(src);
+        block b1 = loadu(src+16);
+        block b2 = loadu(src+32);
+        block b3 = loadu(src+48);
+        b0 = aes((const block*)ctx, b0, w);
+        b1 = aes((const block*)ctx, b1, w);
+        b2 = aes((const block*)ctx, b2, w);
+        b3 = aes((const block*)ctx, b3, w);
+        storeu(dst, b0);
+        storeu(dst+16, b1);
+        storeu(dst+32, b2);
+        storeu(dst+48, b3);
+        src += 64; dst += 64; nblocks -= 4;
+    }
+    while (nblocks > 0) {
+        storeu(dst, aes((const block*)ctx, loadu(src), w));
+        src += 16; dst += 16; nblocks--;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Fixed-width Feistel PRP (not part of AEZ)                                 */
+/* ------------------------------------------------------------------------- */
+
+/* Balanced Feistel network over 32 or 64 bits integers, whose round function
+ * is AES4 (four AES rounds, as in AEZ's own small-message Feistel network)
+ * under four round keys K1..K4, applied to the half block xored with a
+ * whitening block W_i = T xor (i, half width). K1..K4 and T are derived from
+ * the AEZ context with aez_aes10_blocks, on constants that are distinct from
+ * any other use of this function in the library. 8 rounds are used for 64
+ * bits blocks and 12 rounds for 32 bits blocks. The high half of the integer
+ * is the left half of the network. */
+
+#define AEZ_FEISTEL_MAX_ROUNDS 12
+
+void aez_feistel_setup(const aez_ctx_t *ctx, block *keys) {
+    unsigned char constants[16*AEZ_FEISTEL_KEY_BLOCKS];
+    unsigned i;
+    memset(constants, 0, sizeof(constants));
+    for (i=0; i<AEZ_FEISTEL_KEY_BLOCKS; i++) {
+        constants[16*i] = (unsigned char)i;
+        constants[16*i+15] = 0xfe;
+    }
+    aez_aes10_blocks(ctx, (const char*)constants, AEZ_FEISTEL_KEY_BLOCKS,
+                     (char*)keys);
+}
+
+/* Round function, on the half block x: AES4(x xor w, K1, K2, K3, K4). */
+#define FEISTEL_F(x, w) \
+    (b = zero, memcpy(&b, &(x), 4), b = aes4(vxor(b, w), K1, K2, K3, K4), \
+     memcpy(&f, &b, 4), f & mask)
+
+static void feistel_lanes(const block *keys, int d, unsigned width,
+                          const char *src, unsigned count, char *dst) {
+    const unsigned half_bits = 4*width;
+    const unsigned rnds = (width == 8 ? 8 : 12);
+    const uint32_t mask = (width == 8 ? 0xffffffffu : 0xffffu);
+    const block K1 = loadu(keys), K2 = loadu(keys+1);
+    const block K3 = loadu(keys+2), K4 = loadu(keys+3);
+    block w[AEZ_FEISTEL_MAX_ROUNDS], b;
+    uint32_t l[AEZ_TINY_LANES], r[AEZ_TINY_LANES], x, f;
+    uint64_t v;
+    unsigned lanes, i, k;
+
+    for (i=0; i<rnds; i++) {
+        w[i] = vxor3(loadu(keys+4), zero_set_byte((char)i,15),
+                     zero_set_byte((char)half_bits,14));
+    }
+
+    while (count > 0) {
+        lanes = (count < AEZ_TINY_LANES ? count : AEZ_TINY_LANES);
+        for (k=0; k<lanes; k++, src+=width) {
+            if (width == 8) {
+                memcpy(&v, src, 8);
+            } else {
+                memcpy(&x, src, 4);
+                v = x;
+            }
+            l[k] = (uint32_t)(v >> half_bits);
+            r[k] = (uint32_t)v & mask;
+        }
+        if (!d) {                   /* (L, R) <- (R, L ^ F(R)) */
+            for (i=0; i<rnds; i++) {
+                for (k=0; k<lanes; k++) {
+                    x = r[k]; r[k] = l[k] ^ FEISTEL_F(x, w[i]); l[k] = x;
+                }
+            }
+        } else {                    /* (L, R) <- (R ^ F(L), L) */
+            for (i=rnds; i-- > 0; ) {
+                for (k=0; k<lanes; k++) {
+                    x = l[k]; l[k] = r[k] ^ FEISTEL_F(x, w[i]); r[k] = x;
+                }
+            }
+        }
+        for (k=0; k<lanes; k++, dst+=width) {
+            v = ((uint64_t)l[k] << half_bits) | r[k];
+            if (width == 8) {
+                memcpy(dst, &v, 8);
+            } else {
+                x = (uint32_t)v;
+                memcpy(dst, &x, 4);
+            }
+        }
+        count -= lanes;
+    }
+}
+
+#undef FEISTEL_F
+
+void aez_feistel_encrypt_32(const block *keys, const uint32_t *src,
+                            unsigned count, uint32_t *dst) {
+    feistel_lanes(keys, 0, 4, (const char*)src, count, (char*)dst);
+}
+
+void aez_feistel_decrypt_32(const block *keys, const uint32_t *src,
+                            unsigned count, uint32_t *dst) {
+    feistel_lanes(keys, 1, 4, (const char*)src, count, (char*)dst);
+}
+
+void aez_feistel_encrypt_64(const block *keys, const uint64_t *src,
+                            unsigned count, uint64_t *dst) {
+    feistel_lanes(keys, 0, 8, (const char*)src, count, (char*)dst);
+}
+
+void aez_feistel_decrypt_64(const block *keys, const uint64_t *src,
+                            unsigned count, uint64_t *dst) {
+    feistel_lanes(keys, 1, 8, (const char*)src, count, (char*)dst);
+}
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +38,21 @@ typedef struct {
 
 
 
+/* Implementations of the AEZ core passes, used for messages of 32 bytes or
+ * more (see aez_set_core_impl) */
+#define AEZ_IMPL_AUTO      0  /* Best implementation supported by the CPU */
+#define AEZ_IMPL_REFERENCE 1  /* 128 bits AES-NI or ARM code */
+#define AEZ_IMPL_VAES256   2  /* VAES + AVX2 (256 bits registers) */
+#define AEZ_IMPL_VAES512   3  /* VAES + AVX-512F (512 bits registers) */
+
+/* Returns the implementation currently in use (never AEZ_IMPL_AUTO) */
+int aez_core_impl(void);
+/* Selects the implementation used by subsequent calls, for all contexts.
+ * Returns 0 on success, -1 if the implementation is not supported. It can be
+ * called while other threads use AEZ, but is meant for initialization, tests
+ * and benchmarks. */
+int aez_set_core_impl(int impl);
+
 void aez_setup(const unsigned char *key, unsigned keylen, aez_ctx_t *ctx);
 void aez_encrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
                  unsigned abytes,
@@ -43,6 +60,34 @@ void aez_encrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
 int aez_decrypt(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
                  unsigned abytes,
                  const char *src, unsigned bytes, char *dst);
+void aez_setup_tweak(const aez_ctx_t *ctx, const char *n, unsigned nbytes,
+                     unsigned abytes, block *tweak);
+void aez_encrypt_tweak(const aez_ctx_t *ctx, const block *tweak,
+                       unsigned abytes,
+                       const char *src, unsigned bytes, char *dst);
+int aez_decrypt_tweak(const aez_ctx_t *ctx, const block *tweak,
+                      unsigned abytes,
+                      const char *src, unsigned bytes, char *dst);
+void aez_encrypt_batch(const aez_ctx_t *ctx, const block *tweak,
+                       const char *src, unsigned bytes, unsigned count,
+                       char *dst);
+void aez_decrypt_batch(const aez_ctx_t *ctx, const block *tweak,
+                       const char *src, unsigned bytes, unsigned count,
+                       char *dst);
+void aez_aes10_blocks(const aez_ctx_t *ctx, const char *src, unsigned nblocks,
+                      char *dst);
+
+/* Fixed-width Feistel PRP built on AES4 (not part of AEZ) */
+#define AEZ_FEISTEL_KEY_BLOCKS 5
+void aez_feistel_setup(const aez_ctx_t *ctx, block *keys);
+void aez_feistel_encrypt_32(const block *keys, const uint32_t *src,
+                            unsigned count, uint32_t *dst);
+void aez_feistel_decrypt_32(const block *keys, const uint32_t *src,
+                            unsigned count, uint32_t *dst);
+void aez_feistel_encrypt_64(const block *keys, const uint64_t *src,
+                            unsigned count, uint64_t *dst);
+void aez_feistel_decrypt_64(const block *keys, const uint64_t *src,
+                            unsigned count, uint64_t *dst);
 
 #ifdef __cplusplus
 }
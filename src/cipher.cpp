@@ -20,13 +20,30 @@
 
 #include "cipher.hpp"
 
+#include "parallel/process_batch.hpp"
 #include "random.hpp"
 
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <exception>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include <sodium/crypto_aead_aes256gcm.h>
 #include <sodium/crypto_aead_chacha20poly1305.h>
+#include <sodium/crypto_aead_xchacha20poly1305.h>
 #include <sodium/crypto_generichash_blake2b.h>
+#include <sodium/crypto_secretstream_xchacha20poly1305.h>
 #include <sodium/utils.h>
 
 namespace sse {
@@ -39,26 +56,105 @@ static constexpr uint8_t
     hash_personal__[crypto_generichash_blake2b_PERSONALBYTES]
     = "encryption_key";
 
+#define XCHACHA_NONCE_SIZE crypto_aead_xchacha20poly1305_ietf_NPUBBYTES
+
+// First byte of the ciphertexts in the kXChaCha20Poly1305 mode
+static constexpr uint8_t xchacha_format_tag__ = 0x01;
+static constexpr size_t  xchacha_header_size__ = 1 + XCHACHA_NONCE_SIZE;
+
+// First byte of the ciphertexts in the kAES256GCM mode. The 128 bits nonce
+// is only used to derive the AES key, and AES-GCM is always called with an
+// all-zero IV
+static constexpr uint8_t aes_gcm_format_tag__  = 0x03;
+static constexpr size_t  aes_gcm_header_size__ = 1 + NONCE_SIZE;
+static constexpr uint8_t aes_gcm_iv__[crypto_aead_aes256gcm_NPUBBYTES] = {0};
+
+// Maximum message length of AES-GCM: 2^32-2 blocks
+static constexpr unsigned long long aes_gcm_max_length__ // NOLINT
+    = 16ULL * ((1ULL << 32) - 2);
+
+static constexpr uint8_t
+    aes_gcm_personal__[crypto_generichash_blake2b_PERSONALBYTES]
+    = "aes_gcm_key";
+
+// Streams start with a format tag and the chunk size (32 bits, little
+// endian), authenticated with every chunk, followed by the secretstream
+// header
+static constexpr uint8_t stream_format_tag__  = 0x02;
+static constexpr size_t  stream_prefix_size__ = 1 + 4;
+static constexpr size_t  stream_header_size__
+    = stream_prefix_size__ + crypto_secretstream_xchacha20poly1305_HEADERBYTES;
+
+static constexpr uint8_t
+    stream_personal__[crypto_generichash_blake2b_PERSONALBYTES]
+    = "stream_key";
+
+// Number of nonces drawn at once by encrypt_batch and encrypt_records
+static constexpr size_t batch_nonce_block__ = 1024;
+
+// Scheduling of encrypt_records: the weight of a record is its length plus
+// bulk_record_weight__ (the cost of the nonce and of the key setup, in bytes
+// of payload). Tasks weigh about 1/bulk_tasks_per_thread__ of the share of a
+// thread (within bounds), and at most bulk_window__ tasks per thread are
+// scheduled ahead of the output.
+static constexpr size_t bulk_record_weight__    = 256;
+static constexpr size_t bulk_tasks_per_thread__ = 16;
+static constexpr size_t bulk_min_task_weight__  = 1 << 14;
+static constexpr size_t bulk_max_task_weight__  = 1 << 22;
+static constexpr size_t bulk_window__           = 4;
+
+constexpr size_t Cipher::kStreamChunkSize;
+constexpr size_t Cipher::kMaxStreamChunkSize;
+
 class Cipher::CipherImpl
 {
 public:
     CipherImpl() = delete;
 
-    explicit CipherImpl(Key<kKeySize>&& k) noexcept;
+    CipherImpl(Key<kKeySize>&& k, const Mode mode);
 
     ~CipherImpl() = default;
 
-    inline static size_t ciphertext_length(const size_t plaintext_len) noexcept
+    inline Mode mode() const noexcept
+    {
+        return mode_;
+    }
+
+    inline static size_t overhead(const Mode mode) noexcept
+    {
+        if (mode == Mode::kXChaCha20Poly1305) {
+            return xchacha_header_size__
+                   + crypto_aead_xchacha20poly1305_ietf_ABYTES;
+        }
+        if (mode == Mode::kAES256GCM) {
+            return aes_gcm_header_size__ + crypto_aead_aes256gcm_ABYTES;
+        }
+        return NONCE_SIZE + crypto_aead_chacha20poly1305_IETF_ABYTES;
+    }
+
+    // Position and size of the random nonce in a ciphertext
+    inline static size_t nonce_offset(const Mode mode) noexcept
     {
-        return plaintext_len + NONCE_SIZE
-               + crypto_aead_chacha20poly1305_IETF_ABYTES;
+        return (mode == Mode::kChaCha20Poly1305) ? 0 : 1;
+    }
+
+    inline static size_t nonce_size(const Mode mode) noexcept
+    {
+        return (mode == Mode::kXChaCha20Poly1305) ? XCHACHA_NONCE_SIZE
+                                                  : NONCE_SIZE;
+    }
+
+    inline static size_t ciphertext_length(const size_t plaintext_len,
+                                           const Mode   mode) noexcept
+    {
+        return plaintext_len + overhead(mode);
     };
 
-    inline static size_t plaintext_length(const size_t c_len) noexcept
+    inline static size_t plaintext_length(const size_t c_len,
+                                          const Mode   mode) noexcept
     {
-        if (c_len > NONCE_SIZE + crypto_aead_chacha20poly1305_IETF_ABYTES) {
-            return c_len - NONCE_SIZE
-                   - crypto_aead_chacha20poly1305_IETF_ABYTES;
+        if (c_len > overhead(mode)) {
+            return c_len - overhead(mode);
         }
         return 0;
     };
@@ -72,14 +168,79 @@ public:
                  unsigned char*       out);
     void decrypt(const std::string& in, std::string& out);
 
+    void encrypt_batch(const std::vector<std::string>& in,
+                       std::vector<uint8_t>&           arena,
+                       std::vector<size_t>&            offsets,
+                       const unsigned int              n_threads);
+    size_t decrypt_batch(const std::vector<std::string>& in,
+                         std::vector<uint8_t>&           arena,
+                         std::vector<size_t>&            offsets,
+                         std::vector<uint64_t>&          status,
+                         const unsigned int              n_threads);
+
+    BulkStats encrypt_records(const std::vector<Record>& records,
+                              const RecordWriter&        out,
+                              unsigned int               n_threads);
+
+    void encrypt_stream(const StreamReader& in,
+                        const StreamWriter& out,
+                        const size_t        chunk_size);
+    void decrypt_stream(const StreamReader& in, const StreamWriter& out);
+
 private:
+    // The original mode keeps the key inaccessible between two calls. The
+    // other ones are meant to be fast on short messages: their key is kept
+    // read-only (it remains in guarded memory) rather than paying two
+    // mprotect calls per message, which cost more than the encryption of a
+    // short message (see the documentation of Cipher::Mode).
+    inline bool relocks_key() const noexcept
+    {
+        return mode_ == Mode::kChaCha20Poly1305;
+    }
+
+    void check_plaintext_length(const size_t len) const;
+
+    void derive_stream_key(uint8_t* stream_key);
+
     static_assert(crypto_generichash_blake2b_KEYBYTES == kKeySize,
                   "Invalid Cipher key size");
+    static_assert(crypto_aead_xchacha20poly1305_ietf_KEYBYTES == kKeySize,
+                  "Invalid Cipher key size");
+    static_assert(NONCE_SIZE == crypto_generichash_blake2b_SALTBYTES,
+                  "Invalid nonce size");
     Key<crypto_generichash_blake2b_KEYBYTES> key_;
+    const Mode                               mode_;
 };
 
-Cipher::Cipher(Key<kKeySize>&& k) : cipher_imp_(new CipherImpl(std::move(k)))
+Cipher::Cipher(Key<kKeySize>&& k)
+    : cipher_imp_(new CipherImpl(std::move(k), Mode::kChaCha20Poly1305))
+{
+}
+
+Cipher::Cipher(Key<kKeySize>&& k, const Mode mode)
+    : cipher_imp_(Cipher::is_available(mode)
+                      ? new CipherImpl(std::move(k), mode)
+                      : nullptr)
+{
+    if (!Cipher::is_available(mode)) {
+        throw std::runtime_error("This Cipher mode is unavailable: AES "
+                                 "hardware acceleration not supported by the "
+                                 "CPU");
+    }
+}
+
+bool Cipher::is_available(const Mode mode) noexcept
+{
+    if (mode == Mode::kAES256GCM) {
+        return crypto_aead_aes256gcm_is_available() == 1;
+    }
+    return true;
+}
+
+Cipher::Mode Cipher::preferred_mode() noexcept
 {
+    return is_available(Mode::kAES256GCM) ? Mode::kAES256GCM
+                                          : Mode::kXChaCha20Poly1305;
 }
 
 Cipher::~Cipher()
@@ -87,6 +248,11 @@ Cipher::~Cipher()
     delete cipher_imp_;
 }
 
+Cipher::Mode Cipher::mode() const noexcept
+{
+    return cipher_imp_->mode();
+}
+
 void Cipher::encrypt(const std::string& in, std::string& out)
 {
     cipher_imp_->encrypt(in, out);
@@ -96,14 +262,122 @@ void Cipher::decrypt(const std::string& in, std::string& out)
     cipher_imp_->decrypt(in, out);
 }
 
+void Cipher::encrypt_batch(const std::vector<std::string>& in,
+                           std::vector<uint8_t>&           arena,
+                           std::vector<size_t>&            offsets,
+                           const unsigned int              n_threads)
+{
+    cipher_imp_->encrypt_batch(in, arena, offsets, n_threads);
+}
+
+size_t Cipher::decrypt_batch(const std::vector<std::string>& in,
+                             std::vector<uint8_t>&           arena,
+                             std::vector<size_t>&            offsets,
+                             std::vector<uint64_t>&          status,
+                             const unsigned int              n_threads)
+{
+    return cipher_imp_->decrypt_batch(in, arena, offsets, status, n_threads);
+}
+
+Cipher::BulkStats Cipher::encrypt_records(const std::vector<Record>& records,
+                                          const RecordWriter&        out,
+                                          const unsigned int         n_threads)
+{
+    return cipher_imp_->encrypt_records(records, out, n_threads);
+}
+
+void Cipher::encrypt_stream(const StreamReader& in,
+                            const StreamWriter& out,
+                            const size_t        chunk_size)
+{
+    cipher_imp_->encrypt_stream(in, out, chunk_size);
+}
+
+void Cipher::decrypt_stream(const StreamReader& in, const StreamWriter& out)
+{
+    cipher_imp_->decrypt_stream(in, out);
+}
+
+static Cipher::StreamReader fd_reader(const int fd)
+{
+    return [fd](uint8_t* buf, size_t len) -> size_t {
+        ssize_t ret;
+        do {
+            ret = ::read(fd, buf, len);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret == -1) {
+            throw std::runtime_error("Error when reading from the stream: "
+                                     + std::string(strerror(errno)));
+        }
+        return static_cast<size_t>(ret);
+    };
+}
+
+static Cipher::StreamWriter fd_writer(const int fd)
+{
+    return [fd](const uint8_t* buf, size_t len) {
+        while (len > 0) {
+            ssize_t ret = ::write(fd, buf, len);
+            if (ret == -1 && errno == EINTR) {
+                continue;
+            }
+            if (ret == -1) {
+                throw std::runtime_error("Error when writing to the stream: "
+                                         + std::string(strerror(errno)));
+            }
+            buf += ret;
+            len -= static_cast<size_t>(ret);
+        }
+    };
+}
+
+void Cipher::encrypt_stream(const int    in_fd,
+                            const int    out_fd,
+                            const size_t chunk_size)
+{
+    cipher_imp_->encrypt_stream(
+        fd_reader(in_fd), fd_writer(out_fd), chunk_size);
+}
+
+void Cipher::decrypt_stream(const int in_fd, const int out_fd)
+{
+    cipher_imp_->decrypt_stream(fd_reader(in_fd), fd_writer(out_fd));
+}
+
+size_t Cipher::stream_ciphertext_length(const size_t plaintext_len,
+                                        const size_t chunk_size) noexcept
+{
+    if (chunk_size == 0) {
+        return 0;
+    }
+    // the last chunk is always shorter than chunk_size (possibly empty)
+    const size_t n_chunks = plaintext_len / chunk_size + 1;
+    return stream_header_size__ + plaintext_len
+           + n_chunks * crypto_secretstream_xchacha20poly1305_ABYTES;
+}
+
 size_t Cipher::ciphertext_length(const size_t plaintext_len) noexcept
 {
-    return Cipher::CipherImpl::ciphertext_length(plaintext_len);
+    return Cipher::CipherImpl::ciphertext_length(plaintext_len,
+                                                 Mode::kChaCha20Poly1305);
+}
+
+size_t Cipher::ciphertext_length(const size_t plaintext_len,
+                                 const Mode   mode) noexcept
+{
+    return Cipher::CipherImpl::ciphertext_length(plaintext_len, mode);
 }
 
 size_t Cipher::plaintext_length(const size_t c_len) noexcept
 {
-    return Cipher::CipherImpl::plaintext_length(c_len);
+    return Cipher::CipherImpl::plaintext_length(c_len,
+                                                Mode::kChaCha20Poly1305);
+}
+
+size_t Cipher::plaintext_length(const size_t c_len, const Mode mode) noexcept
+{
+    return Cipher::CipherImpl::plaintext_length(c_len, mode);
 }
 
 // Cipher implementation
@@ -115,36 +389,34 @@ size_t Cipher::plaintext_length(const size_t c_len) noexcept
 // most to retain 32 bits of security) and from the IV length (not more than
 // 2^(8*kIVSize) different IVs)
 
-Cipher::CipherImpl::CipherImpl(Key<kKeySize>&& k) noexcept : key_(std::move(k))
+Cipher::CipherImpl::CipherImpl(Key<kKeySize>&& k, const Mode mode)
+    : key_(std::move(k)), mode_(mode)
 {
+    if (!relocks_key()) {
+        key_.unlock();
+    }
 }
 
-void Cipher::CipherImpl::encrypt(const unsigned char* in,
-                                 const size_t&        len,
-                                 unsigned char*       out)
+// Encrypts len bytes from in to out with the kChaCha20Poly1305 construction.
+// The nonce must already be at the beginning of out.
+static void seal_chacha20poly1305(const uint8_t*       key,
+                                  const unsigned char* in,
+                                  const size_t         len,
+                                  unsigned char*       out)
 {
     uint8_t            chacha_key[crypto_aead_chacha20poly1305_KEYBYTES];
     unsigned long long c_len = 0; // NOLINT
 
-    // generate a random nonce, and place it at the beginning of the output
-    random_bytes(NONCE_SIZE, out);
-
-    // unlock the master key
-    key_.unlock();
-
     // start by deriving a subkey from the master and the nonce
     crypto_generichash_blake2b_salt_personal(chacha_key,
                                              sizeof(chacha_key),
                                              nullptr,
                                              0,
-                                             key_.data(),
-                                             kKeySize,
+                                             key,
+                                             Cipher::kKeySize,
                                              out,
                                              hash_personal__);
 
-    // re-lock the master key
-    key_.lock();
-
     // go for encryption with the derived key
     crypto_aead_chacha20poly1305_ietf_encrypt(out + NONCE_SIZE,
                                               &c_len,
@@ -160,55 +432,107 @@ void Cipher::CipherImpl::encrypt(const unsigned char* in,
     sodium_memzero(chacha_key, crypto_aead_chacha20poly1305_KEYBYTES);
 }
 
-void Cipher::CipherImpl::encrypt(const std::string& in, std::string& out)
+// Encrypts len bytes from in to out with the kXChaCha20Poly1305
+// construction. The nonce must already be in out, after the format tag.
+static void seal_xchacha20poly1305(const uint8_t*       key,
+                                   const unsigned char* in,
+                                   const size_t         len,
+                                   unsigned char*       out)
 {
-    if (in.empty()) {
-        throw std::invalid_argument(
-            "The minimum number of bytes to encrypt is 1.");
-    }
+    unsigned long long c_len = 0; // NOLINT
 
-    size_t         len   = in.size();
-    size_t         c_len = ciphertext_length(len);
-    unsigned char* data  = new unsigned char[c_len];
+    out[0] = xchacha_format_tag__;
 
-    encrypt(reinterpret_cast<const unsigned char*>(in.data()), len, data);
-    out = std::string(reinterpret_cast<char*>(data), c_len);
+    // the key is directly used: HChaCha20 derives the subkey from the nonce
+    crypto_aead_xchacha20poly1305_ietf_encrypt(out + xchacha_header_size__,
+                                               &c_len,
+                                               in,
+                                               len,
+                                               out,
+                                               1,
+                                               nullptr,
+                                               out + 1,
+                                               key);
+}
 
-    // erase the buffer
-    sodium_memzero(data, c_len);
+// Encrypts len bytes from in to out with the kAES256GCM construction. The
+// nonce must already be in out, after the format tag.
+static void seal_aes256gcm(const uint8_t*       key,
+                           const unsigned char* in,
+                           const size_t         len,
+                           unsigned char*       out)
+{
+    uint8_t            gcm_key[crypto_aead_aes256gcm_KEYBYTES];
+    unsigned long long c_len = 0; // NOLINT
 
-    delete[] data;
+    out[0] = aes_gcm_format_tag__;
+
+    // derive a subkey from the master and the nonce
+    crypto_generichash_blake2b_salt_personal(gcm_key,
+                                             sizeof(gcm_key),
+                                             nullptr,
+                                             0,
+                                             key,
+                                             Cipher::kKeySize,
+                                             out + 1,
+                                             aes_gcm_personal__);
+
+    // the format tag is authenticated as additional data
+    crypto_aead_aes256gcm_encrypt(out + aes_gcm_header_size__,
+                                  &c_len,
+                                  in,
+                                  len,
+                                  out,
+                                  1,
+                                  nullptr,
+                                  aes_gcm_iv__,
+                                  gcm_key);
+
+    // delete the derived key
+    sodium_memzero(gcm_key, sizeof(gcm_key));
 }
 
-void Cipher::CipherImpl::decrypt(const unsigned char* in,
-                                 const size_t&        len,
-                                 unsigned char*       out)
+// Encrypts len bytes from in to out, with the nonce already in place
+static void seal(const Cipher::Mode   mode,
+                 const uint8_t*       key,
+                 const unsigned char* in,
+                 const size_t         len,
+                 unsigned char*       out)
 {
-    if (len < ciphertext_length(0)) {
-        throw std::invalid_argument(
-            "The minimum number of bytes to decrypt is "
-            + std::to_string(ciphertext_length(0))); /* LCOV_EXCL_LINE */
+    switch (mode) {
+    case Cipher::Mode::kXChaCha20Poly1305:
+        seal_xchacha20poly1305(key, in, len, out);
+        break;
+    case Cipher::Mode::kAES256GCM:
+        seal_aes256gcm(key, in, len, out);
+        break;
+    default:
+        seal_chacha20poly1305(key, in, len, out);
+        break;
     }
+}
 
+// Decrypts a ciphertext of len bytes from in to out with the
+// kChaCha20Poly1305 construction. Returns false if the tag is invalid, in
+// which case out is left untouched.
+static bool open_chacha20poly1305(const uint8_t*       key,
+                                  const unsigned char* in,
+                                  const size_t         len,
+                                  unsigned char*       out)
+{
     uint8_t            chacha_key[crypto_aead_chacha20poly1305_KEYBYTES];
     unsigned long long m_len = 0; // NOLINT
 
-    // unlock the master key
-    key_.unlock();
-
     // start by deriving a subkey from the master and the nonce
     crypto_generichash_blake2b_salt_personal(chacha_key,
                                              sizeof(chacha_key),
                                              nullptr,
                                              0,
-                                             key_.data(),
-                                             kKeySize,
+                                             key,
+                                             Cipher::kKeySize,
                                              in,
                                              hash_personal__);
 
-    // re-lock the master key
-    key_.lock();
-
     // go for decryption with the derived key
     int ret = crypto_aead_chacha20poly1305_ietf_decrypt(out,
                                                         &m_len,
@@ -223,10 +547,169 @@ void Cipher::CipherImpl::decrypt(const unsigned char* in,
     // delete the derived key
     sodium_memzero(chacha_key, crypto_aead_chacha20poly1305_KEYBYTES);
 
-    if (ret == -1) { // invalid decryption
-        // erase the decrypted plaintext
-        sodium_memzero(out, m_len);
+    return ret == 0;
+}
+
+// Same as open_chacha20poly1305, with the kXChaCha20Poly1305 construction
+static bool open_xchacha20poly1305(const uint8_t*       key,
+                                   const unsigned char* in,
+                                   const size_t         len,
+                                   unsigned char*       out)
+{
+    unsigned long long m_len = 0; // NOLINT
+
+    // the format tag is authenticated as additional data
+    int ret = crypto_aead_xchacha20poly1305_ietf_decrypt(
+        out,
+        &m_len,
+        nullptr,
+        in + xchacha_header_size__,
+        len - xchacha_header_size__,
+        in,
+        1,
+        in + 1,
+        key);
+
+    return ret == 0;
+}
+
+// Same as open_chacha20poly1305, with the kAES256GCM construction
+static bool open_aes256gcm(const uint8_t*       key,
+                           const unsigned char* in,
+                           const size_t         len,
+                           unsigned char*       out)
+{
+    uint8_t            gcm_key[crypto_aead_aes256gcm_KEYBYTES];
+    unsigned long long m_len = 0; // NOLINT
+
+    // derive the subkey from the master and the nonce
+    crypto_generichash_blake2b_salt_personal(gcm_key,
+                                             sizeof(gcm_key),
+                                             nullptr,
+                                             0,
+                                             key,
+                                             Cipher::kKeySize,
+                                             in + 1,
+                                             aes_gcm_personal__);
+
+    int ret = crypto_aead_aes256gcm_decrypt(out,
+                                            &m_len,
+                                            nullptr,
+                                            in + aes_gcm_header_size__,
+                                            len - aes_gcm_header_size__,
+                                            in,
+                                            1,
+                                            aes_gcm_iv__,
+                                            gcm_key);
+
+    // delete the derived key
+    sodium_memzero(gcm_key, sizeof(gcm_key));
+
+    return ret == 0;
+}
+
+// Checks the format tag of a ciphertext (the kChaCha20Poly1305 ciphertexts
+// have none)
+static bool has_format_tag(const Cipher::Mode mode, const unsigned char* in)
+{
+    switch (mode) {
+    case Cipher::Mode::kXChaCha20Poly1305:
+        return in[0] == xchacha_format_tag__;
+    case Cipher::Mode::kAES256GCM:
+        return in[0] == aes_gcm_format_tag__;
+    default:
+        return true;
+    }
+}
+
+// Decrypts a ciphertext of len bytes from in to out, once its length and its
+// format tag have been checked. Returns false if the tag is invalid.
+static bool open(const Cipher::Mode   mode,
+                 const uint8_t*       key,
+                 const unsigned char* in,
+                 const size_t         len,
+                 unsigned char*       out)
+{
+    switch (mode) {
+    case Cipher::Mode::kXChaCha20Poly1305:
+        return open_xchacha20poly1305(key, in, len, out);
+    case Cipher::Mode::kAES256GCM:
+        return open_aes256gcm(key, in, len, out);
+    default:
+        return open_chacha20poly1305(key, in, len, out);
+    }
+}
+
+void Cipher::CipherImpl::check_plaintext_length(const size_t len) const
+{
+    if (len == 0) {
+        throw std::invalid_argument(
+            "The minimum number of bytes to encrypt is 1.");
+    }
+    if (mode_ == Mode::kAES256GCM && len > aes_gcm_max_length__) {
+        throw std::invalid_argument(
+            "The maximum number of bytes to encrypt with AES-GCM is "
+            + std::to_string(aes_gcm_max_length__));
+    }
+}
+
+void Cipher::CipherImpl::encrypt(const unsigned char* in,
+                                 const size_t&        len,
+                                 unsigned char*       out)
+{
+    // generate a random nonce, and place it at the beginning of the output
+    // (after the format tag if there is one)
+    random_bytes(nonce_size(mode_), out + nonce_offset(mode_));
+
+    seal(mode_, key_.unlock_get(), in, len, out);
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+}
+
+void Cipher::CipherImpl::encrypt(const std::string& in, std::string& out)
+{
+    check_plaintext_length(in.size());
+
+    size_t         len   = in.size();
+    size_t         c_len = ciphertext_length(len, mode_);
+    unsigned char* data  = new unsigned char[c_len];
+
+    encrypt(reinterpret_cast<const unsigned char*>(in.data()), len, data);
+    out = std::string(reinterpret_cast<char*>(data), c_len);
+
+    // erase the buffer
+    sodium_memzero(data, c_len);
 
+    delete[] data;
+}
+
+void Cipher::CipherImpl::decrypt(const unsigned char* in,
+                                 const size_t&        len,
+                                 unsigned char*       out)
+{
+    if (len < ciphertext_length(0, mode_)) {
+        throw std::invalid_argument(
+            "The minimum number of bytes to decrypt is "
+            + std::to_string(
+                ciphertext_length(0, mode_))); /* LCOV_EXCL_LINE */
+    }
+
+    if (!has_format_tag(mode_, in)) {
+        throw std::runtime_error("Failed decryption. Invalid ciphertext "
+                                 "format");
+    }
+
+    bool success = open(mode_, key_.unlock_get(), in, len, out);
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+
+    if (!success) { // invalid decryption
         throw std::runtime_error("Failed decryption. Invalid ciphertext");
     }
 }
@@ -235,13 +718,13 @@ void Cipher::CipherImpl::decrypt(const std::string& in, std::string& out)
 {
     size_t len = in.size();
 
-    if (len <= NONCE_SIZE + crypto_aead_chacha20poly1305_IETF_ABYTES) {
+    if (len <= overhead(mode_)) {
         throw std::invalid_argument("The minimum number of bytes to decrypt is "
                                     "1. The minimum length for a "
                                     "decryption input is kIVSize+1");
     }
 
-    size_t p_len = plaintext_length(len);
+    size_t p_len = plaintext_length(len, mode_);
 
     std::vector<uint8_t> data(p_len);
     decrypt(
@@ -250,5 +733,552 @@ void Cipher::CipherImpl::decrypt(const std::string& in, std::string& out)
     out = std::string(reinterpret_cast<const char*>(data.data()), p_len);
 }
 
+void Cipher::CipherImpl::encrypt_batch(
+    const std::vector<std::string>& in,
+    std::vector<uint8_t>&           arena,
+    std::vector<size_t>&            offsets,
+    const unsigned int              n_threads)
+{
+    // compute the layout of the arena before doing anything
+    offsets.resize(in.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        check_plaintext_length(in[i].size());
+        offsets[i + 1] = offsets[i] + ciphertext_length(in[i].size(), mode_);
+    }
+    arena.resize(offsets.back());
+
+    const Mode   mode     = mode_;
+    const size_t n_size   = nonce_size(mode);
+    const size_t n_offset = nonce_offset(mode);
+
+    // the key stays unlocked for the whole batch
+    const uint8_t* key = key_.unlock_get();
+
+    auto worker = [&](size_t begin, size_t end) {
+        // draw the nonces of batch_nonce_block__ entries at once
+        std::vector<uint8_t> nonces(batch_nonce_block__ * n_size);
+
+        for (size_t i = begin; i < end; i += batch_nonce_block__) {
+            const size_t count = std::min(batch_nonce_block__, end - i);
+            random_bytes(count * n_size, nonces.data());
+
+            for (size_t j = 0; j < count; j++) {
+                const std::string& m   = in[i + j];
+                uint8_t*           out = arena.data() + offsets[i + j];
+
+                memcpy(out + n_offset, nonces.data() + j * n_size, n_size);
+                seal(mode,
+                     key,
+                     reinterpret_cast<const unsigned char*>(m.data()),
+                     m.size(),
+                     out);
+            }
+        }
+    };
+
+    try {
+        process_batch(in.size(),
+                      n_threads,
+                      [&worker](size_t first, size_t count) {
+                          worker(first, first + count);
+                      });
+    } catch (...) {
+        if (relocks_key()) {
+            key_.lock();
+        }
+        throw;
+    }
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+}
+
+size_t Cipher::CipherImpl::decrypt_batch(const std::vector<std::string>& in,
+                                         std::vector<uint8_t>&  arena,
+                                         std::vector<size_t>&   offsets,
+                                         std::vector<uint64_t>& status,
+                                         const unsigned int     n_threads)
+{
+    // as for decrypt(const std::string&, std::string&), empty plaintexts are
+    // not valid
+    const size_t min_len = ciphertext_length(1, mode_);
+
+    // compute the layout of the arena before doing anything
+    offsets.resize(in.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        const size_t len = in[i].size();
+        offsets[i + 1]   = offsets[i];
+        if (len >= min_len) {
+            offsets[i + 1] += plaintext_length(len, mode_);
+        }
+    }
+    arena.resize(offsets.back());
+    status.assign((in.size() + 63) / 64, 0);
+
+    const Mode mode = mode_;
+
+    // the key stays unlocked for the whole batch
+    const uint8_t* key = key_.unlock_get();
+
+    // every thread decrypts whole blocks of 64 entries, so that no word of
+    // status is shared between threads
+    auto worker = [&](size_t begin, size_t end) {
+        for (size_t w = begin; w < end; w++) {
+            uint64_t     bits = 0;
+            const size_t last = std::min(in.size(), 64 * (w + 1));
+
+            for (size_t i = 64 * w; i < last; i++) {
+                const auto* ct
+                    = reinterpret_cast<const unsigned char*>(in[i].data());
+                const size_t len = in[i].size();
+                uint8_t*     out = arena.data() + offsets[i];
+
+                // early reject of truncated or foreign ciphertexts
+                if (len < min_len || !has_format_tag(mode, ct)) {
+                    continue;
+                }
+                if (open(mode, key, ct, len, out)) {
+                    bits |= 1ULL << (i % 64);
+                } else {
+                    sodium_memzero(out, offsets[i + 1] - offsets[i]);
+                }
+            }
+            status[w] = bits;
+        }
+    };
+
+    try {
+        process_batch(status.size(),
+                      n_threads,
+                      [&worker](size_t first, size_t count) {
+                          worker(first, first + count);
+                      });
+    } catch (...) {
+        if (relocks_key()) {
+            key_.lock();
+        }
+        throw;
+    }
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+
+    size_t n_valid = 0;
+    for (uint64_t w : status) {
+        n_valid += std::bitset<64>(w).count();
+    }
+    return n_valid;
+}
+
+// Task of encrypt_records: a range of records, encrypted by the same thread
+// in the same output buffer
+struct BulkTask
+{
+    size_t begin;
+    size_t end;
+    size_t ciphertext_bytes;
+};
+
+// Per-thread task queue of encrypt_records. Both the owner and the thieves
+// take the task with the smallest index, as it is the first one needed by the
+// ordered output.
+struct BulkQueue
+{
+    std::mutex         mutex;
+    std::deque<size_t> tasks;
+};
+
+Cipher::BulkStats Cipher::CipherImpl::encrypt_records(
+    const std::vector<Record>& records,
+    const RecordWriter&        out,
+    unsigned int               n_threads)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    BulkStats stats;
+    size_t    total_weight = 0;
+    for (const auto& r : records) {
+        check_plaintext_length(r.second.size());
+        stats.plaintext_bytes += r.second.size();
+        stats.ciphertext_bytes += ciphertext_length(r.second.size(), mode_);
+        total_weight += r.second.size() + bulk_record_weight__;
+    }
+    stats.records = records.size();
+
+    if (n_threads == 0) {
+        n_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // split the records in tasks of similar weight
+    const size_t task_weight = std::min(
+        std::max(total_weight / (n_threads * bulk_tasks_per_thread__),
+                 bulk_min_task_weight__),
+        bulk_max_task_weight__);
+
+    std::vector<BulkTask> tasks;
+    size_t                weight = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        const size_t len = records[i].second.size();
+        if (weight == 0) {
+            tasks.push_back({i, i, 0});
+        }
+        tasks.back().end = i + 1;
+        tasks.back().ciphertext_bytes += ciphertext_length(len, mode_);
+
+        weight += len + bulk_record_weight__;
+        if (weight >= task_weight) {
+            weight = 0;
+        }
+    }
+
+    n_threads = static_cast<unsigned int>(
+        std::min<size_t>(n_threads, std::max<size_t>(tasks.size(), 1)));
+
+    std::vector<BulkQueue> queues(n_threads);
+    for (size_t t = 0; t < tasks.size(); t++) {
+        queues[t % n_threads].tasks.push_back(t);
+    }
+
+    // Output buffers: task t uses buffers[t % window], and can only start
+    // once task t - window has been passed to out
+    const size_t window = std::min(bulk_window__ * n_threads, tasks.size());
+    std::vector<std::vector<uint8_t>> buffers(window);
+    std::vector<bool>                 ready(window, false);
+
+    std::mutex              emit_mutex;
+    std::condition_variable emit_cv;
+    size_t                  next_emit = 0;
+    bool                    emitting  = false;
+    bool                    abort     = false;
+    std::exception_ptr      error;
+
+    const Mode   mode     = mode_;
+    const size_t n_size   = nonce_size(mode);
+    const size_t n_offset = nonce_offset(mode);
+
+    // the key stays unlocked for the whole encryption
+    const uint8_t* key = key_.unlock_get();
+
+    auto fail = [&](std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(emit_mutex);
+        if (!error) {
+            error = e;
+        }
+        abort = true;
+        emit_cv.notify_all();
+    };
+
+    // takes the first task of queue q, or steals one from another queue
+    auto pop_task = [&](const unsigned int q, size_t& task) {
+        for (unsigned int i = 0; i < n_threads; i++) {
+            BulkQueue&                  queue = queues[(q + i) % n_threads];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Passes the ciphertexts of the completed tasks to out, in order. Only
+    // one thread emits at a time, and emit_mutex is released during the
+    // calls to out, so that the other threads can keep on encrypting.
+    auto emit = [&](std::unique_lock<std::mutex>& lock) {
+        if (emitting) {
+            return;
+        }
+        emitting = true;
+        while (!abort && next_emit < tasks.size()
+               && ready[next_emit % window]) {
+            const size_t    slot = next_emit % window;
+            const BulkTask& task = tasks[next_emit];
+
+            lock.unlock();
+            const uint8_t* ct = buffers[slot].data();
+            for (size_t i = task.begin; i < task.end; i++) {
+                const size_t len
+                    = ciphertext_length(records[i].second.size(), mode);
+                out(records[i].first, ct, len);
+                ct += len;
+            }
+            lock.lock();
+
+            ready[slot] = false;
+            next_emit++;
+            emit_cv.notify_all();
+        }
+        emitting = false;
+    };
+
+    auto worker = [&](const unsigned int q) {
+        try {
+            // reused for all the tasks of the thread
+            std::vector<uint8_t> nonces;
+            size_t               t;
+
+            while (pop_task(q, t)) {
+                const size_t slot = t % window;
+                {
+                    std::unique_lock<std::mutex> lock(emit_mutex);
+                    emit_cv.wait(lock, [&] {
+                        return abort || t < next_emit + window;
+                    });
+                    if (abort) {
+                        return;
+                    }
+                }
+
+                const BulkTask& task = tasks[t];
+                buffers[slot].resize(task.ciphertext_bytes);
+                nonces.resize((task.end - task.begin) * n_size);
+                random_bytes(nonces.size(), nonces.data());
+
+                uint8_t* ct = buffers[slot].data();
+                for (size_t i = task.begin; i < task.end; i++) {
+                    const std::string& m = records[i].second;
+
+                    memcpy(ct + n_offset,
+                           nonces.data() + (i - task.begin) * n_size,
+                           n_size);
+                    seal(mode,
+                         key,
+                         reinterpret_cast<const unsigned char*>(m.data()),
+                         m.size(),
+                         ct);
+                    ct += ciphertext_length(m.size(), mode);
+                }
+
+                std::unique_lock<std::mutex> lock(emit_mutex);
+                ready[slot] = true;
+                emit(lock);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(n_threads - 1);
+        for (unsigned int q = 1; q < n_threads; q++) {
+            threads.emplace_back(worker, q);
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+    worker(0);
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    return stats;
+}
+
+// Fill buf with len bytes from in, unless the end of the stream is reached.
+// Returns the number of bytes read.
+static size_t read_full(const Cipher::StreamReader& in,
+                        uint8_t*                    buf,
+                        const size_t                len)
+{
+    size_t done = 0;
+    while (done < len) {
+        const size_t ret = in(buf + done, len - done);
+        if (ret == 0) {
+            break;
+        }
+        if (ret > len - done) {
+            throw std::runtime_error(
+                "Invalid stream reader: too many bytes returned");
+        }
+        done += ret;
+    }
+    return done;
+}
+
+void Cipher::CipherImpl::derive_stream_key(uint8_t* stream_key)
+{
+    crypto_generichash_blake2b_salt_personal(
+        stream_key,
+        crypto_secretstream_xchacha20poly1305_KEYBYTES,
+        nullptr,
+        0,
+        key_.unlock_get(),
+        kKeySize,
+        nullptr,
+        stream_personal__);
+
+    if (relocks_key()) {
+        // re-lock the master key
+        key_.lock();
+    }
+}
+
+void Cipher::CipherImpl::encrypt_stream(const StreamReader& in,
+                                        const StreamWriter& out,
+                                        const size_t        chunk_size)
+{
+    if (chunk_size == 0 || chunk_size > kMaxStreamChunkSize) {
+        throw std::invalid_argument("Invalid stream chunk size: it must be "
+                                    "between 1 and kMaxStreamChunkSize");
+    }
+
+    std::array<uint8_t, stream_header_size__> header;
+    header[0] = stream_format_tag__;
+    for (size_t i = 0; i < 4; i++) {
+        header[1 + i] = static_cast<uint8_t>(chunk_size >> (8 * i));
+    }
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    uint8_t stream_key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+
+    derive_stream_key(stream_key);
+    crypto_secretstream_xchacha20poly1305_init_push(
+        &state, header.data() + stream_prefix_size__, stream_key);
+    sodium_memzero(stream_key, sizeof(stream_key));
+
+    std::vector<uint8_t> m(chunk_size);
+    std::vector<uint8_t> c(chunk_size
+                           + crypto_secretstream_xchacha20poly1305_ABYTES);
+
+    try {
+        out(header.data(), header.size());
+
+        // a chunk shorter than chunk_size (possibly empty) ends the stream
+        bool final = false;
+        while (!final) {
+            const size_t m_len = read_full(in, m.data(), chunk_size);
+            final              = (m_len < chunk_size);
+
+            unsigned long long c_len = 0; // NOLINT
+            crypto_secretstream_xchacha20poly1305_push(
+                &state,
+                c.data(),
+                &c_len,
+                m.data(),
+                m_len,
+                header.data(),
+                stream_prefix_size__,
+                final ? crypto_secretstream_xchacha20poly1305_TAG_FINAL
+                      : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE);
+
+            out(c.data(), static_cast<size_t>(c_len));
+        }
+    } catch (...) {
+        sodium_memzero(&state, sizeof(state));
+        sodium_memzero(m.data(), m.size());
+        throw;
+    }
+
+    sodium_memzero(&state, sizeof(state));
+    sodium_memzero(m.data(), m.size());
+}
+
+void Cipher::CipherImpl::decrypt_stream(const StreamReader& in,
+                                        const StreamWriter& out)
+{
+    std::array<uint8_t, stream_header_size__> header;
+
+    if (read_full(in, header.data(), header.size()) != header.size()
+        || header[0] != stream_format_tag__) {
+        throw std::runtime_error("Failed stream decryption. Invalid header");
+    }
+
+    size_t chunk_size = 0;
+    for (size_t i = 0; i < 4; i++) {
+        chunk_size |= static_cast<size_t>(header[1 + i]) << (8 * i);
+    }
+    if (chunk_size == 0 || chunk_size > kMaxStreamChunkSize) {
+        throw std::runtime_error("Failed stream decryption. Invalid header");
+    }
+
+    crypto_secretstream_xchacha20poly1305_state state;
+    uint8_t stream_key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+
+    derive_stream_key(stream_key);
+    crypto_secretstream_xchacha20poly1305_init_pull(
+        &state, header.data() + stream_prefix_size__, stream_key);
+    sodium_memzero(stream_key, sizeof(stream_key));
+
+    std::vector<uint8_t> c(chunk_size
+                           + crypto_secretstream_xchacha20poly1305_ABYTES);
+    std::vector<uint8_t> m(chunk_size);
+
+    const unsigned char tag_message
+        = crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+    const unsigned char tag_final
+        = crypto_secretstream_xchacha20poly1305_TAG_FINAL;
+
+    try {
+        bool final = false;
+        while (!final) {
+            const size_t c_len = read_full(in, c.data(), c.size());
+            if (c_len == 0) {
+                throw std::runtime_error(
+                    "Failed stream decryption. Truncated stream");
+            }
+
+            unsigned long long m_len = 0; // NOLINT
+            unsigned char      tag   = 0;
+            int                ret   = -1;
+            if (c_len >= crypto_secretstream_xchacha20poly1305_ABYTES) {
+                ret = crypto_secretstream_xchacha20poly1305_pull(
+                    &state,
+                    m.data(),
+                    &m_len,
+                    &tag,
+                    c.data(),
+                    c_len,
+                    header.data(),
+                    stream_prefix_size__);
+            }
+            final = (tag == tag_final);
+            if (ret != 0 || (!final && tag != tag_message)) {
+                throw std::runtime_error(
+                    "Failed stream decryption. Invalid chunk");
+            }
+
+            if (!final && c_len < c.size()) {
+                throw std::runtime_error(
+                    "Failed stream decryption. Truncated stream");
+            }
+
+            out(m.data(), static_cast<size_t>(m_len));
+        }
+
+        uint8_t trailing;
+        if (read_full(in, &trailing, 1) != 0) {
+            throw std::runtime_error("Failed stream decryption. Trailing data "
+                                     "after the final chunk");
+        }
+    } catch (...) {
+        sodium_memzero(&state, sizeof(state));
+        sodium_memzero(m.data(), m.size());
+        throw;
+    }
+
+    sodium_memzero(&state, sizeof(state));
+    sodium_memzero(m.data(), m.size());
+}
+
 } // namespace crypto
 } // namespace sse
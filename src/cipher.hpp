@@ -22,10 +22,14 @@
 
 #include "key.hpp"
 
+#include <cstddef>
 #include <cstdint>
 
 #include <array>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace sse {
 
@@ -41,6 +45,16 @@ namespace crypto {
 /// nonces can be randomly generated, and the Cipher object does not
 /// need to keep a state to be secure.
 ///
+/// Alternatively, a Cipher object can use the XChaCha20+Poly1305 construction
+/// (see Cipher::Mode), which provides 192 bits nonces without deriving a new
+/// key for every message, or AES-256-GCM with a nonce-derived key, which is
+/// faster on CPUs with AES and carry-less multiplication instructions.
+///
+/// Large payloads can be encrypted in constant memory using the streaming
+/// functions (encrypt_stream and decrypt_stream), which split the input in
+/// fixed-size chunks, individually authenticated with libsodium's
+/// secretstream construction.
+///
 
 class Cipher
 {
@@ -48,6 +62,130 @@ public:
     /// @brief Cipher key size (in bytes)
     static constexpr uint8_t kKeySize = 32;
 
+    /// @brief Default chunk size for streaming encryption (in bytes)
+    static constexpr size_t kStreamChunkSize = 1 << 16;
+
+    /// @brief Maximum chunk size for streaming encryption (in bytes)
+    static constexpr size_t kMaxStreamChunkSize = 1 << 24;
+
+    ///
+    /// @brief Input of the streaming functions
+    ///
+    /// A StreamReader is called with a buffer and its size. It must fill the
+    /// buffer with at most size bytes, and return the number of bytes written
+    /// in the buffer. It returns 0 if and only if the end of the input has
+    /// been reached.
+    ///
+    using StreamReader = std::function<size_t(uint8_t*, size_t)>;
+
+    ///
+    /// @brief Output of the streaming functions
+    ///
+    /// A StreamWriter is called with a buffer and its size, and must consume
+    /// all the bytes of the buffer.
+    ///
+    using StreamWriter = std::function<void(const uint8_t*, size_t)>;
+
+    ///
+    /// @brief Record of a document collection
+    ///
+    /// A record is made of the identifier of a document, chosen by the
+    /// caller, and of its content.
+    ///
+    using Record = std::pair<uint64_t, std::string>;
+
+    ///
+    /// @brief Output of encrypt_records
+    ///
+    /// A RecordWriter is called with the identifier of a record and its
+    /// ciphertext. The ciphertext buffer is only valid during the call.
+    ///
+    using RecordWriter = std::function<void(uint64_t, const uint8_t*, size_t)>;
+
+    ///
+    /// @brief Statistics of a bulk encryption
+    ///
+    struct BulkStats
+    {
+        size_t records{0};          ///< Number of encrypted records
+        size_t plaintext_bytes{0};  ///< Total length of the plaintexts
+        size_t ciphertext_bytes{0}; ///< Total length of the ciphertexts
+        double seconds{0.};         ///< Duration of the encryption
+
+        /// @brief Encryption throughput (plaintext bytes per second)
+        double bytes_per_second() const noexcept
+        {
+            return (seconds > 0.) ? plaintext_bytes / seconds : 0.;
+        }
+    };
+
+    ///
+    /// @brief Encryption construction
+    ///
+    /// The ciphertexts produced with one mode cannot be decrypted by a Cipher
+    /// object using another mode.
+    ///
+    /// kChaCha20Poly1305 is the original construction: for every message, a
+    /// ChaCha20 key is derived from the master key and a 128 bits random
+    /// nonce using BLAKE2b, and the message is encrypted with
+    /// ChaCha20+Poly1305 (IETF version). The ciphertext is the nonce followed
+    /// by the encrypted message and the authentication tag.
+    ///
+    /// kXChaCha20Poly1305 uses the master key directly with
+    /// XChaCha20+Poly1305 (IETF version) and a 192 bits random nonce (the
+    /// subkey is derived by HChaCha20, as part of the construction). The
+    /// ciphertext starts with a one byte format tag, which is authenticated,
+    /// followed by the nonce, the encrypted message and the authentication
+    /// tag. It is significantly faster for short messages. In this mode, the
+    /// key is kept read-only (instead of inaccessible) between two calls: it
+    /// stays in guarded memory and cannot be overwritten, but can be read by
+    /// the process. Changing the memory protection around every call costs
+    /// about 3.5 us (two mprotect calls), which would make the encryption of
+    /// a 32 bytes message 4 times slower (4.6 us instead of 1.1 us).
+    ///
+    /// kAES256GCM keeps the design of kChaCha20Poly1305 (an AES-256 key is
+    /// derived from the master key and a 128 bits random nonce with BLAKE2b,
+    /// so random nonces are safe), and encrypts the message with libsodium's
+    /// AES-256-GCM, using an all-zero IV. The ciphertext starts with a one
+    /// byte format tag, which is authenticated, followed by the nonce, the
+    /// encrypted message and the authentication tag. As for
+    /// kXChaCha20Poly1305, the key is kept read-only between two calls: the
+    /// two mprotect calls would make the encryption of a 32 bytes message 4
+    /// times slower (5.0 us instead of 1.2 us).
+    /// This mode is only available on x86 CPUs supporting AES-NI and
+    /// PCLMULQDQ (see is_available). Messages are limited to 2^36-32 bytes.
+    ///
+    enum class Mode : uint8_t
+    {
+        kChaCha20Poly1305,  ///< BLAKE2b-derived key + ChaCha20+Poly1305
+        kXChaCha20Poly1305, ///< XChaCha20+Poly1305
+        kAES256GCM          ///< BLAKE2b-derived key + AES-256-GCM
+    };
+
+    ///
+    /// @brief Check availability of an encryption mode
+    ///
+    /// Checks if the host CPU supports the given mode. All the modes but
+    /// kAES256GCM are always available. The library must have been
+    /// initialized with init_crypto_lib.
+    ///
+    /// @param mode The encryption mode.
+    ///
+    /// @return true if Cipher objects can be created with this mode.
+    ///
+    static bool is_available(const Mode mode) noexcept;
+
+    ///
+    /// @brief Fastest mode supported by the host CPU
+    ///
+    /// Selects the encryption mode at runtime, depending on the features of
+    /// the host CPU: kAES256GCM if it is available, kXChaCha20Poly1305
+    /// otherwise.
+    ///
+    /// @return The fastest available encryption mode.
+    ///
+    static Mode preferred_mode() noexcept;
+
     Cipher() = delete;
 
     // we should not be able to duplicate Cipher objects
@@ -72,6 +210,21 @@ public:
     ///
     explicit Cipher(Key<kKeySize>&& k);
 
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a cipher from a 32 bytes (256 bits) key, using the given
+    /// encryption mode. After a call to the constructor, the input key is
+    /// held by the Cipher object, and cannot be re-used.
+    ///
+    /// @param k    The key used to initialize the cipher.
+    ///             Upon return, k is empty
+    /// @param mode The encryption construction.
+    ///
+    /// @exception std::runtime_error The mode is not available on this CPU.
+    ///
+    Cipher(Key<kKeySize>&& k, const Mode mode);
+
     ///
     /// @brief Destructor
     ///
@@ -80,6 +233,13 @@ public:
     ///
     ~Cipher();
 
+    ///
+    /// @brief Get the encryption mode
+    ///
+    /// @return The encryption construction selected at construction.
+    ///
+    Mode mode() const noexcept;
+
     ///
     /// @brief Encrypt a plaintext
     ///
@@ -89,7 +249,8 @@ public:
     /// least (i.e. non-empty).
     /// @param out   The computed ciphertext.
     ///
-    /// @exception std::invalid_argument The size of in is 0.
+    /// @exception std::invalid_argument The size of in is 0, or is larger
+    /// than the maximum message length of the mode.
     ///
     void encrypt(const std::string& in, std::string& out);
 
@@ -106,9 +267,215 @@ public:
     /// nonce
     /// + the size of the tag.
     /// @exception std::runtime_error       The decryption failed: invalid tag
+    /// or invalid format tag
     ///
     void decrypt(const std::string& in, std::string& out);
 
+    ///
+    /// @brief Encrypt a batch of plaintexts
+    ///
+    /// Encrypts every element of in, and writes the ciphertexts back to back
+    /// in arena: the ciphertext of in[i] is stored in the bytes of arena
+    /// between offsets[i] (included) and offsets[i+1] (excluded), and is
+    /// identical to what encrypt(in[i]) would have produced, with a different
+    /// nonce. Hence it can be decrypted with decrypt.
+    ///
+    /// Compared to repeated calls to encrypt, the nonces of many elements
+    /// are drawn with a single call to the random generator, the key is
+    /// unlocked only once for the whole batch, and no memory allocation takes
+    /// place per element (arena and offsets can be reused across calls to
+    /// avoid any reallocation).
+    ///
+    /// @param in           The plaintexts to be encrypted. Every plaintext
+    ///                     must be non-empty.
+    /// @param arena        The buffer receiving the ciphertexts. It is
+    ///                     resized to the total length of the ciphertexts.
+    /// @param offsets      The offsets of the ciphertexts in arena. It is
+    ///                     resized to in.size()+1 elements.
+    /// @param n_threads    The number of threads used for encryption (the
+    ///                     calling thread included). 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @exception std::invalid_argument    One of the plaintexts is empty or
+    ///                                     too long. In that case, nothing is
+    ///                                     encrypted.
+    ///
+    void encrypt_batch(const std::vector<std::string>& in,
+                       std::vector<uint8_t>&           arena,
+                       std::vector<size_t>&            offsets,
+                       const unsigned int              n_threads = 1);
+
+    ///
+    /// @brief Decrypt a batch of ciphertexts
+    ///
+    /// Decrypts and authenticates every element of in, and writes the
+    /// plaintexts back to back in arena: the plaintext of in[i] is stored in
+    /// the bytes of arena between offsets[i] (included) and offsets[i+1]
+    /// (excluded). Instead of throwing an exception when a ciphertext is
+    /// invalid, the result of every decryption is reported in status: the
+    /// decryption of in[i] succeeded iff the bit i%64 of status[i/64] is set.
+    ///
+    /// Ciphertexts that are too short, or whose format tag does not match the
+    /// mode of the Cipher object, are rejected before any cryptographic
+    /// computation, and no space is reserved for them in arena. The space of
+    /// the other invalid ciphertexts is filled with zeros. The key is
+    /// unlocked only once for the whole batch, and the authentication tags
+    /// can be verified on several threads.
+    ///
+    /// @param in           The ciphertexts to be decrypted.
+    /// @param arena        The buffer receiving the plaintexts. It is resized
+    ///                     to the total length of the plaintexts.
+    /// @param offsets      The offsets of the plaintexts in arena. It is
+    ///                     resized to in.size()+1 elements.
+    /// @param status       The bitmap of the valid ciphertexts. It is resized
+    ///                     to (in.size()+63)/64 elements.
+    /// @param n_threads    The number of threads used for decryption (the
+    ///                     calling thread included). 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @return The number of valid ciphertexts.
+    ///
+    size_t decrypt_batch(const std::vector<std::string>& in,
+                         std::vector<uint8_t>&           arena,
+                         std::vector<size_t>&            offsets,
+                         std::vector<uint64_t>&          status,
+                         const unsigned int              n_threads = 1);
+
+    ///
+    /// @brief Encrypt a document collection
+    ///
+    /// Encrypts every record of a collection in parallel, and passes the
+    /// ciphertexts to out, together with the record identifiers, in the order
+    /// of the input. Every ciphertext is identical to what encrypt would have
+    /// produced (with a different nonce), and can be decrypted with decrypt.
+    ///
+    /// The records are grouped in tasks of similar weight (the weight of a
+    /// record is its length plus a fixed per-record cost), dealt round-robin
+    /// to per-thread queues. A thread whose queue is empty steals tasks from
+    /// the others. The ciphertexts of a task are written in an output buffer
+    /// that is reused once they have been passed to out: at most a few tasks
+    /// per thread are held in memory at any time, whatever the size of the
+    /// collection.
+    ///
+    /// out is never called concurrently, but it can be called from any of the
+    /// threads. If it throws, the encryption stops and the exception is
+    /// rethrown by encrypt_records.
+    ///
+    /// @param records      The records to be encrypted. Every record must be
+    ///                     non-empty.
+    /// @param out          The ciphertext sink.
+    /// @param n_threads    The number of threads used for encryption (the
+    ///                     calling thread included). 0 means one thread per
+    ///                     hardware thread.
+    ///
+    /// @return The number of encrypted records and bytes, and the duration
+    ///         of the encryption.
+    ///
+    /// @exception std::invalid_argument    One of the records is empty or
+    ///                                     too long. In that case, nothing is
+    ///                                     encrypted.
+    ///
+    BulkStats encrypt_records(const std::vector<Record>& records,
+                              const RecordWriter&        out,
+                              const unsigned int         n_threads = 1);
+
+    ///
+    /// @brief Encrypt a stream
+    ///
+    /// Reads the plaintext from in until its end, and writes the ciphertext
+    /// to out, chunk by chunk. Only one chunk of plaintext and one chunk of
+    /// ciphertext are held in memory at any time.
+    ///
+    /// A stream key is derived from the Cipher key, and the chunks are
+    /// encrypted with libsodium's secretstream construction
+    /// (XChaCha20+Poly1305): every chunk is authenticated together with its
+    /// position in the stream and the stream header, and the last chunk is
+    /// marked as final, so that reordering, truncation and extension of the
+    /// ciphertext are detected. The stream format does not depend on the
+    /// Cipher mode.
+    ///
+    /// @param in           The plaintext source.
+    /// @param out          The ciphertext sink.
+    /// @param chunk_size   The size of the plaintext chunks, between 1 and
+    ///                     kMaxStreamChunkSize.
+    ///
+    /// @exception std::invalid_argument    chunk_size is invalid.
+    /// @exception std::runtime_error       in returned more bytes than
+    ///                                     requested.
+    ///
+    void encrypt_stream(const StreamReader& in,
+                        const StreamWriter& out,
+                        const size_t        chunk_size = kStreamChunkSize);
+
+    ///
+    /// @brief Encrypt a file descriptor
+    ///
+    /// Same as encrypt_stream(const StreamReader&, const StreamWriter&,
+    /// const size_t), reading from and writing to file descriptors.
+    ///
+    /// @param in_fd        The plaintext file descriptor.
+    /// @param out_fd       The ciphertext file descriptor.
+    /// @param chunk_size   The size of the plaintext chunks, between 1 and
+    ///                     kMaxStreamChunkSize.
+    ///
+    /// @exception std::invalid_argument    chunk_size is invalid.
+    /// @exception std::runtime_error       A read or a write failed.
+    ///
+    void encrypt_stream(const int    in_fd,
+                        const int    out_fd,
+                        const size_t chunk_size = kStreamChunkSize);
+
+    ///
+    /// @brief Decrypt a stream
+    ///
+    /// Reads a ciphertext produced by encrypt_stream from in, until its end,
+    /// and writes the plaintext to out, chunk by chunk. The chunk size is
+    /// read from the stream header.
+    ///
+    /// The plaintext of a chunk is only written once the chunk has been
+    /// authenticated. Still, if an exception is thrown, the data already
+    /// written to out must be discarded: it might be a truncated or a partial
+    /// plaintext.
+    ///
+    /// @param in   The ciphertext source.
+    /// @param out  The plaintext sink.
+    ///
+    /// @exception std::runtime_error   The decryption failed: invalid header,
+    ///                                 invalid chunk, truncated stream or
+    ///                                 trailing data after the final chunk.
+    ///
+    void decrypt_stream(const StreamReader& in, const StreamWriter& out);
+
+    ///
+    /// @brief Decrypt a file descriptor
+    ///
+    /// Same as decrypt_stream(const StreamReader&, const StreamWriter&),
+    /// reading from and writing to file descriptors.
+    ///
+    /// @param in_fd    The ciphertext file descriptor.
+    /// @param out_fd   The plaintext file descriptor.
+    ///
+    /// @exception std::runtime_error   The decryption failed, or a read or a
+    ///                                 write failed.
+    ///
+    void decrypt_stream(const int in_fd, const int out_fd);
+
+    ///
+    /// @brief Compute the length of an encrypted stream
+    ///
+    /// Computes the size of the ciphertext written by encrypt_stream
+    /// given the plaintext length and the chunk size.
+    ///
+    /// @param plaintext_len    Length of the plaintext to be encrypted.
+    /// @param chunk_size       The size of the plaintext chunks (must be
+    ///                         non-zero).
+    ///
+    /// @return Length of the encrypted stream.
+    ///
+    static size_t stream_ciphertext_length(
+        const size_t plaintext_len,
+        const size_t chunk_size = kStreamChunkSize) noexcept;
+
     ///
     /// @brief Compute the length of a ciphertext
     ///
@@ -122,6 +489,21 @@ public:
     ///
     static size_t ciphertext_length(const size_t plaintext_len) noexcept;
 
+    ///
+    /// @brief Compute the length of a ciphertext
+    ///
+    /// Computes the size of the ciphertext returned by encrypt
+    /// given the plaintext length and the encryption mode.
+    ///
+    /// @param plaintext_len    Length of the plaintext to be encrypted.
+    /// @param mode             The encryption mode.
+    ///
+    /// @return Length of the ciphertext, that is the length of the plaintext +
+    /// the length of the header (format tag and nonce) + the length of the tag
+    ///
+    static size_t ciphertext_length(const size_t plaintext_len,
+                                    const Mode   mode) noexcept;
+
     ///
     /// @brief Compute the length of a plaintext
     ///
@@ -136,6 +518,23 @@ public:
     ///
     static size_t plaintext_length(const size_t c_len) noexcept;
 
+    ///
+    /// @brief Compute the length of a plaintext
+    ///
+    /// Computes the size of the plaintext returned by decrypt
+    /// given the ciphertext length and the encryption mode, when the
+    /// decryption suceeds.
+    ///
+    /// @param c_len    Length of the ciphertext to be decrypted.
+    /// @param mode     The encryption mode.
+    ///
+    /// @return Length of the plaintext, that is the length of the ciphertext -
+    /// the length of the header - the length of the tag (or 0 if this quantity
+    /// is negative)
+    ///
+    static size_t plaintext_length(const size_t c_len,
+                                   const Mode   mode) noexcept;
+
 private:
     /// @class CipherImpl
     /// @brief Hidden Cipher implementation
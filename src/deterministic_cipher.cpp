@@ -0,0 +1,324 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "deterministic_cipher.hpp"
+
+#include "prp.hpp"
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+#include "aez/aez.h"
+#endif
+
+#include <climits>
+#include <cstring>
+
+#include <exception>
+#include <stdexcept>
+
+#include <sodium/utils.h>
+
+namespace sse {
+
+namespace crypto {
+
+constexpr uint8_t  DeterministicCipher::kKeySize;
+constexpr size_t   DeterministicCipher::kMaxLabelSize;
+constexpr unsigned DeterministicCipher::kMinExpansion;
+constexpr unsigned DeterministicCipher::kMaxExpansion;
+constexpr unsigned DeterministicCipher::kDefaultExpansion;
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+class DeterministicCipher::DeterministicCipherImpl
+{
+public:
+    DeterministicCipherImpl(Key<kKeySize>&& k, const unsigned expansion);
+
+    inline unsigned expansion() const noexcept
+    {
+        return expansion_;
+    }
+
+    void encrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const;
+
+    bool decrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const;
+
+private:
+    // The AEZ context stays readable (in guarded memory) for the lifetime of
+    // the object: deterministic encryption is meant for short index entries,
+    // for which two mprotect calls would cost more than the encryption.
+    Key<sizeof(aez_ctx_t)> aez_ctx_;
+
+    const unsigned expansion_;
+};
+
+#else
+#warning DeterministicCipher is not available without CPU support for AES
+
+class DeterministicCipher::DeterministicCipherImpl
+{
+public:
+    DeterministicCipherImpl(Key<kKeySize>&& k, const unsigned expansion){};
+
+    inline unsigned expansion() const noexcept
+    {
+        return 0;
+    }
+
+    void encrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const {};
+
+    bool decrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const
+    {
+        return false;
+    };
+};
+#endif /* __AES__ || __ARM_FEATURE_CRYPTO */
+
+bool DeterministicCipher::is_available() noexcept
+{
+    return Prp::is_available();
+}
+
+DeterministicCipher::DeterministicCipher(const unsigned expansion)
+    : DeterministicCipher(Key<kKeySize>(), expansion)
+{
+}
+
+DeterministicCipher::DeterministicCipher(Key<kKeySize>&& k,
+                                         const unsigned  expansion)
+    : cipher_imp_(nullptr)
+{
+    if (!DeterministicCipher::is_available()) {
+        throw std::runtime_error("DeterministicCipher is unavailable: AES "
+                                 "hardware acceleration not supported by "
+                                 "the CPU");
+    }
+    if (expansion < kMinExpansion || expansion > kMaxExpansion) {
+        throw std::invalid_argument(
+            "Invalid ciphertext expansion: must be between "
+            + std::to_string(kMinExpansion) + " and "
+            + std::to_string(kMaxExpansion) + " bytes");
+    }
+    cipher_imp_ = new DeterministicCipherImpl(std::move(k), expansion);
+}
+
+DeterministicCipher::~DeterministicCipher()
+{
+    delete cipher_imp_;
+}
+
+unsigned DeterministicCipher::expansion() const noexcept
+{
+    return cipher_imp_->expansion();
+}
+
+size_t DeterministicCipher::ciphertext_length(
+    const size_t plaintext_len) const noexcept
+{
+    return plaintext_len + expansion();
+}
+
+size_t DeterministicCipher::plaintext_length(
+    const size_t ciphertext_len) const
+{
+    if (ciphertext_len < expansion()) {
+        throw std::invalid_argument(
+            "The ciphertext length should be at least "
+            + std::to_string(expansion()) + " bytes");
+    }
+    return ciphertext_len - expansion();
+}
+
+void DeterministicCipher::encrypt(const uint8_t* label,
+                                  const size_t   label_len,
+                                  const uint8_t* in,
+                                  const size_t   len,
+                                  uint8_t*       out) const
+{
+    if (label_len > kMaxLabelSize) {
+        throw std::invalid_argument("Invalid label: labels are at most "
+                                    + std::to_string(kMaxLabelSize)
+                                    + " bytes long");
+    }
+    if ((label == nullptr && label_len != 0) || (in == nullptr && len != 0)) {
+        throw std::invalid_argument("Invalid input: in == NULL");
+    }
+    if (out == nullptr) {
+        throw std::invalid_argument("Invalid output: out == NULL");
+    }
+    // AEZ counts the bytes of the ciphertext with an unsigned int
+    if (len > UINT_MAX - expansion()) {
+        throw std::invalid_argument("The plaintext is too long");
+    }
+
+    cipher_imp_->encrypt(label, label_len, in, len, out);
+}
+
+void DeterministicCipher::encrypt(const std::string& label,
+                                  const std::string& in,
+                                  std::string&       out) const
+{
+    if (in.size() > UINT_MAX - expansion()) {
+        throw std::invalid_argument("The plaintext is too long");
+    }
+    out.resize(ciphertext_length(in.size()));
+
+    encrypt(reinterpret_cast<const uint8_t*>(label.data()),
+            label.size(),
+            reinterpret_cast<const uint8_t*>(in.data()),
+            in.size(),
+            reinterpret_cast<uint8_t*>(&out[0]));
+}
+
+std::string DeterministicCipher::encrypt(const std::string& label,
+                                         const std::string& in) const
+{
+    std::string out;
+    encrypt(label, in, out);
+    return out;
+}
+
+void DeterministicCipher::decrypt(const uint8_t* label,
+                                  const size_t   label_len,
+                                  const uint8_t* in,
+                                  const size_t   len,
+                                  uint8_t*       out) const
+{
+    if (label_len > kMaxLabelSize) {
+        throw std::invalid_argument("Invalid label: labels are at most "
+                                    + std::to_string(kMaxLabelSize)
+                                    + " bytes long");
+    }
+    if ((label == nullptr && label_len != 0) || in == nullptr) {
+        throw std::invalid_argument("Invalid input: in == NULL");
+    }
+    const size_t out_len = plaintext_length(len);
+    if (out == nullptr && out_len != 0) {
+        throw std::invalid_argument("Invalid output: out == NULL");
+    }
+    if (len > UINT_MAX) {
+        throw std::invalid_argument("The ciphertext is too long");
+    }
+
+    if (!cipher_imp_->decrypt(label, label_len, in, len, out)) {
+        // do not leak the unauthenticated plaintext
+        if (out_len != 0) {
+            sodium_memzero(out, out_len);
+        }
+        throw std::runtime_error("Decryption failed: invalid ciphertext or "
+                                 "label");
+    }
+}
+
+void DeterministicCipher::decrypt(const std::string& label,
+                                  const std::string& in,
+                                  std::string&       out) const
+{
+    std::string tmp(plaintext_length(in.size()), 0x00);
+
+    decrypt(reinterpret_cast<const uint8_t*>(label.data()),
+            label.size(),
+            reinterpret_cast<const uint8_t*>(in.data()),
+            in.size(),
+            reinterpret_cast<uint8_t*>(&tmp[0]));
+    out = std::move(tmp);
+}
+
+std::string DeterministicCipher::decrypt(const std::string& label,
+                                         const std::string& in) const
+{
+    std::string out;
+    decrypt(label, in, out);
+    return out;
+}
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+
+DeterministicCipher::DeterministicCipherImpl::DeterministicCipherImpl(
+    Key<kKeySize>&& k,
+    const unsigned  expansion)
+    : expansion_(expansion)
+{
+    auto callback = [&k](uint8_t* key_content) {
+        aez_setup(static_cast<const unsigned char*>(k.unlock_get()),
+                  kKeySize,
+                  reinterpret_cast<aez_ctx_t*>(key_content));
+    };
+
+    aez_ctx_ = Key<sizeof(aez_ctx_t)>(callback);
+    k.erase();
+    aez_ctx_.unlock();
+}
+
+// The message is enciphered with AEZ, appending expansion_ zero bytes, and
+// using the label as the nonce.
+void DeterministicCipher::DeterministicCipherImpl::encrypt(
+    const uint8_t* label,
+    const size_t   label_len,
+    const uint8_t* in,
+    const size_t   len,
+    uint8_t*       out) const
+{
+    aez_encrypt(reinterpret_cast<const aez_ctx_t*>(aez_ctx_.data()),
+                reinterpret_cast<const char*>(label),
+                static_cast<unsigned>(label_len),
+                expansion_,
+                reinterpret_cast<const char*>(in),
+                static_cast<unsigned>(len),
+                reinterpret_cast<char*>(out));
+}
+
+bool DeterministicCipher::DeterministicCipherImpl::decrypt(
+    const uint8_t* label,
+    const size_t   label_len,
+    const uint8_t* in,
+    const size_t   len,
+    uint8_t*       out) const
+{
+    int ret = aez_decrypt(reinterpret_cast<const aez_ctx_t*>(aez_ctx_.data()),
+                          reinterpret_cast<const char*>(label),
+                          static_cast<unsigned>(label_len),
+                          expansion_,
+                          reinterpret_cast<const char*>(in),
+                          static_cast<unsigned>(len),
+                          reinterpret_cast<char*>(out));
+    return ret == 0;
+}
+
+#endif /* __AES__ || __ARM_FEATURE_CRYPTO */
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,294 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "key.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+namespace sse {
+namespace crypto {
+
+/// @class DeterministicCipher
+/// @brief Deterministic authenticated encryption.
+///
+/// DeterministicCipher is an opaque class for deterministic, misuse-resistant
+/// authenticated encryption. Instead of drawing a random nonce for every
+/// message, as Cipher does, the caller supplies a label (of at most
+/// kMaxLabelSize bytes). The label is not stored in the ciphertext: it has to
+/// be provided again for decryption, and decryption with another label fails.
+///
+/// The ciphertext of a message is as long as the message plus expansion()
+/// bytes, the expansion being chosen between kMinExpansion and kMaxExpansion
+/// bytes (16 by default). For index entries of a few bytes, this is much more
+/// compact than Cipher, which adds at least 32 bytes per message.
+///
+/// The construction is AEZ (Hoang, Krovetz and Rogaway, EUROCRYPT'15), used
+/// as a tweakable enciphering scheme: the message, followed by expansion()
+/// zero bytes, is enciphered with the label as the nonce, and these zero
+/// bytes are checked on decryption. As AEZ is a strong pseudorandom
+/// permutation over the whole message, encrypting the same (label, message)
+/// pair twice gives the same ciphertext, but nothing else is leaked, even if
+/// labels are repeated: the labels only need to be unique for messages to be
+/// unlinkable. The probability of forging a ciphertext is at most
+/// q/2^(8*expansion()) after q attempts.
+///
+/// @warning    Encryption is deterministic: when a label is used for several
+///             messages, equal messages have equal ciphertexts.
+///
+/// As for Prp, DeterministicCipher requires support of AES-NI (on x86 CPUs)
+/// or of ARM NEON instructions (on ARM CPUs). See the is_available static
+/// function.
+///
+
+class DeterministicCipher
+{
+public:
+    /// @brief DeterministicCipher key size (in bytes)
+    static constexpr uint8_t kKeySize = 48;
+
+    /// @brief Maximum label size (in bytes)
+    static constexpr size_t kMaxLabelSize = 16;
+
+    /// @brief Minimum ciphertext expansion (in bytes)
+    static constexpr unsigned kMinExpansion = 4;
+
+    /// @brief Maximum ciphertext expansion (in bytes)
+    static constexpr unsigned kMaxExpansion = 16;
+
+    /// @brief Default ciphertext expansion (in bytes)
+    static constexpr unsigned kDefaultExpansion = 16;
+
+    ///
+    /// @brief Check availability of the DeterministicCipher class
+    ///
+    /// The DeterministicCipher class is available iff the Prp class is.
+    ///
+    /// @return true if the DeterministicCipher class can be used, false
+    ///         otherwise.
+    ///
+    static bool is_available() noexcept;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a deterministic cipher with a new randomly generated key.
+    ///
+    /// @param expansion    The number of bytes added to every message. Must
+    ///                     be between kMinExpansion and kMaxExpansion.
+    ///
+    /// @exception std::runtime_error       The DeterministicCipher class is
+    ///                                     not available.
+    /// @exception std::invalid_argument    expansion is out of range.
+    ///
+    explicit DeterministicCipher(
+        const unsigned expansion = kDefaultExpansion);
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a deterministic cipher from a 48 bytes (384 bits) key. After a
+    /// call to the constructor, the input key is held by the
+    /// DeterministicCipher object, and cannot be re-used.
+    ///
+    /// @param k            The key used to initialize the cipher.
+    ///                     Upon return, k is empty
+    /// @param expansion    The number of bytes added to every message. Must
+    ///                     be between kMinExpansion and kMaxExpansion.
+    ///
+    /// @exception std::runtime_error       The DeterministicCipher class is
+    ///                                     not available.
+    /// @exception std::invalid_argument    expansion is out of range.
+    ///
+    explicit DeterministicCipher(
+        Key<kKeySize>&& k,
+        const unsigned  expansion = kDefaultExpansion);
+
+    ///
+    /// @brief Destructor
+    ///
+    /// Destructs the DeterministicCipher object and erase its key.
+    ///
+    ///
+    ~DeterministicCipher();
+
+    // we should not be able to duplicate DeterministicCipher objects
+    DeterministicCipher(const DeterministicCipher& c)  = delete;
+    DeterministicCipher(DeterministicCipher& c)        = delete;
+    DeterministicCipher(const DeterministicCipher&& c) = delete;
+    DeterministicCipher(DeterministicCipher&& c)       = delete;
+
+    ///
+    /// @brief Get the ciphertext expansion
+    ///
+    /// @return The number of bytes added to every message by encryption.
+    ///
+    unsigned expansion() const noexcept;
+
+    ///
+    /// @brief Ciphertext length
+    ///
+    /// @param plaintext_len    The length of the message.
+    /// @return                 The length of the encryption of the message.
+    ///
+    size_t ciphertext_length(const size_t plaintext_len) const noexcept;
+
+    ///
+    /// @brief Plaintext length
+    ///
+    /// @param ciphertext_len   The length of the ciphertext.
+    /// @return                 The length of the decrypted message.
+    ///
+    /// @exception std::invalid_argument    ciphertext_len is smaller than
+    ///                                     expansion().
+    ///
+    size_t plaintext_length(const size_t ciphertext_len) const;
+
+    ///
+    /// @brief Encrypt a message
+    ///
+    /// Encrypts a message under a label. The ciphertext is written in out,
+    /// which must be at least ciphertext_length(len) bytes long. This
+    /// function is thread-safe.
+    ///
+    /// @param label        The label.
+    /// @param label_len    The length of the label, at most kMaxLabelSize.
+    /// @param in           The message.
+    /// @param len          The length of the message.
+    /// @param out          The ciphertext.
+    ///
+    /// @exception std::invalid_argument    The label is too long, in or out
+    ///                                     is NULL, or the message is too
+    ///                                     long.
+    ///
+    void encrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const;
+
+    ///
+    /// @brief Encrypt a message
+    ///
+    /// Encrypts a string under a label.
+    ///
+    /// @param label    The label, of at most kMaxLabelSize bytes.
+    /// @param in       The message.
+    /// @param out      The ciphertext.
+    ///
+    /// @exception std::invalid_argument    The label or the message is too
+    ///                                     long.
+    ///
+    void encrypt(const std::string& label,
+                 const std::string& in,
+                 std::string&       out) const;
+
+    ///
+    /// @brief Encrypt a message
+    ///
+    /// Encrypts a string under a label.
+    ///
+    /// @param label    The label, of at most kMaxLabelSize bytes.
+    /// @param in       The message.
+    /// @return         The ciphertext.
+    ///
+    /// @exception std::invalid_argument    The label or the message is too
+    ///                                     long.
+    ///
+    std::string encrypt(const std::string& label, const std::string& in) const;
+
+    ///
+    /// @brief Decrypt a ciphertext
+    ///
+    /// Decrypts and authenticates a ciphertext under a label. The message is
+    /// written in out, which must be at least plaintext_length(len) bytes
+    /// long. On failure, the content of out is erased. This function is
+    /// thread-safe.
+    ///
+    /// @param label        The label used for encryption.
+    /// @param label_len    The length of the label, at most kMaxLabelSize.
+    /// @param in           The ciphertext.
+    /// @param len          The length of the ciphertext.
+    /// @param out          The decrypted message.
+    ///
+    /// @exception std::invalid_argument    The label is too long, in or out
+    ///                                     is NULL, or the ciphertext is
+    ///                                     shorter than expansion().
+    /// @exception std::runtime_error       The ciphertext is not valid for
+    ///                                     this label.
+    ///
+    void decrypt(const uint8_t* label,
+                 const size_t   label_len,
+                 const uint8_t* in,
+                 const size_t   len,
+                 uint8_t*       out) const;
+
+    ///
+    /// @brief Decrypt a ciphertext
+    ///
+    /// Decrypts and authenticates a ciphertext under a label.
+    ///
+    /// @param label    The label used for encryption.
+    /// @param in       The ciphertext.
+    /// @param out      The decrypted message.
+    ///
+    /// @exception std::invalid_argument    The label is too long, or the
+    ///                                     ciphertext is shorter than
+    ///                                     expansion().
+    /// @exception std::runtime_error       The ciphertext is not valid for
+    ///                                     this label.
+    ///
+    void decrypt(const std::string& label,
+                 const std::string& in,
+                 std::string&       out) const;
+
+    ///
+    /// @brief Decrypt a ciphertext
+    ///
+    /// Decrypts and authenticates a ciphertext under a label.
+    ///
+    /// @param label    The label used for encryption.
+    /// @param in       The ciphertext.
+    /// @return         The decrypted message.
+    ///
+    /// @exception std::invalid_argument    The label is too long, or the
+    ///                                     ciphertext is shorter than
+    ///                                     expansion().
+    /// @exception std::runtime_error       The ciphertext is not valid for
+    ///                                     this label.
+    ///
+    std::string decrypt(const std::string& label, const std::string& in) const;
+
+    // Again, avoid any assignement of DeterministicCipher objects
+    DeterministicCipher& operator=(const DeterministicCipher& h) = delete;
+    DeterministicCipher& operator=(DeterministicCipher& h) = delete;
+
+private:
+    class DeterministicCipherImpl;        // not defined in the header
+    DeterministicCipherImpl* cipher_imp_; // opaque pointer
+};
+
+} // namespace crypto
+} // namespace sse
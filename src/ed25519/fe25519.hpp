@@ -0,0 +1,352 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if !defined(__SIZEOF_INT128__)
+#error "The Ed25519 field arithmetic needs 128 bits integers"
+#endif
+
+namespace sse {
+
+namespace crypto {
+
+namespace ed25519 {
+
+// Arithmetic in GF(2^255-19), with 5 limbs of 51 bits, adapted from the ref10
+// implementation (and libsodium's fe51 variant). libsodium does not export
+// these functions, hence this copy.
+//
+// All the functions return loosely reduced elements: the limbs are smaller
+// than 2^52, which is the precondition of all the functions.
+// None of the functions branches on secret data.
+
+struct fe25519
+{
+    uint64_t v[5];
+};
+
+constexpr uint64_t fe25519_mask__ = (uint64_t(1) << 51) - 1;
+
+using uint128_t = unsigned __int128;
+
+inline void fe25519_0(fe25519& h)
+{
+    memset(h.v, 0, sizeof(h.v));
+}
+
+inline void fe25519_1(fe25519& h)
+{
+    fe25519_0(h);
+    h.v[0] = 1;
+}
+
+// propagates the carries: the limbs become smaller than 2^51 (except the
+// first one, which can slightly exceed it)
+inline void fe25519_carry(fe25519& h)
+{
+    uint64_t c;
+    c = h.v[0] >> 51;
+    h.v[0] &= fe25519_mask__;
+    h.v[1] += c;
+    c = h.v[1] >> 51;
+    h.v[1] &= fe25519_mask__;
+    h.v[2] += c;
+    c = h.v[2] >> 51;
+    h.v[2] &= fe25519_mask__;
+    h.v[3] += c;
+    c = h.v[3] >> 51;
+    h.v[3] &= fe25519_mask__;
+    h.v[4] += c;
+    c = h.v[4] >> 51;
+    h.v[4] &= fe25519_mask__;
+    h.v[0] += 19 * c;
+}
+
+inline void fe25519_add(fe25519& h, const fe25519& f, const fe25519& g)
+{
+    for (size_t i = 0; i < 5; i++) {
+        h.v[i] = f.v[i] + g.v[i];
+    }
+    fe25519_carry(h);
+}
+
+// h = f - g, computed as f + 4p - g to avoid underflows
+inline void fe25519_sub(fe25519& h, const fe25519& f, const fe25519& g)
+{
+    constexpr uint64_t four_p0 = 0x1FFFFFFFFFFFB4; // 4 * (2^51 - 19)
+    constexpr uint64_t four_pi = 0x1FFFFFFFFFFFFC; // 4 * (2^51 - 1)
+
+    h.v[0] = f.v[0] + four_p0 - g.v[0];
+    for (size_t i = 1; i < 5; i++) {
+        h.v[i] = f.v[i] + four_pi - g.v[i];
+    }
+    fe25519_carry(h);
+}
+
+inline void fe25519_neg(fe25519& h, const fe25519& f)
+{
+    fe25519 zero;
+    fe25519_0(zero);
+    fe25519_sub(h, zero, f);
+}
+
+inline void fe25519_mul(fe25519& h, const fe25519& f, const fe25519& g)
+{
+    const uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3],
+                   f4 = f.v[4];
+    const uint64_t g0 = g.v[0], g1 = g.v[1], g2 = g.v[2], g3 = g.v[3],
+                   g4 = g.v[4];
+
+    const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3,
+                   g4_19 = 19 * g4;
+
+    uint128_t r0 = (uint128_t)f0 * g0 + (uint128_t)f1 * g4_19
+                   + (uint128_t)f2 * g3_19 + (uint128_t)f3 * g2_19
+                   + (uint128_t)f4 * g1_19;
+    uint128_t r1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0
+                   + (uint128_t)f2 * g4_19 + (uint128_t)f3 * g3_19
+                   + (uint128_t)f4 * g2_19;
+    uint128_t r2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1
+                   + (uint128_t)f2 * g0 + (uint128_t)f3 * g4_19
+                   + (uint128_t)f4 * g3_19;
+    uint128_t r3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2
+                   + (uint128_t)f2 * g1 + (uint128_t)f3 * g0
+                   + (uint128_t)f4 * g4_19;
+    uint128_t r4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3
+                   + (uint128_t)f2 * g2 + (uint128_t)f3 * g1
+                   + (uint128_t)f4 * g0;
+
+    r1 += (uint64_t)(r0 >> 51);
+    r2 += (uint64_t)(r1 >> 51);
+    r3 += (uint64_t)(r2 >> 51);
+    r4 += (uint64_t)(r3 >> 51);
+
+    h.v[0] = (uint64_t)r0 & fe25519_mask__;
+    h.v[1] = (uint64_t)r1 & fe25519_mask__;
+    h.v[2] = (uint64_t)r2 & fe25519_mask__;
+    h.v[3] = (uint64_t)r3 & fe25519_mask__;
+    h.v[4] = (uint64_t)r4 & fe25519_mask__;
+
+    h.v[0] += 19 * (uint64_t)(r4 >> 51);
+    h.v[1] += h.v[0] >> 51;
+    h.v[0] &= fe25519_mask__;
+}
+
+inline void fe25519_sq(fe25519& h, const fe25519& f)
+{
+    const uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3],
+                   f4 = f.v[4];
+
+    const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+    const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+
+    uint128_t r0 = (uint128_t)f0 * f0 + (uint128_t)f1_2 * f4_19
+                   + (uint128_t)(2 * f2) * f3_19;
+    uint128_t r1 = (uint128_t)f0_2 * f1 + (uint128_t)(2 * f2) * f4_19
+                   + (uint128_t)f3 * f3_19;
+    uint128_t r2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1
+                   + (uint128_t)(2 * f3) * f4_19;
+    uint128_t r3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2
+                   + (uint128_t)f4 * f4_19;
+    uint128_t r4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3
+                   + (uint128_t)f2 * f2;
+
+    r1 += (uint64_t)(r0 >> 51);
+    r2 += (uint64_t)(r1 >> 51);
+    r3 += (uint64_t)(r2 >> 51);
+    r4 += (uint64_t)(r3 >> 51);
+
+    h.v[0] = (uint64_t)r0 & fe25519_mask__;
+    h.v[1] = (uint64_t)r1 & fe25519_mask__;
+    h.v[2] = (uint64_t)r2 & fe25519_mask__;
+    h.v[3] = (uint64_t)r3 & fe25519_mask__;
+    h.v[4] = (uint64_t)r4 & fe25519_mask__;
+
+    h.v[0] += 19 * (uint64_t)(r4 >> 51);
+    h.v[1] += h.v[0] >> 51;
+    h.v[0] &= fe25519_mask__;
+}
+
+// h = f^(2^n)
+inline void fe25519_sq_n(fe25519& h, const fe25519& f, unsigned int n)
+{
+    fe25519_sq(h, f);
+    for (unsigned int i = 1; i < n; i++) {
+        fe25519_sq(h, h);
+    }
+}
+
+// replaces f with g if b == 1, keeps f if b == 0
+inline void fe25519_cmov(fe25519& f, const fe25519& g, unsigned int b)
+{
+    const uint64_t mask = uint64_t(0) - uint64_t(b);
+    for (size_t i = 0; i < 5; i++) {
+        f.v[i] ^= mask & (f.v[i] ^ g.v[i]);
+    }
+}
+
+// the top bit of s is ignored
+inline void fe25519_frombytes(fe25519& h, const uint8_t s[32])
+{
+    uint64_t w[4];
+    for (size_t i = 0; i < 4; i++) {
+        w[i] = 0;
+        for (size_t j = 0; j < 8; j++) {
+            w[i] |= uint64_t(s[8 * i + j]) << (8 * j);
+        }
+    }
+
+    h.v[0] = w[0] & fe25519_mask__;
+    h.v[1] = ((w[0] >> 51) | (w[1] << 13)) & fe25519_mask__;
+    h.v[2] = ((w[1] >> 38) | (w[2] << 26)) & fe25519_mask__;
+    h.v[3] = ((w[2] >> 25) | (w[3] << 39)) & fe25519_mask__;
+    h.v[4] = (w[3] >> 12) & fe25519_mask__;
+}
+
+// writes the canonical (fully reduced) encoding of f
+inline void fe25519_tobytes(uint8_t s[32], const fe25519& f)
+{
+    fe25519 t = f;
+
+    // t < 2^255 + small after two carry rounds
+    fe25519_carry(t);
+    fe25519_carry(t);
+
+    // subtract p if t >= p: q = 1 iff t + 19 >= 2^255
+    uint64_t q = (t.v[0] + 19) >> 51;
+    q          = (t.v[1] + q) >> 51;
+    q          = (t.v[2] + q) >> 51;
+    q          = (t.v[3] + q) >> 51;
+    q          = (t.v[4] + q) >> 51;
+
+    t.v[0] += 19 * q;
+    t.v[1] += t.v[0] >> 51;
+    t.v[0] &= fe25519_mask__;
+    t.v[2] += t.v[1] >> 51;
+    t.v[1] &= fe25519_mask__;
+    t.v[3] += t.v[2] >> 51;
+    t.v[2] &= fe25519_mask__;
+    t.v[4] += t.v[3] >> 51;
+    t.v[3] &= fe25519_mask__;
+    t.v[4] &= fe25519_mask__;
+
+    const uint64_t w[4] = {t.v[0] | (t.v[1] << 51),
+                           (t.v[1] >> 13) | (t.v[2] << 38),
+                           (t.v[2] >> 26) | (t.v[3] << 25),
+                           (t.v[3] >> 39) | (t.v[4] << 12)};
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            s[8 * i + j] = static_cast<uint8_t>(w[i] >> (8 * j));
+        }
+    }
+}
+
+inline int fe25519_isnegative(const fe25519& f)
+{
+    uint8_t s[32];
+    fe25519_tobytes(s, f);
+    return s[0] & 1;
+}
+
+inline int fe25519_iszero(const fe25519& f)
+{
+    uint8_t s[32];
+    fe25519_tobytes(s, f);
+
+    uint8_t d = 0;
+    for (size_t i = 0; i < 32; i++) {
+        d |= s[i];
+    }
+    return 1 & ((uint32_t(d) - 1) >> 8);
+}
+
+// h = f^(2^250 - 1)
+inline void fe25519_pow2_250_1(fe25519& h, const fe25519& f)
+{
+    fe25519 t0, t1, t2;
+
+    fe25519_sq(t0, f);         // 2
+    fe25519_sq_n(t1, t0, 2);   // 8
+    fe25519_mul(t1, f, t1);    // 9
+    fe25519_mul(t0, t0, t1);   // 11
+    fe25519_sq(t0, t0);        // 22
+    fe25519_mul(t0, t1, t0);   // 2^5 - 1
+    fe25519_sq_n(t1, t0, 5);   // 2^10 - 2^5
+    fe25519_mul(t0, t1, t0);   // 2^10 - 1
+    fe25519_sq_n(t1, t0, 10);  // 2^20 - 2^10
+    fe25519_mul(t1, t1, t0);   // 2^20 - 1
+    fe25519_sq_n(t2, t1, 20);  // 2^40 - 2^20
+    fe25519_mul(t1, t2, t1);   // 2^40 - 1
+    fe25519_sq_n(t1, t1, 10);  // 2^50 - 2^10
+    fe25519_mul(t0, t1, t0);   // 2^50 - 1
+    fe25519_sq_n(t1, t0, 50);  // 2^100 - 2^50
+    fe25519_mul(t1, t1, t0);   // 2^100 - 1
+    fe25519_sq_n(t2, t1, 100); // 2^200 - 2^100
+    fe25519_mul(t1, t2, t1);   // 2^200 - 1
+    fe25519_sq_n(t1, t1, 50);  // 2^250 - 2^50
+    fe25519_mul(h, t1, t0);    // 2^250 - 1
+}
+
+// h = 1/f = f^(p - 2) = f^(2^255 - 21)
+inline void fe25519_invert(fe25519& h, const fe25519& f)
+{
+    fe25519 t, f2, f11;
+
+    fe25519_sq(f2, f);
+    fe25519_sq_n(f11, f2, 2);
+    fe25519_mul(f11, f11, f);
+    fe25519_mul(f11, f11, f2);
+
+    fe25519_pow2_250_1(t, f);
+    fe25519_sq_n(t, t, 5);
+    fe25519_mul(h, t, f11);
+}
+
+// h = f^((p - 5) / 8) = f^(2^252 - 3)
+inline void fe25519_pow22523(fe25519& h, const fe25519& f)
+{
+    fe25519 t;
+
+    fe25519_pow2_250_1(t, f);
+    fe25519_sq_n(t, t, 2);
+    fe25519_mul(h, t, f);
+}
+
+// Legendre symbol: h = f^((p - 1) / 2) = f^(2^254 - 10)
+inline void fe25519_chi(fe25519& h, const fe25519& f)
+{
+    fe25519 t, f2, f6;
+
+    fe25519_sq(f2, f);
+    fe25519_mul(f6, f2, f);
+    fe25519_sq(f6, f6);
+
+    fe25519_pow2_250_1(t, f);
+    fe25519_sq_n(t, t, 4);
+    fe25519_mul(h, t, f6);
+}
+
+} // namespace ed25519
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,672 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ed25519/ge25519.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <vector>
+
+namespace sse {
+
+namespace crypto {
+
+namespace ed25519 {
+
+// d = -121665/121666
+static const fe25519 ed25519_d__
+    = {{0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029, 0x739c663a03cbb,
+        0x52036cee2b6ff}};
+
+// 2 * d
+static const fe25519 ed25519_d2__
+    = {{0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977,
+        0x2406d9dc56dff}};
+
+// sqrt(-1)
+static const fe25519 ed25519_sqrtm1__
+    = {{0x61b274a0ea0b0, 0xd5a5fc8f189d, 0x7ef5e9cbd0c60, 0x78595a6804c9e,
+        0x2b8324804fc1d}};
+
+// A, the parameter of the birationally equivalent Montgomery curve
+static const fe25519 curve25519_A__ = {{486662, 0, 0, 0, 0}};
+
+// Ristretto255 constants: sqrt(a*d - 1), 1/sqrt(a - d), 1 - d^2 and (d - 1)^2
+static const fe25519 ristretto255_sqrt_ad_minus_one__
+    = {{0x7f6a0497b2e1b, 0x1836f0a97afd2, 0x7d747f6be7638, 0x456079e7e6498,
+        0x376931bf2b834}};
+
+static const fe25519 ristretto255_invsqrt_a_minus_d__
+    = {{0xfdaa805d40ea, 0x2eb482e57d339, 0x7610274bc58, 0x6510b613dc8ff,
+        0x786c8905cfaff}};
+
+static const fe25519 ristretto255_one_minus_d_sq__
+    = {{0x409c1945fc176, 0x719abc6a1fc4f, 0x1c37f90b20684, 0x6bccca55eedf,
+        0x29072a8b2b3e}};
+
+static const fe25519 ristretto255_d_minus_one_sq__
+    = {{0x55aaa44ed4d20, 0x59603c3332635, 0x26d3baf4a7928, 0x120a66e6997a9,
+        0x5968b37af66c2}};
+
+void ge25519_identity(ge25519_p3& h)
+{
+    fe25519_0(h.X);
+    fe25519_1(h.Y);
+    fe25519_1(h.Z);
+    fe25519_0(h.T);
+}
+
+// Recovers x from y and the sign of x
+static int ge25519_from_y(ge25519_p3& h, const fe25519& y, unsigned int x_sign)
+{
+    fe25519 u, v, v3, vxx, check;
+
+    h.Y = y;
+    fe25519_1(h.Z);
+
+    // x^2 = u/v with u = y^2 - 1 and v = d*y^2 + 1
+    fe25519_sq(u, h.Y);
+    fe25519_mul(v, u, ed25519_d__);
+    fe25519_sub(u, u, h.Z);
+    fe25519_add(v, v, h.Z);
+
+    // x = u * v^3 * (u * v^7)^((p-5)/8)
+    fe25519_sq(v3, v);
+    fe25519_mul(v3, v3, v);
+    fe25519_sq(h.X, v3);
+    fe25519_mul(h.X, h.X, v);
+    fe25519_mul(h.X, h.X, u);
+    fe25519_pow22523(h.X, h.X);
+    fe25519_mul(h.X, h.X, v3);
+    fe25519_mul(h.X, h.X, u);
+
+    fe25519_sq(vxx, h.X);
+    fe25519_mul(vxx, vxx, v);
+    fe25519_sub(check, vxx, u);
+    if (!fe25519_iszero(check)) {
+        fe25519_add(check, vxx, u);
+        if (!fe25519_iszero(check)) {
+            return -1;
+        }
+        fe25519_mul(h.X, h.X, ed25519_sqrtm1__);
+    }
+
+    fe25519 neg_x;
+    fe25519_neg(neg_x, h.X);
+    fe25519_cmov(
+        h.X, neg_x, static_cast<unsigned int>(fe25519_isnegative(h.X))
+                        ^ x_sign);
+
+    fe25519_mul(h.T, h.X, h.Y);
+    return 0;
+}
+
+int ge25519_frombytes(ge25519_p3& h, const uint8_t s[32])
+{
+    fe25519 y;
+    fe25519_frombytes(y, s);
+
+    return ge25519_from_y(h, y, s[31] >> 7);
+}
+
+void ge25519_tobytes(uint8_t s[32], const ge25519_p3& h)
+{
+    fe25519 recip, x, y;
+
+    fe25519_invert(recip, h.Z);
+    fe25519_mul(x, h.X, recip);
+    fe25519_mul(y, h.Y, recip);
+    fe25519_tobytes(s, y);
+    s[31] ^= static_cast<uint8_t>(fe25519_isnegative(x) << 7);
+}
+
+// add-2008-hwcd-3, 8M + 1 multiplication by a constant
+void ge25519_add(ge25519_p3& r, const ge25519_p3& p, const ge25519_p3& q)
+{
+    fe25519 a, b, c, d, e, f, g, h, t;
+
+    fe25519_sub(a, p.Y, p.X);
+    fe25519_sub(t, q.Y, q.X);
+    fe25519_mul(a, a, t);
+    fe25519_add(b, p.Y, p.X);
+    fe25519_add(t, q.Y, q.X);
+    fe25519_mul(b, b, t);
+    fe25519_mul(c, p.T, q.T);
+    fe25519_mul(c, c, ed25519_d2__);
+    fe25519_mul(d, p.Z, q.Z);
+    fe25519_add(d, d, d);
+
+    fe25519_sub(e, b, a);
+    fe25519_sub(f, d, c);
+    fe25519_add(g, d, c);
+    fe25519_add(h, b, a);
+
+    fe25519_mul(r.X, e, f);
+    fe25519_mul(r.Y, g, h);
+    fe25519_mul(r.T, e, h);
+    fe25519_mul(r.Z, f, g);
+}
+
+void ge25519_sub(ge25519_p3& r, const ge25519_p3& p, const ge25519_p3& q)
+{
+    ge25519_p3 neg_q;
+
+    fe25519_neg(neg_q.X, q.X);
+    neg_q.Y = q.Y;
+    neg_q.Z = q.Z;
+    fe25519_neg(neg_q.T, q.T);
+
+    ge25519_add(r, p, neg_q);
+}
+
+// dbl-2008-hwcd, 4M + 4S
+void ge25519_dbl(ge25519_p3& r, const ge25519_p3& p)
+{
+    fe25519 a, b, c, e, f, g, h;
+
+    fe25519_sq(a, p.X);
+    fe25519_sq(b, p.Y);
+    fe25519_sq(c, p.Z);
+    fe25519_add(c, c, c);
+
+    // e = (X + Y)^2 - a - b, g = b - a and h = -a - b, as the curve
+    // parameter is -1
+    fe25519_add(h, p.X, p.Y);
+    fe25519_sq(e, h);
+    fe25519_add(h, a, b);
+    fe25519_sub(e, e, h);
+    fe25519_neg(h, h);
+    fe25519_sub(g, b, a);
+    fe25519_sub(f, g, c);
+
+    fe25519_mul(r.X, e, f);
+    fe25519_mul(r.Y, g, h);
+    fe25519_mul(r.T, e, h);
+    fe25519_mul(r.Z, f, g);
+}
+
+int ge25519_is_equal(const ge25519_p3& p, const ge25519_p3& q)
+{
+    // x_p = x_q and y_p = y_q, without inversion
+    fe25519 l, r, dx, dy;
+
+    fe25519_mul(l, p.X, q.Z);
+    fe25519_mul(r, q.X, p.Z);
+    fe25519_sub(dx, l, r);
+    fe25519_mul(l, p.Y, q.Z);
+    fe25519_mul(r, q.Y, p.Z);
+    fe25519_sub(dy, l, r);
+
+    return fe25519_iszero(dx) & fe25519_iszero(dy);
+}
+
+// replaces p with q if b == 1, keeps p if b == 0
+static void ge25519_cmov(ge25519_p3& p, const ge25519_p3& q, unsigned int b)
+{
+    fe25519_cmov(p.X, q.X, b);
+    fe25519_cmov(p.Y, q.Y, b);
+    fe25519_cmov(p.Z, q.Z, b);
+    fe25519_cmov(p.T, q.T, b);
+}
+
+// number of significant bits of n
+static unsigned int bit_length(uint64_t n)
+{
+    unsigned int l = 0;
+    for (; n != 0; n >>= 1) {
+        l++;
+    }
+    return l;
+}
+
+void ge25519_scalarmult_u64(ge25519_p3& r, const ge25519_p3& p, uint64_t n)
+{
+    ge25519_multi_scalarmult_u64(r, &p, &n, 1);
+}
+
+void ge25519_multi_scalarmult_u64(ge25519_p3&       r,
+                                  const ge25519_p3* p,
+                                  const uint64_t*   n,
+                                  const size_t      len)
+{
+    uint64_t max_n = 0;
+    for (size_t i = 0; i < len; i++) {
+        max_n |= n[i];
+    }
+
+    ge25519_p3 acc, t;
+    ge25519_identity(acc);
+
+    for (unsigned int b = bit_length(max_n); b > 0; b--) {
+        ge25519_dbl(acc, acc);
+        for (size_t i = 0; i < len; i++) {
+            ge25519_add(t, acc, p[i]);
+            ge25519_cmov(
+                acc, t, static_cast<unsigned int>((n[i] >> (b - 1)) & 1));
+        }
+    }
+    r = acc;
+}
+
+// Same computations as libsodium's ge25519_from_uniform, except for the final
+// encoding
+void ge25519_from_uniform(ge25519_p3& h, const uint8_t r[32])
+{
+    fe25519      rr2, x, x2, x3, e, neg_x, one;
+    uint8_t      s[32];
+    unsigned int e_is_minus_1;
+
+    const unsigned int x_sign = r[31] >> 7;
+    fe25519_frombytes(rr2, r); // ignores the top bit
+
+    // elligator 2: x = -A / (1 + 2r^2) on the Montgomery curve
+    fe25519_1(one);
+    fe25519_sq(rr2, rr2);
+    fe25519_add(rr2, rr2, rr2);
+    fe25519_add(rr2, rr2, one);
+    fe25519_invert(rr2, rr2);
+    fe25519_mul(x, curve25519_A__, rr2);
+    fe25519_neg(x, x);
+
+    // e = x^3 + A x^2 + x
+    fe25519_sq(x2, x);
+    fe25519_mul(x3, x, x2);
+    fe25519_add(e, x3, x);
+    fe25519_mul(x2, x2, curve25519_A__);
+    fe25519_add(e, x2, e);
+
+    // if e is not a square, x = -x - A
+    fe25519_chi(e, e);
+    fe25519_tobytes(s, e);
+    e_is_minus_1 = s[1] & 1;
+    fe25519_neg(neg_x, x);
+    fe25519_cmov(x, neg_x, e_is_minus_1);
+    fe25519_0(x2);
+    fe25519_cmov(x2, curve25519_A__, e_is_minus_1);
+    fe25519_sub(x, x, x2);
+
+    // y = (x - 1) / (x + 1) on the Edwards curve
+    fe25519 x_plus_one, x_minus_one, y;
+    fe25519_add(x_plus_one, x, one);
+    fe25519_sub(x_minus_one, x, one);
+    fe25519_invert(x_plus_one, x_plus_one);
+    fe25519_mul(y, x_minus_one, x_plus_one);
+
+
+    ge25519_p3 p;
+    if (ge25519_from_y(p, y, x_sign) != 0) {
+        // y is always the ordinate of a curve point
+        abort(); /* LCOV_EXCL_LINE */
+    }
+
+    // multiply by the cofactor
+    ge25519_dbl(p, p);
+    ge25519_dbl(p, p);
+    ge25519_dbl(h, p);
+}
+
+// Inverts the len elements of a in place (zero is mapped to zero, as with
+// fe25519_invert), with Montgomery's trick: a single inversion and
+// 3 * (len - 1) multiplications.
+static void fe25519_batch_invert(fe25519* a, const size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    std::vector<fe25519> prefix(len);
+    fe25519              acc, one, t, inv;
+
+    // prefix[i] is the product of a[0..i-1], where zeros are replaced by ones
+    fe25519_1(one);
+    fe25519_1(acc);
+    for (size_t i = 0; i < len; i++) {
+        prefix[i] = acc;
+        t         = a[i];
+        fe25519_cmov(t, one, static_cast<unsigned int>(fe25519_iszero(a[i])));
+        fe25519_mul(acc, acc, t);
+    }
+
+    fe25519_invert(inv, acc);
+
+    // inv is the inverse of the product of a[0..i]
+    for (size_t i = len; i-- > 0;) {
+        const unsigned int is_zero
+            = static_cast<unsigned int>(fe25519_iszero(a[i]));
+
+        t = a[i];
+        fe25519_cmov(t, one, is_zero);
+        fe25519_mul(a[i], inv, prefix[i]);
+        fe25519_mul(inv, inv, t);
+
+        fe25519 zero;
+        fe25519_0(zero);
+        fe25519_cmov(a[i], zero, is_zero);
+    }
+}
+
+// The computations of ge25519_from_uniform, but the two inversions of every
+// point are batched.
+void ge25519_from_uniform_sum(ge25519_p3& h, const uint8_t* r, const size_t len)
+{
+    std::vector<fe25519>      den(len), x_minus_one(len);
+    std::vector<unsigned int> x_sign(len);
+    fe25519                   one, rr2, x, x2, x3, e, neg_x;
+    uint8_t                   s[32];
+
+    fe25519_1(one);
+
+    // elligator 2: x = -A / (1 + 2r^2) on the Montgomery curve
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t* r_i = r + 32 * i;
+
+        x_sign[i] = r_i[31] >> 7;
+        fe25519_frombytes(rr2, r_i);
+        fe25519_sq(rr2, rr2);
+        fe25519_add(rr2, rr2, rr2);
+        fe25519_add(den[i], rr2, one);
+    }
+    fe25519_batch_invert(den.data(), len);
+
+    for (size_t i = 0; i < len; i++) {
+        fe25519_mul(x, curve25519_A__, den[i]);
+        fe25519_neg(x, x);
+
+        // e = x^3 + A x^2 + x
+        fe25519_sq(x2, x);
+        fe25519_mul(x3, x, x2);
+        fe25519_add(e, x3, x);
+        fe25519_mul(x2, x2, curve25519_A__);
+        fe25519_add(e, x2, e);
+
+        // if e is not a square, x = -x - A
+        fe25519_chi(e, e);
+        fe25519_tobytes(s, e);
+        const unsigned int e_is_minus_1 = s[1] & 1;
+        fe25519_neg(neg_x, x);
+        fe25519_cmov(x, neg_x, e_is_minus_1);
+        fe25519_0(x2);
+        fe25519_cmov(x2, curve25519_A__, e_is_minus_1);
+        fe25519_sub(x, x, x2);
+
+        // y = (x - 1) / (x + 1) on the Edwards curve: den holds x + 1
+        fe25519_sub(x_minus_one[i], x, one);
+        fe25519_add(den[i], x, one);
+    }
+    fe25519_batch_invert(den.data(), len);
+
+    ge25519_p3 sum, p;
+    fe25519    y;
+    ge25519_identity(sum);
+    for (size_t i = 0; i < len; i++) {
+        fe25519_mul(y, x_minus_one[i], den[i]);
+
+        // y is always the ordinate of a curve point
+        if (ge25519_from_y(p, y, x_sign[i]) != 0) {
+            abort(); /* LCOV_EXCL_LINE */
+        }
+        ge25519_add(sum, sum, p);
+    }
+
+    // multiply the sum by the cofactor, instead of every point
+    ge25519_dbl(sum, sum);
+    ge25519_dbl(sum, sum);
+    ge25519_dbl(h, sum);
+}
+
+//
+// Ristretto255
+//
+
+// h = |f|
+static void fe25519_abs(fe25519& h, const fe25519& f)
+{
+    fe25519 neg_f;
+
+    h = f;
+    fe25519_neg(neg_f, f);
+    fe25519_cmov(h, neg_f, static_cast<unsigned int>(fe25519_isnegative(f)));
+}
+
+static int fe25519_is_equal(const fe25519& f, const fe25519& g)
+{
+    fe25519 diff;
+    fe25519_sub(diff, f, g);
+    return fe25519_iszero(diff);
+}
+
+// SQRT_RATIO_M1 from RFC 9496: r = |sqrt(u/v)| if u/v is a square,
+// |sqrt(sqrt(-1) * u/v)| otherwise. Returns 1 iff u/v is a square.
+static int fe25519_sqrt_ratio_m1(fe25519&       r,
+                                 const fe25519& u,
+                                 const fe25519& v)
+{
+    fe25519 v3, v7, check, neg_u, neg_u_i, r_prime;
+
+    fe25519_sq(v3, v);
+    fe25519_mul(v3, v3, v);
+    fe25519_sq(v7, v3);
+    fe25519_mul(v7, v7, v);
+
+    // r = (u * v^3) * (u * v^7)^((p-5)/8)
+    fe25519_mul(v7, v7, u);
+    fe25519_pow22523(r, v7);
+    fe25519_mul(r, r, v3);
+    fe25519_mul(r, r, u);
+
+    fe25519_sq(check, r);
+    fe25519_mul(check, check, v);
+
+    fe25519_neg(neg_u, u);
+    fe25519_mul(neg_u_i, neg_u, ed25519_sqrtm1__);
+
+    const int correct_sign   = fe25519_is_equal(check, u);
+    const int flipped_sign   = fe25519_is_equal(check, neg_u);
+    const int flipped_sign_i = fe25519_is_equal(check, neg_u_i);
+
+    fe25519_mul(r_prime, r, ed25519_sqrtm1__);
+    fe25519_cmov(r,
+                 r_prime,
+                 static_cast<unsigned int>(flipped_sign | flipped_sign_i));
+    fe25519_abs(r, r);
+
+    return correct_sign | flipped_sign;
+}
+
+int ristretto255_frombytes(ge25519_p3& h, const uint8_t s[32])
+{
+    fe25519 s_fe, ss, u1, u2, u2_sq, v, one, invsqrt, den_x, den_y, t;
+    uint8_t s_check[32];
+
+    // canonical and non-negative
+    fe25519_frombytes(s_fe, s);
+    fe25519_tobytes(s_check, s_fe);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < 32; i++) {
+        diff |= s[i] ^ s_check[i];
+    }
+    if (diff != 0 || (s[0] & 1) != 0) {
+        return -1;
+    }
+
+    fe25519_1(one);
+    fe25519_sq(ss, s_fe);
+    fe25519_sub(u1, one, ss);
+    fe25519_add(u2, one, ss);
+    fe25519_sq(u2_sq, u2);
+
+    // v = -(d * u1^2) - u2^2
+    fe25519_sq(v, u1);
+    fe25519_mul(v, v, ed25519_d__);
+    fe25519_neg(v, v);
+    fe25519_sub(v, v, u2_sq);
+
+    fe25519_mul(t, v, u2_sq);
+    const int was_square = fe25519_sqrt_ratio_m1(invsqrt, one, t);
+
+    fe25519_mul(den_x, invsqrt, u2);
+    fe25519_mul(den_y, invsqrt, den_x);
+    fe25519_mul(den_y, den_y, v);
+
+    fe25519_mul(h.X, s_fe, den_x);
+    fe25519_add(h.X, h.X, h.X);
+    fe25519_abs(h.X, h.X);
+    fe25519_mul(h.Y, u1, den_y);
+    fe25519_1(h.Z);
+    fe25519_mul(h.T, h.X, h.Y);
+
+    if (!was_square || fe25519_isnegative(h.T) || fe25519_iszero(h.Y)) {
+        return -1;
+    }
+    return 0;
+}
+
+void ristretto255_tobytes(uint8_t s[32], const ge25519_p3& h)
+{
+    fe25519 u1, u2, t, one, invsqrt, den1, den2, z_inv, ix, iy, enchanted, x,
+        y, den_inv, neg_y, s_fe;
+
+    // u1 = (Z + Y) * (Z - Y), u2 = X * Y
+    fe25519_add(t, h.Z, h.Y);
+    fe25519_sub(u1, h.Z, h.Y);
+    fe25519_mul(u1, u1, t);
+    fe25519_mul(u2, h.X, h.Y);
+
+    fe25519_sq(t, u2);
+    fe25519_mul(t, t, u1);
+    fe25519_1(one);
+    fe25519_sqrt_ratio_m1(invsqrt, one, t);
+
+    fe25519_mul(den1, invsqrt, u1);
+    fe25519_mul(den2, invsqrt, u2);
+    fe25519_mul(z_inv, den1, den2);
+    fe25519_mul(z_inv, z_inv, h.T);
+
+    fe25519_mul(ix, h.X, ed25519_sqrtm1__);
+    fe25519_mul(iy, h.Y, ed25519_sqrtm1__);
+    fe25519_mul(enchanted, den1, ristretto255_invsqrt_a_minus_d__);
+
+    fe25519_mul(t, h.T, z_inv);
+    const unsigned int rotate
+        = static_cast<unsigned int>(fe25519_isnegative(t));
+
+    x       = h.X;
+    y       = h.Y;
+    den_inv = den2;
+    fe25519_cmov(x, iy, rotate);
+    fe25519_cmov(y, ix, rotate);
+    fe25519_cmov(den_inv, enchanted, rotate);
+
+    fe25519_mul(t, x, z_inv);
+    fe25519_neg(neg_y, y);
+    fe25519_cmov(y, neg_y, static_cast<unsigned int>(fe25519_isnegative(t)));
+
+    fe25519_sub(s_fe, h.Z, y);
+    fe25519_mul(s_fe, s_fe, den_inv);
+    fe25519_abs(s_fe, s_fe);
+    fe25519_tobytes(s, s_fe);
+}
+
+int ristretto255_is_equal(const ge25519_p3& p, const ge25519_p3& q)
+{
+    fe25519 l, r;
+
+    // X1 * Y2 == Y1 * X2 or Y1 * Y2 == X1 * X2
+    fe25519_mul(l, p.X, q.Y);
+    fe25519_mul(r, p.Y, q.X);
+    const int eq_1 = fe25519_is_equal(l, r);
+    fe25519_mul(l, p.Y, q.Y);
+    fe25519_mul(r, p.X, q.X);
+    const int eq_2 = fe25519_is_equal(l, r);
+
+    return eq_1 | eq_2;
+}
+
+// The Elligator map of Ristretto255 (MAP in RFC 9496)
+static void ristretto255_elligator(ge25519_p3& h, const fe25519& t)
+{
+    fe25519 one, r, u, v, tmp, s, s_prime, c, n, w0, w1, w2, w3;
+
+    fe25519_1(one);
+
+    // r = sqrt(-1) * t^2
+    fe25519_sq(r, t);
+    fe25519_mul(r, r, ed25519_sqrtm1__);
+
+    // u = (r + 1) * (1 - d^2)
+    fe25519_add(u, r, one);
+    fe25519_mul(u, u, ristretto255_one_minus_d_sq__);
+
+    // v = (-1 - r * d) * (r + d)
+    fe25519_mul(v, r, ed25519_d__);
+    fe25519_add(v, v, one);
+    fe25519_neg(v, v);
+    fe25519_add(tmp, r, ed25519_d__);
+    fe25519_mul(v, v, tmp);
+
+    const unsigned int was_square
+        = static_cast<unsigned int>(fe25519_sqrt_ratio_m1(s, u, v));
+
+    // s' = -|s * t|
+    fe25519_mul(s_prime, s, t);
+    fe25519_abs(s_prime, s_prime);
+    fe25519_neg(s_prime, s_prime);
+    fe25519_cmov(s, s_prime, 1 - was_square);
+
+    // c = -1 if u/v is a square, r otherwise
+    fe25519_neg(c, one);
+    fe25519_cmov(c, r, 1 - was_square);
+
+    // n = c * (r - 1) * (d - 1)^2 - v
+    fe25519_sub(n, r, one);
+    fe25519_mul(n, n, c);
+    fe25519_mul(n, n, ristretto255_d_minus_one_sq__);
+    fe25519_sub(n, n, v);
+
+    fe25519_mul(w0, s, v);
+    fe25519_add(w0, w0, w0);
+    fe25519_mul(w1, n, ristretto255_sqrt_ad_minus_one__);
+    fe25519_sq(tmp, s);
+    fe25519_sub(w2, one, tmp);
+    fe25519_add(w3, one, tmp);
+
+    fe25519_mul(h.X, w0, w3);
+    fe25519_mul(h.Y, w2, w1);
+    fe25519_mul(h.Z, w1, w3);
+    fe25519_mul(h.T, w0, w2);
+}
+
+void ristretto255_from_hash(ge25519_p3& h, const uint8_t r[64])
+{
+    fe25519    t;
+    ge25519_p3 p, q;
+
+    fe25519_frombytes(t, r); // ignores the top bit
+    ristretto255_elligator(p, t);
+    fe25519_frombytes(t, r + 32);
+    ristretto255_elligator(q, t);
+
+    ge25519_add(h, p, q);
+}
+
+} // namespace ed25519
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,115 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "ed25519/fe25519.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sse {
+
+namespace crypto {
+
+namespace ed25519 {
+
+// Points of the Ed25519 curve in extended coordinates (X:Y:Z:T), with
+// x = X/Z, y = Y/Z and x*y = T/Z (cf. *Twisted Edwards Curves Revisited*,
+// Hisil, Wong, Carter and Dawson). The group operations do not need any field
+// inversion: only the encoding (ge25519_tobytes) does.
+struct ge25519_p3
+{
+    fe25519 X;
+    fe25519 Y;
+    fe25519 Z;
+    fe25519 T;
+};
+
+// Sets h to the neutral element
+void ge25519_identity(ge25519_p3& h);
+
+// Decodes the point encoded in s. Returns 0 on success, -1 if s is not the
+// encoding of a curve point.
+// The encoding is not checked to be canonical, and the point is not checked to
+// be in the prime order subgroup: use crypto_core_ed25519_is_valid_point for
+// that.
+int ge25519_frombytes(ge25519_p3& h, const uint8_t s[32]);
+
+// Writes the canonical encoding of h in s (the same as libsodium's)
+void ge25519_tobytes(uint8_t s[32], const ge25519_p3& h);
+
+// r = p + q
+void ge25519_add(ge25519_p3& r, const ge25519_p3& p, const ge25519_p3& q);
+
+// r = p - q
+void ge25519_sub(ge25519_p3& r, const ge25519_p3& p, const ge25519_p3& q);
+
+// r = 2 * p
+void ge25519_dbl(ge25519_p3& r, const ge25519_p3& p);
+
+// Returns 1 if p and q represent the same point, 0 otherwise
+int ge25519_is_equal(const ge25519_p3& p, const ge25519_p3& q);
+
+// r = n * p, by double-and-add. The running time depends on the bit length of
+// n, but not on the value of its bits.
+void ge25519_scalarmult_u64(ge25519_p3& r, const ge25519_p3& p, uint64_t n);
+
+// r = sum(n[i] * p[i]) for i < len, with Straus' method: the doublings are
+// shared by all the points. The running time depends on the bit length of
+// max(n[i]), but not on the value of the bits.
+void ge25519_multi_scalarmult_u64(ge25519_p3&       r,
+                                  const ge25519_p3* p,
+                                  const uint64_t*   n,
+                                  const size_t      len);
+
+// Maps a 32 bytes string to a point of the prime order subgroup. h is the point
+// encoded by crypto_core_ed25519_from_uniform(_, r), but it is not encoded (and
+// this saves the encoding's inversion).
+void ge25519_from_uniform(ge25519_p3& h, const uint8_t r[32]);
+
+// h = sum of the points ge25519_from_uniform(_, r + 32 * i), for i < len. The
+// field inversions of the points are batched, and the sum is multiplied by the
+// cofactor once.
+void ge25519_from_uniform_sum(ge25519_p3&    h,
+                              const uint8_t* r,
+                              const size_t   len);
+
+// Ristretto255 (RFC 9496): the same point representation is used, but a
+// Ristretto255 element is a class of 4 Ed25519 points, with a canonical
+// encoding.
+
+// Decodes a Ristretto255 element. Returns 0 on success, -1 if s is not a
+// canonical encoding.
+int ristretto255_frombytes(ge25519_p3& h, const uint8_t s[32]);
+
+// Writes the canonical encoding of the element of h in s
+void ristretto255_tobytes(uint8_t s[32], const ge25519_p3& h);
+
+// Returns 1 if p and q represent the same Ristretto255 element, 0 otherwise
+int ristretto255_is_equal(const ge25519_p3& p, const ge25519_p3& q);
+
+// Maps a 64 bytes string to a Ristretto255 element. h is the element encoded by
+// crypto_core_ristretto255_from_hash(_, r), without the encoding.
+void ristretto255_from_hash(ge25519_p3& h, const uint8_t r[64]);
+
+} // namespace ed25519
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,802 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "encrypted_file.hpp"
+
+#include "random.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#include <sodium/crypto_aead_chacha20poly1305.h>
+#include <sodium/crypto_generichash_blake2b.h>
+#include <sodium/crypto_onetimeauth_poly1305.h>
+#include <sodium/crypto_stream_chacha20.h>
+#include <sodium/crypto_verify_16.h>
+#include <sodium/utils.h>
+
+namespace sse {
+
+namespace crypto {
+
+constexpr uint8_t EncryptedFileWriter::kKeySize;
+constexpr size_t  EncryptedFileWriter::kPageSize;
+constexpr size_t  EncryptedFileWriter::kDefaultChunkSize;
+constexpr size_t  EncryptedFileWriter::kMaxChunkSize;
+constexpr size_t  EncryptedFileWriter::kWriteBatchSize;
+constexpr uint8_t EncryptedFileReader::kKeySize;
+
+// The header is made of (integers are little endian):
+//  - the magic string "sse_file" (8 bytes)
+//  - the format version (4 bytes)
+//  - the chunk size (4 bytes)
+//  - the plaintext size (8 bytes)
+//  - the file identifier (16 bytes)
+//  - the MAC of the previous fields (16 bytes)
+// and is padded with zeros to kPageSize bytes.
+static constexpr uint8_t file_magic__[8]
+    = {'s', 's', 'e', '_', 'f', 'i', 'l', 'e'};
+static constexpr uint32_t file_version__      = 1;
+static constexpr size_t   file_id_size__      = 16;
+static constexpr size_t   file_id_offset__    = 24;
+static constexpr size_t   header_mac_offset__ = 40;
+static constexpr size_t   header_mac_size__   = 16;
+
+#define TAG_SIZE crypto_aead_chacha20poly1305_IETF_ABYTES
+#define CHUNK_NONCE_SIZE crypto_aead_chacha20poly1305_IETF_NPUBBYTES
+#define FILE_KEY_SIZE crypto_aead_chacha20poly1305_IETF_KEYBYTES
+
+// The chunk key and the MAC key of a file are derived from the master key,
+// with the file identifier as the salt
+static constexpr uint8_t
+    chunk_personal__[crypto_generichash_blake2b_PERSONALBYTES]
+    = "file_chunk_key";
+static constexpr uint8_t
+    mac_personal__[crypto_generichash_blake2b_PERSONALBYTES]
+    = "file_mac_key";
+
+static_assert(FILE_KEY_SIZE == EncryptedFileWriter::kKeySize,
+              "Invalid file key size");
+
+static void store_le(uint8_t* out, uint64_t x, const size_t n)
+{
+    for (size_t i = 0; i < n; i++, x >>= 8) {
+        out[i] = static_cast<uint8_t>(x);
+    }
+}
+
+static uint64_t load_le(const uint8_t* in, const size_t n)
+{
+    uint64_t x = 0;
+    for (size_t i = n; i > 0; i--) {
+        x = (x << 8) | in[i - 1];
+    }
+    return x;
+}
+
+// Fills keys with the chunk key followed by the MAC key
+static void derive_file_keys(const uint8_t* master_key,
+                             const uint8_t* file_id,
+                             uint8_t*       keys)
+{
+    crypto_generichash_blake2b_salt_personal(keys,
+                                             FILE_KEY_SIZE,
+                                             nullptr,
+                                             0,
+                                             master_key,
+                                             EncryptedFileWriter::kKeySize,
+                                             file_id,
+                                             chunk_personal__);
+    crypto_generichash_blake2b_salt_personal(keys + FILE_KEY_SIZE,
+                                             FILE_KEY_SIZE,
+                                             nullptr,
+                                             0,
+                                             master_key,
+                                             EncryptedFileWriter::kKeySize,
+                                             file_id,
+                                             mac_personal__);
+}
+
+static void header_mac(const uint8_t* mac_key,
+                       const uint8_t* header,
+                       uint8_t*       mac)
+{
+    crypto_generichash_blake2b(mac,
+                               header_mac_size__,
+                               header,
+                               header_mac_offset__,
+                               mac_key,
+                               FILE_KEY_SIZE);
+}
+
+// The nonce of a chunk is its position in the file
+static void chunk_nonce(const uint64_t chunk, uint8_t* nonce)
+{
+    memset(nonce, 0x00, CHUNK_NONCE_SIZE);
+    store_le(nonce, chunk, 8);
+}
+
+static bool valid_chunk_size(const uint64_t chunk_size)
+{
+    return chunk_size != 0 && chunk_size <= EncryptedFileWriter::kMaxChunkSize
+           && chunk_size % EncryptedFileWriter::kPageSize == 0;
+}
+
+// Writes the whole buffer at the given position of the file
+static void pwrite_full(const int      fd,
+                        const uint8_t* buf,
+                        size_t         len,
+                        uint64_t       offset)
+{
+    while (len > 0) {
+        ssize_t ret = ::pwrite(fd, buf, len, static_cast<off_t>(offset));
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (ret == -1) {
+            throw std::runtime_error("Error when writing the encrypted file: "
+                                     + std::string(strerror(errno)));
+        }
+        buf += ret;
+        len -= static_cast<size_t>(ret);
+        offset += static_cast<uint64_t>(ret);
+    }
+}
+
+// Reads exactly len bytes at the given position of the file
+static void pread_full(const int fd, uint8_t* buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t ret = ::pread(fd, buf, len, static_cast<off_t>(offset));
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (ret == -1) {
+            throw std::runtime_error("Error when reading the encrypted file: "
+                                     + std::string(strerror(errno)));
+        }
+        if (ret == 0) {
+            throw std::runtime_error("Invalid encrypted file: truncated file");
+        }
+        buf += ret;
+        len -= static_cast<size_t>(ret);
+        offset += static_cast<uint64_t>(ret);
+    }
+}
+
+uint64_t EncryptedFileWriter::file_size(const uint64_t plaintext_size,
+                                        const size_t   chunk_size) noexcept
+{
+    const uint64_t n_chunks = (plaintext_size + chunk_size - 1) / chunk_size;
+    if (n_chunks == 0) {
+        return kPageSize;
+    }
+    return kPageSize + n_chunks * chunk_size + n_chunks * TAG_SIZE;
+}
+
+class EncryptedFileWriter::EncryptedFileWriterImpl
+{
+public:
+    EncryptedFileWriterImpl(Key<kKeySize>&&    k,
+                            const std::string& path,
+                            const size_t       chunk_size);
+
+    ~EncryptedFileWriterImpl();
+
+    void write(const uint8_t* in, size_t len);
+    void close();
+
+    inline uint64_t size() const noexcept
+    {
+        return size_;
+    }
+
+private:
+    // encrypts a chunk of len bytes at the end of the batch
+    void seal_chunk(const uint8_t* in, const size_t len);
+    void flush_batch();
+    void finalize();
+    // closes and deletes the temporary file
+    void abandon() noexcept;
+
+    // the file is written to tmp_path_, and renamed to path_ when closed
+    const std::string path_;
+    std::string       tmp_path_;
+
+    int          fd_;
+    // set when a write failed: the writer cannot be used anymore
+    bool         failed_{false};
+    const size_t chunk_size_;
+    size_t       batch_chunks_;
+
+    uint8_t                 file_id_[file_id_size__];
+    Key<2 * FILE_KEY_SIZE> keys_;
+
+    // plaintext of the current chunk
+    std::vector<uint8_t> chunk_;
+    size_t               chunk_len_{0};
+
+    // encrypted chunks waiting to be written
+    std::vector<uint8_t> batch_;
+    size_t               batch_len_{0};
+    uint64_t             batch_first_{0};
+
+    // tags of all the chunks
+    std::vector<uint8_t> index_;
+
+    uint64_t n_chunks_{0};
+    uint64_t size_{0};
+};
+
+EncryptedFileWriter::EncryptedFileWriterImpl::EncryptedFileWriterImpl(
+    Key<kKeySize>&&    k,
+    const std::string& path,
+    const size_t       chunk_size)
+    : path_(path), fd_(-1), chunk_size_(chunk_size)
+{
+    if (!valid_chunk_size(chunk_size)) {
+        throw std::invalid_argument(
+            "Invalid chunk size: must be a non-zero multiple of "
+            + std::to_string(kPageSize) + ", at most "
+            + std::to_string(kMaxChunkSize));
+    }
+    batch_chunks_ = std::max<size_t>(kWriteBatchSize / chunk_size_, 1);
+
+    random_bytes(sizeof(file_id_), file_id_);
+
+    const uint8_t* file_id = file_id_;
+    auto           callback = [&k, file_id](uint8_t* key_content) {
+        derive_file_keys(k.unlock_get(), file_id, key_content);
+    };
+    keys_ = Key<2 * FILE_KEY_SIZE>(callback);
+    k.erase();
+    // the keys stay readable until the file is closed
+    keys_.unlock();
+
+    chunk_.resize(chunk_size_);
+    batch_.resize(batch_chunks_ * chunk_size_);
+
+    // the temporary file is in the same directory, so that it can be renamed
+    std::vector<char> tmp_path(path.begin(), path.end());
+    const char        suffix[] = ".XXXXXX";
+    tmp_path.insert(tmp_path.end(), suffix, suffix + sizeof(suffix));
+
+    fd_ = mkstemp(tmp_path.data());
+    if (fd_ == -1) {
+        throw std::runtime_error("Unable to create the encrypted file "
+                                 + path + ": "
+                                 + std::string(strerror(errno)));
+    }
+    tmp_path_ = tmp_path.data();
+}
+
+EncryptedFileWriter::EncryptedFileWriterImpl::~EncryptedFileWriterImpl()
+{
+    // a file that has not been closed is not finalized
+    abandon();
+    sodium_memzero(chunk_.data(), chunk_.size());
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::abandon() noexcept
+{
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (!tmp_path_.empty()) {
+        ::unlink(tmp_path_.c_str());
+        tmp_path_.clear();
+    }
+    keys_.erase();
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::seal_chunk(
+    const uint8_t* in,
+    const size_t   len)
+{
+    uint8_t nonce[CHUNK_NONCE_SIZE];
+    uint8_t tag[TAG_SIZE];
+    chunk_nonce(n_chunks_, nonce);
+
+    crypto_aead_chacha20poly1305_ietf_encrypt_detached(
+        batch_.data() + batch_len_,
+        tag,
+        nullptr,
+        in,
+        len,
+        nullptr,
+        0,
+        nullptr,
+        nonce,
+        keys_.data());
+
+    index_.insert(index_.end(), tag, tag + TAG_SIZE);
+    batch_len_ += len;
+    n_chunks_++;
+
+    if (n_chunks_ - batch_first_ == batch_chunks_) {
+        flush_batch();
+    }
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::flush_batch()
+{
+    // the chunks of the batch are contiguous in the file
+    const size_t   len   = batch_len_;
+    const uint64_t first = batch_first_;
+
+    // the batch is emptied before the write, that might throw
+    batch_len_   = 0;
+    batch_first_ = n_chunks_;
+
+    pwrite_full(fd_, batch_.data(), len, kPageSize + first * chunk_size_);
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::write(const uint8_t* in,
+                                                         size_t         len)
+{
+    if (failed_) {
+        throw std::runtime_error("The encrypted file is in a failed state");
+    }
+    if (fd_ == -1) {
+        throw std::runtime_error("The encrypted file is closed");
+    }
+
+    try {
+        // complete the current chunk
+        if (chunk_len_ > 0) {
+            const size_t n = std::min(len, chunk_size_ - chunk_len_);
+            memcpy(chunk_.data() + chunk_len_, in, n);
+            in += n;
+            len -= n;
+
+            if (chunk_len_ + n < chunk_size_) {
+                chunk_len_ += n;
+                size_ += n;
+                return;
+            }
+            chunk_len_ = 0;
+            seal_chunk(chunk_.data(), chunk_size_);
+            size_ += n;
+        }
+
+        // full chunks are encrypted without being copied
+        for (; len >= chunk_size_; in += chunk_size_, len -= chunk_size_) {
+            seal_chunk(in, chunk_size_);
+            size_ += chunk_size_;
+        }
+
+        if (len > 0) {
+            memcpy(chunk_.data(), in, len);
+            chunk_len_ = len;
+            size_ += len;
+        }
+    } catch (...) {
+        failed_ = true;
+        abandon();
+        throw;
+    }
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::close()
+{
+    if (failed_) {
+        throw std::runtime_error("The encrypted file is in a failed state");
+    }
+    if (fd_ == -1) {
+        return;
+    }
+
+    try {
+        finalize();
+    } catch (...) {
+        failed_ = true;
+        abandon();
+        throw;
+    }
+}
+
+void EncryptedFileWriter::EncryptedFileWriterImpl::finalize()
+{
+    if (chunk_len_ > 0) {
+        const size_t len = chunk_len_;
+        chunk_len_       = 0;
+        seal_chunk(chunk_.data(), len);
+    }
+    if (batch_len_ > 0) {
+        flush_batch();
+    }
+
+    // chunk index
+    pwrite_full(
+        fd_, index_.data(), index_.size(), kPageSize + n_chunks_ * chunk_size_);
+
+    // the header is written last
+    std::vector<uint8_t> header(kPageSize, 0x00);
+    memcpy(header.data(), file_magic__, sizeof(file_magic__));
+    store_le(header.data() + 8, file_version__, 4);
+    store_le(header.data() + 12, chunk_size_, 4);
+    store_le(header.data() + 16, size_, 8);
+    memcpy(header.data() + file_id_offset__, file_id_, file_id_size__);
+    header_mac(keys_.data() + FILE_KEY_SIZE,
+               header.data(),
+               header.data() + header_mac_offset__);
+    pwrite_full(fd_, header.data(), header.size(), 0);
+
+    keys_.erase();
+
+    int ret = ::close(fd_);
+    fd_     = -1;
+    if (ret == -1) {
+        throw std::runtime_error("Error when closing the encrypted file: "
+                                 + std::string(strerror(errno)));
+    }
+
+    // the complete file replaces the one at path, if any
+    if (std::rename(tmp_path_.c_str(), path_.c_str()) == -1) {
+        throw std::runtime_error("Unable to create the encrypted file "
+                                 + path_ + ": "
+                                 + std::string(strerror(errno)));
+    }
+    tmp_path_.clear();
+}
+
+EncryptedFileWriter::EncryptedFileWriter(Key<kKeySize>&&    k,
+                                         const std::string& path,
+                                         const size_t       chunk_size)
+    : writer_imp_(new EncryptedFileWriterImpl(std::move(k), path, chunk_size))
+{
+}
+
+EncryptedFileWriter::~EncryptedFileWriter()
+{
+    delete writer_imp_;
+}
+
+void EncryptedFileWriter::write(const uint8_t* in, const size_t len)
+{
+    if (in == nullptr && len != 0) {
+        throw std::invalid_argument("Invalid input: in == NULL");
+    }
+    writer_imp_->write(in, len);
+}
+
+void EncryptedFileWriter::write(const std::string& in)
+{
+    writer_imp_->write(reinterpret_cast<const uint8_t*>(in.data()),
+                       in.size());
+}
+
+void EncryptedFileWriter::close()
+{
+    writer_imp_->close();
+}
+
+uint64_t EncryptedFileWriter::size() const noexcept
+{
+    return writer_imp_->size();
+}
+
+class EncryptedFileReader::EncryptedFileReaderImpl
+{
+public:
+    EncryptedFileReaderImpl(Key<kKeySize>&& k, const std::string& path);
+
+    ~EncryptedFileReaderImpl();
+
+    inline uint64_t size() const noexcept
+    {
+        return size_;
+    }
+
+    inline size_t chunk_size() const noexcept
+    {
+        return chunk_size_;
+    }
+
+    void read(uint64_t offset, size_t len, uint8_t* out) const;
+
+private:
+    void parse_header(Key<kKeySize>&& k, const uint64_t file_size);
+
+    int fd_;
+
+    uint64_t size_;
+    size_t   chunk_size_;
+    uint64_t n_chunks_;
+    // positions of the chunks and of the chunk index in the file
+    uint64_t chunks_offset_;
+    uint64_t index_offset_;
+
+    Key<2 * FILE_KEY_SIZE> keys_;
+};
+
+EncryptedFileReader::EncryptedFileReaderImpl::EncryptedFileReaderImpl(
+    Key<kKeySize>&&    k,
+    const std::string& path)
+    : fd_(-1)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ == -1) {
+        throw std::runtime_error("Unable to open the encrypted file " + path
+                                 + ": " + std::string(strerror(errno)));
+    }
+
+    try {
+        struct stat st;
+        if (fstat(fd_, &st) == -1) {
+            throw std::runtime_error("Unable to open the encrypted file "
+                                     + path + ": "
+                                     + std::string(strerror(errno)));
+        }
+        if (st.st_size
+            < static_cast<off_t>(EncryptedFileWriter::kPageSize)) {
+            throw std::runtime_error("Invalid encrypted file: missing header");
+        }
+
+        // chunks are accessed in random order: disable read-ahead
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+
+        parse_header(std::move(k), static_cast<uint64_t>(st.st_size));
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+void EncryptedFileReader::EncryptedFileReaderImpl::parse_header(
+    Key<kKeySize>&& k,
+    const uint64_t  file_size)
+{
+    uint8_t header[header_mac_offset__ + header_mac_size__];
+    pread_full(fd_, header, sizeof(header), 0);
+
+    if (memcmp(header, file_magic__, sizeof(file_magic__)) != 0
+        || load_le(header + 8, 4) != file_version__) {
+        throw std::runtime_error("Invalid encrypted file: unknown format");
+    }
+
+    // derive the keys of the file, and authenticate the header
+    auto callback = [&k, header](uint8_t* key_content) {
+        derive_file_keys(
+            k.unlock_get(), header + file_id_offset__, key_content);
+    };
+    keys_ = Key<2 * FILE_KEY_SIZE>(callback);
+    k.erase();
+    keys_.unlock();
+
+    uint8_t mac[header_mac_size__];
+    header_mac(keys_.data() + FILE_KEY_SIZE, header, mac);
+    if (crypto_verify_16(mac, header + header_mac_offset__) != 0) {
+        throw std::runtime_error("Invalid encrypted file: the header is not "
+                                 "authentic");
+    }
+
+    const uint64_t chunk_size = load_le(header + 12, 4);
+    size_                     = load_le(header + 16, 8);
+    if (!valid_chunk_size(chunk_size)) {
+        throw std::runtime_error("Invalid encrypted file: invalid chunk size");
+    }
+    chunk_size_ = static_cast<size_t>(chunk_size);
+    n_chunks_   = (size_ + chunk_size_ - 1) / chunk_size_;
+
+    if (file_size < EncryptedFileWriter::file_size(size_, chunk_size_)) {
+        throw std::runtime_error("Invalid encrypted file: truncated file");
+    }
+    chunks_offset_ = EncryptedFileWriter::kPageSize;
+    index_offset_  = chunks_offset_ + n_chunks_ * chunk_size_;
+}
+
+EncryptedFileReader::EncryptedFileReaderImpl::~EncryptedFileReaderImpl()
+{
+    ::close(fd_);
+}
+
+// Verifies the Poly1305 tag of the ChaCha20+Poly1305 (IETF) encryption of a
+// chunk, without decrypting it. Follows the construction of
+// crypto_aead_chacha20poly1305_ietf_encrypt_detached, with no additional
+// data.
+static bool verify_chunk(const uint8_t* key,
+                         const uint8_t* nonce,
+                         const uint8_t* ct,
+                         const size_t   len,
+                         const uint8_t* tag)
+{
+    static const uint8_t pad[16] = {0};
+
+    uint8_t                           block0[64];
+    uint8_t                           lengths[16];
+    uint8_t                           computed_tag[TAG_SIZE];
+    crypto_onetimeauth_poly1305_state state;
+
+    // the Poly1305 key is the beginning of the first keystream block
+    crypto_stream_chacha20_ietf(block0, sizeof(block0), nonce, key);
+    crypto_onetimeauth_poly1305_init(&state, block0);
+    sodium_memzero(block0, sizeof(block0));
+
+    crypto_onetimeauth_poly1305_update(&state, ct, len);
+    crypto_onetimeauth_poly1305_update(&state, pad, (0x10 - len) & 0xf);
+    store_le(lengths, 0, 8);
+    store_le(lengths + 8, len, 8);
+    crypto_onetimeauth_poly1305_update(&state, lengths, sizeof(lengths));
+    crypto_onetimeauth_poly1305_final(&state, computed_tag);
+    sodium_memzero(&state, sizeof(state));
+
+    return crypto_verify_16(computed_tag, tag) == 0;
+}
+
+// Decrypts the bytes [pos, pos+len) of an encrypted chunk. The payload is
+// encrypted with the keystream starting at the second block.
+static void decrypt_range(const uint8_t* key,
+                          const uint8_t* nonce,
+                          const uint8_t* ct,
+                          size_t         pos,
+                          size_t         len,
+                          uint8_t*       out)
+{
+    const size_t head = pos % 64;
+    if (head != 0) {
+        // partial first block
+        uint8_t      block[64] = {0};
+        const size_t n         = std::min(len, 64 - head);
+
+        memcpy(block + head, ct + pos, n);
+        crypto_stream_chacha20_ietf_xor_ic(block,
+                                           block,
+                                           sizeof(block),
+                                           nonce,
+                                           static_cast<uint32_t>(1 + pos / 64),
+                                           key);
+        memcpy(out, block + head, n);
+        sodium_memzero(block, sizeof(block));
+
+        pos += n;
+        out += n;
+        len -= n;
+    }
+    if (len > 0) {
+        crypto_stream_chacha20_ietf_xor_ic(out,
+                                           ct + pos,
+                                           len,
+                                           nonce,
+                                           static_cast<uint32_t>(1 + pos / 64),
+                                           key);
+    }
+}
+
+void EncryptedFileReader::EncryptedFileReaderImpl::read(uint64_t offset,
+                                                        size_t   len,
+                                                        uint8_t* out) const
+{
+    const uint8_t* key       = keys_.data();
+    uint8_t*       out_begin = out;
+    const size_t   out_len   = len;
+
+    // The ciphertext of a chunk is copied once, and is verified and
+    // decrypted from that private copy: the file can be modified
+    // concurrently without unauthenticated bytes being decrypted. The copy
+    // buffer is thread-local, so that reads do not allocate once it has
+    // reached the chunk size, and remain thread-safe.
+    static thread_local std::vector<uint8_t> ct;
+    uint8_t                                  tag[TAG_SIZE];
+
+    try {
+        while (len > 0) {
+            const uint64_t chunk = offset / chunk_size_;
+            const size_t   pos   = static_cast<size_t>(offset % chunk_size_);
+            const size_t   chunk_len = static_cast<size_t>(
+                std::min<uint64_t>(chunk_size_, size_ - chunk * chunk_size_));
+            const size_t n = std::min(len, chunk_len - pos);
+
+            if (ct.size() < chunk_len) {
+                ct.resize(chunk_len);
+            }
+            pread_full(fd_,
+                       ct.data(),
+                       chunk_len,
+                       chunks_offset_ + chunk * chunk_size_);
+            pread_full(fd_, tag, TAG_SIZE, index_offset_ + chunk * TAG_SIZE);
+
+            uint8_t nonce[CHUNK_NONCE_SIZE];
+            chunk_nonce(chunk, nonce);
+
+            if (!verify_chunk(key, nonce, ct.data(), chunk_len, tag)) {
+                throw std::runtime_error("Invalid encrypted file: chunk "
+                                         + std::to_string(chunk)
+                                         + " is not authentic");
+            }
+            decrypt_range(key, nonce, ct.data(), pos, n, out);
+
+            offset += n;
+            out += n;
+            len -= n;
+        }
+    } catch (...) {
+        sodium_memzero(out_begin, out_len);
+        throw;
+    }
+}
+
+static void check_range(const uint64_t offset,
+                        const size_t   len,
+                        const uint64_t size)
+{
+    if (offset > size || len > size - offset) {
+        throw std::invalid_argument("Invalid range: the range is not included "
+                                    "in the file");
+    }
+}
+
+EncryptedFileReader::EncryptedFileReader(Key<kKeySize>&&    k,
+                                         const std::string& path)
+    : reader_imp_(new EncryptedFileReaderImpl(std::move(k), path))
+{
+}
+
+EncryptedFileReader::~EncryptedFileReader()
+{
+    delete reader_imp_;
+}
+
+uint64_t EncryptedFileReader::size() const noexcept
+{
+    return reader_imp_->size();
+}
+
+size_t EncryptedFileReader::chunk_size() const noexcept
+{
+    return reader_imp_->chunk_size();
+}
+
+void EncryptedFileReader::read(const uint64_t offset,
+                               const size_t   len,
+                               uint8_t*       out) const
+{
+    if (out == nullptr && len != 0) {
+        throw std::invalid_argument("Invalid output: out == NULL");
+    }
+    check_range(offset, len, size());
+    reader_imp_->read(offset, len, out);
+}
+
+std::string EncryptedFileReader::read(const uint64_t offset,
+                                      const size_t   len) const
+{
+    check_range(offset, len, size());
+
+    std::string out(len, 0x00);
+    read(offset, len, reinterpret_cast<uint8_t*>(&out[0]));
+    return out;
+}
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,297 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "key.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+namespace sse {
+
+namespace crypto {
+
+/// @class EncryptedFileWriter
+/// @brief Creation of random-access encrypted files.
+///
+/// An encrypted file is a container in which any byte range can be read and
+/// authenticated without processing the rest of the file (see
+/// EncryptedFileReader). The plaintext is split in chunks of a fixed size
+/// (a multiple of kPageSize), that are individually encrypted and
+/// authenticated with ChaCha20+Poly1305 (IETF version), the AEAD used by
+/// Cipher.
+///
+/// The file is made of:
+///     - a header page, holding the chunk size, the plaintext size and a
+///       random file identifier, authenticated with a MAC;
+///     - the encrypted chunks, each of them starting on a page boundary
+///       (the ciphertext of a chunk is as long as its plaintext);
+///     - the chunk index, made of the authentication tags of the chunks.
+///
+/// Every file uses its own keys, derived from the master key and the file
+/// identifier with BLAKE2b, and the nonce of a chunk is its position in the
+/// file. Hence chunks cannot be swapped, or moved from one file to another,
+/// and as the plaintext size is authenticated, truncation is detected.
+/// Encrypted files are written once: they cannot be modified in place.
+///
+/// The encrypted chunks are accumulated in memory and written by batches of
+/// kWriteBatchSize bytes (or of one chunk, for larger chunks) with a single
+/// pwrite call. The file is written to a temporary file in the same
+/// directory, whose header is written last, by close: the temporary file is
+/// then renamed to the destination path. Hence, an existing file at that path
+/// is only replaced by a complete encrypted file. If a write fails, the
+/// writer enters a failed state: the temporary file is deleted, and every
+/// subsequent call to write or close throws.
+///
+
+class EncryptedFileWriter
+{
+public:
+    /// @brief Master key size (in bytes)
+    static constexpr uint8_t kKeySize = 32;
+
+    /// @brief Alignment of the header and of the chunks in the file
+    static constexpr size_t kPageSize = 4096;
+
+    /// @brief Default chunk size (in bytes)
+    static constexpr size_t kDefaultChunkSize = 1 << 16;
+
+    /// @brief Maximum chunk size (in bytes)
+    static constexpr size_t kMaxChunkSize = 1 << 24;
+
+    /// @brief Size of the batches of chunks written with a single system call
+    static constexpr size_t kWriteBatchSize = 1 << 20;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a temporary file next to path, and prepares it to receive the
+    /// plaintext. After a call to the constructor, the input key is held
+    /// by the EncryptedFileWriter object, and cannot be re-used.
+    ///
+    /// @param k            The master key. Upon return, k is empty.
+    /// @param path         The path of the encrypted file.
+    /// @param chunk_size   The size of the plaintext chunks. Must be a
+    ///                     non-zero multiple of kPageSize, at most
+    ///                     kMaxChunkSize.
+    ///
+    /// @exception std::invalid_argument    chunk_size is invalid.
+    /// @exception std::runtime_error       The temporary file cannot be
+    ///                                     created.
+    ///
+    EncryptedFileWriter(Key<kKeySize>&&    k,
+                        const std::string& path,
+                        const size_t       chunk_size = kDefaultChunkSize);
+
+    ///
+    /// @brief Destructor
+    ///
+    /// If close() has not been called, the file is abandoned: the temporary
+    /// file is deleted, and the file at path (if any) is left untouched.
+    ///
+    ~EncryptedFileWriter();
+
+    // we should not be able to duplicate EncryptedFileWriter objects
+    EncryptedFileWriter(const EncryptedFileWriter& c)  = delete;
+    EncryptedFileWriter(EncryptedFileWriter& c)        = delete;
+    EncryptedFileWriter(const EncryptedFileWriter&& c) = delete;
+    EncryptedFileWriter(EncryptedFileWriter&& c)       = delete;
+
+    ///
+    /// @brief Append data to the file
+    ///
+    /// @param in   The data to be appended.
+    /// @param len  The length of the data.
+    ///
+    /// @exception std::invalid_argument    in is NULL and len is not 0.
+    /// @exception std::runtime_error       The file has been closed, or a
+    ///                                     write failed (now or during a
+    ///                                     previous call).
+    ///
+    void write(const uint8_t* in, const size_t len);
+
+    ///
+    /// @brief Append data to the file
+    ///
+    /// @param in   The data to be appended.
+    ///
+    /// @exception std::runtime_error       The file has been closed, or a
+    ///                                     write failed (now or during a
+    ///                                     previous call).
+    ///
+    void write(const std::string& in);
+
+    ///
+    /// @brief Finalize the file
+    ///
+    /// Encrypts the last (partial) chunk, writes the pending chunks, the
+    /// chunk index and the header, closes the file, and renames it to the
+    /// path given to the constructor. Calling close on a closed file has no
+    /// effect.
+    ///
+    /// @exception std::runtime_error       A write failed (now or during a
+    ///                                     previous call): the file is
+    ///                                     abandoned.
+    ///
+    void close();
+
+    ///
+    /// @brief Plaintext size
+    ///
+    /// @return The number of bytes successfully appended to the file so far.
+    ///
+    uint64_t size() const noexcept;
+
+    ///
+    /// @brief Size of an encrypted file
+    ///
+    /// @param plaintext_size   The size of the plaintext.
+    /// @param chunk_size       The size of the chunks (a valid chunk size).
+    ///
+    /// @return The size of the encrypted file.
+    ///
+    static uint64_t file_size(const uint64_t plaintext_size,
+                              const size_t   chunk_size) noexcept;
+
+    // Again, avoid any assignement of EncryptedFileWriter objects
+    EncryptedFileWriter& operator=(const EncryptedFileWriter& h) = delete;
+    EncryptedFileWriter& operator=(EncryptedFileWriter& h) = delete;
+
+private:
+    class EncryptedFileWriterImpl;        // not defined in the header
+    EncryptedFileWriterImpl* writer_imp_; // opaque pointer
+};
+
+/// @class EncryptedFileReader
+/// @brief Random access to encrypted files.
+///
+/// EncryptedFileReader gives access to the files created by
+/// EncryptedFileWriter. A read only touches the chunks containing the
+/// requested byte range: each of these chunks is read (with pread) to a
+/// private, thread-local buffer, its tag is verified on that copy, and only
+/// the requested bytes are decrypted from it to the output buffer. Hence, a
+/// small read costs the authentication of one chunk, whatever the size of the
+/// file, and concurrent modifications of the file cannot lead to the
+/// decryption of unauthenticated bytes.
+///
+/// The header is authenticated when the file is opened.
+///
+
+class EncryptedFileReader
+{
+public:
+    /// @brief Master key size (in bytes)
+    static constexpr uint8_t kKeySize = EncryptedFileWriter::kKeySize;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Opens the encrypted file at path. After a call to the
+    /// constructor, the input key is held by the EncryptedFileReader object,
+    /// and cannot be re-used.
+    ///
+    /// @param k            The master key. Upon return, k is empty.
+    /// @param path         The path of the encrypted file.
+    ///
+    /// @exception std::runtime_error       The file cannot be opened or
+    ///                                     read, is not an encrypted file,
+    ///                                     is truncated, or its header is not
+    ///                                     authentic (e.g. the key is not
+    ///                                     the one used to create the file).
+    ///
+    EncryptedFileReader(Key<kKeySize>&& k, const std::string& path);
+
+    ///
+    /// @brief Destructor
+    ///
+    /// Closes the file, and erases the keys.
+    ///
+    ~EncryptedFileReader();
+
+    // we should not be able to duplicate EncryptedFileReader objects
+    EncryptedFileReader(const EncryptedFileReader& c)  = delete;
+    EncryptedFileReader(EncryptedFileReader& c)        = delete;
+    EncryptedFileReader(const EncryptedFileReader&& c) = delete;
+    EncryptedFileReader(EncryptedFileReader&& c)       = delete;
+
+    ///
+    /// @brief Plaintext size
+    ///
+    /// @return The size of the plaintext stored in the file.
+    ///
+    uint64_t size() const noexcept;
+
+    ///
+    /// @brief Chunk size
+    ///
+    /// @return The size of the plaintext chunks of the file.
+    ///
+    size_t chunk_size() const noexcept;
+
+    ///
+    /// @brief Read a byte range
+    ///
+    /// Authenticates the chunks containing the bytes [offset, offset+len) of
+    /// the plaintext, and decrypts these bytes to out. This function is
+    /// thread-safe.
+    ///
+    /// @param offset   The position of the first byte.
+    /// @param len      The number of bytes to read.
+    /// @param out      The output buffer, of at least len bytes.
+    ///
+    /// @exception std::invalid_argument    out is NULL and len is not 0, or
+    ///                                     the range is not included in the
+    ///                                     plaintext.
+    /// @exception std::runtime_error       One of the chunks is not
+    ///                                     authentic, or cannot be read. In
+    ///                                     that case, out is erased.
+    ///
+    void read(const uint64_t offset, const size_t len, uint8_t* out) const;
+
+    ///
+    /// @brief Read a byte range
+    ///
+    /// @param offset   The position of the first byte.
+    /// @param len      The number of bytes to read.
+    ///
+    /// @return The bytes [offset, offset+len) of the plaintext.
+    ///
+    /// @exception std::invalid_argument    The range is not included in the
+    ///                                     plaintext.
+    /// @exception std::runtime_error       One of the chunks is not
+    ///                                     authentic, or cannot be read.
+    ///
+    std::string read(const uint64_t offset, const size_t len) const;
+
+    // Again, avoid any assignement of EncryptedFileReader objects
+    EncryptedFileReader& operator=(const EncryptedFileReader& h) = delete;
+    EncryptedFileReader& operator=(EncryptedFileReader& h) = delete;
+
+private:
+    class EncryptedFileReaderImpl;        // not defined in the header
+    EncryptedFileReaderImpl* reader_imp_; // opaque pointer
+};
+
+} // namespace crypto
+} // namespace sse
@@ -77,6 +77,45 @@ void Hash::hash(const unsigned char* in,
     memcpy(out, digest, out_len);
 }
 
+void Hash::hash_many(const unsigned char* const* in,
+                     const size_t*               len,
+                     const size_t                n,
+                     const size_t                out_len,
+                     unsigned char*              out)
+{
+    if (out_len > kDigestSize) {
+        throw std::invalid_argument(
+            "Invalid output length: out_len > kDigestSize");
+    }
+
+    if (in == nullptr) {
+        throw std::invalid_argument("in is NULL");
+    }
+
+    if (out == nullptr) {
+        throw std::invalid_argument("out is NULL");
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (in[i] == nullptr && len[i] != 0) {
+            throw std::invalid_argument("in[i] is NULL");
+        }
+    }
+
+    // the digests are computed by batches of kBatch, and then truncated
+    constexpr size_t kBatch = 16;
+    unsigned char    digests[kBatch * kDigestSize];
+
+    for (size_t i = 0; i < n; i += kBatch) {
+        const size_t m = (n - i < kBatch) ? n - i : kBatch;
+
+        hash_function::hash_many(in + i, len + i, m, digests);
+        for (size_t j = 0; j < m; j++) {
+            memcpy(out + (i + j) * out_len, digests + j * kDigestSize, out_len);
+        }
+    }
+}
+
 void Hash::hash(const std::string& in, std::string& out)
 {
     unsigned char tmp_out[kDigestSize];
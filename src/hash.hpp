@@ -86,6 +86,34 @@ public:
                      const size_t         out_len,
                      unsigned char*       out);
     ///
+    /// @brief Hash several buffers
+    ///
+    /// Computes the hashes of n input buffers, truncates them and places them
+    /// in the output buffer. The digests are the same as the ones computed by
+    /// hash(in[i], len[i], out_len, out + i * out_len), but the hash function
+    /// can process several buffers in parallel.
+    ///
+    /// @param in       The input buffers. Must be non NULL, as well as every
+    ///                 in[i] such that len[i] is not 0.
+    /// @param len      The sizes of the input buffers in bytes.
+    /// @param n        The number of input buffers.
+    /// @param out_len  The size of each digest in bytes. Must be smaller
+    ///                 than kDigestSize.
+    /// @param out      The output buffer. Must be non NULL, and larger than
+    ///                 n * out_len bytes.
+    ///
+    /// @exception std::invalid_argument       One of in, out or a non-empty
+    /// in[i] is NULL
+    /// @exception std::invalid_argument       out_len is larger than
+    /// kDigestSize
+    ///
+    static void hash_many(const unsigned char* const* in,
+                          const size_t*               len,
+                          const size_t                n,
+                          const size_t                out_len,
+                          unsigned char*              out);
+
+    ///
     /// @brief Hash a string
     ///
     /// Computes the hash of the input string andplaces it in the
@@ -21,9 +21,14 @@
 #include "blake2b.hpp"
 
 #include <cstdint>
+#include <cstring>
 
 #include <sodium/crypto_generichash_blake2b.h>
 
+#if __AVX2__
+#include <immintrin.h>
+#endif
+
 
 namespace sse {
 
@@ -38,6 +43,222 @@ void blake2b::hash(const unsigned char* in,
     crypto_generichash_blake2b(digest, kDigestSize, in, len, nullptr, 0);
 }
 
+#if __AVX2__
+
+// Multi-buffer BLAKE2b: four messages are hashed in parallel, the i-th 64 bits
+// lane of each AVX2 register belonging to the i-th message. The messages do
+// not need to have the same length: a lane whose message has no block left
+// computes a dummy compression, which is discarded.
+
+constexpr size_t kBlake2bLanes = 4;
+
+static const uint64_t blake2b_iv__[8]
+    = {0x6a09e667f3bcc908ULL,
+       0xbb67ae8584caa73bULL,
+       0x3c6ef372fe94f82bULL,
+       0xa54ff53a5f1d36f1ULL,
+       0x510e527fade682d1ULL,
+       0x9b05688c2b3e6c1fULL,
+       0x1f83d9abfb41bd6bULL,
+       0x5be0cd19137e2179ULL};
+
+static const uint8_t blake2b_sigma__[12][16]
+    = {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+       {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+       {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+       {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+       {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+       {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+       {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+       {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+       {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+       {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+       {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+       {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}};
+
+static inline __m256i rotr32(__m256i x)
+{
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __m256i rotr24(__m256i x)
+{
+    const __m256i r24 = _mm256_setr_epi8(3,  4,  5,  6,  7,  0,  1,  2,
+                                         11, 12, 13, 14, 15, 8,  9,  10,
+                                         3,  4,  5,  6,  7,  0,  1,  2,
+                                         11, 12, 13, 14, 15, 8,  9,  10);
+    return _mm256_shuffle_epi8(x, r24);
+}
+
+static inline __m256i rotr16(__m256i x)
+{
+    const __m256i r16 = _mm256_setr_epi8(2,  3,  4,  5,  6,  7,  0,  1,
+                                         10, 11, 12, 13, 14, 15, 8,  9,
+                                         2,  3,  4,  5,  6,  7,  0,  1,
+                                         10, 11, 12, 13, 14, 15, 8,  9);
+    return _mm256_shuffle_epi8(x, r16);
+}
+
+static inline __m256i rotr63(__m256i x)
+{
+    return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+static inline void blake2b_g(__m256i&       a,
+                             __m256i&       b,
+                             __m256i&       c,
+                             __m256i&       d,
+                             const __m256i& x,
+                             const __m256i& y)
+{
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);
+    d = rotr32(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi64(c, d);
+    b = rotr24(_mm256_xor_si256(b, c));
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);
+    d = rotr16(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi64(c, d);
+    b = rotr63(_mm256_xor_si256(b, c));
+}
+
+// Compression of one block per lane. t holds the byte counters, f the
+// finalization flags.
+static void blake2b_compress4(__m256i       h[8],
+                              const __m256i m[16],
+                              const __m256i t,
+                              const __m256i f)
+{
+    __m256i v[16];
+    for (size_t i = 0; i < 8; i++) {
+        v[i]     = h[i];
+        v[i + 8] = _mm256_set1_epi64x(static_cast<int64_t>(blake2b_iv__[i]));
+    }
+    v[12] = _mm256_xor_si256(v[12], t);
+    v[14] = _mm256_xor_si256(v[14], f);
+
+    for (size_t r = 0; r < 12; r++) {
+        const uint8_t* s = blake2b_sigma__[r];
+
+        blake2b_g(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+        blake2b_g(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+        blake2b_g(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+        blake2b_g(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+        blake2b_g(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+        blake2b_g(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        blake2b_g(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+        blake2b_g(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (size_t i = 0; i < 8; i++) {
+        h[i] = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+    }
+}
+
+static void blake2b_hash4(const unsigned char* const* in,
+                          const size_t*               len,
+                          unsigned char*              digests)
+{
+    size_t n_blocks[kBlake2bLanes];
+    size_t max_blocks = 0;
+    for (size_t l = 0; l < kBlake2bLanes; l++) {
+        // the empty message is hashed as one (padding) block
+        n_blocks[l] = (len[l] == 0) ? 1
+                                    : (len[l] + blake2b::kBlockSize - 1)
+                                          / blake2b::kBlockSize;
+        max_blocks = (n_blocks[l] > max_blocks) ? n_blocks[l] : max_blocks;
+    }
+
+    // parameter block: 64 bytes digest, no key, fanout = depth = 1
+    __m256i h[8];
+    for (size_t i = 0; i < 8; i++) {
+        h[i] = _mm256_set1_epi64x(static_cast<int64_t>(blake2b_iv__[i]));
+    }
+    h[0] = _mm256_xor_si256(
+        h[0], _mm256_set1_epi64x(0x01010000 ^ blake2b::kDigestSize));
+
+    uint8_t  padded[kBlake2bLanes][blake2b::kBlockSize];
+    uint64_t w[kBlake2bLanes][16];
+    int64_t  t[kBlake2bLanes], f[kBlake2bLanes], active[kBlake2bLanes];
+
+    for (size_t k = 0; k < max_blocks; k++) {
+        for (size_t l = 0; l < kBlake2bLanes; l++) {
+            const size_t offset = k * blake2b::kBlockSize;
+
+            const unsigned char* block = padded[l];
+            active[l]                  = (k < n_blocks[l]) ? -1 : 0;
+            f[l]                       = (k + 1 == n_blocks[l]) ? -1 : 0;
+
+            if (k + 1 < n_blocks[l]) {
+                block = in[l] + offset;
+                t[l]  = static_cast<int64_t>(offset + blake2b::kBlockSize);
+            } else if (k + 1 == n_blocks[l]) {
+                memset(padded[l], 0x00, blake2b::kBlockSize);
+                if (len[l] > offset) {
+                    memcpy(padded[l], in[l] + offset, len[l] - offset);
+                }
+                t[l] = static_cast<int64_t>(len[l]);
+            } else {
+                // the compression is discarded
+                t[l] = 0;
+            }
+            memcpy(w[l], block, blake2b::kBlockSize);
+        }
+
+        __m256i m[16];
+        for (size_t j = 0; j < 16; j++) {
+            m[j] = _mm256_set_epi64x(static_cast<int64_t>(w[3][j]),
+                                     static_cast<int64_t>(w[2][j]),
+                                     static_cast<int64_t>(w[1][j]),
+                                     static_cast<int64_t>(w[0][j]));
+        }
+
+        __m256i h_prev[8];
+        memcpy(h_prev, h, sizeof(h));
+
+        blake2b_compress4(h,
+                          m,
+                          _mm256_set_epi64x(t[3], t[2], t[1], t[0]),
+                          _mm256_set_epi64x(f[3], f[2], f[1], f[0]));
+
+        const __m256i mask = _mm256_set_epi64x(
+            active[3], active[2], active[1], active[0]);
+        for (size_t i = 0; i < 8; i++) {
+            h[i] = _mm256_blendv_epi8(h_prev[i], h[i], mask);
+        }
+    }
+
+    uint64_t out[kBlake2bLanes];
+    for (size_t i = 0; i < 8; i++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), h[i]);
+        for (size_t l = 0; l < kBlake2bLanes; l++) {
+            memcpy(digests + l * blake2b::kDigestSize + 8 * i,
+                   &out[l],
+                   sizeof(uint64_t));
+        }
+    }
+}
+
+#endif
+
+void blake2b::hash_many(const unsigned char* const* in,
+                        const size_t*               len,
+                        const size_t                n,
+                        unsigned char*              digests)
+{
+    size_t i = 0;
+
+#if __AVX2__
+    for (; i + kBlake2bLanes <= n; i += kBlake2bLanes) {
+        blake2b_hash4(in + i, len + i, digests + i * kDigestSize);
+    }
+#endif
+
+    for (; i < n; i++) {
+        crypto_generichash_blake2b(
+            digests + i * kDigestSize, kDigestSize, in[i], len[i], nullptr, 0);
+    }
+}
+
 } // namespace hash
 } // namespace crypto
 } // namespace sse
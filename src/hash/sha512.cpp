@@ -38,6 +38,16 @@ void sha512::hash(const unsigned char* in,
     crypto_hash_sha512(digest, in, len);
 }
 
+void sha512::hash_many(const unsigned char* const* in,
+                       const size_t*               len,
+                       const size_t                n,
+                       unsigned char*              digests)
+{
+    for (size_t i = 0; i < n; i++) {
+        crypto_hash_sha512(digests + i * kDigestSize, in[i], len[i]);
+    }
+}
+
 } // namespace hash
 } // namespace crypto
 } // namespace sse
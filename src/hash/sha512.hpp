@@ -35,6 +35,13 @@ struct sha512
     static void hash(const unsigned char* in,
                      const size_t         len,
                      unsigned char*       digest);
+
+    // Hashes the n buffers (in[i], len[i]): the digest of the i-th buffer is
+    // written at digests + i * kDigestSize
+    static void hash_many(const unsigned char* const* in,
+                          const size_t*               len,
+                          const size_t                n,
+                          unsigned char*              digests);
 };
 
 } // namespace hash
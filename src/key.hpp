@@ -35,6 +35,9 @@ namespace tests {
 template<size_t K_SIZE>
 extern void prg_test_key_derivation_consistency();
 
+template<size_t K_SIZE>
+extern void prg_test_key_iterator();
+
 template<size_t L>
 extern void test_key_derivation_consistency(size_t input_size);
 
@@ -85,10 +88,16 @@ class Key
     friend class Prf;
     friend class Prg;
     friend class Prp;
+    friend class SmallDomainPrp;
+    friend class DeterministicCipher;
     friend class Cipher;
+    friend class EncryptedFileWriter;
+    friend class EncryptedFileReader;
 
     template<size_t K_SIZE>
     friend void tests::prg_test_key_derivation_consistency(); // NOLINT
+    template<size_t K_SIZE>
+    friend void tests::prg_test_key_iterator(); // NOLINT
     template<size_t L>
     friend void tests::test_key_derivation_consistency(size_t); // NOLINT
     template<size_t L, size_t M>
@@ -262,6 +271,47 @@ private:
         is_locked_ = true;
     }
 
+    ///
+    /// @brief Overwrites the key content
+    ///
+    /// Refills the key using a callback given as input. If the key is not
+    /// empty, its memory is reused, and no allocation takes place.
+    ///
+    /// @param init_callback    The callback used to fill the key. It takes an
+    /// uint8_t pointer as argument, with will point to the key content
+    ///
+    /// @exception std::bad_alloc           Memory cannot be allocated.
+    /// @exception std::runtime_error       Memory could not be protected.
+    ///
+    void reset(const std::function<void(uint8_t*)>& init_callback)
+    {
+        int err;
+        if (content_ == nullptr) {
+            content_ = static_cast<uint8_t*>(sodium_malloc(N));
+
+            if (content_ == nullptr) {
+                throw std::bad_alloc(); /* LCOV_EXCL_LINE */
+            }
+        } else {
+            err = sodium_mprotect_readwrite(content_);
+            if (err == -1 && errno != ENOSYS) {
+                throw std::runtime_error(/* LCOV_EXCL_LINE */
+                                         "Error when unlocking memory: "
+                                         + std::string(strerror(errno)));
+            }
+        }
+
+        init_callback(content_); // use the callback to fill the key
+
+        err = sodium_mprotect_noaccess(content_);
+        if (err == -1 && errno != ENOSYS) {
+            throw std::runtime_error(/* LCOV_EXCL_LINE */
+                                     "Error when locking memory: "
+                                     + std::string(strerror(errno)));
+        }
+        is_locked_ = true;
+    }
+
     ///
     /// @brief Locks the key
     ///
@@ -0,0 +1,307 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "lt_hash.hpp"
+
+#include <cstring>
+
+#include <iomanip>
+#include <iostream>
+
+#include <sodium/crypto_generichash_blake2b.h>
+#include <sodium/crypto_stream_chacha20.h>
+#include <sodium/utils.h>
+
+#if __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace sse {
+
+namespace crypto {
+
+// BLAKE2b personalization of the ChaCha20 keys used to expand the elements
+constexpr uint8_t lt_hash_personal__[crypto_generichash_blake2b_PERSONALBYTES]
+    = {'s', 's', 'e', '_', 'l', 't', 'h', 'a',
+       's', 'h', '1', '6', 0x00, 0x00, 0x00, 0x00};
+
+class LtHash::LtHashImpl
+{
+public:
+    LtHashImpl();
+    LtHashImpl(const LtHashImpl& h) = default;
+    explicit LtHashImpl(const std::array<uint8_t, kLtHashSize>& bytes);
+    explicit LtHashImpl(const std::vector<std::string>& in_set);
+
+    LtHashImpl& operator=(const LtHashImpl& h) = default;
+
+    void add_element(const std::string& in);
+    void add_set(const LtHashImpl* in);
+    void remove_element(const std::string& in);
+    void remove_set(const LtHashImpl* in);
+
+    std::array<uint8_t, kLtHashSize> data() const;
+    std::array<uint8_t, kDigestSize> digest() const;
+
+    bool operator==(const LtHashImpl& h) const;
+
+private:
+    // expands the element into kLanes lanes
+    static void expand(const std::string& in, uint8_t* lanes);
+
+    // acc += in and acc -= in, lane by lane, modulo 2^16
+    static void add_lanes(uint8_t* acc, const uint8_t* in);
+    static void sub_lanes(uint8_t* acc, const uint8_t* in);
+
+    // the lanes, in little endian order
+    uint8_t lanes_[kLtHashSize];
+};
+
+constexpr size_t LtHash::kLanes;
+constexpr size_t LtHash::kLtHashSize;
+constexpr size_t LtHash::kDigestSize;
+
+LtHash::LtHash() : lt_hash_imp_(new LtHashImpl())
+{
+}
+
+LtHash::LtHash(const std::array<uint8_t, kLtHashSize>& bytes)
+    : lt_hash_imp_(new LtHashImpl(bytes))
+{
+}
+
+LtHash::LtHash(const LtHash& o) : lt_hash_imp_(new LtHashImpl(*o.lt_hash_imp_))
+{
+}
+
+LtHash::LtHash(LtHash&& o) noexcept : lt_hash_imp_(o.lt_hash_imp_)
+{
+    o.lt_hash_imp_ = nullptr;
+}
+
+LtHash::LtHash(const std::vector<std::string>& in_set)
+    : lt_hash_imp_(new LtHashImpl(in_set))
+{
+}
+
+LtHash::~LtHash()
+{
+    delete lt_hash_imp_;
+}
+
+void LtHash::add_element(const std::string& in)
+{
+    lt_hash_imp_->add_element(in);
+}
+
+void LtHash::add_set(const LtHash& h)
+{
+    lt_hash_imp_->add_set(h.lt_hash_imp_);
+}
+
+void LtHash::remove_element(const std::string& in)
+{
+    lt_hash_imp_->remove_element(in);
+}
+
+void LtHash::remove_set(const LtHash& h)
+{
+    lt_hash_imp_->remove_set(h.lt_hash_imp_);
+}
+
+std::array<uint8_t, LtHash::kLtHashSize> LtHash::data() const
+{
+    return lt_hash_imp_->data();
+}
+
+std::array<uint8_t, LtHash::kDigestSize> LtHash::digest() const
+{
+    return lt_hash_imp_->digest();
+}
+
+/* LCOV_EXCL_START */
+std::ostream& operator<<(std::ostream& os, const LtHash& h)
+{
+    auto d = h.lt_hash_imp_->digest();
+    for (uint8_t b : d) {
+        os << std::hex << std::setw(2) << std::setfill('0')
+           << static_cast<uint>(b);
+    }
+    os << std::dec;
+    return os;
+}
+/* LCOV_EXCL_STOP */
+
+LtHash& LtHash::operator=(const LtHash& h)
+{
+    if (this != &h) {
+        *lt_hash_imp_ = *h.lt_hash_imp_;
+    }
+    return *this;
+}
+
+bool LtHash::operator==(const LtHash& h) const
+{
+    return (*lt_hash_imp_ == *h.lt_hash_imp_);
+}
+
+bool LtHash::operator!=(const LtHash& h) const
+{
+    return !(*this == h);
+}
+
+//
+//
+// LtHashImpl
+//
+//
+
+void LtHash::LtHashImpl::expand(const std::string& in, uint8_t* lanes)
+{
+    uint8_t key[crypto_stream_chacha20_ietf_KEYBYTES];
+    uint8_t nonce[crypto_stream_chacha20_ietf_NONCEBYTES] = {0x00};
+
+    crypto_generichash_blake2b_salt_personal(
+        key,
+        sizeof(key),
+        reinterpret_cast<const uint8_t*>(in.data()),
+        in.size(),
+        nullptr,
+        0,
+        nullptr,
+        lt_hash_personal__);
+
+    // the key is only used for this element: the nonce can be constant
+    crypto_stream_chacha20_ietf(lanes, kLtHashSize, nonce, key);
+    sodium_memzero(key, sizeof(key));
+}
+
+void LtHash::LtHashImpl::add_lanes(uint8_t* acc, const uint8_t* in)
+{
+#if __AVX2__
+    for (size_t i = 0; i < kLtHashSize; i += sizeof(__m256i)) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i*>(acc + i));
+        __m256i b
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i),
+                            _mm256_add_epi16(a, b));
+    }
+#else
+    for (size_t i = 0; i < kLtHashSize; i += 2) {
+        const uint16_t a = static_cast<uint16_t>(acc[i] | (acc[i + 1] << 8));
+        const uint16_t b = static_cast<uint16_t>(in[i] | (in[i + 1] << 8));
+        const uint16_t s = static_cast<uint16_t>(a + b);
+        acc[i]           = static_cast<uint8_t>(s);
+        acc[i + 1]       = static_cast<uint8_t>(s >> 8);
+    }
+#endif
+}
+
+void LtHash::LtHashImpl::sub_lanes(uint8_t* acc, const uint8_t* in)
+{
+#if __AVX2__
+    for (size_t i = 0; i < kLtHashSize; i += sizeof(__m256i)) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i*>(acc + i));
+        __m256i b
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i),
+                            _mm256_sub_epi16(a, b));
+    }
+#else
+    for (size_t i = 0; i < kLtHashSize; i += 2) {
+        const uint16_t a = static_cast<uint16_t>(acc[i] | (acc[i + 1] << 8));
+        const uint16_t b = static_cast<uint16_t>(in[i] | (in[i + 1] << 8));
+        const uint16_t s = static_cast<uint16_t>(a - b);
+        acc[i]           = static_cast<uint8_t>(s);
+        acc[i + 1]       = static_cast<uint8_t>(s >> 8);
+    }
+#endif
+}
+
+LtHash::LtHashImpl::LtHashImpl()
+{
+    memset(lanes_, 0x00, sizeof(lanes_));
+}
+
+LtHash::LtHashImpl::LtHashImpl(const std::array<uint8_t, kLtHashSize>& bytes)
+{
+    memcpy(lanes_, bytes.data(), sizeof(lanes_));
+}
+
+LtHash::LtHashImpl::LtHashImpl(const std::vector<std::string>& in_set)
+{
+    memset(lanes_, 0x00, sizeof(lanes_));
+
+    uint8_t e_lanes[kLtHashSize];
+    for (const auto& s : in_set) {
+        expand(s, e_lanes);
+        add_lanes(lanes_, e_lanes);
+    }
+}
+
+void LtHash::LtHashImpl::add_element(const std::string& in)
+{
+    uint8_t e_lanes[kLtHashSize];
+    expand(in, e_lanes);
+    add_lanes(lanes_, e_lanes);
+}
+
+void LtHash::LtHashImpl::add_set(const LtHashImpl* in)
+{
+    add_lanes(lanes_, in->lanes_);
+}
+
+void LtHash::LtHashImpl::remove_element(const std::string& in)
+{
+    uint8_t e_lanes[kLtHashSize];
+    expand(in, e_lanes);
+    sub_lanes(lanes_, e_lanes);
+}
+
+void LtHash::LtHashImpl::remove_set(const LtHashImpl* in)
+{
+    sub_lanes(lanes_, in->lanes_);
+}
+
+std::array<uint8_t, LtHash::kLtHashSize> LtHash::LtHashImpl::data() const
+{
+    std::array<uint8_t, kLtHashSize> bytes;
+    memcpy(bytes.data(), lanes_, kLtHashSize);
+
+    return bytes;
+}
+
+std::array<uint8_t, LtHash::kDigestSize> LtHash::LtHashImpl::digest() const
+{
+    std::array<uint8_t, kDigestSize> d;
+    crypto_generichash_blake2b(
+        d.data(), d.size(), lanes_, sizeof(lanes_), nullptr, 0);
+
+    return d;
+}
+
+bool LtHash::LtHashImpl::operator==(const LtHash::LtHashImpl& h) const
+{
+    return sodium_memcmp(lanes_, h.lanes_, kLtHashSize) == 0;
+}
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,209 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace sse {
+
+namespace crypto {
+
+///
+/// @class LtHash
+/// @brief Incremental set hashing with a lattice-based construction
+///
+/// LtHash is a (multi)set hash function with the same interface as SetHash,
+/// implementing the LtHash16 construction of Lewi, Kim, Maykov and Weis
+/// (*Securing Update Propagation with Homomorphic Hashing* --
+/// https://eprint.iacr.org/2019/227 ), itself an instance of the additive
+/// (AdHash) construction of Bellare and Micciancio.
+///
+/// Every element is expanded into a vector of 1024 16 bits lanes (2 kB), and
+/// the hash of a set is the sum of its elements' vectors, lane by lane,
+/// modulo 2^16. The expansion uses ChaCha20, keyed with a BLAKE2b hash of the
+/// element. Adding or removing an element is much cheaper than with SetHash
+/// (no hash-to-curve), and the vector additions use AVX2 when available. The
+/// price is the size of the hash: 2 kB instead of 32 bytes. digest() gives a
+/// compact (32 bytes) fingerprint of the hash, which can be compared but not
+/// combined.
+///
+/// The sets that can be hashed are sets of std::string.
+///
+class LtHash
+{
+public:
+    /// @brief Number of 16 bits lanes of the hash
+    static constexpr size_t kLanes = 1024;
+    /// @brief Size of the bytes representation of an LtHash
+    static constexpr size_t kLtHashSize = 2 * kLanes;
+    /// @brief Size of the compact digest of an LtHash
+    static constexpr size_t kDigestSize = 32;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates and initializes an LtHash for an empty set.
+    ///
+    LtHash();
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a new LtHash from its bytes representation (see data()).
+    ///
+    /// @param bytes    A bytes array representing an LtHash.
+    ///
+    explicit LtHash(const std::array<uint8_t, kLtHashSize>& bytes);
+
+    ///
+    /// @brief Copy constructor
+    ///
+    LtHash(const LtHash& o);
+
+    ///
+    /// @brief Move constructor
+    ///
+    LtHash(LtHash&& o) noexcept;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a new LtHash representing a vector (list) of strings
+    ///
+    /// @param in_set   The elements to be hashed.
+    ///
+    explicit LtHash(const std::vector<std::string>& in_set);
+
+    ///
+    /// @brief Destructor
+    ///
+    ~LtHash();
+
+    ///
+    /// @brief Hash a new element in the set hash
+    ///
+    /// Compute the hash of \f$S \cup \{in\} \f$ where S is the set represented
+    /// by the object.
+    ///
+    /// @param in   The element to insert
+    ///
+    void add_element(const std::string& in);
+
+    ///
+    /// @brief Compute the hash of a union
+    ///
+    /// Compute the hash of \f$S \cup S'\f$ where S is the set represented by
+    /// the object, and S' the set represented by h.
+    ///
+    /// @param h    The set hash of the set to insert in the target object
+    ///
+    void add_set(const LtHash& h);
+
+    ///
+    /// @brief Remove an element of the set hash
+    ///
+    /// Compute the hash of \f$S \setminus \{in\} \f$ where S is the set
+    /// represented by the object.
+    ///
+    /// @param in   The element to remove
+    ///
+    void remove_element(const std::string& in);
+
+    ///
+    /// @brief Compute the hash of a set difference
+    ///
+    /// Compute the hash of \f$S \setminus S'\f$ where S is the set represented
+    /// by the object, and S' the set represented by h.
+    ///
+    /// @param h    The set hash of the set to remove from the target object
+    ///
+    void remove_set(const LtHash& h);
+
+    ///
+    /// @brief Binary representation of the LtHash
+    ///
+    /// Returns the lanes of the hash, in little endian order. The result can
+    /// be given to the constructor to recreate the LtHash.
+    ///
+    /// @return The array representing the set hash
+    ///
+    std::array<uint8_t, kLtHashSize> data() const;
+
+    ///
+    /// @brief Compact digest of the LtHash
+    ///
+    /// Returns the BLAKE2b hash of data(), truncated to kDigestSize bytes.
+    /// Two LtHash objects are equal iff their digests are equal (except with
+    /// negligible probability).
+    ///
+    /// @return The digest of the set hash
+    ///
+    std::array<uint8_t, kDigestSize> digest() const;
+
+    ///
+    /// @brief Stream serialization operator
+    ///
+    /// Put the hex string representation of the digest of an LtHash in an
+    /// output stream.
+    ///
+    /// @param os   The output stream
+    /// @param h    The set hash to serialize in the stream
+    ///
+    /// @return     The stream os
+    ///
+    friend std::ostream& operator<<(std::ostream& os, const LtHash& h);
+
+    ///
+    /// @brief Assignment operator
+    ///
+    /// @param h    The element to assign
+    /// @return     The assigned object
+    ///
+    LtHash& operator=(const LtHash& h);
+
+    ///
+    /// @brief Comparison operator
+    ///
+    /// @param h    The element to compare
+    /// @return     true if h and the object have the same hash, false otherwise
+    ///
+    bool operator==(const LtHash& h) const;
+
+    ///
+    /// @brief Comparison operator
+    /// @param h    The element to compare
+    /// @return     false if h and the object have the same hash,
+    ///             true otherwise
+    ///
+    bool operator!=(const LtHash& h) const;
+
+private:
+    class LtHashImpl;         // not defined in the header
+    LtHashImpl* lt_hash_imp_; // opaque pointer
+};
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,99 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+// Splits a batch of n elements in (at most) thread_count contiguous chunks,
+// and calls process(first, count) on every chunk, each from its own thread.
+// The calling thread processes the last chunk. A thread_count of 0 stands for
+// the number of hardware threads. The exceptions thrown by process are caught
+// in the thread that threw them: the first one is rethrown once all the
+// threads are joined.
+template<class F>
+void process_batch(const size_t n, unsigned int thread_count, F process)
+{
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    if (thread_count > n) {
+        thread_count = static_cast<unsigned int>(n);
+    }
+    if (thread_count <= 1) {
+        process(0, n);
+        return;
+    }
+
+    std::vector<std::thread>        threads;
+    std::vector<std::exception_ptr> errors(thread_count);
+
+    auto run_chunk = [&process, &errors](const unsigned int t,
+                                         const size_t       first,
+                                         const size_t       count) {
+        try {
+            process(first, count);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    const size_t chunk_size = n / thread_count;
+    const size_t remainder  = n % thread_count;
+
+    size_t first = 0;
+    try {
+        for (unsigned int t = 0; t < thread_count; t++) {
+            const size_t count = chunk_size + ((t < remainder) ? 1 : 0);
+            if (t + 1 < thread_count) {
+                threads.emplace_back(run_chunk, t, first, count);
+            } else {
+                run_chunk(t, first, count);
+            }
+            first += count;
+        }
+    } catch (...) {
+        // a thread could not be created: wait for the running ones
+        for (auto& th : threads) {
+            th.join();
+        }
+        throw;
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    for (const auto& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+} // namespace crypto
+} // namespace sse
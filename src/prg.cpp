@@ -42,7 +42,7 @@ namespace sse {
 namespace crypto {
 
 static void prg_derivation(const unsigned char* key,
-                           const uint32_t       offset,
+                           const uint64_t       offset,
                            const size_t         len,
                            unsigned char*       out)
 {
@@ -54,11 +54,17 @@ static void prg_derivation(const unsigned char* key,
         return; /* LCOV_EXCL_LINE */
     }
 
-    const size_t mod_offset      = (offset % CHACHA20_BLOCK_SIZE);
-    const size_t block_offset    = offset / CHACHA20_BLOCK_SIZE;
-    const size_t max_block_index = (len + offset - 1) / CHACHA20_BLOCK_SIZE + 1;
+    if (len > UINT64_MAX - offset) {
+        throw std::invalid_argument(/* LCOV_EXCL_LINE */
+                                    "Offset too large: offset+len overflows");
+    }
+
+    const size_t   mod_offset   = (offset % CHACHA20_BLOCK_SIZE);
+    const uint64_t block_offset = offset / CHACHA20_BLOCK_SIZE;
+    const uint64_t max_block_index
+        = (len + offset - 1) / CHACHA20_BLOCK_SIZE + 1;
 
-    const size_t block_len = max_block_index - block_offset;
+    const uint64_t block_len = max_block_index - block_offset;
 
     memset(out, 0, len);
 
@@ -110,7 +116,7 @@ public:
 
     inline explicit PrgImpl(Key<kKeySize>&& key);
 
-    inline void derive(const uint32_t offset,
+    inline void derive(const uint64_t offset,
                        const size_t   len,
                        unsigned char* out) const;
 
@@ -160,6 +166,13 @@ void Prg::derive(const uint32_t offset,
     prg_imp_->derive(offset, len, out);
 }
 
+void Prg::derive_64(const uint64_t offset,
+                    const size_t   len,
+                    unsigned char* out) const
+{
+    prg_imp_->derive(offset, len, out);
+}
+
 void Prg::derive(Key<kKeySize>&& k, const size_t len, std::string& out)
 {
     std::vector<uint8_t> data(len);
@@ -219,7 +232,7 @@ Prg::PrgImpl::PrgImpl(Key<kKeySize>&& key) : key_(std::move(key))
 }
 
 
-void Prg::PrgImpl::derive(const uint32_t offset,
+void Prg::PrgImpl::derive(const uint64_t offset,
                           const size_t   len,
                           unsigned char* out) const
 {
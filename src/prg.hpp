@@ -24,8 +24,10 @@
 #include "key.hpp"
 
 #include <cstdint>
+#include <cstring>
 
 #include <array>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -148,6 +150,26 @@ public:
                 const size_t   len,
                 unsigned char* out) const;
 
+    ///
+    /// @brief Fills buffer with pseudorandom bytes, using a 64 bits offset
+    ///
+    /// Fills the out buffer with len pseudorandom bytes, skipping the first
+    /// offset bytes of the pseudo-random generation. Contrary to derive, the
+    /// offset can address the whole pseudo-random stream.
+    ///
+    ///
+    /// @param offset   The number of bytes to skip in the pseudo-random
+    ///                 sequence.
+    /// @param len      The number of pseudo-random bytes to generate.
+    /// @param out      The output buffer. Must not be NULL
+    ///
+    /// @exception std::invalid_argument       out is NULL
+    /// @exception std::invalid_argument       offset+len overflows
+    ///
+    void derive_64(const uint64_t offset,
+                   const size_t   len,
+                   unsigned char* out) const;
+
     ///
     /// @brief Generate a pseudorandom string from the input seed
     ///
@@ -269,6 +291,29 @@ public:
     std::vector<Key<K>> derive_keys(const uint16_t n_keys,
                                     const uint16_t key_offset = 0);
 
+    template<size_t K>
+    class KeyIterator;
+
+    ///
+    /// @brief Iterate over derived keys
+    ///
+    /// Returns an iterator over the pseudo-randomly generated keys. As for
+    /// derive_keys, the pseudo-random stream is cut in blocks of K bytes, and
+    /// the key_offset-th block is the one pointed to by the returned iterator.
+    /// Contrary to derive_keys, the keys are lazily generated, and are indexed
+    /// by 64 bits integers.
+    ///
+    /// The Prg object must outlive the returned iterator.
+    ///
+    /// @tparam K           The size of the generated keys.
+    ///
+    /// @param key_offset   The number of the block pointed to by the iterator.
+    ///
+    /// @return             An iterator over the derived keys.
+    ///
+    template<size_t K>
+    KeyIterator<K> key_iterator(const uint64_t key_offset = 0) const;
+
 
     ///
     /// @brief Derive a key from a seed
@@ -338,6 +383,291 @@ private:
     PrgImpl* prg_imp_; // opaque pointer
 };
 
+/// @class Prg::KeyIterator
+/// @brief Lazy iterator over keys derived by a Prg.
+///
+/// KeyIterator iterates over the keys derived from a Prg object. The keys are
+/// generated on demand: the iterator keeps a window of the pseudo-random
+/// stream in an internal buffer, and refills it only when the requested key
+/// lies outside of this window. Hence, iterating over
+/// consecutive keys amortizes the cost of the stream generation.
+///
+/// KeyIterator is a proxy iterator: dereferencing it derives a fresh key and
+/// returns it by value, there is no stored key to point or refer to. Hence,
+/// it is only declared as an input iterator, even though it also provides
+/// the random access operators (+, -, [], comparisons) as conveniences to
+/// move around the stream. Algorithms that require forward iterators must not
+/// be used with it.
+///
+/// The internal buffer is allocated once per iterator. Using derive() with an
+/// already initialized key does not allocate any memory.
+///
+/// @tparam K   The size of the derived keys.
+///
+template<size_t K>
+class Prg::KeyIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = Key<K>;
+    using difference_type   = int64_t;
+    using pointer           = void;
+    using reference         = Key<K>;
+
+    static_assert(K > 0, "K must be strictly positive");
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates an iterator pointing to the index-th key derived by prg.
+    ///
+    /// @param prg      The Prg used to derive the keys. It must outlive the
+    ///                 iterator.
+    /// @param index    The index of the pointed key.
+    ///
+    KeyIterator(const Prg& prg, const uint64_t index) noexcept
+        : prg_(&prg), index_(index)
+    {
+    }
+
+    ///
+    /// @brief Copy constructor
+    ///
+    /// The internal buffer is not shared with the copied iterator.
+    ///
+    KeyIterator(const KeyIterator& it) noexcept
+        : prg_(it.prg_), index_(it.index_)
+    {
+    }
+
+    ///
+    /// @brief Move constructor
+    ///
+    KeyIterator(KeyIterator&& it) noexcept
+        : prg_(it.prg_), index_(it.index_), buffer_(it.buffer_),
+          buffer_start_(it.buffer_start_), buffer_valid_(it.buffer_valid_)
+    {
+        it.buffer_       = nullptr;
+        it.buffer_valid_ = false;
+    }
+
+    ///
+    /// @brief Destructor
+    ///
+    /// Erases and frees the internal buffer.
+    ///
+    ~KeyIterator()
+    {
+        if (buffer_ != nullptr) {
+            sodium_free(buffer_);
+        }
+    }
+
+    KeyIterator& operator=(const KeyIterator& it) noexcept
+    {
+        if (this != &it) {
+            prg_          = it.prg_;
+            index_        = it.index_;
+            buffer_valid_ = false;
+        }
+        return *this;
+    }
+
+    KeyIterator& operator=(KeyIterator&& it) noexcept
+    {
+        if (this != &it) {
+            if (buffer_ != nullptr) {
+                sodium_free(buffer_);
+            }
+            prg_          = it.prg_;
+            index_        = it.index_;
+            buffer_       = it.buffer_;
+            buffer_start_ = it.buffer_start_;
+            buffer_valid_ = it.buffer_valid_;
+
+            it.buffer_       = nullptr;
+            it.buffer_valid_ = false;
+        }
+        return *this;
+    }
+
+    ///
+    /// @brief Index of the pointed key
+    ///
+    inline uint64_t index() const noexcept
+    {
+        return index_;
+    }
+
+    ///
+    /// @brief Derive the pointed key
+    ///
+    /// Every call derives a new key and returns it by value: modifying or
+    /// destroying the returned key does not affect the iterator.
+    ///
+    /// @return A new key, initialized with the index()-th block of K bytes
+    ///         of the pseudo-random stream.
+    ///
+    /// @exception std::invalid_argument    The key index is too large.
+    ///
+    Key<K> operator*() const
+    {
+        const uint8_t* src = key_data(index_);
+        return Key<K>([src](uint8_t* key_content) {
+            memcpy(key_content, src, K);
+        });
+    }
+
+    ///
+    /// @brief Derive the key n positions away from the pointed key
+    ///
+    /// As operator*, returns a freshly derived key by value.
+    ///
+    /// @exception std::invalid_argument    The key index is too large.
+    ///
+    Key<K> operator[](const difference_type n) const
+    {
+        const uint8_t* src = key_data(index_ + static_cast<uint64_t>(n));
+        return Key<K>([src](uint8_t* key_content) {
+            memcpy(key_content, src, K);
+        });
+    }
+
+    ///
+    /// @brief Derive the pointed key in place
+    ///
+    /// Overwrites the content of key with the pointed key. If key is not
+    /// empty, its memory is reused and no allocation takes place.
+    ///
+    /// @param key  The key to overwrite.
+    ///
+    /// @exception std::invalid_argument    The key index is too large.
+    ///
+    void derive(Key<K>& key) const
+    {
+        const uint8_t* src = key_data(index_);
+        key.reset([src](uint8_t* key_content) { memcpy(key_content, src, K); });
+    }
+
+    KeyIterator& operator++() noexcept
+    {
+        ++index_;
+        return *this;
+    }
+    KeyIterator operator++(int) noexcept
+    {
+        KeyIterator tmp(*this);
+        ++index_;
+        return tmp;
+    }
+    KeyIterator& operator--() noexcept
+    {
+        --index_;
+        return *this;
+    }
+    KeyIterator operator--(int) noexcept
+    {
+        KeyIterator tmp(*this);
+        --index_;
+        return tmp;
+    }
+    KeyIterator& operator+=(const difference_type n) noexcept
+    {
+        index_ += static_cast<uint64_t>(n);
+        return *this;
+    }
+    KeyIterator& operator-=(const difference_type n) noexcept
+    {
+        index_ -= static_cast<uint64_t>(n);
+        return *this;
+    }
+    KeyIterator operator+(const difference_type n) const noexcept
+    {
+        return KeyIterator(*prg_, index_ + static_cast<uint64_t>(n));
+    }
+    KeyIterator operator-(const difference_type n) const noexcept
+    {
+        return KeyIterator(*prg_, index_ - static_cast<uint64_t>(n));
+    }
+    difference_type operator-(const KeyIterator& it) const noexcept
+    {
+        return static_cast<difference_type>(index_ - it.index_);
+    }
+
+    bool operator==(const KeyIterator& it) const noexcept
+    {
+        return (prg_ == it.prg_) && (index_ == it.index_);
+    }
+    bool operator!=(const KeyIterator& it) const noexcept
+    {
+        return !(*this == it);
+    }
+    bool operator<(const KeyIterator& it) const noexcept
+    {
+        return index_ < it.index_;
+    }
+    bool operator>(const KeyIterator& it) const noexcept
+    {
+        return index_ > it.index_;
+    }
+    bool operator<=(const KeyIterator& it) const noexcept
+    {
+        return index_ <= it.index_;
+    }
+    bool operator>=(const KeyIterator& it) const noexcept
+    {
+        return index_ >= it.index_;
+    }
+
+private:
+    // ChaCha20 block size: the window always starts on a block boundary
+    static constexpr size_t kBlockSize = 64;
+    // The window spans 8 blocks more than needed to hold a single key
+    static constexpr size_t kBufferSize
+        = ((K + kBlockSize - 1) / kBlockSize + 8) * kBlockSize;
+    // Largest key index whose window does not overflow the 64 bits offset
+    static constexpr uint64_t kMaxIndex = (UINT64_MAX - kBufferSize) / K;
+
+    const uint8_t* key_data(const uint64_t index) const
+    {
+        if (index > kMaxIndex) {
+            throw std::invalid_argument(/* LCOV_EXCL_LINE */
+                                        "Key index too large.");
+        }
+
+        const uint64_t offset = index * K;
+
+        if (!buffer_valid_ || offset < buffer_start_
+            || offset + K > buffer_start_ + kBufferSize) {
+            if (buffer_ == nullptr) {
+                buffer_
+                    = reinterpret_cast<uint8_t*>(sodium_malloc(kBufferSize));
+                if (buffer_ == nullptr) {
+                    throw std::bad_alloc(); /* LCOV_EXCL_LINE */
+                }
+            }
+            buffer_start_ = offset - (offset % kBlockSize);
+            buffer_valid_ = false; // in case of exception
+            prg_->derive_64(buffer_start_, kBufferSize, buffer_);
+            buffer_valid_ = true;
+        }
+
+        return buffer_ + (offset - buffer_start_);
+    }
+
+    const Prg*       prg_;
+    uint64_t         index_;
+    mutable uint8_t* buffer_{nullptr};
+    mutable uint64_t buffer_start_{0};
+    mutable bool     buffer_valid_{false};
+};
+
+template<size_t K>
+Prg::KeyIterator<K> Prg::key_iterator(const uint64_t key_offset) const
+{
+    return KeyIterator<K>(*this, key_offset);
+}
+
 template<size_t K>
 Key<K> Prg::derive_key(const uint16_t key_offset)
 {
@@ -469,6 +799,9 @@ std::vector<Key<K>> Prg::derive_keys(Key<kKeySize>&& k,
         Key<kKeySize>&& k,                                                     \
         const uint16_t  n_keys,                                                \
         const uint16_t  key_offset = 0);                                        \
+    extern template class Prg::KeyIterator<(N)>;                               \
+    extern template Prg::KeyIterator<(N)> Prg::key_iterator(                   \
+        const uint64_t key_offset) const;                                      \
     }                                                                          \
     }
 
@@ -485,6 +818,9 @@ std::vector<Key<K>> Prg::derive_keys(Key<kKeySize>&& k,
                                                     const uint16_t  n_keys,    \
                                                     const uint16_t  key_offset \
                                                     = 0);                      \
+    template class Prg::KeyIterator<(N)>;                                      \
+    template Prg::KeyIterator<(N)> Prg::key_iterator(                          \
+        const uint64_t key_offset) const;                                      \
     }                                                                          \
     }
 
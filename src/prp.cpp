@@ -29,6 +29,7 @@
 #include <climits>
 #include <cstring>
 
+#include <algorithm>
 #include <exception>
 #include <iomanip>
 
@@ -41,12 +42,29 @@ namespace crypto {
 bool Prp::is_available__ = false;
 
 #if __AES__ || __ARM_FEATURE_CRYPTO
+
+// Prp always calls AEZ with an all-zero 16 bytes nonce and no authenticator,
+// so the tweak AEZ derives from the nonce is a per-key constant. It is
+// computed once, and stored together with the AEZ context and the round keys
+// of the Feistel backend.
+struct aez_prp_ctx_t
+{
+    aez_ctx_t ctx;
+    block     tweak;
+    block     feistel[AEZ_FEISTEL_KEY_BLOCKS];
+};
+
 class Prp::PrpImpl
 {
 public:
-    PrpImpl();
+    explicit PrpImpl(const Backend backend);
+
+    PrpImpl(Key<kKeySize>&& k, const Backend backend);
 
-    explicit PrpImpl(Key<kKeySize>&& k);
+    Backend backend() const noexcept
+    {
+        return backend_;
+    }
 
     void encrypt(const unsigned char* in,
                  const unsigned int&  len,
@@ -57,8 +75,34 @@ public:
                  unsigned char*       out);
     void decrypt(const std::string& in, std::string& out);
 
+    void encrypt_int(const unsigned char* in,
+                     const unsigned int&  elt_len,
+                     unsigned char*       out);
+    void decrypt_int(const unsigned char* in,
+                     const unsigned int&  elt_len,
+                     unsigned char*       out);
+
+    void encrypt_batch(const unsigned char* in,
+                       const unsigned int&  elt_len,
+                       const size_t         n,
+                       unsigned char*       out);
+    void decrypt_batch(const unsigned char* in,
+                       const unsigned int&  elt_len,
+                       const size_t         n,
+                       unsigned char*       out);
+
 private:
-    Key<sizeof(aez_ctx_t)> aez_ctx_;
+    static void setup(const uint8_t* key, aez_prp_ctx_t* ctx);
+
+    static void feistel(const aez_prp_ctx_t* ctx,
+                        const bool           inverse,
+                        const unsigned char* in,
+                        const unsigned int&  elt_len,
+                        const size_t         n,
+                        unsigned char*       out);
+
+    Key<sizeof(aez_prp_ctx_t)> aez_ctx_;
+    const Backend              backend_;
 };
 
 #else
@@ -67,9 +111,14 @@ private:
 class Prp::PrpImpl
 {
 public:
-    PrpImpl(){};
+    explicit PrpImpl(const Backend backend){};
 
-    explicit PrpImpl(Key<kKeySize>&& k){};
+    PrpImpl(Key<kKeySize>&& k, const Backend backend){};
+
+    Backend backend() const noexcept
+    {
+        return Backend::kAEZ;
+    }
 
     void encrypt(const unsigned char* in,
                  const unsigned int&  len,
@@ -79,6 +128,22 @@ public:
                  const unsigned int&  len,
                  unsigned char*       out){};
     void decrypt(const std::string& in, std::string& out){};
+
+    void encrypt_int(const unsigned char* in,
+                     const unsigned int&  elt_len,
+                     unsigned char*       out){};
+    void decrypt_int(const unsigned char* in,
+                     const unsigned int&  elt_len,
+                     unsigned char*       out){};
+
+    void encrypt_batch(const unsigned char* in,
+                       const unsigned int&  elt_len,
+                       const size_t         n,
+                       unsigned char*       out){};
+    void decrypt_batch(const unsigned char* in,
+                       const unsigned int&  elt_len,
+                       const size_t         n,
+                       unsigned char*       out){};
 };
 #endif /* __AES__ || __ARM_FEATURE_CRYPTO */
 
@@ -92,7 +157,12 @@ void Prp::compute_is_available() noexcept
 #endif
 }
 
-Prp::Prp() : prp_imp_(Prp::is_available() ? new PrpImpl() : nullptr)
+Prp::Prp() : Prp(Backend::kAEZ)
+{
+}
+
+Prp::Prp(const Backend backend)
+    : prp_imp_(Prp::is_available() ? new PrpImpl(backend) : nullptr)
 {
     if (!Prp::is_available()) {
         throw std::runtime_error("PRP is unavailable: AES hardware "
@@ -101,8 +171,13 @@ Prp::Prp() : prp_imp_(Prp::is_available() ? new PrpImpl() : nullptr)
 }
 
 
-Prp::Prp(Key<kKeySize>&& k)
-    : prp_imp_(Prp::is_available() ? new PrpImpl(std::move(k)) : nullptr)
+Prp::Prp(Key<kKeySize>&& k) : Prp(std::move(k), Backend::kAEZ)
+{
+}
+
+Prp::Prp(Key<kKeySize>&& k, const Backend backend)
+    : prp_imp_(Prp::is_available() ? new PrpImpl(std::move(k), backend)
+                                   : nullptr)
 {
     if (!Prp::is_available()) {
         throw std::runtime_error("PRP are unavailable: AES hardware "
@@ -116,6 +191,11 @@ Prp::~Prp()
     delete prp_imp_;
 }
 
+Prp::Backend Prp::backend() const noexcept
+{
+    return prp_imp_->backend();
+}
+
 void Prp::encrypt(const std::string& in, std::string& out)
 {
     prp_imp_->encrypt(in, out);
@@ -131,18 +211,18 @@ std::string Prp::encrypt(const std::string& in)
 uint32_t Prp::encrypt(const uint32_t in)
 {
     uint32_t out;
-    prp_imp_->encrypt(reinterpret_cast<const unsigned char*>(&in),
-                      sizeof(uint32_t),
-                      reinterpret_cast<unsigned char*>(&out));
+    prp_imp_->encrypt_int(reinterpret_cast<const unsigned char*>(&in),
+                          sizeof(uint32_t),
+                          reinterpret_cast<unsigned char*>(&out));
     return out;
 }
 
 uint64_t Prp::encrypt_64(const uint64_t in)
 {
     uint64_t out;
-    prp_imp_->encrypt(reinterpret_cast<const unsigned char*>(&in),
-                      sizeof(uint64_t),
-                      reinterpret_cast<unsigned char*>(&out));
+    prp_imp_->encrypt_int(reinterpret_cast<const unsigned char*>(&in),
+                          sizeof(uint64_t),
+                          reinterpret_cast<unsigned char*>(&out));
     return out;
 }
 
@@ -162,44 +242,95 @@ std::string Prp::decrypt(const std::string& in)
 uint32_t Prp::decrypt(const uint32_t in)
 {
     uint32_t out;
-    prp_imp_->decrypt(reinterpret_cast<const unsigned char*>(&in),
-                      sizeof(uint32_t),
-                      reinterpret_cast<unsigned char*>(&out));
+    prp_imp_->decrypt_int(reinterpret_cast<const unsigned char*>(&in),
+                          sizeof(uint32_t),
+                          reinterpret_cast<unsigned char*>(&out));
     return out;
 }
 
 uint64_t Prp::decrypt_64(const uint64_t in)
 {
     uint64_t out;
-    prp_imp_->decrypt(reinterpret_cast<const unsigned char*>(&in),
-                      sizeof(uint64_t),
-                      reinterpret_cast<unsigned char*>(&out));
+    prp_imp_->decrypt_int(reinterpret_cast<const unsigned char*>(&in),
+                          sizeof(uint64_t),
+                          reinterpret_cast<unsigned char*>(&out));
     return out;
 }
 
+void Prp::encrypt_batch(const uint32_t* in, const size_t n, uint32_t* out)
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    prp_imp_->encrypt_batch(reinterpret_cast<const unsigned char*>(in),
+                            sizeof(uint32_t),
+                            n,
+                            reinterpret_cast<unsigned char*>(out));
+}
+
+void Prp::encrypt_64_batch(const uint64_t* in, const size_t n, uint64_t* out)
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    prp_imp_->encrypt_batch(reinterpret_cast<const unsigned char*>(in),
+                            sizeof(uint64_t),
+                            n,
+                            reinterpret_cast<unsigned char*>(out));
+}
+
+void Prp::decrypt_batch(const uint32_t* in, const size_t n, uint32_t* out)
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    prp_imp_->decrypt_batch(reinterpret_cast<const unsigned char*>(in),
+                            sizeof(uint32_t),
+                            n,
+                            reinterpret_cast<unsigned char*>(out));
+}
+
+void Prp::decrypt_64_batch(const uint64_t* in, const size_t n, uint64_t* out)
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    prp_imp_->decrypt_batch(reinterpret_cast<const unsigned char*>(in),
+                            sizeof(uint64_t),
+                            n,
+                            reinterpret_cast<unsigned char*>(out));
+}
+
 #if __AES__ || __ARM_FEATURE_CRYPTO
 
-Prp::PrpImpl::PrpImpl()
+void Prp::PrpImpl::setup(const uint8_t* key, aez_prp_ctx_t* ctx)
+{
+    const char iv[16] = {0x00};
+
+    aez_setup(static_cast<const unsigned char*>(key), 48, &ctx->ctx);
+    aez_setup_tweak(&ctx->ctx, iv, 16, 0, &ctx->tweak);
+    aez_feistel_setup(&ctx->ctx, ctx->feistel);
+}
+
+Prp::PrpImpl::PrpImpl(const Backend backend) : backend_(backend)
 {
     auto callback = [](uint8_t* key_content) {
         Key<kKeySize> r_key;
-        aez_setup(static_cast<const unsigned char*>(r_key.unlock_get()),
-                  48,
-                  reinterpret_cast<aez_ctx_t*>(key_content));
+        setup(r_key.unlock_get(),
+              reinterpret_cast<aez_prp_ctx_t*>(key_content));
     };
 
-    aez_ctx_ = Key<sizeof(aez_ctx_t)>(callback);
+    aez_ctx_ = Key<sizeof(aez_prp_ctx_t)>(callback);
 }
 
-Prp::PrpImpl::PrpImpl(Key<kKeySize>&& k)
+Prp::PrpImpl::PrpImpl(Key<kKeySize>&& k, const Backend backend)
+    : backend_(backend)
 {
     auto callback = [&k](uint8_t* key_content) {
-        aez_setup(static_cast<const unsigned char*>(k.unlock_get()),
-                  48,
-                  reinterpret_cast<aez_ctx_t*>(key_content));
+        setup(k.unlock_get(), reinterpret_cast<aez_prp_ctx_t*>(key_content));
     };
 
-    aez_ctx_ = Key<sizeof(aez_ctx_t)>(callback);
+    aez_ctx_ = Key<sizeof(aez_prp_ctx_t)>(callback);
     k.erase();
 }
 
@@ -211,29 +342,15 @@ void Prp::PrpImpl::encrypt(const unsigned char* in,
         throw std::runtime_error("PRP is unavailable: AES hardware "
                                  "acceleration not supported by the CPU");
     }
-    char iv[16] = {0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00};
-    aez_encrypt(reinterpret_cast<const aez_ctx_t*>(aez_ctx_.unlock_get()),
-                iv,
-                16,
-                0,
-                reinterpret_cast<const char*>(in),
-                len,
-                reinterpret_cast<char*>(out));
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
+
+    aez_encrypt_tweak(&ctx->ctx,
+                      &ctx->tweak,
+                      0,
+                      reinterpret_cast<const char*>(in),
+                      len,
+                      reinterpret_cast<char*>(out));
 }
 
 void Prp::PrpImpl::encrypt(const std::string& in, std::string& out)
@@ -268,30 +385,15 @@ void Prp::PrpImpl::decrypt(const unsigned char* in,
         throw std::runtime_error("PRP is unavailable: AES hardware "
                                  "acceleration not supported by the CPU");
     }
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
 
-    char iv[16] = {0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00,
-                   0x00};
-    aez_decrypt(reinterpret_cast<const aez_ctx_t*>(aez_ctx_.unlock_get()),
-                iv,
-                16,
-                0,
-                reinterpret_cast<const char*>(in),
-                len,
-                reinterpret_cast<char*>(out));
+    aez_decrypt_tweak(&ctx->ctx,
+                      &ctx->tweak,
+                      0,
+                      reinterpret_cast<const char*>(in),
+                      len,
+                      reinterpret_cast<char*>(out));
 
     aez_ctx_.lock();
 }
@@ -321,6 +423,150 @@ void Prp::PrpImpl::decrypt(const std::string& in, std::string& out)
     delete[] data;
 }
 
+void Prp::PrpImpl::feistel(const aez_prp_ctx_t* ctx,
+                           const bool           inverse,
+                           const unsigned char* in,
+                           const unsigned int&  elt_len,
+                           const size_t         n,
+                           unsigned char*       out)
+{
+    // the Feistel functions count the elements with an unsigned int
+    const size_t max_chunk = UINT_MAX;
+    for (size_t done = 0; done < n;) {
+        const auto chunk
+            = static_cast<unsigned int>(std::min(n - done, max_chunk));
+        const unsigned char* src = in + done * elt_len;
+        unsigned char*       dst = out + done * elt_len;
+
+        if (elt_len == sizeof(uint32_t)) {
+            const auto* src32 = reinterpret_cast<const uint32_t*>(src);
+            auto*       dst32 = reinterpret_cast<uint32_t*>(dst);
+            if (inverse) {
+                aez_feistel_decrypt_32(ctx->feistel, src32, chunk, dst32);
+            } else {
+                aez_feistel_encrypt_32(ctx->feistel, src32, chunk, dst32);
+            }
+        } else {
+            const auto* src64 = reinterpret_cast<const uint64_t*>(src);
+            auto*       dst64 = reinterpret_cast<uint64_t*>(dst);
+            if (inverse) {
+                aez_feistel_decrypt_64(ctx->feistel, src64, chunk, dst64);
+            } else {
+                aez_feistel_encrypt_64(ctx->feistel, src64, chunk, dst64);
+            }
+        }
+        done += chunk;
+    }
+}
+
+void Prp::PrpImpl::encrypt_int(const unsigned char* in,
+                               const unsigned int&  elt_len,
+                               unsigned char*       out)
+{
+    if (backend_ == Backend::kAEZ) {
+        encrypt(in, elt_len, out);
+        return;
+    }
+    if (!Prp::is_available()) {
+        throw std::runtime_error("PRP is unavailable: AES hardware "
+                                 "acceleration not supported by the CPU");
+    }
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
+
+    feistel(ctx, false, in, elt_len, 1, out);
+}
+
+void Prp::PrpImpl::decrypt_int(const unsigned char* in,
+                               const unsigned int&  elt_len,
+                               unsigned char*       out)
+{
+    if (backend_ == Backend::kAEZ) {
+        decrypt(in, elt_len, out);
+        return;
+    }
+    if (!Prp::is_available()) {
+        throw std::runtime_error("PRP is unavailable: AES hardware "
+                                 "acceleration not supported by the CPU");
+    }
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
+
+    feistel(ctx, true, in, elt_len, 1, out);
+
+    aez_ctx_.lock();
+}
+
+void Prp::PrpImpl::encrypt_batch(const unsigned char* in,
+                                 const unsigned int&  elt_len,
+                                 const size_t         n,
+                                 unsigned char*       out)
+{
+    if (!Prp::is_available()) {
+        throw std::runtime_error("PRP is unavailable: AES hardware "
+                                 "acceleration not supported by the CPU");
+    }
+
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
+
+    if (backend_ == Backend::kFeistel) {
+        feistel(ctx, false, in, elt_len, n, out);
+        aez_ctx_.lock();
+        return;
+    }
+
+    // aez_encrypt_batch counts the elements with an unsigned int
+    const size_t max_chunk = UINT_MAX / elt_len;
+    for (size_t done = 0; done < n;) {
+        const size_t chunk = std::min(n - done, max_chunk);
+        aez_encrypt_batch(&ctx->ctx,
+                          &ctx->tweak,
+                          reinterpret_cast<const char*>(in + done * elt_len),
+                          elt_len,
+                          static_cast<unsigned int>(chunk),
+                          reinterpret_cast<char*>(out + done * elt_len));
+        done += chunk;
+    }
+
+    aez_ctx_.lock();
+}
+
+void Prp::PrpImpl::decrypt_batch(const unsigned char* in,
+                                 const unsigned int&  elt_len,
+                                 const size_t         n,
+                                 unsigned char*       out)
+{
+    if (!Prp::is_available()) {
+        throw std::runtime_error("PRP is unavailable: AES hardware "
+                                 "acceleration not supported by the CPU");
+    }
+
+    const aez_prp_ctx_t* ctx
+        = reinterpret_cast<const aez_prp_ctx_t*>(aez_ctx_.unlock_get());
+
+    if (backend_ == Backend::kFeistel) {
+        feistel(ctx, true, in, elt_len, n, out);
+        aez_ctx_.lock();
+        return;
+    }
+
+    // aez_decrypt_batch counts the elements with an unsigned int
+    const size_t max_chunk = UINT_MAX / elt_len;
+    for (size_t done = 0; done < n;) {
+        const size_t chunk = std::min(n - done, max_chunk);
+        aez_decrypt_batch(&ctx->ctx,
+                          &ctx->tweak,
+                          reinterpret_cast<const char*>(in + done * elt_len),
+                          elt_len,
+                          static_cast<unsigned int>(chunk),
+                          reinterpret_cast<char*>(out + done * elt_len));
+        done += chunk;
+    }
+
+    aez_ctx_.lock();
+}
+
 #endif /* __AES__ || __ARM_FEATURE_CRYPTO */
 
 } // namespace crypto
@@ -20,16 +20,23 @@
 
 #include "set_hash.hpp"
 
+#include "ed25519/ge25519.hpp"
 #include "hash.hpp"
 
 #include <cstring>
 
+#include <algorithm>
+#include <atomic>
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include <sodium/crypto_core_ed25519.h>
-#include <sodium/crypto_scalarmult_ed25519.h>
+#include <sodium/crypto_core_ristretto255.h>
 #include <sodium/utils.h>
 
 namespace sse {
@@ -41,48 +48,82 @@ constexpr uint8_t ec_inf_point__[crypto_core_ed25519_BYTES]
        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+// first byte of the serialized hashes
+constexpr uint8_t ed25519_serialization_tag__      = 0x01;
+constexpr uint8_t ristretto255_serialization_tag__ = 0x02;
+
 class SetHash::SetHashImpl
 {
     friend SetHash;
+    friend ConcurrentSetHash;
 
 public:
-    SetHashImpl();
+    explicit SetHashImpl(const Backend backend);
     SetHashImpl(const SetHashImpl& s);
     explicit SetHashImpl(const std::array<uint8_t, kSetHashSize>& bytes);
-    explicit SetHashImpl(const std::vector<std::string>& in_set);
+    explicit SetHashImpl(const std::array<uint8_t, kSerializedSize>& bytes);
+    SetHashImpl(const std::vector<std::string>& in_set, const Backend backend);
 
     SetHashImpl& operator=(const SetHashImpl& h);
 
     void add_element(const std::string& in);
+    void add_element(const std::string& in, const uint64_t count);
+    void add_counts(const std::map<std::string, uint64_t>& counts);
+    void add_elements(const uint8_t* const* elements,
+                      const size_t*         lengths,
+                      const size_t          n);
     void add_set(const SetHashImpl* in);
     void remove_element(const std::string& in);
+    void remove_element(const std::string& in, const uint64_t count);
     void remove_set(const SetHashImpl* in);
 
-    std::array<uint8_t, kSetHashSize> data() const;
+    std::array<uint8_t, kSetHashSize>    data() const;
+    std::array<uint8_t, kSerializedSize> serialize() const;
+
+    inline Backend backend() const noexcept
+    {
+        return backend_;
+    }
 
     bool operator==(const SetHashImpl& h) const;
 
 private:
-    static void gen_curve_point(
-        std::array<uint8_t, crypto_core_ed25519_BYTES>& p,
-        const uint8_t*                                  buf,
-        const size_t                                    len);
-
-    uint8_t
-        ellig_state_[crypto_core_ed25519_BYTES]; // keep it that way for now,
-                                                 // might be replaced with
-                                                 // dynamic memory allocation
-    static constexpr std::array<uint8_t, crypto_scalarmult_ed25519_SCALARBYTES>
-        seed__{{0x00}};
+    static void gen_curve_point(const Backend        backend,
+                                ed25519::ge25519_p3& p,
+                                const uint8_t*       buf,
+                                const size_t         len);
+
+    static void check_backends(const Backend b1, const Backend b2);
+
+    // Number of elements hashed and mapped to the group at once by
+    // add_elements
+    static constexpr size_t kBatchSize = 256;
+
+    void decode_ed25519(const uint8_t* bytes);
+    void decode_ristretto255(const uint8_t* bytes);
+
+    Backend backend_;
+
+    // The sum of the elements' points, in extended coordinates: the additions
+    // need neither point decompressions nor field inversions (the Ristretto255
+    // elements are represented by one of their points). The state is only
+    // encoded by data() and serialize().
+    ed25519::ge25519_p3 state_;
 
     static_assert(crypto_core_ed25519_BYTES == kSetHashSize,
                   "crypto_core_ed25519_BYTES != kSetHashSize");
+    static_assert(crypto_core_ristretto255_BYTES == kSetHashSize,
+                  "crypto_core_ristretto255_BYTES != kSetHashSize");
 };
 
-constexpr std::array<uint8_t, crypto_scalarmult_ed25519_SCALARBYTES>
-    SetHash::SetHashImpl::seed__;
+constexpr size_t SetHash::SetHashImpl::kBatchSize;
+
+SetHash::SetHash() : set_hash_imp_(new SetHashImpl(Backend::kEd25519))
+{
+}
 
-SetHash::SetHash() : set_hash_imp_(new SetHashImpl())
+SetHash::SetHash(const Backend backend)
+    : set_hash_imp_(new SetHashImpl(backend))
 {
 }
 
@@ -91,6 +132,11 @@ SetHash::SetHash(const std::array<uint8_t, kSetHashSize>& bytes)
 {
 }
 
+SetHash::SetHash(const std::array<uint8_t, kSerializedSize>& bytes)
+    : set_hash_imp_(new SetHashImpl(bytes))
+{
+}
+
 SetHash::SetHash(const SetHash& o)
     : set_hash_imp_(new SetHashImpl(*o.set_hash_imp_))
 {
@@ -102,7 +148,12 @@ SetHash::SetHash(SetHash&& o) noexcept : set_hash_imp_(o.set_hash_imp_)
 }
 
 SetHash::SetHash(const std::vector<std::string>& in_set)
-    : set_hash_imp_(new SetHashImpl(in_set))
+    : set_hash_imp_(new SetHashImpl(in_set, Backend::kEd25519))
+{
+}
+
+SetHash::SetHash(const std::vector<std::string>& in_set, const Backend backend)
+    : set_hash_imp_(new SetHashImpl(in_set, backend))
 {
 }
 
@@ -116,6 +167,23 @@ void SetHash::add_element(const std::string& in)
     set_hash_imp_->add_element(in);
 }
 
+void SetHash::add_element(const std::string& in, const uint64_t count)
+{
+    set_hash_imp_->add_element(in, count);
+}
+
+void SetHash::add_counts(const std::map<std::string, uint64_t>& counts)
+{
+    set_hash_imp_->add_counts(counts);
+}
+
+void SetHash::add_elements(const uint8_t* const* elements,
+                           const size_t*         lengths,
+                           const size_t          n)
+{
+    set_hash_imp_->add_elements(elements, lengths, n);
+}
+
 void SetHash::add_set(const SetHash& h)
 {
     set_hash_imp_->add_set(h.set_hash_imp_);
@@ -126,6 +194,11 @@ void SetHash::remove_element(const std::string& in)
     set_hash_imp_->remove_element(in);
 }
 
+void SetHash::remove_element(const std::string& in, const uint64_t count)
+{
+    set_hash_imp_->remove_element(in, count);
+}
+
 void SetHash::remove_set(const SetHash& h)
 {
     set_hash_imp_->remove_set(h.set_hash_imp_);
@@ -136,6 +209,16 @@ std::array<uint8_t, SetHash::kSetHashSize> SetHash::data() const
     return set_hash_imp_->data();
 }
 
+std::array<uint8_t, SetHash::kSerializedSize> SetHash::serialize() const
+{
+    return set_hash_imp_->serialize();
+}
+
+SetHash::Backend SetHash::backend() const noexcept
+{
+    return set_hash_imp_->backend();
+}
+
 
 /* LCOV_EXCL_START */
 std::ostream& operator<<(std::ostream& os, const SetHash& h)
@@ -174,108 +257,517 @@ bool SetHash::operator!=(const SetHash& h) const
 //
 //
 
-void SetHash::SetHashImpl::gen_curve_point(
-    std::array<uint8_t, crypto_core_ed25519_BYTES>& p,
-    const uint8_t*                                  buf,
-    const size_t                                    len)
+void SetHash::SetHashImpl::gen_curve_point(const Backend        backend,
+                                           ed25519::ge25519_p3& p,
+                                           const uint8_t*       buf,
+                                           const size_t         len)
+{
+    if (backend == Backend::kRistretto255) {
+        std::array<uint8_t, crypto_core_ristretto255_HASHBYTES> h;
+        sse::crypto::Hash::hash(
+            buf, len, crypto_core_ristretto255_HASHBYTES, h.data());
+
+        // same element as crypto_core_ristretto255_from_hash
+        ed25519::ristretto255_from_hash(p, h.data());
+    } else {
+        std::array<uint8_t, crypto_core_ed25519_UNIFORMBYTES> h;
+        sse::crypto::Hash::hash(
+            buf, len, crypto_core_ed25519_UNIFORMBYTES, h.data());
+
+        // same point as crypto_core_ed25519_from_uniform, without the encoding
+        ed25519::ge25519_from_uniform(p, h.data());
+    }
+}
+
+void SetHash::SetHashImpl::check_backends(const Backend b1, const Backend b2)
+{
+    if (b1 != b2) {
+        throw std::invalid_argument("SetHash: Incompatible backends");
+    }
+}
+
+void SetHash::SetHashImpl::decode_ed25519(const uint8_t* bytes)
 {
-    std::array<uint8_t, crypto_core_ed25519_UNIFORMBYTES> h;
-    sse::crypto::Hash::hash(
-        buf, len, crypto_core_ed25519_UNIFORMBYTES, h.data());
+    if ((crypto_core_ed25519_is_valid_point(bytes) != 1)
+        && (sodium_memcmp(bytes, ec_inf_point__, crypto_core_ed25519_BYTES)
+            != 0)) {
+        throw std::invalid_argument("SetHash: Invalid curve point");
+    }
+    if (ed25519::ge25519_frombytes(state_, bytes) != 0) {
+        throw std::invalid_argument(/* LCOV_EXCL_LINE */
+                                    "SetHash: Invalid curve point");
+    }
+}
 
-    crypto_core_ed25519_from_uniform(p.data(), h.data());
+void SetHash::SetHashImpl::decode_ristretto255(const uint8_t* bytes)
+{
+    // unlike libsodium 1.0.18, rejects the encodings with the top bit set, as
+    // they are not canonical
+    if (ed25519::ristretto255_frombytes(state_, bytes) != 0) {
+        throw std::invalid_argument("SetHash: Invalid Ristretto255 element");
+    }
 }
 
-SetHash::SetHashImpl::SetHashImpl()
+SetHash::SetHashImpl::SetHashImpl(const Backend backend) : backend_(backend)
 {
-    // the initial state is the infinite point
-    // we directly copy ec_inf_point__: calling
-    // crypto_scalarmult_ed25519_base(ellig_state_, scalar_zero__)
-    // will generate a differenter byte string as the one obtained by computing
-    // crypto_core_ed25519_sub(_,b,b) (computing b-b). Indeed,
-    // crypto_core_ed25519_sub(x,b,b) sets x to ec_inf_point__.
-    memcpy(ellig_state_, ec_inf_point__, crypto_core_ed25519_BYTES);
+    // the initial state is the neutral element, encoded as ec_inf_point__
+    // (Ed25519) or as the all-zero string (Ristretto255)
+    ed25519::ge25519_identity(state_);
 }
 
 SetHash::SetHashImpl::SetHashImpl(const SetHash::SetHashImpl& s)
+    : backend_(s.backend_), state_(s.state_)
 {
-    memcpy(ellig_state_, s.ellig_state_, sizeof(ellig_state_));
 }
 
 SetHash::SetHashImpl::SetHashImpl(
     const std::array<uint8_t, kSetHashSize>& bytes)
+    : backend_(Backend::kEd25519)
 {
-    memcpy(ellig_state_, bytes.data(), crypto_core_ed25519_BYTES);
+    decode_ed25519(bytes.data());
+}
 
-    if ((crypto_core_ed25519_is_valid_point(ellig_state_) != 1)
-        && (sodium_memcmp(
-                bytes.data(), ec_inf_point__, crypto_core_ed25519_BYTES)
-            != 0)) {
-        throw std::invalid_argument("SetHash: Invalid curve point");
+SetHash::SetHashImpl::SetHashImpl(
+    const std::array<uint8_t, kSerializedSize>& bytes)
+{
+    switch (bytes[0]) {
+    case ed25519_serialization_tag__:
+        backend_ = Backend::kEd25519;
+        decode_ed25519(bytes.data() + 1);
+        break;
+    case ristretto255_serialization_tag__:
+        backend_ = Backend::kRistretto255;
+        decode_ristretto255(bytes.data() + 1);
+        break;
+    default:
+        throw std::invalid_argument("SetHash: Unknown serialization format");
     }
 }
 
-SetHash::SetHashImpl::SetHashImpl(const std::vector<std::string>& in_set)
+SetHash::SetHashImpl::SetHashImpl(const std::vector<std::string>& in_set,
+                                  const Backend                   backend)
+    : backend_(backend)
 {
-    memcpy(ellig_state_, ec_inf_point__, crypto_core_ed25519_BYTES);
-    std::array<uint8_t, crypto_core_ed25519_BYTES> p;
-
-    for (auto& s : in_set) {
-        SetHash::SetHashImpl::gen_curve_point(
-            p, reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    ed25519::ge25519_identity(state_);
 
-        crypto_core_ed25519_add(ellig_state_, ellig_state_, p.data());
+    std::vector<const uint8_t*> elements(in_set.size());
+    std::vector<size_t>         lengths(in_set.size());
+    for (size_t i = 0; i < in_set.size(); i++) {
+        elements[i] = reinterpret_cast<const uint8_t*>(in_set[i].data());
+        lengths[i]  = in_set[i].size();
     }
+    add_elements(elements.data(), lengths.data(), in_set.size());
 }
 
 SetHash::SetHashImpl& SetHash::SetHashImpl::operator=(const SetHashImpl& h)
 {
-    memcpy(ellig_state_, h.ellig_state_, sizeof(ellig_state_));
+    backend_ = h.backend_;
+    state_   = h.state_;
 
     return *this;
 }
 
 void SetHash::SetHashImpl::add_element(const std::string& in)
 {
-    std::array<uint8_t, crypto_core_ed25519_BYTES> p;
+    ed25519::ge25519_p3 p;
     SetHash::SetHashImpl::gen_curve_point(
-        p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
+        backend_, p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
+
+    ed25519::ge25519_add(state_, state_, p);
+}
+
+void SetHash::SetHashImpl::add_element(const std::string& in,
+                                       const uint64_t     count)
+{
+    ed25519::ge25519_p3 p;
+    SetHash::SetHashImpl::gen_curve_point(
+        backend_, p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
+
+    ed25519::ge25519_scalarmult_u64(p, p, count);
+    ed25519::ge25519_add(state_, state_, p);
+}
+
+void SetHash::SetHashImpl::add_counts(
+    const std::map<std::string, uint64_t>& counts)
+{
+    std::vector<ed25519::ge25519_p3> points(counts.size());
+    std::vector<uint64_t>            scalars(counts.size());
+
+    size_t i = 0;
+    for (const auto& c : counts) {
+        SetHash::SetHashImpl::gen_curve_point(
+            backend_,
+            points[i],
+            reinterpret_cast<const uint8_t*>(c.first.data()),
+            c.first.size());
+        scalars[i] = c.second;
+        i++;
+    }
 
-    crypto_core_ed25519_add(ellig_state_, ellig_state_, p.data());
+    ed25519::ge25519_p3 sum;
+    ed25519::ge25519_multi_scalarmult_u64(
+        sum, points.data(), scalars.data(), points.size());
+    ed25519::ge25519_add(state_, state_, sum);
+}
+
+void SetHash::SetHashImpl::add_elements(const uint8_t* const* elements,
+                                        const size_t*         lengths,
+                                        const size_t          n)
+{
+    const size_t hash_len = (backend_ == Backend::kRistretto255)
+                                ? crypto_core_ristretto255_HASHBYTES
+                                : crypto_core_ed25519_UNIFORMBYTES;
+
+    std::vector<uint8_t> hashes(std::min(n, kBatchSize) * hash_len);
+    ed25519::ge25519_p3  p;
+
+    for (size_t i = 0; i < n; i += kBatchSize) {
+        const size_t m = std::min(n - i, kBatchSize);
+
+        // the elements are hashed with the multi-buffer hash function
+        sse::crypto::Hash::hash_many(
+            elements + i, lengths + i, m, hash_len, hashes.data());
+
+        if (backend_ == Backend::kRistretto255) {
+            // the Ristretto255 map has no inversion to batch
+            for (size_t j = 0; j < m; j++) {
+                ed25519::ristretto255_from_hash(p,
+                                                hashes.data() + j * hash_len);
+                ed25519::ge25519_add(state_, state_, p);
+            }
+        } else {
+            ed25519::ge25519_from_uniform_sum(p, hashes.data(), m);
+            ed25519::ge25519_add(state_, state_, p);
+        }
+    }
 }
 
 void SetHash::SetHashImpl::add_set(const SetHash::SetHashImpl* in)
 {
-    crypto_core_ed25519_add(ellig_state_, ellig_state_, in->ellig_state_);
+    check_backends(backend_, in->backend_);
+    ed25519::ge25519_add(state_, state_, in->state_);
 }
 
 void SetHash::SetHashImpl::remove_element(const std::string& in)
 {
-    std::array<uint8_t, crypto_core_ed25519_BYTES> p;
+    ed25519::ge25519_p3 p;
+    SetHash::SetHashImpl::gen_curve_point(
+        backend_, p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
+
+    ed25519::ge25519_sub(state_, state_, p);
+}
+
+void SetHash::SetHashImpl::remove_element(const std::string& in,
+                                          const uint64_t     count)
+{
+    ed25519::ge25519_p3 p;
     SetHash::SetHashImpl::gen_curve_point(
-        p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
+        backend_, p, reinterpret_cast<const uint8_t*>(in.data()), in.size());
 
-    crypto_core_ed25519_sub(ellig_state_, ellig_state_, p.data());
+    ed25519::ge25519_scalarmult_u64(p, p, count);
+    ed25519::ge25519_sub(state_, state_, p);
 }
 
 void SetHash::SetHashImpl::remove_set(const SetHash::SetHashImpl* in)
 {
-    crypto_core_ed25519_sub(ellig_state_, ellig_state_, in->ellig_state_);
+    check_backends(backend_, in->backend_);
+    ed25519::ge25519_sub(state_, state_, in->state_);
 }
 
 std::array<uint8_t, SetHash::kSetHashSize> SetHash::SetHashImpl::data() const
 {
     std::array<uint8_t, kSetHashSize> bytes;
-    memcpy(bytes.data(), ellig_state_, kSetHashSize);
+    if (backend_ == Backend::kRistretto255) {
+        ed25519::ristretto255_tobytes(bytes.data(), state_);
+    } else {
+        ed25519::ge25519_tobytes(bytes.data(), state_);
+    }
+
+    return bytes;
+}
+
+std::array<uint8_t, SetHash::kSerializedSize> SetHash::SetHashImpl::serialize()
+    const
+{
+    std::array<uint8_t, kSerializedSize> bytes;
+    if (backend_ == Backend::kRistretto255) {
+        bytes[0] = ristretto255_serialization_tag__;
+        ed25519::ristretto255_tobytes(bytes.data() + 1, state_);
+    } else {
+        bytes[0] = ed25519_serialization_tag__;
+        ed25519::ge25519_tobytes(bytes.data() + 1, state_);
+    }
 
     return bytes;
 }
 
 bool SetHash::SetHashImpl::operator==(const SetHash::SetHashImpl& h) const
 {
-    return sodium_memcmp(
-               ellig_state_, h.ellig_state_, crypto_core_ed25519_BYTES)
-           == 0;
+    if (backend_ != h.backend_) {
+        return false;
+    }
+    // compare the points, without encoding them
+    if (backend_ == Backend::kRistretto255) {
+        return ed25519::ristretto255_is_equal(state_, h.state_) == 1;
+    }
+    return ed25519::ge25519_is_equal(state_, h.state_) == 1;
+}
+
+//
+//
+// ConcurrentSetHash
+//
+//
+
+class ConcurrentSetHash::ConcurrentSetHashImpl
+{
+public:
+    explicit ConcurrentSetHashImpl(const SetHash::Backend backend);
+
+    inline SetHash::Backend backend() const noexcept
+    {
+        return backend_;
+    }
+
+    void add(const ed25519::ge25519_p3& p);
+    void sub(const ed25519::ge25519_p3& p);
+
+    ed25519::ge25519_p3 sum() const;
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+    static constexpr size_t kShardWords    = 4 * 5;
+
+    static_assert(sizeof(ed25519::ge25519_p3)
+                      == kShardWords * sizeof(uint64_t),
+                  "Invalid ge25519_p3 size");
+
+    // Partial sum of a thread. It is only written by its thread: seq is odd
+    // while the update is in progress, and readers retry when it changed.
+    // Shards are allocated separately, and the padding keeps two shards
+    // (updated by different threads) out of the same cache line.
+    struct Shard
+    {
+        uint8_t               padding_begin[kCacheLineSize];
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> words[kShardWords];
+        uint8_t               padding_end[kCacheLineSize];
+
+        Shard();
+        void                store(const ed25519::ge25519_p3& p);
+        ed25519::ge25519_p3 load_owned() const;
+        ed25519::ge25519_p3 load() const;
+    };
+
+    Shard* local_shard();
+
+    const SetHash::Backend backend_;
+
+    // distinguishes the accumulators in the threads' shard cache: addresses
+    // can be reused, identifiers are not
+    const uint64_t id_;
+
+    mutable std::mutex                          shards_mtx_;
+    std::vector<std::unique_ptr<Shard>>         shards_;
+    std::unordered_map<std::thread::id, Shard*> thread_shards_;
+
+    static std::atomic<uint64_t> next_id__;
+};
+
+constexpr size_t ConcurrentSetHash::ConcurrentSetHashImpl::kCacheLineSize;
+constexpr size_t ConcurrentSetHash::ConcurrentSetHashImpl::kShardWords;
+std::atomic<uint64_t> ConcurrentSetHash::ConcurrentSetHashImpl::next_id__(1);
+
+ConcurrentSetHash::ConcurrentSetHash()
+    : concurrent_set_hash_imp_(
+        new ConcurrentSetHashImpl(SetHash::Backend::kEd25519))
+{
+}
+
+ConcurrentSetHash::ConcurrentSetHash(const SetHash::Backend backend)
+    : concurrent_set_hash_imp_(new ConcurrentSetHashImpl(backend))
+{
+}
+
+ConcurrentSetHash::~ConcurrentSetHash()
+{
+    delete concurrent_set_hash_imp_;
+}
+
+void ConcurrentSetHash::add_element(const std::string& in)
+{
+    ed25519::ge25519_p3 p;
+    SetHash::SetHashImpl::gen_curve_point(
+        concurrent_set_hash_imp_->backend(),
+        p,
+        reinterpret_cast<const uint8_t*>(in.data()),
+        in.size());
+
+    concurrent_set_hash_imp_->add(p);
+}
+
+void ConcurrentSetHash::add_set(const SetHash& h)
+{
+    SetHash::SetHashImpl::check_backends(concurrent_set_hash_imp_->backend(),
+                                         h.backend());
+    concurrent_set_hash_imp_->add(h.set_hash_imp_->state_);
+}
+
+void ConcurrentSetHash::remove_element(const std::string& in)
+{
+    ed25519::ge25519_p3 p;
+    SetHash::SetHashImpl::gen_curve_point(
+        concurrent_set_hash_imp_->backend(),
+        p,
+        reinterpret_cast<const uint8_t*>(in.data()),
+        in.size());
+
+    concurrent_set_hash_imp_->sub(p);
+}
+
+void ConcurrentSetHash::remove_set(const SetHash& h)
+{
+    SetHash::SetHashImpl::check_backends(concurrent_set_hash_imp_->backend(),
+                                         h.backend());
+    concurrent_set_hash_imp_->sub(h.set_hash_imp_->state_);
+}
+
+SetHash ConcurrentSetHash::snapshot() const
+{
+    SetHash h(concurrent_set_hash_imp_->backend());
+    h.set_hash_imp_->state_ = concurrent_set_hash_imp_->sum();
+
+    return h;
+}
+
+ConcurrentSetHash::ConcurrentSetHashImpl::Shard::Shard() : seq(0)
+{
+    ed25519::ge25519_p3 identity;
+    ed25519::ge25519_identity(identity);
+    store(identity);
+}
+
+void ConcurrentSetHash::ConcurrentSetHashImpl::Shard::store(
+    const ed25519::ge25519_p3& p)
+{
+    uint64_t p_words[kShardWords];
+    memcpy(p_words, &p, sizeof(p_words));
+
+    const uint64_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < kShardWords; i++) {
+        words[i].store(p_words[i], std::memory_order_relaxed);
+    }
+    seq.store(s + 2, std::memory_order_release);
+}
+
+// only called by the owner: there cannot be any concurrent write
+ed25519::ge25519_p3
+ConcurrentSetHash::ConcurrentSetHashImpl::Shard::load_owned() const
+{
+    uint64_t p_words[kShardWords];
+    for (size_t i = 0; i < kShardWords; i++) {
+        p_words[i] = words[i].load(std::memory_order_relaxed);
+    }
+
+    ed25519::ge25519_p3 p;
+    memcpy(&p, p_words, sizeof(p));
+    return p;
+}
+
+ed25519::ge25519_p3 ConcurrentSetHash::ConcurrentSetHashImpl::Shard::load()
+    const
+{
+    uint64_t p_words[kShardWords];
+    uint64_t s_begin, s_end;
+
+    do {
+        s_begin = seq.load(std::memory_order_acquire);
+        for (size_t i = 0; i < kShardWords; i++) {
+            p_words[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        s_end = seq.load(std::memory_order_relaxed);
+    } while ((s_begin & 1) != 0 || s_begin != s_end);
+
+    ed25519::ge25519_p3 p;
+    memcpy(&p, p_words, sizeof(p));
+    return p;
+}
+
+ConcurrentSetHash::ConcurrentSetHashImpl::ConcurrentSetHashImpl(
+    const SetHash::Backend backend)
+    : backend_(backend), id_(next_id__.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+ConcurrentSetHash::ConcurrentSetHashImpl::Shard*
+ConcurrentSetHash::ConcurrentSetHashImpl::local_shard()
+{
+    // Cache of the last accumulator used by the thread (a thread alternating
+    // between several accumulators goes through the mutex). The shards are
+    // only deleted with their accumulator, whose identifier is never reused.
+    static thread_local uint64_t cached_id    = 0;
+    static thread_local Shard*   cached_shard = nullptr;
+
+    if (cached_id == id_) {
+        return cached_shard;
+    }
+
+    std::lock_guard<std::mutex> lock(shards_mtx_);
+
+    Shard*& shard = thread_shards_[std::this_thread::get_id()];
+    if (shard == nullptr) {
+        shards_.emplace_back(new Shard());
+        shard = shards_.back().get();
+    }
+    cached_id    = id_;
+    cached_shard = shard;
+
+    return shard;
+}
+
+void ConcurrentSetHash::ConcurrentSetHashImpl::add(
+    const ed25519::ge25519_p3& p)
+{
+    Shard*              shard = local_shard();
+    ed25519::ge25519_p3 sum   = shard->load_owned();
+
+    ed25519::ge25519_add(sum, sum, p);
+    shard->store(sum);
+}
+
+void ConcurrentSetHash::ConcurrentSetHashImpl::sub(
+    const ed25519::ge25519_p3& p)
+{
+    Shard*              shard = local_shard();
+    ed25519::ge25519_p3 sum   = shard->load_owned();
+
+    ed25519::ge25519_sub(sum, sum, p);
+    shard->store(sum);
+}
+
+ed25519::ge25519_p3 ConcurrentSetHash::ConcurrentSetHashImpl::sum() const
+{
+    ed25519::ge25519_p3 sum;
+    ed25519::ge25519_identity(sum);
+
+    // the shards are never removed: their address does not change once they
+    // have been added
+    std::vector<const Shard*> shards;
+    {
+        std::lock_guard<std::mutex> lock(shards_mtx_);
+        for (const auto& shard : shards_) {
+            shards.push_back(shard.get());
+        }
+    }
+
+    for (const Shard* shard : shards) {
+        ed25519::ge25519_add(sum, sum, shard->load());
+    }
+    return sum;
 }
 
 } // namespace crypto
@@ -21,7 +21,10 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace sse {
@@ -44,7 +47,10 @@ namespace crypto {
 /// This implementation uses the elliptic curve multiset hash (ECMH) by by
 /// Maitin-Shepard, Tibouchi and Aranha (see https://arxiv.org/abs/1601.06502 )
 /// implemented on Ed25519 using libsodium's Elligator primitives introduced in
-/// libsodium 1.0.16
+/// libsodium 1.0.16, or on the Ristretto255 group (see SetHash::Backend).
+/// The hash is kept as a point in extended coordinates, so that additions and
+/// removals do not need any field inversion: the point is only encoded by
+/// data(), serialize() (and the stream operator).
 ///
 /// The sets that can be hashed are sets of std::string.
 ///
@@ -53,13 +59,51 @@ class SetHash
 public:
     /// @brief Size of the bytes representation of a SetHash
     static constexpr size_t kSetHashSize = 32;
+    /// @brief Size of the versioned serialization of a SetHash
+    static constexpr size_t kSerializedSize = kSetHashSize + 1;
+
+    ///
+    /// @brief Group in which the elements are hashed
+    ///
+    /// Hashes computed with different backends cannot be combined or
+    /// compared.
+    ///
+    /// kEd25519 is the original construction: the elements are hashed with
+    /// BLAKE2b (truncated to 32 bytes), mapped to the Ed25519 curve with
+    /// Elligator 2 (crypto_core_ed25519_from_uniform), and the result is
+    /// multiplied by the cofactor. The empty set is encoded by a point that is
+    /// not a valid libsodium point, and must be special-cased.
+    ///
+    /// kRistretto255 hashes the elements with BLAKE2b (the full 64 bytes
+    /// digest), and maps them to the Ristretto255 group as
+    /// crypto_core_ristretto255_from_hash does. Ristretto255 has prime order
+    /// and its encodings are canonical: every 32 bytes string encodes at most
+    /// one group element, including the empty set's hash (the all-zero
+    /// string). It is the recommended backend for new digests.
+    ///
+    enum class Backend : uint8_t
+    {
+        kEd25519,     ///< ECMH on Ed25519
+        kRistretto255 ///< ECMH on Ristretto255
+    };
+
     ///
     /// @brief Constructor
     ///
-    /// Creates and initializes a SetHash for an empty set.
+    /// Creates and initializes a SetHash for an empty set, using the kEd25519
+    /// backend.
     ///
     SetHash();
 
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates and initializes a SetHash for an empty set.
+    ///
+    /// @param backend  The group in which the elements are hashed.
+    ///
+    explicit SetHash(const Backend backend);
+
     ///
     /// @brief Constructor
     ///
@@ -70,6 +114,19 @@ public:
     ///
     explicit SetHash(const std::array<uint8_t, kSetHashSize>& bytes);
 
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a new SetHash from its versioned serialization (see
+    /// serialize()).
+    ///
+    /// @param bytes    A serialized set hash.
+    ///
+    /// @exception std::invalid_argument    The version is unknown, or bytes
+    ///                                     does not encode a group element.
+    ///
+    explicit SetHash(const std::array<uint8_t, kSerializedSize>& bytes);
+
     ///
     /// @brief Copy constructor
     ///
@@ -89,6 +146,52 @@ public:
     ///
     explicit SetHash(const std::vector<std::string>& in_set);
 
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a new SetHash representing a vector (list) of strings
+    ///
+    /// @param in_set   The elements to be hashed.
+    /// @param backend  The group in which the elements are hashed.
+    ///
+    SetHash(const std::vector<std::string>& in_set, const Backend backend);
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a new SetHash representing the elements of the range
+    /// [first, last). The elements are not copied: the range can be a range
+    /// of std::string, but also of std::string_view, std::vector<uint8_t>, or
+    /// of any type with data() and size() members describing the element's
+    /// bytes.
+    ///
+    /// The elements are hashed and mapped to the group by batches, which is
+    /// faster than adding them one by one.
+    ///
+    /// @tparam ForwardIt   The iterator type.
+    ///
+    /// @param first    The first element to be hashed.
+    /// @param last     The end of the range of elements.
+    /// @param backend  The group in which the elements are hashed.
+    ///
+    template<class ForwardIt,
+             class = decltype(std::declval<ForwardIt&>()->data()
+                              + std::declval<ForwardIt&>()->size())>
+    SetHash(ForwardIt     first,
+            ForwardIt     last,
+            const Backend backend = Backend::kEd25519)
+        : SetHash(backend)
+    {
+        std::vector<const uint8_t*> elements;
+        std::vector<size_t>         lengths;
+        for (; first != last; ++first) {
+            elements.push_back(
+                reinterpret_cast<const uint8_t*>(first->data()));
+            lengths.push_back(first->size());
+        }
+        add_elements(elements.data(), lengths.data(), elements.size());
+    }
+
     ///
     /// @brief Destructor
     ///
@@ -104,6 +207,31 @@ public:
     ///
     void add_element(const std::string& in);
 
+    ///
+    /// @brief Hash several copies of an element in the (multi)set hash
+    ///
+    /// Compute the hash of \f$S \cup \{in, \ldots, in\} \f$ (count
+    /// copies of in) where S is the multiset represented by the object. The
+    /// result is the same as calling add_element(in) count times, but the
+    /// element is hashed once, and its point is multiplied by count:
+    /// \f$O(\log count)\f$ group operations instead of count.
+    ///
+    /// @param in       The element to insert
+    /// @param count    The number of copies to insert
+    ///
+    void add_element(const std::string& in, const uint64_t count);
+
+    ///
+    /// @brief Hash several elements with multiplicities
+    ///
+    /// Same as calling add_element(e, c) for every pair (e, c) in counts, but
+    /// the doublings of the scalar multiplications are shared by all the
+    /// elements.
+    ///
+    /// @param counts   The elements to insert, with their number of copies
+    ///
+    void add_counts(const std::map<std::string, uint64_t>& counts);
+
     ///
     /// @brief Compute the hash of a union
     ///
@@ -112,6 +240,8 @@ public:
     ///
     /// @param h    The set hash of the set to insert in the target object
     ///
+    /// @exception std::invalid_argument    h uses another backend.
+    ///
     void add_set(const SetHash& h);
 
 
@@ -125,6 +255,17 @@ public:
     ///
     void remove_element(const std::string& in);
 
+    ///
+    /// @brief Remove several copies of an element of the (multi)set hash
+    ///
+    /// Same as calling remove_element(in) count times, with one scalar
+    /// multiplication.
+    ///
+    /// @param in       The element to remove
+    /// @param count    The number of copies to remove
+    ///
+    void remove_element(const std::string& in, const uint64_t count);
+
     ///
     /// @brief Compute the hash of a set difference
     ///
@@ -133,6 +274,8 @@ public:
     ///
     /// @param h    The set hash of the set to remove from the target object
     ///
+    /// @exception std::invalid_argument    h uses another backend.
+    ///
     void remove_set(const SetHash& h);
 
     ///
@@ -145,6 +288,24 @@ public:
     ///
     std::array<uint8_t, kSetHashSize> data() const;
 
+    ///
+    /// @brief Versioned binary representation of the SetHash
+    ///
+    /// The first byte identifies the format, and hence the backend: 0x01 for
+    /// kEd25519, 0x02 for kRistretto255. It is followed by the kSetHashSize
+    /// bytes returned by data().
+    ///
+    /// @return The serialized set hash
+    ///
+    std::array<uint8_t, kSerializedSize> serialize() const;
+
+    ///
+    /// @brief Get the backend
+    ///
+    /// @return The group in which the elements are hashed.
+    ///
+    Backend backend() const noexcept;
+
 
     ///
     /// @brief Stream serialization operator
@@ -170,7 +331,8 @@ public:
     /// @brief Comparison operator
     ///
     /// @param h    The element to compare
-    /// @return     true if h and the object have the same hash, false otherwise
+    /// @return     true if h and the object have the same backend and the same
+    ///             hash, false otherwise
     ///
     bool operator==(const SetHash& h) const;
 
@@ -183,9 +345,116 @@ public:
     bool operator!=(const SetHash& h) const;
 
 private:
+    friend class ConcurrentSetHash;
+
+    // adds the n elements (elements[i], lengths[i]) by batches
+    void add_elements(const uint8_t* const* elements,
+                      const size_t*         lengths,
+                      const size_t          n);
+
     class SetHashImpl;          // not defined in the header
     SetHashImpl* set_hash_imp_; // opaque pointer
 };
 
+///
+/// @class ConcurrentSetHash
+/// @brief Set hash accumulator shared by concurrent writers
+///
+/// A ConcurrentSetHash computes the same hash as SetHash, but elements can be
+/// added and removed from any number of threads without external
+/// synchronization.
+///
+/// Every thread updating the accumulator gets its own shard, holding the sum
+/// of the elements the thread added (minus the ones it removed). A shard is
+/// only written by its thread, and is published with a sequence lock: apart
+/// from the first update of a thread, which registers its shard, updates never
+/// wait, neither for other writers nor for readers. The shards are folded
+/// (with the semantics of SetHash::add_set) by snapshot().
+///
+class ConcurrentSetHash
+{
+public:
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates an accumulator for the empty set, using the kEd25519 backend.
+    ///
+    ConcurrentSetHash();
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates an accumulator for the empty set.
+    ///
+    /// @param backend  The group in which the elements are hashed.
+    ///
+    explicit ConcurrentSetHash(const SetHash::Backend backend);
+
+    ///
+    /// @brief Destructor
+    ///
+    /// No other thread must be using the accumulator when it is destroyed.
+    ///
+    ~ConcurrentSetHash();
+
+    ConcurrentSetHash(const ConcurrentSetHash&) = delete;
+    ConcurrentSetHash& operator=(const ConcurrentSetHash&) = delete;
+
+    ///
+    /// @brief Hash a new element in the set hash
+    ///
+    /// Thread-safe.
+    ///
+    /// @param in   The element to insert
+    ///
+    void add_element(const std::string& in);
+
+    ///
+    /// @brief Compute the hash of a union
+    ///
+    /// Thread-safe.
+    ///
+    /// @param h    The set hash of the set to insert
+    ///
+    /// @exception std::invalid_argument    h uses another backend.
+    ///
+    void add_set(const SetHash& h);
+
+    ///
+    /// @brief Remove an element of the set hash
+    ///
+    /// Thread-safe.
+    ///
+    /// @param in   The element to remove
+    ///
+    void remove_element(const std::string& in);
+
+    ///
+    /// @brief Compute the hash of a set difference
+    ///
+    /// Thread-safe.
+    ///
+    /// @param h    The set hash of the set to remove
+    ///
+    /// @exception std::invalid_argument    h uses another backend.
+    ///
+    void remove_set(const SetHash& h);
+
+    ///
+    /// @brief Current value of the hash
+    ///
+    /// Folds the shards of all the threads. The result accounts for all the
+    /// updates that returned before the call to snapshot(). Updates running
+    /// concurrently with snapshot() may or may not be accounted for.
+    ///
+    /// @return The set hash of the current set
+    ///
+    SetHash snapshot() const;
+
+private:
+    class ConcurrentSetHashImpl; // not defined in the header
+    ConcurrentSetHashImpl* concurrent_set_hash_imp_; // opaque pointer
+};
+
 } // namespace crypto
 } // namespace sse
@@ -0,0 +1,370 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "small_domain_prp.hpp"
+
+#include "prp.hpp"
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+#include "aez/aez.h"
+#endif
+
+#include <cstring>
+
+#include <exception>
+#include <stdexcept>
+
+namespace sse {
+
+namespace crypto {
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+class SmallDomainPrp::SmallDomainPrpImpl
+{
+public:
+    SmallDomainPrpImpl(Key<kKeySize>&& k, const uint64_t domain_size);
+
+    inline uint64_t domain_size() const noexcept
+    {
+        return domain_size_;
+    }
+
+    template<class Input>
+    void evaluate(const Input& input,
+                  const size_t n,
+                  uint64_t*    out,
+                  const bool   inverse) const;
+
+private:
+    // number of values walked through the Feistel network simultaneously
+    static constexpr size_t kLanes = 8;
+
+    void feistel(uint64_t*        lanes,
+                 const size_t     n_lanes,
+                 const aez_ctx_t* ctx,
+                 const bool       inverse) const;
+
+    Key<sizeof(aez_ctx_t)> aez_ctx_;
+
+    const uint64_t domain_size_;
+    unsigned       half_bits_;
+    uint64_t       half_mask_;
+
+    // common part of the round function inputs
+    uint8_t tweak_[16];
+};
+
+#else
+#warning SmallDomainPrp is not available without CPU support for AES
+
+class SmallDomainPrp::SmallDomainPrpImpl
+{
+public:
+    SmallDomainPrpImpl(Key<kKeySize>&& k, const uint64_t domain_size){};
+
+    inline uint64_t domain_size() const noexcept
+    {
+        return 0;
+    }
+
+    template<class Input>
+    void evaluate(const Input& input,
+                  const size_t n,
+                  uint64_t*    out,
+                  const bool   inverse) const {};
+};
+#endif /* __AES__ || __ARM_FEATURE_CRYPTO */
+
+bool SmallDomainPrp::is_available() noexcept
+{
+    return Prp::is_available();
+}
+
+SmallDomainPrp::SmallDomainPrp(const uint64_t domain_size)
+    : SmallDomainPrp(Key<kKeySize>(), domain_size)
+{
+}
+
+SmallDomainPrp::SmallDomainPrp(Key<kKeySize>&& k, const uint64_t domain_size)
+    : prp_imp_(SmallDomainPrp::is_available()
+                   ? new SmallDomainPrpImpl(std::move(k), domain_size)
+                   : nullptr)
+{
+    if (!SmallDomainPrp::is_available()) {
+        throw std::runtime_error("PRP is unavailable: AES hardware "
+                                 "acceleration not supported by the CPU");
+    }
+}
+
+SmallDomainPrp::~SmallDomainPrp()
+{
+    delete prp_imp_;
+}
+
+uint64_t SmallDomainPrp::domain_size() const noexcept
+{
+    return prp_imp_->domain_size();
+}
+
+uint64_t SmallDomainPrp::encrypt(const uint64_t in) const
+{
+    uint64_t out;
+    encrypt(&in, 1, &out);
+    return out;
+}
+
+void SmallDomainPrp::encrypt(const uint64_t* in,
+                             const size_t    n,
+                             uint64_t*       out) const
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (in[i] >= prp_imp_->domain_size()) {
+            throw std::invalid_argument("Input out of the permutation domain");
+        }
+    }
+    prp_imp_->evaluate([in](size_t i) { return in[i]; }, n, out, false);
+}
+
+std::vector<uint64_t> SmallDomainPrp::encrypt(
+    const std::vector<uint64_t>& in) const
+{
+    std::vector<uint64_t> out(in.size());
+    encrypt(in.data(), in.size(), out.data());
+    return out;
+}
+
+uint64_t SmallDomainPrp::decrypt(const uint64_t in) const
+{
+    uint64_t out;
+    decrypt(&in, 1, &out);
+    return out;
+}
+
+void SmallDomainPrp::decrypt(const uint64_t* in,
+                             const size_t    n,
+                             uint64_t*       out) const
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument("in and out must not be NULL");
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (in[i] >= prp_imp_->domain_size()) {
+            throw std::invalid_argument("Input out of the permutation domain");
+        }
+    }
+    prp_imp_->evaluate([in](size_t i) { return in[i]; }, n, out, true);
+}
+
+std::vector<uint64_t> SmallDomainPrp::decrypt(
+    const std::vector<uint64_t>& in) const
+{
+    std::vector<uint64_t> out(in.size());
+    decrypt(in.data(), in.size(), out.data());
+    return out;
+}
+
+void SmallDomainPrp::permutation(const uint64_t first,
+                                 const size_t   n,
+                                 uint64_t*      out) const
+{
+    if (n > 0 && out == nullptr) {
+        throw std::invalid_argument("out must not be NULL");
+    }
+    if (n > prp_imp_->domain_size() || first > prp_imp_->domain_size() - n) {
+        throw std::invalid_argument("Range out of the permutation domain");
+    }
+    prp_imp_->evaluate(
+        [first](size_t i) { return first + i; }, n, out, false);
+}
+
+std::vector<uint64_t> SmallDomainPrp::permutation() const
+{
+    std::vector<uint64_t> out;
+    if (prp_imp_->domain_size() > out.max_size()) {
+        throw std::length_error(
+            "The permutation domain is too large to be materialized");
+    }
+    out.resize(static_cast<size_t>(prp_imp_->domain_size()));
+    permutation(0, out.size(), out.data());
+    return out;
+}
+
+#if __AES__ || __ARM_FEATURE_CRYPTO
+
+static inline void store32_le(uint8_t* dst, const uint64_t x)
+{
+    dst[0] = static_cast<uint8_t>(x);
+    dst[1] = static_cast<uint8_t>(x >> 8);
+    dst[2] = static_cast<uint8_t>(x >> 16);
+    dst[3] = static_cast<uint8_t>(x >> 24);
+}
+
+static inline uint64_t load32_le(const uint8_t* src)
+{
+    return static_cast<uint64_t>(src[0])
+           | (static_cast<uint64_t>(src[1]) << 8)
+           | (static_cast<uint64_t>(src[2]) << 16)
+           | (static_cast<uint64_t>(src[3]) << 24);
+}
+
+SmallDomainPrp::SmallDomainPrpImpl::SmallDomainPrpImpl(
+    Key<kKeySize>&& k,
+    const uint64_t  domain_size)
+    : domain_size_(domain_size)
+{
+    if (domain_size == 0) {
+        throw std::invalid_argument("The permutation domain must not be empty");
+    }
+
+    // 2*half_bits_ is the smallest even number of bits needed to represent
+    // the elements of [0, N): 2^(2*half_bits_) < 4N
+    unsigned bits = 0;
+    for (uint64_t m = domain_size - 1; m != 0; m >>= 1) {
+        bits++;
+    }
+    half_bits_ = (bits <= 2) ? 1 : (bits + 1) / 2;
+    half_mask_ = (1ULL << half_bits_) - 1;
+
+    // the round function input is
+    // N (8 bytes, LE) || half (4 bytes, LE) || round || half_bits_ || 0 || 0
+    memset(tweak_, 0x00, sizeof(tweak_));
+    for (size_t i = 0; i < 8; i++) {
+        tweak_[i] = static_cast<uint8_t>(domain_size >> (8 * i));
+    }
+    tweak_[13] = static_cast<uint8_t>(half_bits_);
+
+    auto callback = [&k](uint8_t* key_content) {
+        aez_setup(static_cast<const unsigned char*>(k.unlock_get()),
+                  kKeySize,
+                  reinterpret_cast<aez_ctx_t*>(key_content));
+    };
+
+    aez_ctx_ = Key<sizeof(aez_ctx_t)>(callback);
+    k.erase();
+}
+
+void SmallDomainPrp::SmallDomainPrpImpl::feistel(uint64_t*        lanes,
+                                                 const size_t     n_lanes,
+                                                 const aez_ctx_t* ctx,
+                                                 const bool inverse) const
+{
+    uint64_t left[kLanes];
+    uint64_t right[kLanes];
+    alignas(16) uint8_t blocks[16 * kLanes];
+
+    for (size_t l = 0; l < n_lanes; l++) {
+        left[l]  = lanes[l] >> half_bits_;
+        right[l] = lanes[l] & half_mask_;
+    }
+
+    for (unsigned r = 0; r < kRounds; r++) {
+        const uint8_t round
+            = static_cast<uint8_t>(inverse ? kRounds - 1 - r : r);
+
+        for (size_t l = 0; l < n_lanes; l++) {
+            uint8_t* b = blocks + 16 * l;
+            memcpy(b, tweak_, sizeof(tweak_));
+            store32_le(b + 8, inverse ? left[l] : right[l]);
+            b[12] = round;
+        }
+
+        aez_aes10_blocks(ctx,
+                         reinterpret_cast<const char*>(blocks),
+                         static_cast<unsigned>(n_lanes),
+                         reinterpret_cast<char*>(blocks));
+
+        for (size_t l = 0; l < n_lanes; l++) {
+            const uint64_t f = load32_le(blocks + 16 * l) & half_mask_;
+            if (inverse) {
+                // (L, R) <- (R ^ F(L), L)
+                const uint64_t tmp = left[l];
+                left[l]            = right[l] ^ f;
+                right[l]           = tmp;
+            } else {
+                // (L, R) <- (R, L ^ F(R))
+                const uint64_t tmp = right[l];
+                right[l]           = left[l] ^ f;
+                left[l]            = tmp;
+            }
+        }
+    }
+
+    for (size_t l = 0; l < n_lanes; l++) {
+        lanes[l] = (left[l] << half_bits_) | right[l];
+    }
+}
+
+template<class Input>
+void SmallDomainPrp::SmallDomainPrpImpl::evaluate(const Input& input,
+                                                  const size_t n,
+                                                  uint64_t*    out,
+                                                  const bool   inverse) const
+{
+    const aez_ctx_t* ctx
+        = reinterpret_cast<const aez_ctx_t*>(aez_ctx_.unlock_get());
+
+    uint64_t lanes[kLanes];
+    size_t   dst[kLanes];
+    size_t   active = 0;
+    size_t   next   = 0;
+
+    for (; active < kLanes && next < n; active++, next++) {
+        lanes[active] = input(next);
+        dst[active]   = next;
+    }
+
+    // Cycle walking: a lane is run through the Feistel network until it
+    // falls back into [0, N). Lanes are refilled as soon as they are done, so
+    // that the batch does not wait for the longest walk. out is only written
+    // at indices that have already been read, hence in and out may alias.
+    while (active > 0) {
+        feistel(lanes, active, ctx, inverse);
+
+        size_t l = 0;
+        while (l < active) {
+            if (lanes[l] >= domain_size_) {
+                l++;
+                continue;
+            }
+            out[dst[l]] = lanes[l];
+            if (next < n) {
+                lanes[l] = input(next);
+                dst[l]   = next;
+                next++;
+                l++;
+            } else {
+                active--;
+                lanes[l] = lanes[active];
+                dst[l]   = dst[active];
+            }
+        }
+    }
+
+    aez_ctx_.lock();
+}
+
+#endif /* __AES__ || __ARM_FEATURE_CRYPTO */
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,251 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "key.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+/// @class SmallDomainPrp
+/// @brief Format-preserving random permutation over an integer range.
+///
+/// SmallDomainPrp is an opaque class implementing a pseudorandom permutation
+/// over the integer range [0, N), for any domain size 1 <= N <= 2^64-1. Prp
+/// only permutes byte strings: the usual workaround to get a permutation of
+/// [0, N) is to cycle-walk Prp::encrypt_64, which needs about 2^64/N AEZ
+/// calls per evaluation, and is unusable as soon as N is not close to 2^64.
+///
+/// SmallDomainPrp instead uses a balanced Feistel network over the smallest
+/// domain of 2b bits containing [0, N), combined with cycle walking. As
+/// 2^(2b) < 4N, the expected number of Feistel evaluations per call is less
+/// than 4. The construction follows the one of NIST's FF1 on binary strings:
+/// it uses kRounds = 10 rounds, the round function being AEZ's AES10 core
+/// (see aez_aes10_blocks) applied to the encoding of (N, b, round, half).
+///
+/// @warning    For very small domains, message recovery attacks against
+///             Feistel-based format-preserving encryption exist (Bellare,
+///             Hoang and Tessaro, CCS'16; Durak and Vaudenay,
+///             CRYPTO'17). NIST requires domains of at least 10^6 elements
+///             for FF1, and the same recommendation applies here.
+///
+/// As for Prp, SmallDomainPrp requires support of AES-NI (on x86 CPUs) or of
+/// ARM NEON instructions (on ARM CPUs). See the is_available static function.
+///
+
+class SmallDomainPrp
+{
+public:
+    /// @brief SmallDomainPrp key size (in bytes)
+    static constexpr uint8_t kKeySize = 48;
+
+    /// @brief Number of Feistel rounds
+    static constexpr unsigned kRounds = 10;
+
+    ///
+    /// @brief Check availability of the SmallDomainPrp class
+    ///
+    /// The SmallDomainPrp class is available iff the Prp class is.
+    ///
+    /// @return true if the SmallDomainPrp class can be used, false otherwise.
+    ///
+    static bool is_available() noexcept;
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a permutation of [0, domain_size) with a new randomly
+    /// generated key.
+    ///
+    /// @param domain_size  The size N of the permuted domain [0, N).
+    ///
+    /// @exception std::runtime_error       The SmallDomainPrp class is not
+    ///                                     available.
+    /// @exception std::invalid_argument    domain_size is 0.
+    ///
+    explicit SmallDomainPrp(const uint64_t domain_size);
+
+    ///
+    /// @brief Constructor
+    ///
+    /// Creates a permutation of [0, domain_size) from a 48 bytes (384 bits)
+    /// key. After a call to the constructor, the input key is held by the
+    /// SmallDomainPrp object, and cannot be re-used.
+    ///
+    /// @param k            The key used to initialize the permutation.
+    ///                     Upon return, k is empty
+    /// @param domain_size  The size N of the permuted domain [0, N).
+    ///
+    /// @exception std::runtime_error       The SmallDomainPrp class is not
+    ///                                     available.
+    /// @exception std::invalid_argument    domain_size is 0.
+    ///
+    SmallDomainPrp(Key<kKeySize>&& k, const uint64_t domain_size);
+
+    ///
+    /// @brief Destructor
+    ///
+    /// Destructs the SmallDomainPrp object and erase its key.
+    ///
+    ///
+    ~SmallDomainPrp();
+
+    // we should not be able to duplicate SmallDomainPrp objects
+    SmallDomainPrp(const SmallDomainPrp& c)  = delete;
+    SmallDomainPrp(SmallDomainPrp& c)        = delete;
+    SmallDomainPrp(const SmallDomainPrp&& c) = delete;
+    SmallDomainPrp(SmallDomainPrp&& c)       = delete;
+
+    ///
+    /// @brief Get the domain size
+    ///
+    /// @return The size N of the permuted domain [0, N).
+    ///
+    uint64_t domain_size() const noexcept;
+
+    ///
+    /// @brief Permutation evaluation
+    ///
+    /// Evaluates the pseudo random permutation on the input integer.
+    ///
+    /// @param in    The input of the permutation. Must be in [0, N).
+    /// @return      The evaluation of PRP(in), in [0, N).
+    ///
+    /// @exception std::invalid_argument    in is out of the domain.
+    ///
+    uint64_t encrypt(const uint64_t in) const;
+
+    ///
+    /// @brief Batch permutation evaluation
+    ///
+    /// Evaluates the pseudo random permutation on n integers. The evaluations
+    /// are interleaved so that several AES computations are in flight at the
+    /// same time, and the key is unlocked only once per batch. in and out can
+    /// point to the same array.
+    ///
+    /// @param in    The inputs of the permutation. Must be in [0, N).
+    /// @param n     The number of inputs.
+    /// @param out   The evaluations of PRP(in[i]), for 0 <= i < n.
+    ///
+    /// @exception std::invalid_argument    in or out is NULL, or one of the
+    ///                                     inputs is out of the domain.
+    ///
+    void encrypt(const uint64_t* in, const size_t n, uint64_t* out) const;
+
+    ///
+    /// @brief Batch permutation evaluation
+    ///
+    /// Evaluates the pseudo random permutation on a vector of integers.
+    ///
+    /// @param in    The inputs of the permutation. Must be in [0, N).
+    /// @return      The evaluations of PRP(in[i]).
+    ///
+    /// @exception std::invalid_argument    One of the inputs is out of the
+    ///                                     domain.
+    ///
+    std::vector<uint64_t> encrypt(const std::vector<uint64_t>& in) const;
+
+    ///
+    /// @brief Permutation inversion
+    ///
+    /// Inverts the pseudo random permutation on the input integer.
+    ///
+    /// @param in    The input of the inversion. Must be in [0, N).
+    /// @return      The evaluation of PRP^{-1}(in), in [0, N).
+    ///
+    /// @exception std::invalid_argument    in is out of the domain.
+    ///
+    uint64_t decrypt(const uint64_t in) const;
+
+    ///
+    /// @brief Batch permutation inversion
+    ///
+    /// Inverts the pseudo random permutation on n integers. in and out can
+    /// point to the same array.
+    ///
+    /// @param in    The inputs of the inversion. Must be in [0, N).
+    /// @param n     The number of inputs.
+    /// @param out   The evaluations of PRP^{-1}(in[i]), for 0 <= i < n.
+    ///
+    /// @exception std::invalid_argument    in or out is NULL, or one of the
+    ///                                     inputs is out of the domain.
+    ///
+    void decrypt(const uint64_t* in, const size_t n, uint64_t* out) const;
+
+    ///
+    /// @brief Batch permutation inversion
+    ///
+    /// Inverts the pseudo random permutation on a vector of integers.
+    ///
+    /// @param in    The inputs of the inversion. Must be in [0, N).
+    /// @return      The evaluations of PRP^{-1}(in[i]).
+    ///
+    /// @exception std::invalid_argument    One of the inputs is out of the
+    ///                                     domain.
+    ///
+    std::vector<uint64_t> decrypt(const std::vector<uint64_t>& in) const;
+
+    ///
+    /// @brief Partial permutation table
+    ///
+    /// Computes PRP(first), PRP(first+1), ..., PRP(first+n-1) without
+    /// materializing the inputs. Successive calls on consecutive ranges
+    /// can be used to stream the whole permutation in bounded memory.
+    ///
+    /// @param first The first input.
+    /// @param n     The number of evaluations.
+    /// @param out   The evaluations of PRP(first+i), for 0 <= i < n.
+    ///
+    /// @exception std::invalid_argument    out is NULL, or
+    ///                                     [first, first+n) is not included
+    ///                                     in the domain.
+    ///
+    void permutation(const uint64_t first, const size_t n, uint64_t* out) const;
+
+    ///
+    /// @brief Full permutation table
+    ///
+    /// Computes the whole permutation, i.e. the vector v such that
+    /// v[i] = PRP(i) for all i in [0, N).
+    ///
+    /// @return     The permutation table.
+    ///
+    /// @exception std::length_error    The domain does not fit in a vector.
+    ///
+    std::vector<uint64_t> permutation() const;
+
+    // Again, avoid any assignement of SmallDomainPrp objects
+    SmallDomainPrp& operator=(const SmallDomainPrp& h) = delete;
+    SmallDomainPrp& operator=(SmallDomainPrp& h) = delete;
+
+private:
+    class SmallDomainPrpImpl;     // not defined in the header
+    SmallDomainPrpImpl* prp_imp_; // opaque pointer
+};
+
+} // namespace crypto
+} // namespace sse
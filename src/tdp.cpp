@@ -22,13 +22,18 @@
 
 #include "prf.hpp"
 #include "random.hpp"
+#include "parallel/process_batch.hpp"
 #include "tdp_impl/tdp_impl.hpp"
 
 #include <cstring>
 
+#include <algorithm>
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #define SSE_CRYPTO_TDP_IMPL_MBEDTLS 1
 
@@ -83,6 +88,14 @@ using TdpMultPoolImpl_Current = TdpMultPoolImpl_mbedTLS;
 static_assert(Tdp::kMessageSize == TdpInverse::kMessageSize,
               "Constants kMessageSize of Tdp and TdpInverse do not match");
 
+static void check_batch_arguments(const void* in, const void* out, size_t n)
+{
+    if (n > 0 && (in == nullptr || out == nullptr)) {
+        throw std::invalid_argument(
+            "Invalid TDP batch: in or out is nullptr");
+    }
+}
+
 Tdp::Tdp(const std::string& pk) : tdp_imp_(new TdpImpl_Current(pk))
 {
 }
@@ -168,6 +181,36 @@ std::array<uint8_t, Tdp::kMessageSize> Tdp::eval(
     return tdp_imp_->eval(in);
 }
 
+void Tdp::eval_batch(const std::array<uint8_t, kMessageSize>* in,
+                     std::array<uint8_t, kMessageSize>*       out,
+                     const size_t                             n,
+                     const unsigned int threads) const
+{
+    check_batch_arguments(in, out, n);
+
+    const TdpImpl* imp = tdp_imp_;
+    process_batch(n, threads, [imp, in, out](size_t first, size_t count) {
+        imp->eval_batch(in + first, out + first, count);
+    });
+}
+
+std::vector<std::array<uint8_t, Tdp::kMessageSize>> Tdp::eval_batch(
+    const std::vector<std::array<uint8_t, kMessageSize>>& in,
+    const unsigned int                                    threads) const
+{
+    std::vector<std::array<uint8_t, kMessageSize>> out(in.size());
+    eval_batch(in.data(), out.data(), in.size(), threads);
+
+    return out;
+}
+
+void Tdp::eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                    const size_t                             n,
+                    const Tdp::ChainCallback&                callback) const
+{
+    tdp_imp_->eval_chain(start, n, callback);
+}
+
 TdpInverse::TdpInverse() : tdp_inv_imp_(new TdpInverseImpl_Current())
 {
 }
@@ -246,6 +289,29 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::eval(
     return tdp_inv_imp_->eval(in);
 }
 
+void TdpInverse::eval_batch(const std::array<uint8_t, kMessageSize>* in,
+                            std::array<uint8_t, kMessageSize>*       out,
+                            const size_t                             n,
+                            const unsigned int threads) const
+{
+    check_batch_arguments(in, out, n);
+
+    const TdpInverseImpl* imp = tdp_inv_imp_;
+    process_batch(n, threads, [imp, in, out](size_t first, size_t count) {
+        imp->eval_batch(in + first, out + first, count);
+    });
+}
+
+std::vector<std::array<uint8_t, TdpInverse::kMessageSize>> TdpInverse::
+    eval_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+               const unsigned int threads) const
+{
+    std::vector<std::array<uint8_t, kMessageSize>> out(in.size());
+    eval_batch(in.data(), out.data(), in.size(), threads);
+
+    return out;
+}
+
 void TdpInverse::invert(const std::string& in, std::string& out) const
 {
     tdp_inv_imp_->invert(in, out);
@@ -265,6 +331,80 @@ std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::invert(
     return tdp_inv_imp_->invert(in);
 }
 
+void TdpInverse::invert_batch(const std::array<uint8_t, kMessageSize>* in,
+                              std::array<uint8_t, kMessageSize>*       out,
+                              const size_t                             n,
+                              const unsigned int threads) const
+{
+    check_batch_arguments(in, out, n);
+
+    const TdpInverseImpl* imp = tdp_inv_imp_;
+    process_batch(n, threads, [imp, in, out](size_t first, size_t count) {
+        imp->invert_batch(in + first, out + first, count);
+    });
+}
+
+std::vector<std::array<uint8_t, TdpInverse::kMessageSize>> TdpInverse::
+    invert_batch(const std::vector<std::array<uint8_t, kMessageSize>>& in,
+                 const unsigned int threads) const
+{
+    std::vector<std::array<uint8_t, kMessageSize>> out(in.size());
+    invert_batch(in.data(), out.data(), in.size(), threads);
+
+    return out;
+}
+
+void TdpInverse::eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                           const size_t                             n,
+                           const Tdp::ChainCallback& callback) const
+{
+    tdp_inv_imp_->eval_chain(start, n, callback);
+}
+
+std::array<uint8_t, TdpInverse::kMessageSize> TdpInverse::eval_mult(
+    const std::array<uint8_t, kMessageSize>& in,
+    uint64_t                                 order) const
+{
+    return tdp_inv_imp_->eval_mult(in, order);
+}
+
+std::vector<std::array<uint8_t, TdpInverse::kMessageSize>> TdpInverse::
+    eval_chain_parallel(const std::array<uint8_t, kMessageSize>& start,
+                        const size_t                             n,
+                        const unsigned int threads) const
+{
+    std::vector<std::array<uint8_t, kMessageSize>> out(n);
+
+    unsigned int thread_count = threads;
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    // do not cut the chain in segments too short to amortize the jumps
+    const size_t max_segments = std::max<size_t>(n / kMinChainSegmentLength, 1);
+    if (thread_count > max_segments) {
+        thread_count = static_cast<unsigned int>(max_segments);
+    }
+
+    const TdpInverseImpl*              imp = tdp_inv_imp_;
+    std::array<uint8_t, kMessageSize>* res = out.data();
+    process_batch(
+        n, thread_count, [imp, &start, res](size_t first, size_t count) {
+            // jump to pi^first(start), and walk the segment from there
+            const std::array<uint8_t, kMessageSize> segment_start
+                = imp->eval_mult(start, first);
+
+            std::array<uint8_t, kMessageSize>* it = res + first;
+            imp->eval_chain(
+                segment_start,
+                count,
+                [&it](const std::array<uint8_t, kMessageSize>& x) {
+                    *it++ = x;
+                });
+        });
+
+    return out;
+}
+
 void TdpInverse::invert_mult(const std::string& in,
                              std::string&       out,
                              uint32_t           order) const
@@ -395,6 +535,13 @@ std::array<uint8_t, Tdp::kMessageSize> TdpMultPool::eval(
     return static_cast<TdpImpl*>(tdp_pool_imp_)->eval(in);
 }
 
+void TdpMultPool::eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                            const size_t                             n,
+                            const Tdp::ChainCallback& callback) const
+{
+    static_cast<TdpImpl*>(tdp_pool_imp_)->eval_chain(start, n, callback);
+}
+
 uint8_t TdpMultPool::maximum_order() const
 {
     return tdp_pool_imp_->maximum_order();
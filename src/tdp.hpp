@@ -27,7 +27,9 @@
 #include <cstdint>
 
 #include <array>
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace sse {
 namespace crypto {
@@ -68,6 +70,11 @@ public:
     static constexpr size_t kRSAPrfSize
         = kMessageSize + (kStatisticalSecurity + 7) / 8;
 
+    /// @brief  Type of the callbacks called on the elements of a TDP chain
+    ///         (see eval_chain)
+    using ChainCallback
+        = std::function<void(const std::array<uint8_t, kMessageSize>&)>;
+
     ///
     /// @brief  Constructor
     ///
@@ -256,6 +263,68 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Evaluates the TDP on the n messages of the in array and writes the
+    /// results to the out array. The big integers used by the computation are
+    /// reused for the whole batch, and the messages can be spread among
+    /// several threads.
+    ///
+    /// @param  in      The input messages. in and out can be the same array.
+    /// @param  out     The output messages
+    /// @param  n       The number of messages in the batch
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    ///
+    /// @exception std::invalid_argument    in or out is nullptr while n > 0
+    /// @exception std::runtime_error       The evaluation of a message failed
+    ///
+    void eval_batch(const std::array<uint8_t, kMessageSize>* in,
+                    std::array<uint8_t, kMessageSize>*       out,
+                    const size_t                             n,
+                    const unsigned int                       threads = 1) const;
+
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Same as above, for the messages of a vector. The results are returned
+    /// in the same order as the inputs.
+    ///
+    /// @param  in      The input messages
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    /// @return         The evaluations of the messages
+    ///
+    /// @exception std::runtime_error   The evaluation of a message failed
+    ///
+    std::vector<std::array<uint8_t, kMessageSize>> eval_batch(
+        const std::vector<std::array<uint8_t, kMessageSize>>& in,
+        const unsigned int threads = 1) const;
+
+    ///
+    /// @brief Evaluate a chain of TDP images
+    ///
+    /// Iteratively evaluates the TDP n times, starting from start, and calls
+    /// callback on every intermediate image, in order (i.e. on
+    /// \f$ \pi_{PK}^{i}(start)\f$ for i = 1 to n). This is equivalent to n
+    /// calls to eval(st, st), each followed by a call to callback(st), but
+    /// faster: the current element is kept in the internal representation of
+    /// the backend (in Montgomery form) between two steps, and no memory is
+    /// allocated per step.
+    ///
+    /// @param  start       The first element of the chain (not passed to
+    ///                     callback)
+    /// @param  n           The number of evaluations of the TDP
+    /// @param  callback    The function called on every image. Its argument
+    ///                     only lives during the call: copy it to keep it.
+    ///
+    /// @exception std::runtime_error   An evaluation failed
+    ///
+    void eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                    const size_t                             n,
+                    const ChainCallback&                     callback) const;
+
 private:
     TdpImpl* tdp_imp_; // opaque pointer
 };
@@ -275,6 +344,10 @@ public:
     /// @brief  Size (in bytes) of a message (i.e. the elements on which the TDP
     ///         operates). It is also the size of the RSA modulus.
     static constexpr size_t kMessageSize = Tdp::kMessageSize;
+    /// @brief  Minimum number of evaluations per thread in
+    ///         eval_chain_parallel. It amortizes the cost of the jump to the
+    ///         beginning of a segment (about one private-key operation).
+    static constexpr size_t kMinChainSegmentLength = 256;
 
 
     ///
@@ -472,6 +545,114 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Evaluates the TDP on the n messages of the in array and writes the
+    /// results to the out array. The big integers used by the computation are
+    /// reused for the whole batch, and the messages can be spread among
+    /// several threads.
+    ///
+    /// @param  in      The input messages. in and out can be the same array.
+    /// @param  out     The output messages
+    /// @param  n       The number of messages in the batch
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    ///
+    /// @exception std::invalid_argument    in or out is nullptr while n > 0
+    /// @exception std::runtime_error       The evaluation of a message failed
+    ///
+    void eval_batch(const std::array<uint8_t, kMessageSize>* in,
+                    std::array<uint8_t, kMessageSize>*       out,
+                    const size_t                             n,
+                    const unsigned int                       threads = 1) const;
+
+    ///
+    /// @brief Evaluate the TDP on a batch of messages
+    ///
+    /// Same as above, for the messages of a vector. The results are returned
+    /// in the same order as the inputs.
+    ///
+    /// @param  in      The input messages
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    /// @return         The evaluations of the messages
+    ///
+    /// @exception std::runtime_error   The evaluation of a message failed
+    ///
+    std::vector<std::array<uint8_t, kMessageSize>> eval_batch(
+        const std::vector<std::array<uint8_t, kMessageSize>>& in,
+        const unsigned int threads = 1) const;
+
+    ///
+    /// @brief Evaluate a chain of TDP images
+    ///
+    /// Iteratively evaluates the TDP n times, starting from start, and calls
+    /// callback on every intermediate image, in order (i.e. on
+    /// \f$ \pi_{PK}^{i}(start)\f$ for i = 1 to n). This is equivalent to n
+    /// calls to eval(st, st), each followed by a call to callback(st), but
+    /// faster: the current element is kept in the internal representation of
+    /// the backend (in Montgomery form) between two steps, and no memory is
+    /// allocated per step.
+    ///
+    /// @param  start       The first element of the chain (not passed to
+    ///                     callback)
+    /// @param  n           The number of evaluations of the TDP
+    /// @param  callback    The function called on every image. Its argument
+    ///                     only lives during the call: copy it to keep it.
+    ///
+    /// @exception std::runtime_error   An evaluation failed
+    ///
+    void eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                    const size_t                             n,
+                    const Tdp::ChainCallback&                callback) const;
+
+    ///
+    /// @brief Evaluate the TDP multiple times
+    ///
+    /// Evaluates the TDP on the input message order times (i.e. compute
+    /// \f$ \pi_{PK}^{order}(in)\f$) and returns the result as a byte array.
+    /// The trapdoor is used to reduce the exponent \f$ e^{order}\f$ modulo
+    /// \f$ \varphi(N)\f$: the cost is roughly the one of a single inversion,
+    /// whatever the order.
+    ///
+    /// @param  in      The input message, stored in a byte array
+    /// @param  order   The number of times the TDP is iterated on in
+    /// @return         The result of the evaluation, stored in a byte array
+    ///
+    /// @exception std::runtime_error   The evaluation failed
+    ///
+    std::array<uint8_t, kMessageSize> eval_mult(
+        const std::array<uint8_t, kMessageSize>& in,
+        uint64_t                                 order) const;
+
+    ///
+    /// @brief Evaluate a chain of TDP images in parallel
+    ///
+    /// Returns the n images \f$ \pi_{PK}^{i}(start)\f$, for i = 1 to n, in
+    /// order. The chain is cut in contiguous segments, one per thread: every
+    /// thread jumps to the beginning of its segment with eval_mult, and then
+    /// walks the segment as eval_chain does. A segment is at least
+    /// kMinChainSegmentLength evaluations long, so short chains use fewer
+    /// threads (and are evaluated serially below 2*kMinChainSegmentLength).
+    ///
+    /// Without the trapdoor, the chain is inherently sequential: iterating
+    /// the public-key operation k times costs k exponentiations, whatever the
+    /// precomputations.
+    ///
+    /// @param  start   The first element of the chain (not returned)
+    /// @param  n       The number of evaluations of the TDP
+    /// @param  threads The maximum number of threads. If it is 0, one thread
+    ///                 per hardware thread is used.
+    /// @return         The images of start, in order
+    ///
+    /// @exception std::runtime_error   An evaluation failed
+    ///
+    std::vector<std::array<uint8_t, kMessageSize>> eval_chain_parallel(
+        const std::array<uint8_t, kMessageSize>& start,
+        const size_t                             n,
+        const unsigned int                       threads = 0) const;
+
     ///
     /// @brief Invert the TDP (private-key operation)
     ///
@@ -512,6 +693,45 @@ public:
     std::array<uint8_t, kMessageSize> invert(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+    ///
+    /// @brief Invert the TDP on a batch of messages
+    ///
+    /// Evaluates the inverse of the TDP on the n messages of the in array and
+    /// writes the results to the out array. The big integers used by the
+    /// computation are reused for the whole batch, and the messages can be
+    /// spread among several threads.
+    ///
+    /// @param  in      The input messages. in and out can be the same array.
+    /// @param  out     The output messages
+    /// @param  n       The number of messages in the batch
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    ///
+    /// @exception std::invalid_argument    in or out is nullptr while n > 0
+    /// @exception std::runtime_error       The inversion of a message failed
+    ///
+    void invert_batch(const std::array<uint8_t, kMessageSize>* in,
+                      std::array<uint8_t, kMessageSize>*       out,
+                      const size_t                             n,
+                      const unsigned int threads = 1) const;
+
+    ///
+    /// @brief Invert the TDP on a batch of messages
+    ///
+    /// Same as above, for the messages of a vector. The results are returned
+    /// in the same order as the inputs.
+    ///
+    /// @param  in      The input messages
+    /// @param  threads The number of threads used to process the batch. If it
+    ///                 is 0, one thread per hardware thread is used.
+    /// @return         The inversions of the messages
+    ///
+    /// @exception std::runtime_error   The inversion of a message failed
+    ///
+    std::vector<std::array<uint8_t, kMessageSize>> invert_batch(
+        const std::vector<std::array<uint8_t, kMessageSize>>& in,
+        const unsigned int threads = 1) const;
+
     ///
     /// @brief Invert the TDP multiple times
     ///
@@ -770,6 +990,30 @@ public:
     std::array<uint8_t, kMessageSize> eval(
         const std::array<uint8_t, kMessageSize>& in) const;
 
+
+    ///
+    /// @brief Evaluate a chain of TDP images
+    ///
+    /// Iteratively evaluates the TDP n times, starting from start, and calls
+    /// callback on every intermediate image, in order (i.e. on
+    /// \f$ \pi_{PK}^{i}(start)\f$ for i = 1 to n). This is equivalent to n
+    /// calls to eval(st, st), each followed by a call to callback(st), but
+    /// faster: the current element is kept in the internal representation of
+    /// the backend (in Montgomery form) between two steps, and no memory is
+    /// allocated per step.
+    ///
+    /// @param  start       The first element of the chain (not passed to
+    ///                     callback)
+    /// @param  n           The number of evaluations of the TDP
+    /// @param  callback    The function called on every image. Its argument
+    ///                     only lives during the call: copy it to keep it.
+    ///
+    /// @exception std::runtime_error   An evaluation failed
+    ///
+    void eval_chain(const std::array<uint8_t, kMessageSize>& start,
+                    const size_t                             n,
+                    const Tdp::ChainCallback&                callback) const;
+
     ///
     /// @brief Iteratively evaluate the TDP
     ///
@@ -0,0 +1,431 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "rsa_multi_buffer.hpp"
+
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+
+#if __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace sse {
+namespace crypto {
+
+constexpr size_t RsaMultiBuffer::kModulusSize;
+constexpr size_t RsaMultiBuffer::kLanes;
+constexpr bool   RsaMultiBuffer::kIfma;
+
+#if __AVX2__
+
+#if __AVX512F__ && __AVX512IFMA__
+
+// vpmadd52[lh]uq multiply the low 52 bits of 64-bit lanes
+static constexpr unsigned int kLimbBits = 52;
+using LimbVector                        = __m512i;
+
+#else
+
+// vpmuludq multiplies the low 32 bits of 64-bit lanes. 28-bit limbs leave
+// enough room in the accumulators to add all the products of a column
+// without carry propagation (2 * 74 * 2^56 < 2^64).
+static constexpr unsigned int kLimbBits = 28;
+using LimbVector                        = __m256i;
+
+#endif
+
+static constexpr uint64_t kLimbMask = (1ULL << kLimbBits) - 1;
+
+// R = 2^(kLimbBits * kLimbs) is at least 4N, so that the Montgomery products
+// of numbers smaller than 2N are smaller than 2N, without final subtraction
+static constexpr size_t kLimbs
+    = (8 * RsaMultiBuffer::kModulusSize + 2 + kLimbBits - 1) / kLimbBits;
+
+// Conversions between big endian integers and little endian limbs
+static void bytes_to_limbs(const uint8_t* in, uint64_t* limbs)
+{
+    std::fill(limbs, limbs + kLimbs, 0);
+
+    for (size_t i = 0; i < RsaMultiBuffer::kModulusSize; i++) {
+        const uint64_t b     = in[RsaMultiBuffer::kModulusSize - 1 - i];
+        const size_t   limb  = (8 * i) / kLimbBits;
+        const size_t   shift = (8 * i) % kLimbBits;
+
+        limbs[limb] |= (b << shift) & kLimbMask;
+        if (shift + 8 > kLimbBits) {
+            limbs[limb + 1] |= b >> (kLimbBits - shift);
+        }
+    }
+}
+
+static void limbs_to_bytes(const uint64_t* limbs, uint8_t* out)
+{
+    for (size_t i = 0; i < RsaMultiBuffer::kModulusSize; i++) {
+        const size_t limb  = (8 * i) / kLimbBits;
+        const size_t shift = (8 * i) % kLimbBits;
+
+        uint64_t b = limbs[limb] >> shift;
+        if (shift + 8 > kLimbBits) {
+            b |= limbs[limb + 1] << (kLimbBits - shift);
+        }
+        out[RsaMultiBuffer::kModulusSize - 1 - i] = static_cast<uint8_t>(b);
+    }
+}
+
+// Arithmetic on normalized limbs (i.e. smaller than 2^kLimbBits)
+static bool limbs_geq(const uint64_t* x, const uint64_t* y)
+{
+    for (size_t i = kLimbs; i > 0; i--) {
+        if (x[i - 1] != y[i - 1]) {
+            return x[i - 1] > y[i - 1];
+        }
+    }
+    return true;
+}
+
+static void limbs_sub(uint64_t* x, const uint64_t* y)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < kLimbs; i++) {
+        const uint64_t v = x[i] - y[i] - borrow;
+        borrow           = v >> 63;
+        x[i]             = v & kLimbMask;
+    }
+}
+
+// x = 2x mod N, for x < N
+static void limbs_double_mod(uint64_t* x, const uint64_t* n)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < kLimbs; i++) {
+        const uint64_t v = (x[i] << 1) | carry;
+        carry            = v >> kLimbBits;
+        x[i]             = v & kLimbMask;
+    }
+    if (limbs_geq(x, n)) {
+        limbs_sub(x, n);
+    }
+}
+
+#if __AVX512F__ && __AVX512IFMA__
+
+static inline LimbVector broadcast_limb(const uint64_t x)
+{
+    return _mm512_set1_epi64(static_cast<long long>(x));
+}
+
+// GCC wrongly reports the undefined pass-through operand of the builtin behind
+// _mm512_srli_epi64 as uninitialized (or maybe uninitialized, depending on
+// the instrumentation)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// r = a * b / R mod N, lane by lane. The inputs must be smaller than 2N, and
+// so is the output. r can alias a or b.
+static void montgomery_mul(LimbVector*       r,
+                           const LimbVector* a,
+                           const LimbVector* b,
+                           const uint64_t*   n,
+                           const uint64_t    k0)
+{
+    const LimbVector zero = _mm512_setzero_si512();
+    const LimbVector vk0  = broadcast_limb(k0);
+
+    // the columns of the product are accumulated in 64 bits, and only
+    // normalized at the end
+    LimbVector t[2 * kLimbs];
+    for (size_t j = 0; j < 2 * kLimbs; j++) {
+        t[j] = zero;
+    }
+
+    for (size_t i = 0; i < kLimbs; i++) {
+        LimbVector*      ti = t + i;
+        const LimbVector bi = b[i];
+        const LimbVector n0 = broadcast_limb(n[0]);
+
+        // choose m such that the low limb of t + a * b_i + m * N is 0
+        LimbVector       x = _mm512_madd52lo_epu64(ti[0], a[0], bi);
+        const LimbVector m = _mm512_madd52lo_epu64(zero, x, vk0);
+        x                  = _mm512_madd52lo_epu64(x, m, n0);
+
+        LimbVector hi = _mm512_madd52hi_epu64(ti[1], a[0], bi);
+        hi            = _mm512_madd52hi_epu64(hi, m, n0);
+        hi            = _mm512_add_epi64(hi, _mm512_srli_epi64(x, kLimbBits));
+
+        // every column is loaded and stored once per row
+        for (size_t j = 1; j < kLimbs; j++) {
+            const LimbVector nj = broadcast_limb(n[j]);
+
+            LimbVector lo = _mm512_madd52lo_epu64(hi, a[j], bi);
+            ti[j]         = _mm512_madd52lo_epu64(lo, m, nj);
+
+            hi = _mm512_madd52hi_epu64(ti[j + 1], a[j], bi);
+            hi = _mm512_madd52hi_epu64(hi, m, nj);
+        }
+        ti[kLimbs] = hi;
+    }
+
+    const LimbVector mask  = broadcast_limb(kLimbMask);
+    LimbVector       carry = zero;
+    for (size_t j = 0; j < kLimbs; j++) {
+        const LimbVector v = _mm512_add_epi64(t[kLimbs + j], carry);
+        r[j]               = _mm512_and_si512(v, mask);
+        carry              = _mm512_srli_epi64(v, kLimbBits);
+    }
+}
+
+#pragma GCC diagnostic pop
+
+static inline void store_limbs(uint64_t* out, const LimbVector v)
+{
+    _mm512_store_si512(reinterpret_cast<__m512i*>(out), v);
+}
+
+static inline LimbVector load_limbs(const uint64_t* in)
+{
+    return _mm512_load_si512(reinterpret_cast<const __m512i*>(in));
+}
+
+#else
+
+static inline LimbVector broadcast_limb(const uint64_t x)
+{
+    return _mm256_set1_epi64x(static_cast<long long>(x));
+}
+
+static_assert(kLimbs % 2 == 0, "The rows are processed by pairs");
+
+// acc + x * y, for 32-bit x and y
+static inline LimbVector mul_add(const LimbVector acc,
+                                 const LimbVector x,
+                                 const LimbVector y)
+{
+    return _mm256_add_epi64(acc, _mm256_mul_epu32(x, y));
+}
+
+// r = a * b / R mod N, lane by lane. The inputs must be smaller than 2N, and
+// so is the output. r can alias a or b.
+static void montgomery_mul(LimbVector*       r,
+                           const LimbVector* a,
+                           const LimbVector* b,
+                           const uint64_t*   n,
+                           const uint64_t    k0)
+{
+    const LimbVector zero = _mm256_setzero_si256();
+    const LimbVector vk0  = broadcast_limb(k0);
+    const LimbVector mask = broadcast_limb(kLimbMask);
+
+    // the columns of the product are accumulated in 64 bits, and only
+    // normalized at the end
+    LimbVector t[2 * kLimbs];
+    for (size_t j = 0; j < 2 * kLimbs; j++) {
+        t[j] = zero;
+    }
+
+    const LimbVector n0 = broadcast_limb(n[0]);
+    const LimbVector n1 = broadcast_limb(n[1]);
+
+    // two rows at a time, to halve the loads and stores of the columns
+    for (size_t i = 0; i < kLimbs; i += 2) {
+        LimbVector*      ti = t + i;
+        const LimbVector b0 = b[i];
+        const LimbVector b1 = b[i + 1];
+
+        // choose m0 such that the low limb of t + a * b_i + m0 * N is 0
+        LimbVector       x  = mul_add(ti[0], a[0], b0);
+        const LimbVector m0 = _mm256_and_si256(_mm256_mul_epu32(x, vk0), mask);
+        x                   = mul_add(x, m0, n0);
+
+        // and m1 such that the next limb of t + a * b_(i+1) + m1 * N is 0
+        LimbVector y = _mm256_add_epi64(ti[1], _mm256_srli_epi64(x, kLimbBits));
+        y            = mul_add(mul_add(y, a[1], b0), m0, n1);
+        y            = mul_add(y, a[0], b1);
+        const LimbVector m1 = _mm256_and_si256(_mm256_mul_epu32(y, vk0), mask);
+        y                   = mul_add(y, m1, n0);
+
+        ti[2] = _mm256_add_epi64(ti[2], _mm256_srli_epi64(y, kLimbBits));
+
+        LimbVector n_prev = n1;
+        for (size_t j = 2; j < kLimbs; j++) {
+            const LimbVector nj = broadcast_limb(n[j]);
+
+            LimbVector v = mul_add(mul_add(ti[j], a[j], b0), m0, nj);
+            ti[j]        = mul_add(mul_add(v, a[j - 1], b1), m1, n_prev);
+            n_prev       = nj;
+        }
+        ti[kLimbs]
+            = mul_add(mul_add(ti[kLimbs], a[kLimbs - 1], b1), m1, n_prev);
+    }
+
+    LimbVector carry = zero;
+    for (size_t j = 0; j < kLimbs; j++) {
+        const LimbVector v = _mm256_add_epi64(t[kLimbs + j], carry);
+        r[j]               = _mm256_and_si256(v, mask);
+        carry              = _mm256_srli_epi64(v, kLimbBits);
+    }
+}
+
+static inline void store_limbs(uint64_t* out, const LimbVector v)
+{
+    _mm256_store_si256(reinterpret_cast<__m256i*>(out), v);
+}
+
+static inline LimbVector load_limbs(const uint64_t* in)
+{
+    return _mm256_load_si256(reinterpret_cast<const __m256i*>(in));
+}
+
+#endif
+
+void RsaMultiBuffer::set_key(const uint8_t* modulus,
+                             size_t         modulus_len,
+                             const uint8_t* exponent,
+                             size_t         exponent_len)
+{
+    clear();
+
+    static const uint8_t kExponent[] = {0x01, 0x00, 0x01};
+
+    if (modulus_len != kModulusSize
+        || (modulus[kModulusSize - 1] & 1) == 0
+        || exponent_len != sizeof(kExponent)
+        || memcmp(exponent, kExponent, sizeof(kExponent)) != 0) {
+        return;
+    }
+
+    std::vector<uint64_t> n(kLimbs);
+    bytes_to_limbs(modulus, n.data());
+
+    // -N^{-1} mod 2^kLimbBits, by Newton iteration (N is odd)
+    uint64_t inv = n[0];
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - n[0] * inv;
+    }
+
+    // R^2 mod N = 2^(2 * kLimbBits * kLimbs) mod N
+    std::vector<uint64_t> rr(kLimbs, 0);
+    rr[0] = 1;
+    for (size_t i = 0; i < 2 * kLimbBits * kLimbs; i++) {
+        limbs_double_mod(rr.data(), n.data());
+    }
+
+    modulus_ = std::move(n);
+    rr_      = std::move(rr);
+    k0_      = (0 - inv) & kLimbMask;
+}
+
+void RsaMultiBuffer::eval(const std::array<uint8_t, kModulusSize>* in,
+                          std::array<uint8_t, kModulusSize>*       out,
+                          size_t                                   count) const
+{
+    if (!enabled() || count > kLanes) {
+        throw std::invalid_argument(
+            "Invalid multi-buffer RSA evaluation"); /* LCOV_EXCL_LINE */
+    }
+
+    // the limbs of the lanes are interleaved: limb j of lane l is at
+    // buffer[j * kLanes + l]
+    alignas(64) uint64_t buffer[kLimbs * kLanes];
+    uint64_t             limbs[kLimbs];
+
+    for (size_t l = 0; l < kLanes; l++) {
+        if (l < count) {
+            bytes_to_limbs(in[l].data(), limbs);
+        } else {
+            std::fill(limbs, limbs + kLimbs, 0);
+        }
+        for (size_t j = 0; j < kLimbs; j++) {
+            buffer[j * kLanes + l] = limbs[j];
+        }
+    }
+
+    const uint64_t* n = modulus_.data();
+
+    LimbVector x[kLimbs], y[kLimbs], c[kLimbs];
+    for (size_t j = 0; j < kLimbs; j++) {
+        x[j] = load_limbs(buffer + j * kLanes);
+        c[j] = broadcast_limb(rr_[j]);
+    }
+
+    // to the Montgomery form: x R = x * R^2 / R
+    montgomery_mul(x, x, c, n, k0_);
+
+    // 65537 = 2^16 + 1: 16 squarings and 1 multiplication
+    std::copy(x, x + kLimbs, y);
+    for (int i = 0; i < 16; i++) {
+        montgomery_mul(y, y, y, n, k0_);
+    }
+    montgomery_mul(y, y, x, n, k0_);
+
+    // out of the Montgomery form: multiply by 1. The result is at most N.
+    c[0] = broadcast_limb(1);
+    for (size_t j = 1; j < kLimbs; j++) {
+        c[j] = broadcast_limb(0);
+    }
+    montgomery_mul(y, y, c, n, k0_);
+
+    for (size_t j = 0; j < kLimbs; j++) {
+        store_limbs(buffer + j * kLanes, y[j]);
+    }
+
+    for (size_t l = 0; l < count; l++) {
+        for (size_t j = 0; j < kLimbs; j++) {
+            limbs[j] = buffer[j * kLanes + l];
+        }
+        if (limbs_geq(limbs, n)) {
+            limbs_sub(limbs, n);
+        }
+        limbs_to_bytes(limbs, out[l].data());
+    }
+}
+
+#else
+
+// no kernel: the multi-buffer evaluation is never enabled
+void RsaMultiBuffer::set_key(const uint8_t*, size_t, const uint8_t*, size_t)
+{
+    clear();
+}
+
+void RsaMultiBuffer::eval(const std::array<uint8_t, kModulusSize>*,
+                          std::array<uint8_t, kModulusSize>*,
+                          size_t) const
+{
+    throw std::invalid_argument(
+        "Multi-buffer RSA evaluation is not available"); /* LCOV_EXCL_LINE */
+}
+
+#endif
+
+void RsaMultiBuffer::clear() noexcept
+{
+    modulus_.clear();
+    rr_.clear();
+    k0_ = 0;
+}
+
+} // namespace crypto
+} // namespace sse
@@ -0,0 +1,85 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+namespace sse {
+namespace crypto {
+
+// Multi-buffer evaluation of the RSA-2048 public-key operation, for the
+// exponent 65537. Several messages are evaluated at once, one per SIMD lane:
+// the Montgomery multiplications of the lanes run side by side, with 52-bit
+// limbs and AVX-512 IFMA when available, and with 28-bit limbs and AVX2
+// otherwise. The kernel is selected at compile time (-march=native), and is
+// missing (kLanes == 0) when none of these extensions is available.
+class RsaMultiBuffer
+{
+public:
+    static constexpr size_t kModulusSize = 256;
+
+#if __AVX512F__ && __AVX512IFMA__
+    static constexpr size_t kLanes = 8;
+    static constexpr bool   kIfma  = true;
+#elif __AVX2__
+    static constexpr size_t kLanes = 4;
+    static constexpr bool   kIfma  = false;
+#else
+    static constexpr size_t kLanes = 0;
+    static constexpr bool   kIfma  = false;
+#endif
+
+    // Precomputes the Montgomery constants of the modulus. The big endian
+    // modulus and exponent must be stripped from their leading zeros. The
+    // kernel stays disabled if the key is not supported (exponent other than
+    // 65537, modulus of another size, or missing SIMD extensions).
+    void set_key(const uint8_t* modulus,
+                 size_t         modulus_len,
+                 const uint8_t* exponent,
+                 size_t         exponent_len);
+    void clear() noexcept;
+
+    bool enabled() const noexcept
+    {
+        return !modulus_.empty();
+    }
+
+    // Computes out[i] = in[i]^65537 mod N for the count (<= kLanes) messages
+    // of in. The inputs can be larger than N, and in and out can be the same
+    // array.
+    void eval(const std::array<uint8_t, kModulusSize>* in,
+              std::array<uint8_t, kModulusSize>*       out,
+              size_t                                   count) const;
+
+private:
+    // the modulus N and R^2 mod N, in the limb representation of the kernel
+    std::vector<uint64_t> modulus_;
+    std::vector<uint64_t> rr_;
+    // -N^{-1} mod 2^(limb size)
+    uint64_t k0_{0};
+};
+
+} // namespace crypto
+} // namespace sse
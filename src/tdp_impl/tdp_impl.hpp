@@ -47,6 +47,17 @@ public:
     virtual void eval(const std::string& in, std::string& out) const = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const = 0;
+    // Evaluates the TDP on the n messages of in, and writes the results in out
+    // (in and out can be the same array). Implementations must support
+    // concurrent calls on the same object.
+    virtual void eval_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                            std::array<uint8_t, kMessageSpaceSize>*       out,
+                            const size_t n) const = 0;
+    // Calls callback on the n successive images of start by the TDP. The
+    // images given to callback only live during the call.
+    virtual void eval_chain(const std::array<uint8_t, kMessageSpaceSize>& start,
+                            const size_t                                  n,
+                            const Tdp::ChainCallback& callback) const = 0;
 
     virtual std::string                            sample() const       = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> sample_array() const = 0;
@@ -73,6 +84,10 @@ public:
     virtual void invert(const std::string& in, std::string& out) const = 0;
     virtual std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const = 0;
+    // Same contract as eval_batch
+    virtual void invert_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                              std::array<uint8_t, kMessageSpaceSize>*       out,
+                              const size_t n) const = 0;
 
     virtual std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -80,6 +95,11 @@ public:
     virtual void invert_mult(const std::string& in,
                              std::string&       out,
                              uint32_t           order) const = 0;
+
+    // Computes pi^order(in), using the trapdoor to shorten the exponent
+    virtual std::array<uint8_t, kMessageSpaceSize> eval_mult(
+        const std::array<uint8_t, kMessageSpaceSize>& in,
+        uint64_t                                      order) const = 0;
 };
 
 class TdpMultPoolImpl : virtual public TdpImpl
@@ -21,6 +21,7 @@
 #include "tdp_impl_mbedtls.hpp"
 
 #include "mbedtls/bignum.h"
+#include "mbedtls/bn_mul.h"
 #include "mbedtls/rsa.h"
 #include "mbedtls/rsa_io.h"
 #include "prf.hpp"
@@ -28,9 +29,11 @@
 
 #include <cstring>
 
+#include <algorithm>
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 #include <sodium/utils.h>
 
@@ -62,6 +65,165 @@ static void zeroize_rsa(mbedtls_rsa_context* rsa)
     mbedtls_mpi_lset(&rsa->Vf, 0);
 }
 
+// Montgomery arithmetic on fixed-size arrays of limbs, used to keep the
+// elements of a TDP chain in Montgomery form between two evaluations (mbedTLS
+// does not expose its own Montgomery multiplication).
+// R = 2^(kLimbBits * kChainLimbs)
+
+constexpr size_t kLimbBits   = 8 * sizeof(mbedtls_mpi_uint);
+constexpr size_t kChainLimbs = Tdp::kMessageSize / sizeof(mbedtls_mpi_uint);
+
+using ChainLimbs = std::array<mbedtls_mpi_uint, kChainLimbs>;
+
+// double-size scratch space of the Montgomery operations (products before
+// their reduction, and carries)
+using ChainProduct = std::array<mbedtls_mpi_uint, 2 * kChainLimbs + 2>;
+
+// d += s * b, where s has i limbs, the carry being propagated to the upper
+// limbs of d (same as mpi_mul_hlp in bignum.c, which is static)
+static void mul_add_limbs(size_t                  i,
+                          const mbedtls_mpi_uint* s,
+                          mbedtls_mpi_uint*       d,
+                          mbedtls_mpi_uint        b)
+{
+    mbedtls_mpi_uint c = 0, t = 0;
+
+#if defined(MULADDC_HUIT)
+    for (; i >= 8; i -= 8) {
+        MULADDC_INIT
+        MULADDC_HUIT
+        MULADDC_STOP
+    }
+#else
+    for (; i >= 8; i -= 8) {
+        MULADDC_INIT
+        MULADDC_CORE MULADDC_CORE MULADDC_CORE MULADDC_CORE
+        MULADDC_CORE MULADDC_CORE MULADDC_CORE MULADDC_CORE
+        MULADDC_STOP
+    }
+#endif
+    for (; i > 0; i--) {
+        MULADDC_INIT
+        MULADDC_CORE
+        MULADDC_STOP
+    }
+
+    t++; // t is only used by some of the MULADDC implementations
+    (void)t;
+
+    do {
+        *d += c;
+        c = (*d < c);
+        d++;
+    } while (c != 0);
+}
+
+// returns -N^-1 mod 2^kLimbBits, where n0 is the least significant limb of N
+// (same as mpi_montg_init in bignum.c)
+static mbedtls_mpi_uint montgomery_minus_inv(const mbedtls_mpi_uint n0)
+{
+    mbedtls_mpi_uint x = n0;
+    x += ((n0 + 2) & 4) << 1;
+
+    for (size_t i = kLimbBits; i >= 8; i /= 2) {
+        x *= (2 - (n0 * x));
+    }
+    return ~x + 1;
+}
+
+// r = T * R^-1 mod N, with T < N * R. T is erased.
+static void montgomery_reduce(ChainLimbs&            r,
+                              ChainProduct&          T,
+                              const ChainLimbs&      N,
+                              const mbedtls_mpi_uint mm)
+{
+    for (size_t i = 0; i < kChainLimbs; i++) {
+        // zeroes the i-th limb of T
+        mul_add_limbs(kChainLimbs, N.data(), T.data() + i, T[i] * mm);
+    }
+
+    // the result d = T / R is smaller than 2N: subtract N if d >= N, without
+    // branching on the value of d
+    const mbedtls_mpi_uint* d = T.data() + kChainLimbs;
+    ChainLimbs              diff;
+    mbedtls_mpi_uint        borrow = 0;
+    for (size_t j = 0; j < kChainLimbs; j++) {
+        const mbedtls_mpi_uint x  = d[j] - N[j];
+        const mbedtls_mpi_uint b1 = (d[j] < N[j]);
+        diff[j]                   = x - borrow;
+        borrow                    = b1 | (x < borrow);
+    }
+    const mbedtls_mpi_uint mask
+        = (mbedtls_mpi_uint)0 - ((d[kChainLimbs] != 0) | (borrow == 0));
+    for (size_t j = 0; j < kChainLimbs; j++) {
+        r[j] = (diff[j] & mask) | (d[j] & ~mask);
+    }
+    sodium_memzero(T.data(), sizeof(T));
+}
+
+// r = a * b * R^-1 mod N, with a, b < N. r can be a or b.
+static void montgomery_mul(ChainLimbs&            r,
+                           const ChainLimbs&      a,
+                           const ChainLimbs&      b,
+                           const ChainLimbs&      N,
+                           const mbedtls_mpi_uint mm,
+                           ChainProduct&          T)
+{
+    T.fill(0);
+    for (size_t i = 0; i < kChainLimbs; i++) {
+        mul_add_limbs(kChainLimbs, b.data(), T.data() + i, a[i]);
+    }
+    montgomery_reduce(r, T, N, mm);
+}
+
+// r = a^2 * R^-1 mod N, with a < N. r can be a.
+// The cross products a[i] * a[j] are only computed once, which saves about a
+// quarter of the limb multiplications of montgomery_mul.
+static void montgomery_sqr(ChainLimbs&            r,
+                           const ChainLimbs&      a,
+                           const ChainLimbs&      N,
+                           const mbedtls_mpi_uint mm,
+                           ChainProduct&          T)
+{
+    T.fill(0);
+    for (size_t i = 0; i + 1 < kChainLimbs; i++) {
+        mul_add_limbs(
+            kChainLimbs - i - 1, a.data() + i + 1, T.data() + 2 * i + 1, a[i]);
+    }
+
+    // double the cross products
+    mbedtls_mpi_uint carry = 0;
+    for (size_t j = 0; j < 2 * kChainLimbs; j++) {
+        const mbedtls_mpi_uint x = T[j];
+        T[j]                     = (x << 1) | carry;
+        carry                    = x >> (kLimbBits - 1);
+    }
+
+    // add the squares
+    for (size_t i = 0; i < kChainLimbs; i++) {
+        mul_add_limbs(1, a.data() + i, T.data() + 2 * i, a[i]);
+    }
+    montgomery_reduce(r, T, N, mm);
+}
+
+// copies the (non-negative) integer x, smaller than R, to an array of limbs
+static void mpi_to_limbs(const mbedtls_mpi& x, ChainLimbs& limbs)
+{
+    limbs.fill(0);
+    std::copy(x.p, x.p + std::min(x.n, kChainLimbs), limbs.begin());
+}
+
+// writes the big-endian representation of limbs to out
+static void limbs_to_bytes(const ChainLimbs&                        limbs,
+                           std::array<uint8_t, Tdp::kMessageSize>& out)
+{
+    for (size_t i = 0; i < Tdp::kMessageSize; i++) {
+        out[Tdp::kMessageSize - 1 - i] = static_cast<uint8_t>(
+            limbs[i / sizeof(mbedtls_mpi_uint)]
+            >> (8 * (i % sizeof(mbedtls_mpi_uint))));
+    }
+}
+
 // mbedTLS implementation of the trapdoor permutation
 
 TdpImpl_mbedTLS::TdpImpl_mbedTLS()
@@ -87,6 +249,9 @@ TdpImpl_mbedTLS::TdpImpl_mbedTLS(const std::string& pk)
                                  "initialization");
         /* LCOV_EXCL_STOP */
     }
+
+    precompute_rr();
+    init_multi_buffer();
 }
 
 TdpImpl_mbedTLS::TdpImpl_mbedTLS(const TdpImpl_mbedTLS& tdp)
@@ -103,6 +268,47 @@ TdpImpl_mbedTLS::TdpImpl_mbedTLS(const TdpImpl_mbedTLS& tdp)
                                  "constructor");
         /* LCOV_EXCL_STOP */
     }
+
+    multi_buffer_ = tdp.multi_buffer_;
+}
+
+void TdpImpl_mbedTLS::precompute_rr()
+{
+    // mbedtls_mpi_exp_mod computes R^2 mod N and stores it in rsa_key_.RN
+    // when RN is empty. Do it once per key with a dummy exponentiation: the
+    // evaluations then only read RN, and can run concurrently.
+    mbedtls_mpi one, tmp;
+    mbedtls_mpi_init(&one);
+    mbedtls_mpi_init(&tmp);
+    mbedtls_mpi_free(&rsa_key_.RN);
+
+    int ret = mbedtls_mpi_lset(&one, 1);
+    if (ret == 0) {
+        ret = mbedtls_mpi_exp_mod(
+            &tmp, &one, &one, &rsa_key_.N, &rsa_key_.RN);
+    }
+
+    mbedtls_mpi_free(&one);
+    mbedtls_mpi_free(&tmp);
+
+    if (ret != 0) {
+        throw std::runtime_error(
+            "Error when computing R^2 mod N"); /* LCOV_EXCL_LINE */
+    }
+}
+
+void TdpImpl_mbedTLS::init_multi_buffer()
+{
+    std::vector<uint8_t> n(mbedtls_mpi_size(&rsa_key_.N));
+    std::vector<uint8_t> e(mbedtls_mpi_size(&rsa_key_.E));
+
+    if (mbedtls_mpi_write_binary(&rsa_key_.N, n.data(), n.size()) != 0
+        || mbedtls_mpi_write_binary(&rsa_key_.E, e.data(), e.size()) != 0) {
+        throw std::runtime_error(
+            "Error when serializing the RSA public key"); /* LCOV_EXCL_LINE */
+    }
+
+    multi_buffer_.set_key(n.data(), n.size(), e.data(), e.size());
 }
 
 inline size_t TdpImpl_mbedTLS::rsa_size() const
@@ -120,6 +326,7 @@ TdpImpl_mbedTLS& TdpImpl_mbedTLS::operator=(const TdpImpl_mbedTLS& t)
 {
     if (this != &t) {
         mbedtls_rsa_copy(&rsa_key_, &(t.rsa_key_));
+        multi_buffer_ = t.multi_buffer_;
     }
 
     return *this;
@@ -227,6 +434,135 @@ std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpImpl_mbedTLS::eval(
     return out;
 }
 
+void TdpImpl_mbedTLS::eval_batch(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    const size_t                                  n) const
+{
+    if (kMessageSpaceSize != rsa_size()) {
+        throw std::runtime_error(
+            "Invalid TDP input size. Input size should be kMessageSpaceSize "
+            "bytes long."); /* LCOV_EXCL_LINE */
+    }
+
+    size_t i = 0;
+
+    // full groups of messages go through the multi-buffer kernel
+    if (multi_buffer_.enabled()) {
+        for (; i + RsaMultiBuffer::kLanes <= n; i += RsaMultiBuffer::kLanes) {
+            multi_buffer_.eval(in + i, out + i, RsaMultiBuffer::kLanes);
+        }
+    }
+
+    // the integer is reused for all the other messages of the batch
+    int         ret = 0;
+    mbedtls_mpi x;
+    mbedtls_mpi_init(&x);
+
+    for (; i < n && ret == 0; i++) {
+        // deserialize the integer
+        ret = mbedtls_mpi_read_binary(&x, in[i].data(), kMessageSpaceSize);
+
+        // in case we were given an input larger than the RSA modulus
+        if (ret == 0) {
+            ret = mbedtls_mpi_mod_mpi(&x, &x, &rsa_key_.N);
+        }
+        if (ret == 0) {
+            // rsa_key_.RN was precomputed: it is only read
+            ret = mbedtls_mpi_exp_mod(
+                &x, &x, &rsa_key_.E, &rsa_key_.N, &rsa_key_.RN);
+        }
+        if (ret == 0) {
+            ret = mbedtls_mpi_write_binary(
+                &x, out[i].data(), kMessageSpaceSize);
+        }
+    }
+
+    mbedtls_mpi_free(&x); // erases the temporary variable
+
+    if (ret != 0) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
+}
+
+void TdpImpl_mbedTLS::eval_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start,
+    const size_t                                  n,
+    const Tdp::ChainCallback&                     callback) const
+{
+    if (kMessageSpaceSize != rsa_size()) {
+        throw std::runtime_error(
+            "Invalid TDP input size. Input size should be kMessageSpaceSize "
+            "bytes long."); /* LCOV_EXCL_LINE */
+    }
+
+    std::array<uint8_t, kMessageSpaceSize> out;
+
+    int         ret;
+    mbedtls_mpi x;
+    mbedtls_mpi_init(&x);
+
+    // deserialize the integer, and reduce it in case we were given an input
+    // larger than the RSA modulus
+    ret = mbedtls_mpi_read_binary(&x, start.data(), kMessageSpaceSize);
+    if (ret == 0) {
+        ret = mbedtls_mpi_mod_mpi(&x, &x, &rsa_key_.N);
+    }
+
+    ChainLimbs   N, rr, elt, img;
+    ChainProduct T;
+
+    mpi_to_limbs(rsa_key_.N, N);
+    mpi_to_limbs(x, elt);
+
+    // R^2 mod N, to get into the Montgomery form
+    if (ret == 0) {
+        ret = mbedtls_mpi_lset(&x, 1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_mpi_shift_l(&x, 2 * kLimbBits * kChainLimbs);
+    }
+    if (ret == 0) {
+        ret = mbedtls_mpi_mod_mpi(&x, &x, &rsa_key_.N);
+    }
+    mpi_to_limbs(x, rr);
+    mbedtls_mpi_free(&x);
+
+    if (ret != 0) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
+
+    const mbedtls_mpi_uint mm     = montgomery_minus_inv(N[0]);
+    const size_t           e_bits = mbedtls_mpi_bitlen(&rsa_key_.E);
+
+    montgomery_mul(elt, elt, rr, N, mm, T);
+
+    for (size_t i = 0; i < n; i++) {
+        // left-to-right square and multiply: the exponent is public
+        img = elt;
+        for (size_t b = e_bits - 1; b-- > 0;) {
+            montgomery_sqr(img, img, N, mm, T);
+            if (mbedtls_mpi_get_bit(&rsa_key_.E, b) == 1) {
+                montgomery_mul(img, img, elt, N, mm, T);
+            }
+        }
+        elt = img;
+
+        // get the image out of the Montgomery form
+        T.fill(0);
+        std::copy(elt.begin(), elt.end(), T.begin());
+        montgomery_reduce(img, T, N, mm);
+        limbs_to_bytes(img, out);
+
+        callback(out);
+    }
+
+    sodium_memzero(elt.data(), sizeof(elt));
+    sodium_memzero(img.data(), sizeof(img));
+}
+
 
 std::string TdpImpl_mbedTLS::sample() const
 {
@@ -371,6 +707,9 @@ TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS()
             "initialization"); /* LCOV_EXCL_LINE */
     }
 
+    precompute_rr();
+    init_multi_buffer();
+
     if (mbedtls_mpi_sub_int(&p_1_, &rsa_key_.P, 1) != 0) {
         throw std::runtime_error(
             "Failed MPI substraction"); /* LCOV_EXCL_LINE */
@@ -415,6 +754,9 @@ TdpInverseImpl_mbedTLS::TdpInverseImpl_mbedTLS(const std::string& sk)
             "initialization from existing secret key"); /* LCOV_EXCL_LINE */
     }
 
+    precompute_rr();
+    init_multi_buffer();
+
     if (mbedtls_mpi_sub_int(&p_1_, &rsa_key_.P, 1) != 0) {
         throw std::runtime_error(
             "Failed MPI substraction"); /* LCOV_EXCL_LINE */
@@ -505,6 +847,37 @@ std::array<uint8_t, TdpImpl_mbedTLS::kMessageSpaceSize> TdpInverseImpl_mbedTLS::
     return out;
 }
 
+void TdpInverseImpl_mbedTLS::invert_batch(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    const size_t                                  n) const
+{
+    // mbedtls_rsa_private updates the blinding values of the context it is
+    // given: work on a copy of the key, so that several batches can be
+    // inverted concurrently. The copy is shared by the whole batch.
+    mbedtls_rsa_context key;
+    mbedtls_rsa_init(&key, 0, 0);
+
+    int ret = mbedtls_rsa_copy(&key, &rsa_key_);
+
+    std::array<uint8_t, kMessageSpaceSize> tmp;
+    for (size_t i = 0; i < n && ret == 0; i++) {
+        // in and out can overlap
+        ret = mbedtls_rsa_private(
+            &key, mbedTLS_rng_wrap, nullptr, in[i].data(), tmp.data());
+        out[i] = tmp;
+    }
+
+    sodium_memzero(tmp.data(), tmp.size());
+    mbedtls_rsa_free(&key);
+
+    if (ret != 0) {
+        throw std::invalid_argument(
+            "Error during the RSA private key operation. Code: "
+            + std::to_string(ret)); /* LCOV_EXCL_LINE */
+    }
+}
+
 // returns X = A^E mod N, even when N is even
 // CAUTION!!!!: be aware that a timing attack would reveal E,
 // contrary to mbedtls_mpi_exp_mod
@@ -700,6 +1073,72 @@ void TdpInverseImpl_mbedTLS::invert_mult(const std::string& in,
     sodium_memzero(out_array.data(), out_array.size());
 }
 
+std::array<uint8_t, TdpInverseImpl_mbedTLS::kMessageSpaceSize>
+TdpInverseImpl_mbedTLS::eval_mult(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    uint64_t                                      order) const
+{
+    if (order == 0) {
+        return in;
+    }
+
+    std::array<uint8_t, kMessageSpaceSize> out;
+
+    int         ret;
+    mbedtls_mpi x, e_p, e_q, y_p, y_q, y;
+    mbedtls_mpi_init(&x);
+    mbedtls_mpi_init(&e_p);
+    mbedtls_mpi_init(&e_q);
+    mbedtls_mpi_init(&y_p);
+    mbedtls_mpi_init(&y_q);
+    mbedtls_mpi_init(&y);
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&x, in.data(), in.size()));
+
+    // pi^order(x) = x^(e^order) mod N. Reduce e^order mod p-1 and q-1 (the
+    // moduli are even, hence insecure_mod_exp), and recombine with the CRT.
+    MBEDTLS_MPI_CHK(insecure_mod_exp(&e_p, &rsa_key_.E, order, &p_1_));
+    MBEDTLS_MPI_CHK(insecure_mod_exp(&e_q, &rsa_key_.E, order, &q_1_));
+
+    // do not use the lazily computed RP and RQ of the key: this function is
+    // called concurrently by TdpInverse::eval_chain_parallel
+    MBEDTLS_MPI_CHK(mbedtls_mpi_exp_mod(&y_p, &x, &e_p, &rsa_key_.P, nullptr));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_exp_mod(&y_q, &x, &e_q, &rsa_key_.Q, nullptr));
+
+    /*
+     * Y = YQ + Q * ((YP - YQ) * (Q^-1 mod P) mod P)
+     */
+    MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&y, &y_p, &y_q));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p, &y, &rsa_key_.QP));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&y, &y_p, &rsa_key_.P));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&y_p, &y, &rsa_key_.Q));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(&y, &y_q, &y_p));
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&y, out.data(), out.size()));
+
+    // cppcheck does not see the use of goto cleanup in the MBEDTLS_MPI_CHK
+    // macros
+// cppcheck-suppress unusedLabel
+cleanup:
+    // the reduced exponents are secret: erase them
+    mbedtls_mpi_lset(&e_p, 0);
+    mbedtls_mpi_lset(&e_q, 0);
+
+    mbedtls_mpi_free(&x);
+    mbedtls_mpi_free(&e_p);
+    mbedtls_mpi_free(&e_q);
+    mbedtls_mpi_free(&y_p);
+    mbedtls_mpi_free(&y_q);
+    mbedtls_mpi_free(&y);
+
+    if (ret != 0) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
+
+    return out;
+}
+
 
 TdpMultPoolImpl_mbedTLS::TdpMultPoolImpl_mbedTLS(const std::string& sk,
                                                  const uint8_t      size)
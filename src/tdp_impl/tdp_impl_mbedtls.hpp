@@ -25,6 +25,7 @@
 #include "mbedtls/bignum.h"
 #include "mbedtls/rsa.h"
 #include "prf.hpp"
+#include "rsa_multi_buffer.hpp"
 #include "tdp_impl.hpp"
 
 #include <cstdint>
@@ -55,6 +56,12 @@ public:
     void eval(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void eval_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                    std::array<uint8_t, kMessageSpaceSize>*       out,
+                    const size_t n) const override;
+    void eval_chain(const std::array<uint8_t, kMessageSpaceSize>& start,
+                    const size_t                                  n,
+                    const Tdp::ChainCallback& callback) const override;
 
     std::string                            sample() const override;
     std::array<uint8_t, kMessageSpaceSize> sample_array() const override;
@@ -73,7 +80,18 @@ public:
 protected:
     TdpImpl_mbedTLS();
 
+    // precomputes R^2 mod N, used by the Montgomery exponentiations, and
+    // stores it in rsa_key_.RN
+    void precompute_rr();
+
+    // sets the multi-buffer kernel up for the modulus of rsa_key_
+    void init_multi_buffer();
+
     mutable mbedtls_rsa_context rsa_key_;
+
+private:
+    // used by eval_batch (when the exponent is 65537)
+    RsaMultiBuffer multi_buffer_;
 };
 
 class TdpInverseImpl_mbedTLS : public TdpImpl_mbedTLS,
@@ -92,6 +110,9 @@ public:
     void        invert(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void invert_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                      std::array<uint8_t, kMessageSpaceSize>*       out,
+                      const size_t n) const override;
 
     std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -100,6 +121,10 @@ public:
                      std::string&       out,
                      uint32_t           order) const override;
 
+    std::array<uint8_t, kMessageSpaceSize> eval_mult(
+        const std::array<uint8_t, kMessageSpaceSize>& in,
+        uint64_t                                      order) const override;
+
 private:
     mbedtls_mpi phi_, p_1_, q_1_;
 };
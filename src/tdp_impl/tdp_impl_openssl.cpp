@@ -31,6 +31,8 @@
 #include <exception>
 #include <iomanip>
 #include <iostream>
+#include <new>
+#include <vector>
 
 #include <openssl/bio.h>
 #include <openssl/evp.h>
@@ -50,6 +52,44 @@ static_assert(Tdp::kMessageSize == TdpInverse::kMessageSize,
 
 #define RSA_PK 0x10001L // RSA_F4 for OpenSSL
 
+// Scratch space of the exponentiations. It is thread-local, so that a const
+// TDP can be shared by several threads: the evaluations do not allocate once
+// the scratch space of the calling thread is initialized.
+struct OpenSSLBnScratch
+{
+    OpenSSLBnScratch() : ctx(BN_CTX_new()), x(BN_new()), y(BN_new())
+    {
+        if (ctx == nullptr || x == nullptr || y == nullptr) {
+            /* LCOV_EXCL_START */
+            BN_free(x);
+            BN_free(y);
+            BN_CTX_free(ctx);
+            throw std::bad_alloc();
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    ~OpenSSLBnScratch()
+    {
+        BN_clear_free(x);
+        BN_clear_free(y);
+        BN_CTX_free(ctx);
+    }
+
+    OpenSSLBnScratch(const OpenSSLBnScratch&) = delete;
+    OpenSSLBnScratch& operator=(const OpenSSLBnScratch&) = delete;
+
+    BN_CTX* ctx;
+    BIGNUM* x;
+    BIGNUM* y;
+};
+
+static OpenSSLBnScratch& bn_scratch()
+{
+    static thread_local OpenSSLBnScratch scratch;
+    return scratch;
+}
+
 // OpenSSL implementation of the trapdoor permutation
 
 TdpImpl_OpenSSL::TdpImpl_OpenSSL() : rsa_key_(nullptr)
@@ -76,6 +116,7 @@ TdpImpl_OpenSSL::TdpImpl_OpenSSL(const std::string& pk) : rsa_key_(nullptr)
         throw std::runtime_error(
             "Error when initializing the RSA key from public key.");
     }
+    init_mont_ctx();
 
     // close and destroy the BIO
     if (BIO_set_close(mem, BIO_CLOSE)
@@ -116,6 +157,45 @@ inline void TdpImpl_OpenSSL::set_rsa_key(RSA* k)
     }
     rsa_key_ = k;
     RSA_blinding_off(rsa_key_);
+    init_mont_ctx();
+}
+
+inline BN_MONT_CTX* TdpImpl_OpenSSL::get_mont_ctx() const
+{
+    return mont_ctx_;
+}
+
+void TdpImpl_OpenSSL::init_mont_ctx()
+{
+    BN_MONT_CTX_free(mont_ctx_);
+    mont_ctx_ = nullptr;
+    multi_buffer_.clear();
+
+    if (rsa_key_->n == nullptr) {
+        // the key is not generated yet
+        return;
+    }
+
+    mont_ctx_ = BN_MONT_CTX_new();
+
+    if (mont_ctx_ == nullptr
+        || BN_MONT_CTX_set(mont_ctx_, rsa_key_->n, bn_scratch().ctx) != 1) {
+        /* LCOV_EXCL_START */
+        throw std::runtime_error(
+            "Error when initializing the Montgomery context.");
+        /* LCOV_EXCL_STOP */
+    }
+
+    // the AVX2 kernel is slower than the assembly code of OpenSSL: only use
+    // the IFMA one
+    if (RsaMultiBuffer::kIfma) {
+        std::vector<uint8_t> n(BN_num_bytes(rsa_key_->n));
+        std::vector<uint8_t> e(BN_num_bytes(rsa_key_->e));
+        BN_bn2bin(rsa_key_->n, n.data());
+        BN_bn2bin(rsa_key_->e, e.data());
+
+        multi_buffer_.set_key(n.data(), n.size(), e.data(), e.size());
+    }
 }
 
 inline size_t TdpImpl_OpenSSL::rsa_size() const
@@ -125,6 +205,7 @@ inline size_t TdpImpl_OpenSSL::rsa_size() const
 
 TdpImpl_OpenSSL::~TdpImpl_OpenSSL()
 {
+    BN_MONT_CTX_free(mont_ctx_);
     RSA_free(rsa_key_);
 }
 
@@ -191,36 +272,117 @@ std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpImpl_OpenSSL::eval(
 {
     std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> out;
 
+    eval_batch(&in, &out, 1);
 
-    if (in.size() != rsa_size()) {
+    return out;
+}
+
+void TdpImpl_OpenSSL::eval_batch(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    const size_t                                  n) const
+{
+    if (kMessageSpaceSize != rsa_size()) {
         throw std::runtime_error(
             "Invalid TDP input size. Input size should be kMessageSpaceSize "
             "bytes long."); /* LCOV_EXCL_LINE */
     }
 
-    BN_CTX* ctx = BN_CTX_new();
+    size_t i = 0;
 
-    BIGNUM* x = BN_new();
-    BN_bin2bn(in.data(), (unsigned int)in.size(), x);
+    // full groups of messages go through the multi-buffer kernel
+    if (multi_buffer_.enabled()) {
+        for (; i + RsaMultiBuffer::kLanes <= n; i += RsaMultiBuffer::kLanes) {
+            multi_buffer_.eval(in + i, out + i, RsaMultiBuffer::kLanes);
+        }
+    }
 
-    BIGNUM* y = BN_new();
+    // the same scratch space is used for all the other messages of the batch
+    OpenSSLBnScratch& scratch = bn_scratch();
+
+    for (; i < n; i++) {
+        BN_bin2bn(in[i].data(), (unsigned int)kMessageSpaceSize, scratch.x);
+
+        // the exponentiation uses the precomputed Montgomery constants
+        if (BN_mod_exp_mont(scratch.y,
+                            scratch.x,
+                            get_rsa_key()->e,
+                            get_rsa_key()->n,
+                            scratch.ctx,
+                            get_mont_ctx())
+            != 1) {
+            throw std::runtime_error(
+                "Error during the RSA exponentiation."); /* LCOV_EXCL_LINE */
+        }
 
-    BN_mod_exp(y, x, get_rsa_key()->e, get_rsa_key()->n, ctx);
+        // bn2bin returns a BIG endian array, so be careful ...
+        size_t pos = kMessageSpaceSize - BN_num_bytes(scratch.y);
+        // set the leading bytes to 0
+        std::fill(out[i].begin(), out[i].begin() + pos, 0);
+        BN_bn2bin(scratch.y, out[i].data() + pos);
+    }
+}
 
 
-    // bn2bin returns a BIG endian array, so be careful ...
-    size_t pos = kMessageSpaceSize - BN_num_bytes(y);
-    // set the leading bytes to 0
-    std::fill(out.begin(), out.begin() + pos, 0);
-    BN_bn2bin(y, out.data() + pos);
+void TdpImpl_OpenSSL::eval_chain(
+    const std::array<uint8_t, kMessageSpaceSize>& start,
+    const size_t                                  n,
+    const Tdp::ChainCallback&                     callback) const
+{
+    if (kMessageSpaceSize != rsa_size()) {
+        throw std::runtime_error(
+            "Invalid TDP input size. Input size should be kMessageSpaceSize "
+            "bytes long."); /* LCOV_EXCL_LINE */
+    }
 
-    BN_free(y);
-    BN_free(x);
-    BN_CTX_free(ctx);
+    // The chain element lives across the callbacks, that might evaluate the
+    // TDP on the same thread: it cannot be kept in the thread-local scratch
+    // space, and this call uses its own.
+    OpenSSLBnScratch scratch;
+    BN_MONT_CTX*     mont   = get_mont_ctx();
+    const BIGNUM*    e      = get_rsa_key()->e;
+    const int        e_bits = BN_num_bits(e);
 
-    return out;
-}
+    // x is the current element of the chain, in Montgomery form, and y
+    // accumulates its next image
+    BIGNUM* x = scratch.x;
+    BIGNUM* y = scratch.y;
+
+    std::array<uint8_t, kMessageSpaceSize> out;
+
+    int ok = (BN_bin2bn(start.data(), (int)kMessageSpaceSize, x) != nullptr);
+    // in case we were given an input larger than the RSA modulus
+    ok = ok && BN_nnmod(x, x, get_rsa_key()->n, scratch.ctx);
+    ok = ok && BN_to_montgomery(x, x, mont, scratch.ctx);
+
+    for (size_t i = 0; ok && i < n; i++) {
+        // left-to-right square and multiply: the exponent is public
+        ok = (BN_copy(y, x) != nullptr);
+        for (int b = e_bits - 2; ok && b >= 0; b--) {
+            ok = BN_mod_mul_montgomery(y, y, y, mont, scratch.ctx);
+            if (ok && BN_is_bit_set(e, b)) {
+                ok = BN_mod_mul_montgomery(y, y, x, mont, scratch.ctx);
+            }
+        }
+        BN_swap(x, y);
+
+        // y is free: use it to get the image out of the Montgomery form
+        ok = ok && BN_from_montgomery(y, x, mont, scratch.ctx);
+        if (!ok) {
+            break; /* LCOV_EXCL_LINE */
+        }
+        size_t pos = kMessageSpaceSize - BN_num_bytes(y);
+        std::fill(out.begin(), out.begin() + pos, 0);
+        BN_bn2bin(y, out.data() + pos);
 
+        callback(out);
+    }
+
+    if (!ok) {
+        throw std::runtime_error(
+            "Error during the RSA exponentiation."); /* LCOV_EXCL_LINE */
+    }
+}
 
 std::string TdpImpl_OpenSSL::sample() const
 {
@@ -341,6 +503,7 @@ TdpInverseImpl_OpenSSL::TdpInverseImpl_OpenSSL()
         throw std::runtime_error("Invalid RSA key generation.");
         /* LCOV_EXCL_STOP */
     }
+    init_mont_ctx();
 
     // initialize the useful variables
     phi_ = BN_new();
@@ -501,6 +664,25 @@ std::array<uint8_t, TdpImpl_OpenSSL::kMessageSpaceSize> TdpInverseImpl_OpenSSL::
     return out;
 }
 
+void TdpInverseImpl_OpenSSL::invert_batch(
+    const std::array<uint8_t, kMessageSpaceSize>* in,
+    std::array<uint8_t, kMessageSpaceSize>*       out,
+    const size_t                                  n) const
+{
+    for (size_t i = 0; i < n; i++) {
+        int ret = RSA_private_decrypt((int)kMessageSpaceSize,
+                                      (const unsigned char*)in[i].data(),
+                                      out[i].data(),
+                                      get_rsa_key(),
+                                      RSA_NO_PADDING);
+
+        if (ret != (int)kMessageSpaceSize) {
+            throw std::runtime_error(
+                "Error during the RSA inversion."); /* LCOV_EXCL_LINE */
+        }
+    }
+}
+
 std::array<uint8_t, TdpInverseImpl_OpenSSL::kMessageSpaceSize>
 TdpInverseImpl_OpenSSL::invert_mult(
     const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -578,6 +760,80 @@ void TdpInverseImpl_OpenSSL::invert_mult(const std::string& in,
     out = std::string(out_array.begin(), out_array.end());
 }
 
+std::array<uint8_t, TdpInverseImpl_OpenSSL::kMessageSpaceSize>
+TdpInverseImpl_OpenSSL::eval_mult(
+    const std::array<uint8_t, kMessageSpaceSize>& in,
+    uint64_t                                      order) const
+{
+    if (order == 0) {
+        return in;
+    }
+
+    std::array<uint8_t, kMessageSpaceSize> out;
+
+    // the order might not fit in a BN_ULONG: load it as a big endian integer
+    std::array<uint8_t, sizeof(order)> order_bytes;
+    for (size_t i = 0; i < order_bytes.size(); i++) {
+        order_bytes[order_bytes.size() - 1 - i]
+            = static_cast<uint8_t>(order >> (8 * i));
+    }
+
+    BN_CTX* ctx      = BN_CTX_new();
+    BIGNUM* bn_order = BN_bin2bn(
+        order_bytes.data(), static_cast<int>(order_bytes.size()), nullptr);
+    BIGNUM* e_p = BN_new();
+    BIGNUM* e_q = BN_new();
+    BIGNUM* x   = BN_bin2bn(in.data(), (int)in.size(), nullptr);
+    BIGNUM* y_p = BN_new();
+    BIGNUM* y_q = BN_new();
+    BIGNUM* h   = BN_new();
+    BIGNUM* y   = BN_new();
+
+    // pi^order(x) = x^(e^order) mod N: reduce e^order mod p-1 and q-1, and
+    // recombine with the CRT
+    int ok = (ctx != nullptr && bn_order != nullptr && e_p != nullptr
+              && e_q != nullptr && x != nullptr && y_p != nullptr
+              && y_q != nullptr && h != nullptr && y != nullptr);
+
+    ok = ok && BN_mod_exp(e_p, get_rsa_key()->e, bn_order, p_1_, ctx);
+    ok = ok && BN_mod_exp(e_q, get_rsa_key()->e, bn_order, q_1_, ctx);
+
+    ok = ok && BN_mod_exp(y_p, x, e_p, get_rsa_key()->p, ctx);
+    ok = ok && BN_mod_exp(y_q, x, e_q, get_rsa_key()->q, ctx);
+
+    ok = ok && BN_mod_sub(h, y_p, y_q, get_rsa_key()->p, ctx);
+    ok = ok && BN_mod_mul(h, h, get_rsa_key()->iqmp, get_rsa_key()->p, ctx);
+
+    ok = ok && BN_mul(y, h, get_rsa_key()->q, ctx);
+    ok = ok && BN_add(y, y, y_q);
+
+    if (ok) {
+        // bn2bin returns a BIG endian array, so be careful ...
+        size_t pos = kMessageSpaceSize - BN_num_bytes(y);
+        // set the leading bytes to 0
+        std::fill(out.begin(), out.begin() + pos, 0);
+        BN_bn2bin(y, out.data() + pos);
+    }
+
+    BN_free(bn_order);
+    // the reduced exponents are secret: erase them
+    BN_clear_free(e_p);
+    BN_clear_free(e_q);
+    BN_free(x);
+    BN_free(y_p);
+    BN_free(y_q);
+    BN_free(h);
+    BN_free(y);
+    BN_CTX_free(ctx);
+
+    if (!ok) {
+        throw std::runtime_error(
+            "Error during the modular exponentiation"); /* LCOV_EXCL_LINE */
+    }
+
+    return out;
+}
+
 
 TdpMultPoolImpl_OpenSSL::TdpMultPoolImpl_OpenSSL(const std::string& sk,
                                                  const uint8_t      size)
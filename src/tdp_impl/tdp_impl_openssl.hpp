@@ -25,6 +25,7 @@
 
 #include "key.hpp"
 #include "prf.hpp"
+#include "rsa_multi_buffer.hpp"
 #include "tdp_impl.hpp"
 
 #include <cstdint>
@@ -32,6 +33,7 @@
 #include <array>
 #include <string>
 
+#include <openssl/bn.h>
 #include <openssl/rsa.h>
 
 namespace sse {
@@ -56,6 +58,12 @@ public:
     void eval(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> eval(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void eval_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                    std::array<uint8_t, kMessageSpaceSize>*       out,
+                    const size_t n) const override;
+    void eval_chain(const std::array<uint8_t, kMessageSpaceSize>& start,
+                    const size_t                                  n,
+                    const Tdp::ChainCallback& callback) const override;
 
     std::string                            sample() const override;
     std::array<uint8_t, kMessageSpaceSize> sample_array() const override;
@@ -74,8 +82,24 @@ public:
 protected:
     TdpImpl_OpenSSL();
 
+    BN_MONT_CTX* get_mont_ctx() const;
+
+    // (re)computes the Montgomery constants of the modulus of rsa_key_, for
+    // the backend and for the multi-buffer kernel
+    void init_mont_ctx();
+
     // cppcheck-suppress constStatement
     RSA* rsa_key_{nullptr};
+
+private:
+    // Montgomery constants of the RSA modulus, computed once per key (and not
+    // on every exponentiation)
+    // cppcheck-suppress constStatement
+    BN_MONT_CTX* mont_ctx_{nullptr};
+
+    // used by eval_batch (when the exponent is 65537 and AVX-512 IFMA is
+    // available), and set up with the Montgomery context
+    RsaMultiBuffer multi_buffer_;
 };
 
 class TdpInverseImpl_OpenSSL : public TdpImpl_OpenSSL,
@@ -94,6 +118,9 @@ public:
     void        invert(const std::string& in, std::string& out) const override;
     std::array<uint8_t, kMessageSpaceSize> invert(
         const std::array<uint8_t, kMessageSpaceSize>& in) const override;
+    void invert_batch(const std::array<uint8_t, kMessageSpaceSize>* in,
+                      std::array<uint8_t, kMessageSpaceSize>*       out,
+                      const size_t n) const override;
 
     std::array<uint8_t, kMessageSpaceSize> invert_mult(
         const std::array<uint8_t, kMessageSpaceSize>& in,
@@ -102,6 +129,10 @@ public:
                      std::string&       out,
                      uint32_t           order) const override;
 
+    std::array<uint8_t, kMessageSpaceSize> eval_mult(
+        const std::array<uint8_t, kMessageSpaceSize>& in,
+        uint64_t                                      order) const override;
+
 private:
     BIGNUM *phi_, *p_1_, *q_1_;
 };
@@ -27,10 +27,27 @@
  ********/
 
 #include "../src/cipher.hpp"
+#include "../src/parallel/process_batch.hpp"
+#include "../src/random.hpp"
 
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sodium/crypto_aead_aes256gcm.h>
+#include <sodium/crypto_aead_xchacha20poly1305.h>
+#include <sodium/crypto_generichash_blake2b.h>
 
 using namespace std;
 
@@ -81,3 +98,712 @@ TEST(encryption, exception)
     in_dec = string(300, 'a'); // long enough to be a 'valid' ciphertext
     ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
 }
+
+TEST(encryption, xchacha20poly1305)
+{
+    using Mode = sse::crypto::Cipher::Mode;
+
+    array<uint8_t, kCipherKeySize> k;
+    sse::crypto::random_bytes(k.size(), k.data());
+    array<uint8_t, kCipherKeySize> k_cp = k;
+
+    sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(k.data()),
+                               Mode::kXChaCha20Poly1305);
+    ASSERT_EQ(cipher.mode(), Mode::kXChaCha20Poly1305);
+
+    for (size_t len : {1, 16, 30, 64, 100, 1000}) {
+        string in_enc = sse::crypto::random_string(len);
+        string out_enc, out_dec;
+
+        cipher.encrypt(in_enc, out_enc);
+        ASSERT_EQ(out_enc.size(),
+                  sse::crypto::Cipher::ciphertext_length(
+                      len, Mode::kXChaCha20Poly1305));
+        ASSERT_EQ(sse::crypto::Cipher::plaintext_length(
+                      out_enc.size(), Mode::kXChaCha20Poly1305),
+                  len);
+        ASSERT_EQ(out_enc[0], 0x01);
+
+        cipher.decrypt(out_enc, out_dec);
+        ASSERT_EQ(in_enc, out_dec);
+    }
+
+    // check the format against libsodium's XChaCha20+Poly1305
+    string in_enc = "This is a test input.";
+    string out_enc, out_dec;
+    cipher.encrypt(in_enc, out_enc);
+
+    const auto* c = reinterpret_cast<const uint8_t*>(out_enc.data());
+    std::vector<uint8_t> m(in_enc.size());
+    unsigned long long   m_len = 0; // NOLINT
+    ASSERT_EQ(crypto_aead_xchacha20poly1305_ietf_decrypt(
+                  m.data(),
+                  &m_len,
+                  nullptr,
+                  c + 1 + crypto_aead_xchacha20poly1305_ietf_NPUBBYTES,
+                  out_enc.size() - 1
+                      - crypto_aead_xchacha20poly1305_ietf_NPUBBYTES,
+                  c,
+                  1,
+                  c + 1,
+                  k_cp.data()),
+              0);
+    ASSERT_EQ(string(m.begin(), m.end()), in_enc);
+
+    // a ciphertext of one mode is rejected by the other
+    array<uint8_t, kCipherKeySize> k_2 = k_cp;
+    sse::crypto::Cipher            legacy_cipher(
+        sse::crypto::Key<kCipherKeySize>(k_2.data()));
+    ASSERT_EQ(legacy_cipher.mode(), Mode::kChaCha20Poly1305);
+
+    ASSERT_THROW(legacy_cipher.decrypt(out_enc, out_dec), std::runtime_error);
+    legacy_cipher.encrypt(in_enc, out_dec);
+    ASSERT_THROW(cipher.decrypt(out_dec, out_enc), std::runtime_error);
+}
+
+TEST(encryption, xchacha20poly1305_exception)
+{
+    using Mode = sse::crypto::Cipher::Mode;
+
+    ASSERT_EQ(
+        sse::crypto::Cipher::plaintext_length(0, Mode::kXChaCha20Poly1305), 0);
+
+    array<uint8_t, kCipherKeySize> k;
+    k.fill(0x00);
+
+    sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(k.data()),
+                               Mode::kXChaCha20Poly1305);
+
+    string in_enc = "";
+    string out_enc, out_dec;
+    ASSERT_THROW(cipher.encrypt(in_enc, out_enc), std::invalid_argument);
+
+    string in_dec = string(41, 'a');
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::invalid_argument);
+
+    in_dec = string(300, 'a'); // invalid format tag
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
+
+    in_enc = "This is a test input.";
+    cipher.encrypt(in_enc, out_enc);
+
+    // the format tag is authenticated
+    in_dec    = out_enc;
+    in_dec[0] = 0x02;
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
+
+    in_dec = out_enc;
+    in_dec[in_dec.size() - 1] ^= 0x01;
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
+}
+
+// Reads from a string, at most max_read bytes at a time, to exercise short
+// reads
+static sse::crypto::Cipher::StreamReader string_reader(const string& src,
+                                                       size_t max_read = 7)
+{
+    auto pos = std::make_shared<size_t>(0);
+    return [&src, pos, max_read](uint8_t* buf, size_t len) -> size_t {
+        size_t n = std::min(std::min(len, max_read), src.size() - *pos);
+        memcpy(buf, src.data() + *pos, n);
+        *pos += n;
+        return n;
+    };
+}
+
+static sse::crypto::Cipher::StreamWriter string_writer(string& dst)
+{
+    return [&dst](const uint8_t* buf, size_t len) {
+        dst.append(reinterpret_cast<const char*>(buf), len);
+    };
+}
+
+TEST(encryption, stream)
+{
+    using Cipher = sse::crypto::Cipher;
+
+    array<uint8_t, kCipherKeySize> k;
+    sse::crypto::random_bytes(k.size(), k.data());
+    array<uint8_t, kCipherKeySize> k_cp = k;
+
+    Cipher cipher(sse::crypto::Key<kCipherKeySize>(k.data()));
+    Cipher xchacha_cipher(sse::crypto::Key<kCipherKeySize>(k_cp.data()),
+                          Cipher::Mode::kXChaCha20Poly1305);
+
+    const size_t chunk_size = 64;
+    for (size_t len : {0, 1, 63, 64, 65, 128, 5 * 64 + 3}) {
+        string in_enc = sse::crypto::random_string(len);
+        string out_enc, out_dec;
+
+        cipher.encrypt_stream(
+            string_reader(in_enc), string_writer(out_enc), chunk_size);
+        ASSERT_EQ(out_enc.size(),
+                  Cipher::stream_ciphertext_length(len, chunk_size));
+
+        cipher.decrypt_stream(string_reader(out_enc), string_writer(out_dec));
+        ASSERT_EQ(in_enc, out_dec);
+
+        // the stream format does not depend on the Cipher mode
+        out_dec.clear();
+        xchacha_cipher.decrypt_stream(string_reader(out_enc, 1000),
+                                      string_writer(out_dec));
+        ASSERT_EQ(in_enc, out_dec);
+    }
+
+    // default chunk size
+    string in_enc = sse::crypto::random_string(3 * Cipher::kStreamChunkSize
+                                               + 1000);
+    string out_enc, out_dec;
+    xchacha_cipher.encrypt_stream(string_reader(in_enc, 1 << 20),
+                                  string_writer(out_enc));
+    ASSERT_EQ(out_enc.size(), Cipher::stream_ciphertext_length(in_enc.size()));
+    cipher.decrypt_stream(string_reader(out_enc, 1 << 20),
+                          string_writer(out_dec));
+    ASSERT_EQ(in_enc, out_dec);
+}
+
+TEST(encryption, stream_fd)
+{
+    sse::crypto::Cipher cipher((sse::crypto::Key<kCipherKeySize>()));
+
+    FILE* plain   = tmpfile();
+    FILE* encrypt = tmpfile();
+    FILE* decrypt = tmpfile();
+    ASSERT_NE(plain, nullptr);
+    ASSERT_NE(encrypt, nullptr);
+    ASSERT_NE(decrypt, nullptr);
+
+    const string in = sse::crypto::random_string(100000);
+    ASSERT_EQ(write(fileno(plain), in.data(), in.size()),
+              static_cast<ssize_t>(in.size()));
+    lseek(fileno(plain), 0, SEEK_SET);
+
+    cipher.encrypt_stream(fileno(plain), fileno(encrypt), 4096);
+    ASSERT_EQ(lseek(fileno(encrypt), 0, SEEK_END),
+              static_cast<off_t>(
+                  sse::crypto::Cipher::stream_ciphertext_length(in.size(),
+                                                                4096)));
+    lseek(fileno(encrypt), 0, SEEK_SET);
+
+    cipher.decrypt_stream(fileno(encrypt), fileno(decrypt));
+
+    string out(in.size() + 1, 0);
+    lseek(fileno(decrypt), 0, SEEK_SET);
+    ASSERT_EQ(read(fileno(decrypt), &out[0], out.size()),
+              static_cast<ssize_t>(in.size()));
+    out.resize(in.size());
+    ASSERT_EQ(in, out);
+
+    fclose(plain);
+    fclose(encrypt);
+    fclose(decrypt);
+
+    ASSERT_THROW(cipher.encrypt_stream(-1, -1), std::runtime_error);
+}
+
+TEST(encryption, stream_exception)
+{
+    using Cipher = sse::crypto::Cipher;
+
+    Cipher cipher((sse::crypto::Key<kCipherKeySize>()));
+    Cipher other_cipher((sse::crypto::Key<kCipherKeySize>()));
+
+    const size_t chunk_size = 32;
+    const size_t chunk_ct_size
+        = Cipher::stream_ciphertext_length(chunk_size, chunk_size)
+          - Cipher::stream_ciphertext_length(0, chunk_size);
+    const size_t header_size = Cipher::stream_ciphertext_length(0, chunk_size)
+                               - (chunk_ct_size - chunk_size);
+
+    string in_enc = sse::crypto::random_string(4 * chunk_size + 5);
+    string out_enc, out_dec;
+
+    ASSERT_THROW(cipher.encrypt_stream(
+                     string_reader(in_enc), string_writer(out_enc), 0),
+                 std::invalid_argument);
+    ASSERT_THROW(cipher.encrypt_stream(string_reader(in_enc),
+                                       string_writer(out_enc),
+                                       Cipher::kMaxStreamChunkSize + 1),
+                 std::invalid_argument);
+    ASSERT_THROW(
+        cipher.encrypt_stream([](uint8_t*, size_t len) { return len + 1; },
+                              string_writer(out_enc)),
+        std::runtime_error);
+
+    out_enc.clear();
+    cipher.encrypt_stream(
+        string_reader(in_enc), string_writer(out_enc), chunk_size);
+
+    auto check_fails = [&cipher, &out_dec](const string& ct) {
+        out_dec.clear();
+        ASSERT_THROW(
+            cipher.decrypt_stream(string_reader(ct), string_writer(out_dec)),
+            std::runtime_error);
+    };
+
+    // wrong key
+    out_dec.clear();
+    ASSERT_THROW(other_cipher.decrypt_stream(string_reader(out_enc),
+                                             string_writer(out_dec)),
+                 std::runtime_error);
+
+    // empty or truncated header
+    check_fails("");
+    check_fails(out_enc.substr(0, header_size - 1));
+
+    // invalid format tag and chunk size
+    string ct = out_enc;
+    ct[0] ^= 0x01;
+    check_fails(ct);
+    ct = out_enc;
+    ct[1] ^= 0x01;
+    check_fails(ct);
+    ct = out_enc;
+    ct[1] = ct[2] = ct[3] = ct[4] = 0;
+    check_fails(ct);
+
+    // modified chunk
+    ct = out_enc;
+    ct[header_size + chunk_ct_size + 3] ^= 0x01;
+    check_fails(ct);
+
+    // truncation, at a chunk boundary or not
+    check_fails(out_enc.substr(0, header_size));
+    check_fails(out_enc.substr(0, header_size + 2 * chunk_ct_size));
+    check_fails(out_enc.substr(0, header_size + 2 * chunk_ct_size + 10));
+    check_fails(out_enc.substr(0, out_enc.size() - 1));
+
+    // reordered chunks
+    ct = out_enc.substr(0, header_size)
+         + out_enc.substr(header_size + chunk_ct_size, chunk_ct_size)
+         + out_enc.substr(header_size, chunk_ct_size)
+         + out_enc.substr(header_size + 2 * chunk_ct_size);
+    check_fails(ct);
+
+    // trailing data
+    check_fails(out_enc + "a");
+
+    // the original stream is still valid
+    out_dec.clear();
+    cipher.decrypt_stream(string_reader(out_enc), string_writer(out_dec));
+    ASSERT_EQ(in_enc, out_dec);
+}
+
+TEST(encryption, batch)
+{
+    using Mode = sse::crypto::Cipher::Mode;
+
+    for (Mode mode : {Mode::kChaCha20Poly1305,
+                      Mode::kXChaCha20Poly1305,
+                      Mode::kAES256GCM}) {
+        if (!sse::crypto::Cipher::is_available(mode)) {
+            continue;
+        }
+        sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(), mode);
+
+        std::vector<string> in;
+        for (size_t i = 0; i < 3000; i++) {
+            in.push_back(sse::crypto::random_string(1 + (i % 100)));
+        }
+
+        for (unsigned int n_threads : {0, 1, 3, 8}) {
+            std::vector<uint8_t> arena;
+            std::vector<size_t>  offsets;
+            cipher.encrypt_batch(in, arena, offsets, n_threads);
+
+            ASSERT_EQ(offsets.size(), in.size() + 1);
+            ASSERT_EQ(offsets[0], 0);
+            ASSERT_EQ(offsets.back(), arena.size());
+
+            std::set<string> ciphertexts;
+            for (size_t i = 0; i < in.size(); i++) {
+                ASSERT_EQ(offsets[i + 1] - offsets[i],
+                          sse::crypto::Cipher::ciphertext_length(
+                              in[i].size(), mode));
+
+                string ct(reinterpret_cast<const char*>(arena.data())
+                              + offsets[i],
+                          offsets[i + 1] - offsets[i]);
+                string out;
+                cipher.decrypt(ct, out);
+                ASSERT_EQ(out, in[i]);
+
+                ciphertexts.insert(ct);
+            }
+            // all the nonces are different
+            ASSERT_EQ(ciphertexts.size(), in.size());
+        }
+
+        // more threads than inputs, and empty batch
+        std::vector<uint8_t> arena(10);
+        std::vector<size_t>  offsets(10);
+        cipher.encrypt_batch({"a", "b"}, arena, offsets, 16);
+        ASSERT_EQ(offsets.size(), 3);
+        cipher.encrypt_batch({}, arena, offsets, 4);
+        ASSERT_EQ(arena.size(), 0);
+        ASSERT_EQ(offsets, std::vector<size_t>({0}));
+
+        ASSERT_THROW(cipher.encrypt_batch({"a", "", "b"}, arena, offsets),
+                     std::invalid_argument);
+    }
+}
+
+// The batch functions rely on process_batch: an exception thrown by a worker
+// thread must reach the caller, once all the threads are done
+TEST(encryption, batch_worker_exception)
+{
+    constexpr size_t n = 1000;
+
+    for (unsigned int n_threads : {1U, 4U}) {
+        std::atomic<size_t> processed(0);
+
+        // the first chunk is processed by a spawned thread
+        ASSERT_THROW(sse::crypto::process_batch(
+                         n,
+                         n_threads,
+                         [&processed](size_t first, size_t count) {
+                             if (first == 0) {
+                                 throw std::runtime_error("worker failure");
+                             }
+                             processed += count;
+                         }),
+                     std::runtime_error);
+        ASSERT_EQ(processed, (n_threads == 1) ? 0 : n - n / n_threads);
+    }
+}
+
+TEST(encryption, decrypt_batch)
+{
+    using Mode = sse::crypto::Cipher::Mode;
+
+    for (Mode mode : {Mode::kChaCha20Poly1305,
+                      Mode::kXChaCha20Poly1305,
+                      Mode::kAES256GCM}) {
+        if (!sse::crypto::Cipher::is_available(mode)) {
+            continue;
+        }
+        sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(), mode);
+        sse::crypto::Cipher other_mode(
+            sse::crypto::Key<kCipherKeySize>(),
+            (mode == Mode::kXChaCha20Poly1305) ? Mode::kChaCha20Poly1305
+                                               : Mode::kXChaCha20Poly1305);
+
+        std::vector<string> plaintexts;
+        std::vector<string> in;
+        std::vector<bool>   expected;
+        for (size_t i = 0; i < 1000; i++) {
+            plaintexts.push_back(sse::crypto::random_string(1 + (i % 100)));
+
+            string ct;
+            cipher.encrypt(plaintexts[i], ct);
+            bool valid = true;
+            if (i % 7 == 3) {
+                // tampered ciphertext
+                ct[ct.size() / 2] ^= 0x01;
+                valid = false;
+            } else if (i % 11 == 5) {
+                // truncated ciphertext
+                ct.resize(i % sse::crypto::Cipher::ciphertext_length(1, mode));
+                valid = false;
+            } else if (i % 13 == 6) {
+                // ciphertext from another mode
+                other_mode.encrypt(plaintexts[i], ct);
+                valid = false;
+            }
+            in.push_back(ct);
+            expected.push_back(valid);
+        }
+
+        for (unsigned int n_threads : {0, 1, 3, 8}) {
+            std::vector<uint8_t>  arena;
+            std::vector<size_t>   offsets;
+            std::vector<uint64_t> status;
+            size_t                n_valid = cipher.decrypt_batch(
+                in, arena, offsets, status, n_threads);
+
+            ASSERT_EQ(offsets.size(), in.size() + 1);
+            ASSERT_EQ(offsets[0], 0);
+            ASSERT_EQ(offsets.back(), arena.size());
+            ASSERT_EQ(status.size(), (in.size() + 63) / 64);
+
+            size_t n_expected = 0;
+            for (size_t i = 0; i < in.size(); i++) {
+                const bool valid = (status[i / 64] >> (i % 64)) & 1;
+                ASSERT_EQ(valid, expected[i]);
+
+                string out(reinterpret_cast<const char*>(arena.data())
+                               + offsets[i],
+                           offsets[i + 1] - offsets[i]);
+                if (valid) {
+                    ASSERT_EQ(out, plaintexts[i]);
+                    n_expected++;
+                } else {
+                    ASSERT_EQ(out, string(out.size(), 0x00));
+                }
+            }
+            ASSERT_EQ(n_valid, n_expected);
+        }
+
+        // empty batch
+        std::vector<uint8_t>  arena(10);
+        std::vector<size_t>   offsets(10);
+        std::vector<uint64_t> status(10);
+        ASSERT_EQ(cipher.decrypt_batch({}, arena, offsets, status, 4), 0);
+        ASSERT_EQ(arena.size(), 0);
+        ASSERT_EQ(offsets, std::vector<size_t>({0}));
+        ASSERT_EQ(status.size(), 0);
+    }
+}
+
+TEST(encryption, records)
+{
+    using Mode   = sse::crypto::Cipher::Mode;
+    using Record = sse::crypto::Cipher::Record;
+
+    // records of very different sizes, so that they are split in many tasks
+    std::vector<Record> records;
+    for (size_t i = 0; i < 2000; i++) {
+        const size_t len = (i % 50 == 0) ? 100000 + i : 1 + (i * 37) % 3000;
+        records.emplace_back(1000 + 3 * i, sse::crypto::random_string(len));
+    }
+
+    for (Mode mode : {Mode::kChaCha20Poly1305,
+                      Mode::kXChaCha20Poly1305,
+                      Mode::kAES256GCM}) {
+        if (!sse::crypto::Cipher::is_available(mode)) {
+            continue;
+        }
+        sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(), mode);
+
+        for (unsigned int n_threads : {0, 1, 3, 8}) {
+            std::vector<uint64_t> ids;
+            std::vector<string>   ciphertexts;
+
+            auto stats = cipher.encrypt_records(
+                records,
+                [&](uint64_t id, const uint8_t* ct, size_t len) {
+                    ids.push_back(id);
+                    ciphertexts.emplace_back(
+                        reinterpret_cast<const char*>(ct), len);
+                },
+                n_threads);
+
+            // the output follows the order of the input
+            ASSERT_EQ(ids.size(), records.size());
+            size_t pt_bytes = 0;
+            size_t ct_bytes = 0;
+            for (size_t i = 0; i < records.size(); i++) {
+                ASSERT_EQ(ids[i], records[i].first);
+
+                string out;
+                cipher.decrypt(ciphertexts[i], out);
+                ASSERT_EQ(out, records[i].second);
+
+                pt_bytes += records[i].second.size();
+                ct_bytes += ciphertexts[i].size();
+            }
+            ASSERT_EQ(stats.records, records.size());
+            ASSERT_EQ(stats.plaintext_bytes, pt_bytes);
+            ASSERT_EQ(stats.ciphertext_bytes, ct_bytes);
+            ASSERT_GT(stats.bytes_per_second(), 0.);
+        }
+
+        // empty collection
+        size_t n_calls = 0;
+        auto   stats   = cipher.encrypt_records(
+            {}, [&](uint64_t, const uint8_t*, size_t) { n_calls++; }, 4);
+        ASSERT_EQ(n_calls, 0);
+        ASSERT_EQ(stats.records, 0);
+
+        // invalid record: nothing is encrypted
+        ASSERT_THROW(
+            cipher.encrypt_records(
+                {Record(0, "a"), Record(1, ""), Record(2, "b")},
+                [&](uint64_t, const uint8_t*, size_t) { n_calls++; }),
+            std::invalid_argument);
+        ASSERT_EQ(n_calls, 0);
+
+        // exceptions thrown by the output stop the encryption
+        for (unsigned int n_threads : {1, 4}) {
+            n_calls = 0;
+            ASSERT_THROW(cipher.encrypt_records(
+                             records,
+                             [&](uint64_t, const uint8_t*, size_t) {
+                                 if (++n_calls == 500) {
+                                     throw std::runtime_error("sink error");
+                                 }
+                             },
+                             n_threads),
+                         std::runtime_error);
+            ASSERT_EQ(n_calls, 500);
+        }
+    }
+}
+
+// In all the batch functions, n_threads = 0 stands for one thread per
+// hardware thread, and the default is to only use the calling thread
+TEST(encryption, batch_thread_count)
+{
+    using Mode   = sse::crypto::Cipher::Mode;
+    using Record = sse::crypto::Cipher::Record;
+
+    sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(),
+                               Mode::kChaCha20Poly1305);
+
+    std::vector<string> in;
+    std::vector<Record> records;
+    for (size_t i = 0; i < 500; i++) {
+        in.push_back(sse::crypto::random_string(1 + (i % 200)));
+        records.emplace_back(i, in.back());
+    }
+
+    std::vector<uint8_t>  arena;
+    std::vector<size_t>   offsets;
+    std::vector<uint64_t> status;
+    cipher.encrypt_batch(in, arena, offsets, 0);
+
+    std::vector<string> ciphertexts;
+    for (size_t i = 0; i < in.size(); i++) {
+        ciphertexts.emplace_back(
+            reinterpret_cast<const char*>(arena.data()) + offsets[i],
+            offsets[i + 1] - offsets[i]);
+    }
+    ASSERT_EQ(cipher.decrypt_batch(ciphertexts, arena, offsets, status, 0),
+              in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        ASSERT_EQ(string(reinterpret_cast<const char*>(arena.data())
+                             + offsets[i],
+                         offsets[i + 1] - offsets[i]),
+                  in[i]);
+    }
+
+    const unsigned int hardware_threads
+        = std::max(std::thread::hardware_concurrency(), 1U);
+
+    for (bool default_threads : {true, false}) {
+        std::set<std::thread::id> sink_threads;
+        std::vector<string>       out;
+
+        auto sink = [&](uint64_t id, const uint8_t* ct, size_t len) {
+            ASSERT_EQ(id, out.size());
+            sink_threads.insert(std::this_thread::get_id());
+            out.emplace_back(reinterpret_cast<const char*>(ct), len);
+        };
+        if (default_threads) {
+            cipher.encrypt_records(records, sink);
+        } else {
+            cipher.encrypt_records(records, sink, 0);
+        }
+
+        ASSERT_EQ(out.size(), records.size());
+        for (size_t i = 0; i < records.size(); i++) {
+            string dec;
+            cipher.decrypt(out[i], dec);
+            ASSERT_EQ(dec, records[i].second);
+        }
+
+        if (default_threads) {
+            ASSERT_EQ(sink_threads,
+                      std::set<std::thread::id>({std::this_thread::get_id()}));
+        } else {
+            ASSERT_LE(sink_threads.size(), hardware_threads);
+        }
+    }
+}
+
+TEST(encryption, aes256gcm)
+{
+    using Mode = sse::crypto::Cipher::Mode;
+
+    ASSERT_TRUE(sse::crypto::Cipher::is_available(Mode::kChaCha20Poly1305));
+    ASSERT_TRUE(sse::crypto::Cipher::is_available(Mode::kXChaCha20Poly1305));
+
+    if (!sse::crypto::Cipher::is_available(Mode::kAES256GCM)) {
+        ASSERT_EQ(sse::crypto::Cipher::preferred_mode(),
+                  Mode::kXChaCha20Poly1305);
+        ASSERT_THROW(sse::crypto::Cipher(sse::crypto::Key<kCipherKeySize>(),
+                                         Mode::kAES256GCM),
+                     std::runtime_error);
+        std::cerr << "AES-256-GCM is not available on this CPU\n";
+        return;
+    }
+    ASSERT_EQ(sse::crypto::Cipher::preferred_mode(), Mode::kAES256GCM);
+
+    array<uint8_t, kCipherKeySize> k;
+    sse::crypto::random_bytes(k.size(), k.data());
+    array<uint8_t, kCipherKeySize> k_cp = k;
+
+    sse::crypto::Cipher cipher(sse::crypto::Key<kCipherKeySize>(k.data()),
+                               Mode::kAES256GCM);
+    ASSERT_EQ(cipher.mode(), Mode::kAES256GCM);
+
+    for (size_t len : {1, 16, 30, 64, 100, 1000, 100000}) {
+        string in_enc = sse::crypto::random_string(len);
+        string out_enc, out_dec;
+
+        cipher.encrypt(in_enc, out_enc);
+        ASSERT_EQ(out_enc.size(),
+                  sse::crypto::Cipher::ciphertext_length(len,
+                                                         Mode::kAES256GCM));
+        ASSERT_EQ(sse::crypto::Cipher::plaintext_length(out_enc.size(),
+                                                        Mode::kAES256GCM),
+                  len);
+        ASSERT_EQ(out_enc[0], 0x03);
+
+        cipher.decrypt(out_enc, out_dec);
+        ASSERT_EQ(in_enc, out_dec);
+    }
+
+    // check the format against libsodium's AES-256-GCM, with the key
+    // derived from the nonce
+    string in_enc = "This is a test input.";
+    string out_enc, out_dec;
+    cipher.encrypt(in_enc, out_enc);
+
+    const auto* c = reinterpret_cast<const uint8_t*>(out_enc.data());
+    uint8_t     gcm_key[crypto_aead_aes256gcm_KEYBYTES];
+    uint8_t     personal[crypto_generichash_blake2b_PERSONALBYTES]
+        = "aes_gcm_key";
+    const uint8_t iv[crypto_aead_aes256gcm_NPUBBYTES] = {0};
+    crypto_generichash_blake2b_salt_personal(gcm_key,
+                                             sizeof(gcm_key),
+                                             nullptr,
+                                             0,
+                                             k_cp.data(),
+                                             k_cp.size(),
+                                             c + 1,
+                                             personal);
+
+    std::vector<uint8_t> m(in_enc.size());
+    unsigned long long   m_len = 0; // NOLINT
+    ASSERT_EQ(crypto_aead_aes256gcm_decrypt(
+                  m.data(),
+                  &m_len,
+                  nullptr,
+                  c + 1 + crypto_generichash_blake2b_SALTBYTES,
+                  out_enc.size() - 1 - crypto_generichash_blake2b_SALTBYTES,
+                  c,
+                  1,
+                  iv,
+                  gcm_key),
+              0);
+    ASSERT_EQ(string(m.begin(), m.end()), in_enc);
+
+    // tampering and mode mismatch
+    string in_dec = out_enc;
+    in_dec[0]     = 0x01;
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
+    in_dec = out_enc;
+    in_dec[5] ^= 0x01;
+    ASSERT_THROW(cipher.decrypt(in_dec, out_dec), std::runtime_error);
+
+    sse::crypto::Cipher xchacha_cipher(
+        sse::crypto::Key<kCipherKeySize>(k_cp.data()),
+        Mode::kXChaCha20Poly1305);
+    ASSERT_THROW(xchacha_cipher.decrypt(out_enc, out_dec),
+                 std::runtime_error);
+
+    ASSERT_THROW(cipher.encrypt("", out_enc), std::invalid_argument);
+    ASSERT_THROW(cipher.decrypt(string(32, 'a'), out_dec),
+                 std::invalid_argument);
+}
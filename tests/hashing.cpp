@@ -35,6 +35,7 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -186,6 +187,40 @@ TEST(blake2, blake2b)
     }
 }
 
+TEST(blake2, blake2b_many)
+{
+    // hash the messages of the test vectors at once: the messages of the
+    // parallel lanes have different lengths
+    constexpr size_t IN_LENGTH = 256;
+
+    uint8_t in[IN_LENGTH] = {0};
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = i;
+    }
+
+    std::vector<const unsigned char*> ins(IN_LENGTH, in);
+    std::vector<size_t>               lens(IN_LENGTH);
+    // the second half of the messages is in reverse order
+    for (size_t i = 0; i < IN_LENGTH; ++i) {
+        lens[i] = (i < IN_LENGTH / 2) ? i
+                                      : (IN_LENGTH - 1) - (i - IN_LENGTH / 2);
+    }
+
+    std::vector<uint8_t> hashes(IN_LENGTH
+                                * sse::crypto::hash::blake2b::kDigestSize);
+    sse::crypto::hash::blake2b::hash_many(
+        ins.data(), lens.data(), IN_LENGTH, hashes.data());
+
+    for (size_t i = 0; i < IN_LENGTH; ++i) {
+        string ref_string(reinterpret_cast<const char*>(blake2b_kat[lens[i]]),
+                          sse::crypto::hash::blake2b::kDigestSize);
+        string out_string(reinterpret_cast<const char*>(hashes.data())
+                              + i * sse::crypto::hash::blake2b::kDigestSize,
+                          sse::crypto::hash::blake2b::kDigestSize);
+
+        ASSERT_EQ(ref_string, out_string);
+    }
+}
 
 TEST(hash, consistency)
 {
@@ -213,6 +248,57 @@ TEST(hash, consistency)
     }
 }
 
+TEST(hash, hash_many)
+{
+    constexpr size_t kNumBuffers = 37;
+
+    std::vector<std::string>          in(kNumBuffers);
+    std::vector<const unsigned char*> ins(kNumBuffers);
+    std::vector<size_t>               lens(kNumBuffers);
+    for (size_t i = 0; i < kNumBuffers; i++) {
+        in[i]   = std::string(7 * i, static_cast<char>(i));
+        ins[i]  = reinterpret_cast<const unsigned char*>(in[i].data());
+        lens[i] = in[i].size();
+    }
+
+    const size_t out_lens[] = {1, 32, sse::crypto::Hash::kDigestSize};
+    for (size_t out_len : out_lens) {
+        std::vector<unsigned char> out(kNumBuffers * out_len);
+        sse::crypto::Hash::hash_many(
+            ins.data(), lens.data(), kNumBuffers, out_len, out.data());
+
+        for (size_t i = 0; i < kNumBuffers; i++) {
+            ASSERT_EQ(sse::crypto::Hash::hash(in[i], out_len),
+                      std::string(out.begin() + i * out_len,
+                                  out.begin() + (i + 1) * out_len));
+        }
+    }
+
+    unsigned char out[sse::crypto::Hash::kDigestSize];
+    ASSERT_THROW(sse::crypto::Hash::hash_many(ins.data(),
+                                              lens.data(),
+                                              1,
+                                              sse::crypto::Hash::kDigestSize
+                                                  + 1,
+                                              out),
+                 std::invalid_argument);
+    ASSERT_THROW(
+        sse::crypto::Hash::hash_many(nullptr, lens.data(), 1, 1, out),
+        std::invalid_argument);
+    ASSERT_THROW(
+        sse::crypto::Hash::hash_many(ins.data(), lens.data(), 1, 1, nullptr),
+        std::invalid_argument);
+
+    // empty buffers can be NULL
+    ins[0] = nullptr;
+    sse::crypto::Hash::hash_many(ins.data(), lens.data(), 1, 1, out);
+
+    ins[1] = nullptr;
+    ASSERT_THROW(
+        sse::crypto::Hash::hash_many(ins.data(), lens.data(), 2, 1, out),
+        std::invalid_argument);
+}
+
 TEST(hash, exceptions)
 {
     std::string in;
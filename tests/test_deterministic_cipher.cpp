@@ -0,0 +1,234 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#if __AES__ || __ARM_FEATURE_CRYPTO /* Defined by gcc/clang when compiling for \
+                                       AES-NI */
+
+#include "../src/deterministic_cipher.hpp"
+#include "../src/random.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using sse::crypto::DeterministicCipher;
+using sse::crypto::Key;
+
+static Key<DeterministicCipher::kKeySize> fixed_key()
+{
+    std::array<uint8_t, DeterministicCipher::kKeySize> k;
+    for (size_t i = 0; i < k.size(); i++) {
+        k[i] = static_cast<uint8_t>(i);
+    }
+    return Key<DeterministicCipher::kKeySize>(k.data());
+}
+
+TEST(deterministic_cipher, correctness)
+{
+    // cover the AEZ code paths: empty messages, short messages (less than 32
+    // bytes with the expansion), and long ones with all the fragment sizes
+    const std::vector<size_t> lengths
+        = {0, 1, 2, 3, 8, 15, 16, 17, 31, 32, 33, 47, 48, 64, 100, 1000, 4097};
+
+    for (unsigned expansion = DeterministicCipher::kMinExpansion;
+         expansion <= DeterministicCipher::kMaxExpansion;
+         expansion++) {
+        DeterministicCipher cipher(expansion);
+        ASSERT_EQ(cipher.expansion(), expansion);
+
+        for (size_t len : lengths) {
+            const std::string label = sse::crypto::random_string(
+                len % (DeterministicCipher::kMaxLabelSize + 1));
+            const std::string in = sse::crypto::random_string(len);
+
+            std::string ct = cipher.encrypt(label, in);
+            ASSERT_EQ(ct.size(), len + expansion);
+            ASSERT_EQ(cipher.ciphertext_length(len), ct.size());
+            ASSERT_EQ(cipher.plaintext_length(ct.size()), len);
+
+            std::string dec;
+            cipher.decrypt(label, ct, dec);
+            ASSERT_EQ(dec, in);
+        }
+    }
+}
+
+// The buffers have the exact size of the messages, so that out-of-bounds
+// accesses are caught by the address sanitizer
+TEST(deterministic_cipher, exact_size_buffers)
+{
+    const std::vector<size_t> lengths = {1, 16, 17, 31, 32, 33, 47, 48, 100};
+
+    for (unsigned expansion = DeterministicCipher::kMinExpansion;
+         expansion <= DeterministicCipher::kMaxExpansion;
+         expansion++) {
+        DeterministicCipher cipher(expansion);
+
+        for (size_t len : lengths) {
+            const std::string label = sse::crypto::random_string(8);
+            const std::string in    = sse::crypto::random_string(len);
+
+            std::unique_ptr<uint8_t[]> plaintext(new uint8_t[len]);
+            std::unique_ptr<uint8_t[]> ciphertext(
+                new uint8_t[len + expansion]);
+            std::unique_ptr<uint8_t[]> decrypted(new uint8_t[len]);
+            std::copy(in.begin(), in.end(), plaintext.get());
+
+            cipher.encrypt(reinterpret_cast<const uint8_t*>(label.data()),
+                           label.size(),
+                           plaintext.get(),
+                           len,
+                           ciphertext.get());
+            ASSERT_EQ(std::string(reinterpret_cast<char*>(ciphertext.get()),
+                                  len + expansion),
+                      cipher.encrypt(label, in));
+
+            cipher.decrypt(reinterpret_cast<const uint8_t*>(label.data()),
+                           label.size(),
+                           ciphertext.get(),
+                           len + expansion,
+                           decrypted.get());
+            ASSERT_EQ(
+                std::string(reinterpret_cast<char*>(decrypted.get()), len),
+                in);
+        }
+    }
+}
+
+TEST(deterministic_cipher, determinism)
+{
+    DeterministicCipher cipher_1(fixed_key());
+    DeterministicCipher cipher_2(fixed_key());
+    DeterministicCipher cipher_3(fixed_key(), 8);
+
+    const std::string in = "deterministic encryption";
+
+    // same key and label: same ciphertext
+    ASSERT_EQ(cipher_1.encrypt("label", in), cipher_2.encrypt("label", in));
+
+    // the label and the expansion are bound to the ciphertext
+    ASSERT_NE(cipher_1.encrypt("label", in), cipher_1.encrypt("label2", in));
+    ASSERT_NE(cipher_1.encrypt("label", in), cipher_1.encrypt("", in));
+    ASSERT_NE(cipher_1.encrypt("label", in).substr(0, in.size() + 8),
+              cipher_3.encrypt("label", in));
+}
+
+TEST(deterministic_cipher, test_vectors)
+{
+    // regression vectors, with the key 00 01 02 ... 2f
+    DeterministicCipher cipher(fixed_key());
+    DeterministicCipher short_cipher(fixed_key(), 4);
+
+    auto bytes = [](const std::string& s) {
+        return std::vector<uint8_t>(s.begin(), s.end());
+    };
+
+    EXPECT_EQ(bytes(cipher.encrypt("", "")),
+              std::vector<uint8_t>({0xEE, 0x29, 0x42, 0x93, 0xFF, 0x71,
+                                    0x29, 0x90, 0x83, 0xDF, 0x45, 0x7D,
+                                    0x17, 0xE9, 0x38, 0x6F}));
+    EXPECT_EQ(bytes(cipher.encrypt("label", "message")),
+              std::vector<uint8_t>({0x83, 0xDC, 0xD1, 0x40, 0xF6, 0x63,
+                                    0x44, 0xE3, 0x60, 0x67, 0x70, 0xD6,
+                                    0x71, 0xD6, 0x5F, 0x77, 0x45, 0x75,
+                                    0xDF, 0xD0, 0x6D, 0xF5, 0x09}));
+    EXPECT_EQ(bytes(short_cipher.encrypt("label", "id")),
+              std::vector<uint8_t>({0x66, 0xCA, 0xC1, 0x4B, 0xBD, 0x40}));
+}
+
+TEST(deterministic_cipher, authentication)
+{
+    DeterministicCipher cipher(fixed_key(), 8);
+
+    const std::string label = "keyword";
+    for (size_t len : {0, 5, 30, 100}) {
+        const std::string in = sse::crypto::random_string(len);
+        const std::string ct = cipher.encrypt(label, in);
+
+        // wrong label
+        EXPECT_THROW(cipher.decrypt("keyword2", ct), std::runtime_error);
+
+        // wrong key
+        DeterministicCipher other(8);
+        EXPECT_THROW(other.decrypt(label, ct), std::runtime_error);
+
+        // tampered ciphertexts
+        for (size_t i = 0; i < ct.size(); i++) {
+            std::string tampered = ct;
+            tampered[i] ^= 0x01;
+            EXPECT_THROW(cipher.decrypt(label, tampered), std::runtime_error);
+        }
+
+        // the output is erased on failure
+        std::string tampered = ct;
+        tampered[0] ^= 0x80;
+        std::vector<uint8_t> out(len, 0xAA);
+        EXPECT_THROW(
+            cipher.decrypt(reinterpret_cast<const uint8_t*>(label.data()),
+                           label.size(),
+                           reinterpret_cast<const uint8_t*>(tampered.data()),
+                           tampered.size(),
+                           out.data()),
+            std::runtime_error);
+        EXPECT_EQ(out, std::vector<uint8_t>(len, 0x00));
+    }
+}
+
+TEST(deterministic_cipher, exceptions)
+{
+    EXPECT_THROW(DeterministicCipher(DeterministicCipher::kMinExpansion - 1),
+                 std::invalid_argument);
+    EXPECT_THROW(DeterministicCipher(DeterministicCipher::kMaxExpansion + 1),
+                 std::invalid_argument);
+
+    DeterministicCipher cipher;
+    const std::string   long_label(DeterministicCipher::kMaxLabelSize + 1, 'a');
+    uint8_t             buf[32];
+
+    EXPECT_THROW(cipher.encrypt(long_label, "plaintext"),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.decrypt(long_label, std::string(32, 'a')),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.decrypt("label", std::string(15, 'a')),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.plaintext_length(15), std::invalid_argument);
+
+    EXPECT_THROW(cipher.encrypt(nullptr, 1, buf, 16, buf),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.encrypt(buf, 1, nullptr, 16, buf),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.encrypt(buf, 1, buf, 16, nullptr),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.decrypt(nullptr, 1, buf, 32, buf),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.decrypt(buf, 1, nullptr, 32, buf),
+                 std::invalid_argument);
+    EXPECT_THROW(cipher.decrypt(buf, 1, buf, 32, nullptr),
+                 std::invalid_argument);
+}
+
+#else
+#warning DeterministicCipher is disabled (requires support of AES instructions)
+#endif
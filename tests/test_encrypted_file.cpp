@@ -0,0 +1,392 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "../src/encrypted_file.hpp"
+#include "../src/random.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <csignal>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using sse::crypto::EncryptedFileReader;
+using sse::crypto::EncryptedFileWriter;
+using sse::crypto::Key;
+
+static constexpr size_t kFileKeySize = EncryptedFileWriter::kKeySize;
+static constexpr size_t kPage        = EncryptedFileWriter::kPageSize;
+
+// Creates an empty temporary file, and returns its path
+static std::string temporary_path()
+{
+    char path[] = "/tmp/sse_crypto_file_XXXXXX";
+    int  fd     = mkstemp(path);
+    if (fd != -1) {
+        close(fd);
+    }
+    return path;
+}
+
+// Creates an empty temporary directory, and returns its path
+static std::string temporary_directory()
+{
+    char path[] = "/tmp/sse_crypto_dir_XXXXXX";
+    if (mkdtemp(path) == nullptr) {
+        return "/tmp";
+    }
+    return path;
+}
+
+// Returns the number of entries of a directory (. and .. excluded)
+static size_t directory_size(const std::string& dir)
+{
+    size_t n = 0;
+    DIR*   d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return 0;
+    }
+    for (struct dirent* e = readdir(d); e != nullptr; e = readdir(d)) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            n++;
+        }
+    }
+    closedir(d);
+    return n;
+}
+
+static void write_file(const std::array<uint8_t, kFileKeySize>& key,
+                       const std::string&                       path,
+                       const std::string&                       content,
+                       const size_t                             chunk_size,
+                       const size_t                             write_size)
+{
+    std::array<uint8_t, kFileKeySize> k = key;
+    EncryptedFileWriter writer(Key<kFileKeySize>(k.data()), path, chunk_size);
+
+    for (size_t pos = 0; pos < content.size(); pos += write_size) {
+        writer.write(content.substr(pos, write_size));
+    }
+    ASSERT_EQ(writer.size(), content.size());
+    writer.close();
+}
+
+static void corrupt_byte(const std::string& path, const off_t offset)
+{
+    int     fd = open(path.c_str(), O_RDWR);
+    uint8_t c  = 0;
+    ASSERT_EQ(pread(fd, &c, 1, offset), 1);
+    c ^= 0x01;
+    ASSERT_EQ(pwrite(fd, &c, 1, offset), 1);
+    close(fd);
+}
+
+TEST(encrypted_file, correctness)
+{
+    std::array<uint8_t, kFileKeySize> key;
+    sse::crypto::random_bytes(key.size(), key.data());
+
+    const std::string path = temporary_path();
+
+    for (size_t chunk_size : {kPage, 4 * kPage}) {
+        for (size_t len : {size_t(0),
+                           size_t(1),
+                           chunk_size - 1,
+                           chunk_size,
+                           chunk_size + 1,
+                           20 * chunk_size + 100}) {
+            const std::string content = sse::crypto::random_string(len);
+
+            // write with calls of various sizes
+            for (size_t write_size : {size_t(1000), 3 * chunk_size}) {
+                write_file(key, path, content, chunk_size, write_size);
+
+                std::array<uint8_t, kFileKeySize> k = key;
+                EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+                ASSERT_EQ(reader.size(), len);
+                ASSERT_EQ(reader.chunk_size(), chunk_size);
+
+                // whole file
+                ASSERT_EQ(reader.read(0, len), content);
+
+                // random ranges, crossing chunk boundaries
+                for (size_t i = 0; i < 50 && len > 0; i++) {
+                    uint64_t r[2];
+                    sse::crypto::random_bytes(
+                        sizeof(r), reinterpret_cast<uint8_t*>(r));
+                    const size_t offset = r[0] % len;
+                    const size_t n      = r[1] % (len - offset + 1);
+                    ASSERT_EQ(reader.read(offset, n),
+                              content.substr(offset, n));
+                }
+            }
+
+            // the layout of the file
+            int fd = open(path.c_str(), O_RDONLY);
+            ASSERT_EQ(lseek(fd, 0, SEEK_END),
+                      static_cast<off_t>(
+                          EncryptedFileWriter::file_size(len, chunk_size)));
+            close(fd);
+        }
+    }
+    unlink(path.c_str());
+}
+
+TEST(encrypted_file, authentication)
+{
+    std::array<uint8_t, kFileKeySize> key;
+    sse::crypto::random_bytes(key.size(), key.data());
+
+    const std::string path       = temporary_path();
+    const size_t      chunk_size = kPage;
+    const std::string content    = sse::crypto::random_string(5 * kPage + 10);
+
+    write_file(key, path, content, chunk_size, content.size());
+
+    // wrong key
+    ASSERT_THROW(EncryptedFileReader(Key<kFileKeySize>(), path),
+                 std::runtime_error);
+
+    // tampered header
+    corrupt_byte(path, 16);
+    {
+        std::array<uint8_t, kFileKeySize> k = key;
+        ASSERT_THROW(EncryptedFileReader(Key<kFileKeySize>(k.data()), path),
+                     std::runtime_error);
+    }
+    corrupt_byte(path, 16);
+
+    // tampered chunk: only the reads touching the chunk fail
+    corrupt_byte(path, kPage + 2 * chunk_size + 100);
+    {
+        std::array<uint8_t, kFileKeySize> k = key;
+        EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+
+        ASSERT_EQ(reader.read(0, 2 * chunk_size),
+                  content.substr(0, 2 * chunk_size));
+        ASSERT_EQ(reader.read(3 * chunk_size, 100),
+                  content.substr(3 * chunk_size, 100));
+
+        std::vector<uint8_t> out(200, 0xAA);
+        ASSERT_THROW(reader.read(2 * chunk_size - 100, out.size(), out.data()),
+                     std::runtime_error);
+        // the output is erased
+        ASSERT_EQ(out, std::vector<uint8_t>(out.size(), 0x00));
+    }
+    corrupt_byte(path, kPage + 2 * chunk_size + 100);
+
+    // tampered tag of the last chunk
+    corrupt_byte(path, kPage + 6 * chunk_size + 5 * 16 + 3);
+    {
+        std::array<uint8_t, kFileKeySize> k = key;
+        EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+        ASSERT_THROW(reader.read(content.size() - 1, 1), std::runtime_error);
+    }
+
+    // truncated file
+    ASSERT_EQ(truncate(path.c_str(), kPage + 6 * chunk_size), 0);
+    {
+        std::array<uint8_t, kFileKeySize> k = key;
+        ASSERT_THROW(EncryptedFileReader(Key<kFileKeySize>(k.data()), path),
+                     std::runtime_error);
+    }
+
+    // file modified or truncated after being opened
+    write_file(key, path, content, chunk_size, content.size());
+    {
+        std::array<uint8_t, kFileKeySize> k = key;
+        EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+        ASSERT_EQ(reader.read(10, 100), content.substr(10, 100));
+
+        corrupt_byte(path, kPage + 50);
+        ASSERT_THROW(reader.read(10, 100), std::runtime_error);
+        corrupt_byte(path, kPage + 50);
+        ASSERT_EQ(reader.read(10, 100), content.substr(10, 100));
+
+        // the chunk index is lost: reads fail, without crashing the reader
+        ASSERT_EQ(truncate(path.c_str(), kPage + chunk_size), 0);
+        ASSERT_THROW(reader.read(10, 100), std::runtime_error);
+        ASSERT_THROW(reader.read(3 * chunk_size, 100), std::runtime_error);
+    }
+
+    unlink(path.c_str());
+}
+
+TEST(encrypted_file, exceptions)
+{
+    const std::string path = temporary_path();
+
+    ASSERT_THROW(EncryptedFileWriter(Key<kFileKeySize>(), path, 0),
+                 std::invalid_argument);
+    ASSERT_THROW(EncryptedFileWriter(Key<kFileKeySize>(), path, 1000),
+                 std::invalid_argument);
+    ASSERT_THROW(EncryptedFileWriter(Key<kFileKeySize>(),
+                                     path,
+                                     2 * EncryptedFileWriter::kMaxChunkSize),
+                 std::invalid_argument);
+    ASSERT_THROW(
+        EncryptedFileWriter(Key<kFileKeySize>(), "/nonexistent/dir/file"),
+        std::runtime_error);
+
+    std::array<uint8_t, kFileKeySize> key;
+    sse::crypto::random_bytes(key.size(), key.data());
+    std::array<uint8_t, kFileKeySize> k = key;
+    {
+        EncryptedFileWriter writer(Key<kFileKeySize>(k.data()), path);
+        ASSERT_THROW(writer.write(nullptr, 1), std::invalid_argument);
+        writer.write("0123456789");
+        writer.close();
+        writer.close();
+        ASSERT_THROW(writer.write("a"), std::runtime_error);
+    }
+
+    // a writer destroyed before being closed abandons its file: the existing
+    // file is left untouched
+    k = key;
+    {
+        EncryptedFileWriter writer(Key<kFileKeySize>(k.data()), path);
+        writer.write("abandoned");
+    }
+
+    k = key;
+    EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+    uint8_t             buf[16];
+    ASSERT_THROW(reader.read(0, 11), std::invalid_argument);
+    ASSERT_THROW(reader.read(11, 0), std::invalid_argument);
+    ASSERT_THROW(reader.read(5, UINT64_MAX), std::invalid_argument);
+    ASSERT_THROW(reader.read(0, 1, nullptr), std::invalid_argument);
+    ASSERT_EQ(reader.read(10, 0), "");
+    reader.read(2, 4, buf);
+    ASSERT_EQ(std::string(reinterpret_cast<char*>(buf), 4), "2345");
+
+    // not an encrypted file
+    ASSERT_EQ(truncate(path.c_str(), 100), 0);
+    k = key;
+    ASSERT_THROW(EncryptedFileReader(Key<kFileKeySize>(k.data()), path),
+                 std::runtime_error);
+    ASSERT_THROW(EncryptedFileReader(Key<kFileKeySize>(), "/nonexistent"),
+                 std::runtime_error);
+
+    unlink(path.c_str());
+}
+
+// Limits the size of the files written by the process, so that writes fail
+// with EFBIG, until destruction
+struct FileSizeLimit
+{
+    explicit FileSizeLimit(const rlim_t limit)
+    {
+        getrlimit(RLIMIT_FSIZE, &saved_limit);
+        saved_handler = signal(SIGXFSZ, SIG_IGN);
+
+        struct rlimit l = saved_limit;
+        l.rlim_cur      = limit;
+        setrlimit(RLIMIT_FSIZE, &l);
+    }
+
+    ~FileSizeLimit()
+    {
+        setrlimit(RLIMIT_FSIZE, &saved_limit);
+        signal(SIGXFSZ, saved_handler);
+    }
+
+    struct rlimit saved_limit;
+    void (*saved_handler)(int);
+};
+
+TEST(encrypted_file, write_failure)
+{
+    const std::string dir  = temporary_directory();
+    const std::string path = dir + "/file";
+
+    const std::string content
+        = sse::crypto::random_string(2 * EncryptedFileWriter::kWriteBatchSize);
+
+    // an existing file, which must survive the failures
+    std::array<uint8_t, kFileKeySize> key;
+    sse::crypto::random_bytes(key.size(), key.data());
+    write_file(key, path, "existing", kPage, 8);
+
+    // a writer destroyed before being closed deletes its temporary file
+    {
+        EncryptedFileWriter writer(Key<kFileKeySize>(), path, kPage);
+        writer.write(content.substr(0, 3 * kPage));
+        ASSERT_EQ(directory_size(dir), 2);
+    }
+    ASSERT_EQ(directory_size(dir), 1);
+
+    {
+        FileSizeLimit limit(2 * kPage);
+
+        // failure when a batch is flushed
+        {
+            EncryptedFileWriter writer(Key<kFileKeySize>(), path, kPage);
+            writer.write(content.substr(0, 100));
+            ASSERT_THROW(writer.write(content), std::runtime_error);
+            ASSERT_LT(writer.size(), content.size() + 100);
+
+            // the writer is in a failed state
+            ASSERT_THROW(writer.write(content.substr(0, 100)),
+                         std::runtime_error);
+            ASSERT_THROW(writer.write(content), std::runtime_error);
+            ASSERT_THROW(writer.close(), std::runtime_error);
+            ASSERT_THROW(writer.close(), std::runtime_error);
+        }
+
+        // failure when the file is closed
+        {
+            EncryptedFileWriter writer(Key<kFileKeySize>(), path, kPage);
+            writer.write(content.substr(0, 3 * kPage + 10));
+            ASSERT_THROW(writer.close(), std::runtime_error);
+            ASSERT_THROW(writer.write("a"), std::runtime_error);
+            ASSERT_THROW(writer.close(), std::runtime_error);
+        }
+
+        // the writer is destroyed after a failure
+        ASSERT_THROW(
+            {
+                EncryptedFileWriter writer(Key<kFileKeySize>(), path, kPage);
+                writer.write(content.substr(0, kPage + 10));
+                writer.write(content);
+            },
+            std::runtime_error);
+    }
+
+    // the temporary files are deleted, and the existing file is intact
+    ASSERT_EQ(directory_size(dir), 1);
+    std::array<uint8_t, kFileKeySize> k = key;
+    EncryptedFileReader reader(Key<kFileKeySize>(k.data()), path);
+    ASSERT_EQ(reader.read(0, reader.size()), "existing");
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
@@ -0,0 +1,176 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Jeremy Maitin-Shepard, Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "lt_hash.hpp"
+#include "random.hpp"
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Size in bytes of the elements hashed
+constexpr size_t kNumTests     = 20;
+constexpr size_t kTestEltsSize = 100;
+constexpr size_t kNumEltsBatch = 20;
+
+using sse::crypto::LtHash;
+
+
+TEST(lt_hash, constructors)
+{
+    for (size_t i = 0; i < kNumTests; i++) {
+        LtHash a;
+        a.add_element(sse::crypto::random_string(kTestEltsSize));
+
+        LtHash b(a), c, d, e(a.data());
+        c = a;
+        d = a;
+
+        LtHash f(std::move(d));
+        ASSERT_EQ(a, b);
+        ASSERT_EQ(a, c);
+        ASSERT_EQ(a, e);
+        ASSERT_EQ(a, f);
+        ASSERT_EQ(a.digest(), f.digest());
+    }
+}
+
+TEST(lt_hash, commutativity)
+{
+    for (size_t i = 0; i < kNumTests; i++) {
+        LtHash a, b;
+
+        std::string e_1 = sse::crypto::random_string(kTestEltsSize);
+        std::string e_2 = sse::crypto::random_string(kTestEltsSize);
+
+        a.add_element(e_1);
+        a.add_element(e_2);
+
+        b.add_element(e_2);
+        b.add_element(e_1);
+
+        ASSERT_EQ(a, b);
+        ASSERT_EQ(a.digest(), b.digest());
+    }
+}
+
+TEST(lt_hash, add_remove)
+{
+    for (size_t i = 0; i < kNumTests; i++) {
+        LtHash a, b, I;
+
+        std::string e_1 = sse::crypto::random_string(kTestEltsSize);
+        std::string e_2 = sse::crypto::random_string(kTestEltsSize);
+
+        a.add_element(e_1);
+        b = a;
+        ASSERT_EQ(a, b);
+
+        a.add_element(e_2);
+        ASSERT_NE(a, b);
+        ASSERT_NE(a.digest(), b.digest());
+
+        a.remove_element(e_2);
+        ASSERT_EQ(a, b);
+
+        // removing an element that was never added and adding it back
+        b.remove_element(e_2);
+        b.add_element(e_2);
+        ASSERT_EQ(a, b);
+
+        a.remove_element(e_1);
+        ASSERT_EQ(a, I);
+    }
+}
+
+TEST(lt_hash, sets)
+{
+    for (size_t i = 0; i < kNumTests; i++) {
+        LtHash a, b, c, I;
+
+        std::string e_1 = sse::crypto::random_string(kTestEltsSize);
+        std::string e_2 = sse::crypto::random_string(kTestEltsSize);
+
+        a.add_element(e_1);
+        b.add_element(e_2);
+        c.add_element(e_1);
+        c.add_element(e_2);
+
+        LtHash u(a);
+        u.add_set(b);
+        ASSERT_EQ(u, c);
+
+        u.remove_set(a);
+        ASSERT_EQ(u, b);
+
+        u.add_set(I);
+        ASSERT_EQ(u, b);
+        u.remove_set(I);
+        ASSERT_EQ(u, b);
+
+        u.remove_set(b);
+        ASSERT_EQ(u, I);
+    }
+}
+
+TEST(lt_hash, batch_constructor)
+{
+    for (size_t i = 0; i < kNumTests; i++) {
+        std::vector<std::string> samples(kNumEltsBatch);
+        LtHash                   a;
+        for (auto& e : samples) {
+            e = sse::crypto::random_string(kTestEltsSize);
+            a.add_element(e);
+        }
+
+        LtHash b(samples);
+
+        ASSERT_EQ(a, b);
+    }
+}
+
+// The digests must not change with the implementation of the lane arithmetic
+TEST(lt_hash, test_vectors)
+{
+    const std::array<uint8_t, LtHash::kDigestSize> abc_digest
+        = {{0xf3, 0xed, 0xc4, 0x95, 0x75, 0x5f, 0x5b, 0x00, 0xf0, 0x0f, 0x68,
+            0x13, 0x46, 0x30, 0xb7, 0x4c, 0x12, 0xb5, 0xdb, 0x76, 0x3d, 0xf2,
+            0x39, 0x0a, 0x2c, 0x95, 0x35, 0x6d, 0x03, 0x42, 0x89, 0x20}};
+    const std::array<uint8_t, LtHash::kDigestSize> elements_digest
+        = {{0x78, 0xd9, 0x88, 0x48, 0xbb, 0x47, 0xda, 0xd0, 0x74, 0x49, 0x3d,
+            0x07, 0xc2, 0xb8, 0x96, 0x69, 0xa6, 0x29, 0x61, 0xd8, 0x0a, 0x94,
+            0x6d, 0x44, 0x3e, 0x42, 0xe0, 0xaf, 0xff, 0x9a, 0x53, 0x2e}};
+
+    LtHash a;
+    a.add_element("a");
+    a.add_element("b");
+    a.add_element("c");
+    ASSERT_EQ(a.digest(), abc_digest);
+
+    std::vector<std::string> elements;
+    for (size_t i = 0; i < 100; i++) {
+        elements.push_back("element " + std::to_string(i));
+    }
+    LtHash b(elements);
+    ASSERT_EQ(b.digest(), elements_digest);
+}
@@ -24,7 +24,9 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <type_traits>
 
 #include "gtest/gtest.h"
 
@@ -308,6 +310,122 @@ TEST(prg, consistency_4)
     tests::prg_test_key_derivation_consistency<32>();
 }
 
+namespace tests {
+template<size_t K_SIZE>
+void prg_test_key_iterator();
+
+template<size_t K_SIZE>
+void prg_test_key_iterator()
+{
+    constexpr size_t kKeyCount = 2 * TEST_COUNT;
+
+    // dereferencing returns a key by value: only an input iterator
+    using Traits
+        = std::iterator_traits<sse::crypto::Prg::KeyIterator<K_SIZE>>;
+    static_assert(std::is_same<typename Traits::iterator_category,
+                               std::input_iterator_tag>::value,
+                  "KeyIterator must be declared as an input iterator");
+
+    std::array<uint8_t, kPrgKeySize> k{{0x00}};
+    sse::crypto::random_bytes(k);
+
+    sse::crypto::Prg prg(sse::crypto::Key<kPrgKeySize>(k.data()));
+
+    std::array<uint8_t, kKeyCount * K_SIZE> out;
+    prg.derive(0, out.size(), out.data());
+
+    // forward iteration, allocating new keys
+    auto it = prg.key_iterator<K_SIZE>();
+    for (size_t j = 0; j < kKeyCount; j++, ++it) {
+        ASSERT_EQ(it.index(), j);
+        sse::crypto::Key<K_SIZE> key = *it;
+        ASSERT_TRUE(memcmp(key.unlock_get(), out.data() + j * K_SIZE, K_SIZE)
+                    == 0);
+    }
+
+    // backward iteration, in place derivation
+    sse::crypto::Key<K_SIZE> key;
+    auto                     end = prg.key_iterator<K_SIZE>(kKeyCount);
+    for (auto r_it = end - 1; r_it >= prg.key_iterator<K_SIZE>(); r_it--) {
+        const uint8_t* content = key.content_;
+        r_it.derive(key);
+        // no reallocation
+        ASSERT_EQ(content, key.content_);
+        ASSERT_TRUE(memcmp(key.unlock_get(),
+                           out.data() + r_it.index() * K_SIZE,
+                           K_SIZE)
+                    == 0);
+        if (r_it.index() == 0) {
+            break;
+        }
+    }
+
+    // random access
+    auto begin = prg.key_iterator<K_SIZE>();
+    ASSERT_EQ(end - begin, static_cast<int64_t>(kKeyCount));
+    for (size_t j = 0; j < TEST_COUNT; j++) {
+        uint64_t index = sse::crypto::random_bytes<uint8_t, 1>()[0] % kKeyCount;
+        ASSERT_TRUE(memcmp(begin[static_cast<int64_t>(index)].unlock_get(),
+                           out.data() + index * K_SIZE,
+                           K_SIZE)
+                    == 0);
+        ASSERT_TRUE(memcmp((*(end - static_cast<int64_t>(kKeyCount - index)))
+                               .unlock_get(),
+                           out.data() + index * K_SIZE,
+                           K_SIZE)
+                    == 0);
+    }
+
+    // consistency with the 16 bits key derivation
+    auto key_vec = prg.derive_keys<K_SIZE>(TEST_COUNT, 7);
+    auto off_it  = prg.key_iterator<K_SIZE>(7);
+    for (size_t j = 0; j < TEST_COUNT; j++, off_it++) {
+        ASSERT_TRUE(
+            memcmp(key_vec[j].unlock_get(), (*off_it).unlock_get(), K_SIZE)
+            == 0);
+    }
+
+    // indices beyond the 16 bits limit
+    const uint64_t large_index = (1ULL << 40) + 3;
+    std::array<uint8_t, K_SIZE> large_out;
+    prg.derive_64(large_index * K_SIZE, K_SIZE, large_out.data());
+    ASSERT_TRUE(memcmp((*prg.key_iterator<K_SIZE>(large_index)).unlock_get(),
+                       large_out.data(),
+                       K_SIZE)
+                == 0);
+}
+} // namespace tests
+
+TEST(prg, key_iterator)
+{
+    tests::prg_test_key_iterator<16>();
+    tests::prg_test_key_iterator<18>();
+    tests::prg_test_key_iterator<32>();
+    tests::prg_test_key_iterator<100>();
+}
+
+TEST(prg, derive_64)
+{
+    std::array<uint8_t, kPrgKeySize> k{{0x00}};
+    sse::crypto::random_bytes(k);
+    sse::crypto::Prg prg(sse::crypto::Key<kPrgKeySize>(k.data()));
+
+    std::array<uint8_t, 100> out_32, out_64;
+    prg.derive(37, out_32.size(), out_32.data());
+    prg.derive_64(37, out_64.size(), out_64.data());
+    ASSERT_EQ(out_32, out_64);
+
+    // offsets larger than UINT32_MAX
+    const uint64_t offset = (1ULL << 35) + 13;
+    prg.derive_64(offset, out_64.size(), out_64.data());
+    prg.derive_64(offset + 20, 50, out_32.data());
+    ASSERT_TRUE(memcmp(out_64.data() + 20, out_32.data(), 50) == 0);
+
+    ASSERT_THROW(prg.derive_64(UINT64_MAX - 10, 20, out_64.data()),
+                 std::invalid_argument);
+    ASSERT_THROW(prg.derive_64(0, 10, NULL), std::invalid_argument);
+}
+
 TEST(prg, exceptions)
 {
     std::array<uint8_t, kPrgKeySize> k{{0x00}};
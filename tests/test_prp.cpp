@@ -21,12 +21,17 @@
 #if __AES__ || __ARM_FEATURE_CRYPTO /* Defined by gcc/clang when compiling for \
                                        AES-NI */
 
+#include "../src/aez/aez.h"
 #include "../src/prp.hpp"
 #include "../src/random.hpp"
 
+#include <cstring>
+
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -118,6 +123,235 @@ TEST(prp, consistency_64)
     }
 }
 
+// Prp caches the AEZ tweak of the all-zero nonce: check that its outputs are
+// those of AEZ called with this nonce
+TEST(prp, zero_nonce_aez)
+{
+    array<uint8_t, sse::crypto::Prp::kKeySize> key;
+    sse::crypto::random_bytes(key);
+
+    aez_ctx_t ctx;
+    aez_setup(key.data(), static_cast<unsigned>(key.size()), &ctx);
+
+    sse::crypto::Prp fpe(
+        sse::crypto::Key<sse::crypto::Prp::kKeySize>(key.data()));
+
+    const char iv[16] = {0x00};
+
+    for (size_t i = 1; i <= 4 * 16; i++) {
+        string in = sse::crypto::random_string(i);
+        string expected(i, 0x00);
+
+        aez_encrypt(&ctx,
+                    iv,
+                    16,
+                    0,
+                    in.data(),
+                    static_cast<unsigned>(i),
+                    &expected[0]);
+
+        string out = fpe.encrypt(in);
+        ASSERT_EQ(out, expected);
+        ASSERT_EQ(fpe.decrypt(out), in);
+    }
+}
+
+// All the implementations of the AEZ core passes must give the same results
+TEST(prp, core_implementations)
+{
+    const std::vector<size_t> lengths
+        = {32, 33, 255, 256, 257, 300, 511, 512, 513, 1000, 4096 + 17, 1 << 20};
+
+    array<uint8_t, sse::crypto::Prp::kKeySize> key;
+    sse::crypto::random_bytes(key);
+    sse::crypto::Prp fpe(
+        sse::crypto::Key<sse::crypto::Prp::kKeySize>(key.data()));
+
+    std::vector<string> inputs, expected;
+    ASSERT_EQ(aez_set_core_impl(AEZ_IMPL_REFERENCE), 0);
+    for (size_t len : lengths) {
+        inputs.push_back(sse::crypto::random_string(len));
+        expected.push_back(fpe.encrypt(inputs.back()));
+    }
+
+    for (int impl : {AEZ_IMPL_VAES256, AEZ_IMPL_VAES512}) {
+        if (aez_set_core_impl(impl) != 0) {
+            continue; // not supported by the CPU
+        }
+        ASSERT_EQ(aez_core_impl(), impl);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            ASSERT_EQ(fpe.encrypt(inputs[i]), expected[i]);
+            ASSERT_EQ(fpe.decrypt(expected[i]), inputs[i]);
+        }
+    }
+
+    ASSERT_EQ(aez_set_core_impl(AEZ_IMPL_AUTO), 0);
+    ASSERT_NE(aez_core_impl(), AEZ_IMPL_AUTO);
+    ASSERT_EQ(aez_set_core_impl(42), -1);
+}
+
+TEST(prp, batch_32)
+{
+    sse::crypto::Prp fpe;
+
+    for (size_t n : {0, 1, 7, 8, 9, 17, 1000}) {
+        std::vector<uint32_t> in(n), out(n), dec(n);
+        if (n > 0) {
+            sse::crypto::random_bytes(n * sizeof(uint32_t),
+                                      reinterpret_cast<uint8_t*>(in.data()));
+        }
+
+        fpe.encrypt_batch(in.data(), n, out.data());
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(out[i], fpe.encrypt(in[i]));
+        }
+
+        fpe.decrypt_batch(out.data(), n, dec.data());
+        ASSERT_EQ(dec, in);
+
+        // in place evaluation
+        fpe.encrypt_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, out);
+        fpe.decrypt_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, in);
+    }
+}
+
+TEST(prp, batch_64)
+{
+    sse::crypto::Prp fpe;
+
+    for (size_t n : {0, 1, 7, 8, 9, 17, 1000}) {
+        std::vector<uint64_t> in(n), out(n), dec(n);
+        if (n > 0) {
+            sse::crypto::random_bytes(n * sizeof(uint64_t),
+                                      reinterpret_cast<uint8_t*>(in.data()));
+        }
+
+        fpe.encrypt_64_batch(in.data(), n, out.data());
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(out[i], fpe.encrypt_64(in[i]));
+        }
+
+        fpe.decrypt_64_batch(out.data(), n, dec.data());
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(dec[i], fpe.decrypt_64(out[i]));
+        }
+        ASSERT_EQ(dec, in);
+
+        // in place evaluation
+        fpe.encrypt_64_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, out);
+        fpe.decrypt_64_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, in);
+    }
+
+    uint64_t x = 0;
+    uint32_t y = 0;
+    EXPECT_THROW(fpe.encrypt_64_batch(nullptr, 1, &x), std::invalid_argument);
+    EXPECT_THROW(fpe.encrypt_64_batch(&x, 1, nullptr), std::invalid_argument);
+    EXPECT_THROW(fpe.decrypt_64_batch(nullptr, 1, &x), std::invalid_argument);
+    EXPECT_THROW(fpe.decrypt_64_batch(&x, 1, nullptr), std::invalid_argument);
+    EXPECT_THROW(fpe.encrypt_batch(nullptr, 1, &y), std::invalid_argument);
+    EXPECT_THROW(fpe.decrypt_batch(&y, 1, nullptr), std::invalid_argument);
+}
+
+TEST(prp, feistel)
+{
+    using Backend = sse::crypto::Prp::Backend;
+
+    sse::crypto::Prp fpe(Backend::kFeistel);
+    sse::crypto::Prp aez_fpe;
+
+    ASSERT_EQ(fpe.backend(), Backend::kFeistel);
+    ASSERT_EQ(aez_fpe.backend(), Backend::kAEZ);
+
+    for (size_t n : {0, 1, 7, 8, 9, 17, 1000}) {
+        std::vector<uint64_t> in(n), out(n), dec(n);
+        std::vector<uint32_t> in_32(n), out_32(n), dec_32(n);
+        if (n > 0) {
+            sse::crypto::random_bytes(n * sizeof(uint64_t),
+                                      reinterpret_cast<uint8_t*>(in.data()));
+            sse::crypto::random_bytes(
+                n * sizeof(uint32_t), reinterpret_cast<uint8_t*>(in_32.data()));
+        }
+
+        fpe.encrypt_64_batch(in.data(), n, out.data());
+        fpe.encrypt_batch(in_32.data(), n, out_32.data());
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(out[i], fpe.encrypt_64(in[i]));
+            ASSERT_EQ(fpe.decrypt_64(out[i]), in[i]);
+            ASSERT_EQ(out_32[i], fpe.encrypt(in_32[i]));
+            ASSERT_EQ(fpe.decrypt(out_32[i]), in_32[i]);
+        }
+
+        fpe.decrypt_64_batch(out.data(), n, dec.data());
+        ASSERT_EQ(dec, in);
+        fpe.decrypt_batch(out_32.data(), n, dec_32.data());
+        ASSERT_EQ(dec_32, in_32);
+
+        // in place evaluation
+        fpe.encrypt_64_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, out);
+        fpe.decrypt_64_batch(dec.data(), n, dec.data());
+        ASSERT_EQ(dec, in);
+    }
+
+    // the 32 bits Feistel permutation is a bijection (checked on a sample)
+    std::vector<uint32_t> in_32(1 << 16), out_32(1 << 16);
+    for (size_t i = 0; i < in_32.size(); i++) {
+        in_32[i] = static_cast<uint32_t>(i * 65537);
+    }
+    fpe.encrypt_batch(in_32.data(), in_32.size(), out_32.data());
+    std::sort(out_32.begin(), out_32.end());
+    ASSERT_EQ(std::unique(out_32.begin(), out_32.end()), out_32.end());
+
+    // the string interface is not affected by the backend
+    uint8_t key[sse::crypto::Prp::kKeySize];
+    uint8_t key_cp[sse::crypto::Prp::kKeySize];
+    sse::crypto::random_bytes(sizeof(key), key);
+    memcpy(key_cp, key, sizeof(key));
+
+    sse::crypto::Key<sse::crypto::Prp::kKeySize> k_1(key);
+    sse::crypto::Key<sse::crypto::Prp::kKeySize> k_2(key_cp);
+    sse::crypto::Prp fpe_1(std::move(k_1), Backend::kFeistel);
+    sse::crypto::Prp fpe_2(std::move(k_2));
+
+    string in_str = sse::crypto::random_string(37);
+    ASSERT_EQ(fpe_1.encrypt(in_str), fpe_2.encrypt(in_str));
+}
+
+TEST(prp, feistel_test_vectors)
+{
+    using Backend = sse::crypto::Prp::Backend;
+
+    uint8_t key[sse::crypto::Prp::kKeySize];
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = static_cast<uint8_t>(i);
+    }
+    sse::crypto::Prp fpe(sse::crypto::Key<sse::crypto::Prp::kKeySize>(key),
+                         Backend::kFeistel);
+
+    const std::vector<uint64_t> in_64
+        = {0, 1, 0xFFFFFFFFFFFFFFFF, 0x0123456789ABCDEF};
+    const std::vector<uint64_t> expected_64 = {0x04AA01D129A70529,
+                                               0x217B0DFB7E7DAAA2,
+                                               0x894F492D187C2A67,
+                                               0xD5CBE07905DF20F7};
+    const std::vector<uint32_t> in_32 = {0, 1, 0xFFFFFFFF, 0x01234567};
+    const std::vector<uint32_t> expected_32
+        = {0xD5A2327A, 0xED5B2847, 0x216575CE, 0x999E5122};
+
+    for (size_t i = 0; i < in_64.size(); i++) {
+        EXPECT_EQ(fpe.encrypt_64(in_64[i]), expected_64[i]);
+        EXPECT_EQ(fpe.decrypt_64(expected_64[i]), in_64[i]);
+    }
+    for (size_t i = 0; i < in_32.size(); i++) {
+        EXPECT_EQ(fpe.encrypt(in_32[i]), expected_32[i]);
+        EXPECT_EQ(fpe.decrypt(expected_32[i]), in_32[i]);
+    }
+}
+
 #else
 #warning PRP is disabled (requires support of AES instructions)
 #endif
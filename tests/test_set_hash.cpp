@@ -22,9 +22,16 @@
 #include "random.hpp"
 #include "set_hash.hpp"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <map>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include <sodium/crypto_core_ristretto255.h>
+
 #include "gtest/gtest.h"
 
 // Size in bytes of the elements hashed
@@ -32,6 +39,7 @@ constexpr size_t kNumTests     = 20;
 constexpr size_t kTestEltsSize = 100;
 constexpr size_t kNumEltsBatch = 20;
 
+using sse::crypto::ConcurrentSetHash;
 using sse::crypto::SetHash;
 
 
@@ -205,3 +213,289 @@ TEST(set_hash, exception)
 
     ASSERT_THROW(SetHash a(in), std::invalid_argument);
 }
+
+// The hashes must not change with the implementation of the group operations
+TEST(set_hash, test_vectors)
+{
+    const std::array<uint8_t, SetHash::kSetHashSize> empty_hash
+        = {{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
+    const std::array<uint8_t, SetHash::kSetHashSize> a_hash
+        = {{0x1f, 0x2c, 0x6c, 0xca, 0xd9, 0xd4, 0x32, 0x6d, 0x77, 0xef, 0xac,
+            0xa8, 0x25, 0xb5, 0x75, 0x26, 0xf7, 0x15, 0xf9, 0x49, 0x0e, 0xf5,
+            0xa3, 0x9a, 0x9f, 0xb4, 0xf3, 0x81, 0xbc, 0x39, 0xd9, 0x3a}};
+    const std::array<uint8_t, SetHash::kSetHashSize> abc_hash
+        = {{0x58, 0x75, 0x0e, 0x08, 0xe2, 0x95, 0xda, 0x62, 0xf2, 0x81, 0xb6,
+            0xc1, 0xed, 0xb9, 0x50, 0x8c, 0x5d, 0xee, 0x09, 0xb7, 0x47, 0x1e,
+            0x4e, 0x0d, 0xe4, 0x40, 0x6b, 0x3f, 0x92, 0x75, 0x29, 0xc9}};
+    const std::array<uint8_t, SetHash::kSetHashSize> elements_hash
+        = {{0x28, 0x81, 0xc6, 0x26, 0x29, 0x35, 0x68, 0xa4, 0xa2, 0xbf, 0xd3,
+            0x96, 0x7f, 0x7c, 0x3d, 0x1b, 0x54, 0x1b, 0x1a, 0x75, 0xaa, 0x43,
+            0xfc, 0x3b, 0x83, 0x47, 0x87, 0x06, 0xf7, 0x6f, 0xc8, 0x8b}};
+    const std::array<uint8_t, SetHash::kSetHashSize> removed_hash
+        = {{0x9c, 0x75, 0x51, 0x56, 0xae, 0xdb, 0xc2, 0x43, 0x68, 0x7d, 0xf2,
+            0xaa, 0x55, 0x35, 0x60, 0xcc, 0x09, 0x53, 0xc0, 0x42, 0x1a, 0x54,
+            0xc2, 0x44, 0x3f, 0x73, 0x72, 0x92, 0x0c, 0x23, 0x8f, 0xfd}};
+
+    SetHash a;
+    ASSERT_EQ(a.data(), empty_hash);
+    a.add_element("a");
+    ASSERT_EQ(a.data(), a_hash);
+    a.add_element("b");
+    a.add_element("c");
+    ASSERT_EQ(a.data(), abc_hash);
+    ASSERT_EQ(SetHash(abc_hash), a);
+
+    std::vector<std::string> elements;
+    for (size_t i = 0; i < 100; i++) {
+        elements.push_back("element " + std::to_string(i));
+    }
+    SetHash b(elements);
+    ASSERT_EQ(b.data(), elements_hash);
+    b.remove_element("element 42");
+    ASSERT_EQ(b.data(), removed_hash);
+}
+
+TEST(set_hash, concurrent)
+{
+    constexpr size_t kNumThreads        = 8;
+    constexpr size_t kNumEltsPerThreads = 200;
+
+    std::vector<std::string> elements(kNumThreads * kNumEltsPerThreads);
+    for (auto& e : elements) {
+        e = sse::crypto::random_string(kTestEltsSize);
+    }
+
+    ConcurrentSetHash        acc;
+    SetHash                  other_set({elements[0], elements[1]});
+    std::vector<std::thread> threads;
+
+    ASSERT_EQ(acc.snapshot(), SetHash());
+
+    for (size_t t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([&acc, &elements, t]() {
+            // every thread adds its elements, and removes those of the next
+            // thread, before they are even added: the result does not depend
+            // on the order
+            for (size_t i = 0; i < kNumEltsPerThreads; i++) {
+                acc.add_element(elements[t * kNumEltsPerThreads + i]);
+            }
+            const size_t next = (t + 1) % kNumThreads;
+            for (size_t i = 0; i < kNumEltsPerThreads / 2; i++) {
+                acc.remove_element(elements[next * kNumEltsPerThreads + i]);
+            }
+        });
+    }
+    // concurrent snapshots
+    for (size_t i = 0; i < 20; i++) {
+        acc.snapshot();
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    SetHash expected;
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (i % kNumEltsPerThreads >= kNumEltsPerThreads / 2) {
+            expected.add_element(elements[i]);
+        }
+    }
+    ASSERT_EQ(acc.snapshot(), expected);
+
+    acc.add_set(other_set);
+    expected.add_set(other_set);
+    ASSERT_EQ(acc.snapshot(), expected);
+    acc.remove_set(expected);
+    ASSERT_EQ(acc.snapshot(), SetHash());
+    ASSERT_EQ(acc.snapshot().data(), SetHash().data());
+}
+
+TEST(set_hash, ristretto255)
+{
+    const SetHash::Backend kBackend = SetHash::Backend::kRistretto255;
+
+    SetHash empty(kBackend);
+    ASSERT_EQ(empty.backend(), kBackend);
+    ASSERT_EQ(empty.data(), (std::array<uint8_t, SetHash::kSetHashSize>{}));
+
+    for (size_t i = 0; i < kNumTests; i++) {
+        std::vector<std::string> samples(kNumEltsBatch);
+        SetHash                  a(kBackend), b(kBackend);
+
+        // compute the same hash with libsodium
+        std::array<uint8_t, crypto_core_ristretto255_BYTES> expected{}, p;
+        std::array<uint8_t, crypto_core_ristretto255_HASHBYTES> h;
+
+        for (auto& e : samples) {
+            e = sse::crypto::random_string(kTestEltsSize);
+            a.add_element(e);
+
+            sse::crypto::Hash::hash(reinterpret_cast<const uint8_t*>(e.data()),
+                                    e.size(),
+                                    h.size(),
+                                    h.data());
+            crypto_core_ristretto255_from_hash(p.data(), h.data());
+            crypto_core_ristretto255_add(
+                expected.data(), expected.data(), p.data());
+        }
+        ASSERT_EQ(a.data(), expected);
+
+        // order independence
+        for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+            b.add_element(*it);
+        }
+        ASSERT_EQ(a, b);
+        ASSERT_EQ(a, SetHash(samples, kBackend));
+
+        // union and difference
+        SetHash c(kBackend);
+        c.add_element(samples[0]);
+        b.remove_element(samples[0]);
+        ASSERT_NE(a, b);
+        b.add_set(c);
+        ASSERT_EQ(a, b);
+        a.remove_set(b);
+        ASSERT_EQ(a, empty);
+        ASSERT_EQ(a.data(), empty.data());
+    }
+}
+
+TEST(set_hash, serialization)
+{
+    for (auto backend :
+         {SetHash::Backend::kEd25519, SetHash::Backend::kRistretto255}) {
+        SetHash a(backend);
+        ASSERT_EQ(SetHash(a.serialize()), a);
+
+        a.add_element("a");
+        a.add_element("b");
+        auto bytes = a.serialize();
+        ASSERT_EQ(bytes[0], backend == SetHash::Backend::kEd25519 ? 1 : 2);
+        const auto data = a.data();
+        ASSERT_TRUE(std::equal(data.begin(), data.end(), bytes.begin() + 1));
+
+        SetHash b(bytes);
+        ASSERT_EQ(b.backend(), backend);
+        ASSERT_EQ(b, a);
+
+        // unknown version
+        bytes[0] = 0x00;
+        ASSERT_THROW(SetHash c(bytes), std::invalid_argument);
+        bytes[0] = 0x03;
+        ASSERT_THROW(SetHash c(bytes), std::invalid_argument);
+    }
+
+    // the legacy representation is an Ed25519 point
+    SetHash a({"a", "b"});
+    ASSERT_EQ(SetHash(a.data()).backend(), SetHash::Backend::kEd25519);
+
+    // non-canonical or invalid Ristretto255 encodings
+    std::array<uint8_t, SetHash::kSerializedSize> bytes{};
+    bytes[0] = 0x02;
+    ASSERT_NO_THROW(SetHash c(bytes));
+    bytes[32] = 0x80;
+    ASSERT_THROW(SetHash c(bytes), std::invalid_argument);
+    bytes[32] = 0x00;
+    bytes[1]  = 0x01;
+    ASSERT_THROW(SetHash c(bytes), std::invalid_argument);
+    bytes.fill(0xFF);
+    bytes[0] = 0x02;
+    ASSERT_THROW(SetHash c(bytes), std::invalid_argument);
+}
+
+TEST(set_hash, mixed_backends)
+{
+    SetHash           a(SetHash::Backend::kEd25519);
+    SetHash           b(SetHash::Backend::kRistretto255);
+    ConcurrentSetHash c(SetHash::Backend::kRistretto255);
+
+    ASSERT_NE(a, b);
+    ASSERT_THROW(a.add_set(b), std::invalid_argument);
+    ASSERT_THROW(a.remove_set(b), std::invalid_argument);
+    ASSERT_THROW(c.add_set(a), std::invalid_argument);
+    ASSERT_THROW(c.remove_set(a), std::invalid_argument);
+
+    c.add_element("a");
+    b.add_element("a");
+    ASSERT_EQ(c.snapshot(), b);
+    c.add_set(b);
+    c.remove_element("a");
+    ASSERT_EQ(c.snapshot(), b);
+}
+
+TEST(set_hash, multiplicities)
+{
+    for (auto backend :
+         {SetHash::Backend::kEd25519, SetHash::Backend::kRistretto255}) {
+        const SetHash empty(backend);
+
+        for (uint64_t count : {0, 1, 2, 3, 17, 100}) {
+            const std::string e = sse::crypto::random_string(kTestEltsSize);
+
+            SetHash a(backend), b(backend);
+            for (uint64_t i = 0; i < count; i++) {
+                a.add_element(e);
+            }
+            b.add_element(e, count);
+            ASSERT_EQ(a, b);
+
+            b.remove_element(e, count);
+            ASSERT_EQ(b, empty);
+        }
+
+        // large multiplicities
+        const std::string e = sse::crypto::random_string(kTestEltsSize);
+        SetHash           a(backend), b(backend);
+        a.add_element(e, (uint64_t(1) << 40) + 5);
+        b.add_element(e, uint64_t(1) << 40);
+        b.add_element(e, 5);
+        ASSERT_EQ(a, b);
+        a.remove_element(e, UINT64_MAX);
+        a.add_element(e, UINT64_MAX - 5);
+        a.remove_element(e, uint64_t(1) << 40);
+        ASSERT_EQ(a, empty);
+
+        // batched multiplicities
+        std::map<std::string, uint64_t> counts;
+        SetHash                         c(backend), d(backend);
+        for (size_t i = 0; i < kNumEltsBatch; i++) {
+            const std::string elt   = sse::crypto::random_string(kTestEltsSize);
+            const uint64_t    count = (i * i * 7919) % 1000;
+            counts[elt]             = count;
+            c.add_element(elt, count);
+        }
+        d.add_counts(counts);
+        ASSERT_EQ(c, d);
+        d.add_counts({});
+        ASSERT_EQ(c, d);
+    }
+}
+
+TEST(set_hash, batch_range)
+{
+    for (auto backend :
+         {SetHash::Backend::kEd25519, SetHash::Backend::kRistretto255}) {
+        // the sizes cover partial and full batches of the mapping and of the
+        // multi-buffer hash
+        for (size_t n : {0, 1, 3, 4, 5, 255, 256, 257, 600}) {
+            std::vector<std::string>          samples(n);
+            std::vector<std::vector<uint8_t>> byte_samples(n);
+            SetHash                           a(backend);
+            for (size_t i = 0; i < n; i++) {
+                // various lengths, including empty and multi-blocks elements
+                samples[i] = sse::crypto::random_string((i * 37) % 300);
+                byte_samples[i].assign(samples[i].begin(), samples[i].end());
+                a.add_element(samples[i]);
+            }
+
+            SetHash b(samples.begin(), samples.end(), backend);
+            SetHash c(byte_samples.begin(), byte_samples.end(), backend);
+            SetHash d(samples, backend);
+
+            ASSERT_EQ(a, b);
+            ASSERT_EQ(a, c);
+            ASSERT_EQ(a, d);
+        }
+    }
+}
@@ -0,0 +1,202 @@
+//
+// libsse_crypto - An abstraction layer for high level cryptographic features.
+// Copyright (C) 2015-2017 Raphael Bost
+//
+// This file is part of libsse_crypto.
+//
+// libsse_crypto is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// libsse_crypto is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#if __AES__ || __ARM_FEATURE_CRYPTO /* Defined by gcc/clang when compiling for \
+                                       AES-NI */
+
+#include "../src/random.hpp"
+#include "../src/small_domain_prp.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using sse::crypto::Key;
+using sse::crypto::SmallDomainPrp;
+
+static Key<SmallDomainPrp::kKeySize> fixed_key()
+{
+    std::array<uint8_t, SmallDomainPrp::kKeySize> k;
+    for (size_t i = 0; i < k.size(); i++) {
+        k[i] = static_cast<uint8_t>(i);
+    }
+    return Key<SmallDomainPrp::kKeySize>(k.data());
+}
+
+TEST(small_domain_prp, bijection)
+{
+    const std::vector<uint64_t> sizes
+        = {1, 2, 3, 4, 5, 7, 10, 17, 100, 255, 256, 257, 1000, 1 << 16, 99991};
+
+    for (uint64_t N : sizes) {
+        SmallDomainPrp prp(N);
+        ASSERT_EQ(prp.domain_size(), N);
+
+        std::vector<uint64_t> perm = prp.permutation();
+        ASSERT_EQ(perm.size(), N);
+
+        for (uint64_t i = 0; i < N; i++) {
+            ASSERT_LT(perm[i], N);
+            ASSERT_EQ(perm[i], prp.encrypt(i));
+            ASSERT_EQ(prp.decrypt(perm[i]), i);
+        }
+
+        std::sort(perm.begin(), perm.end());
+        for (uint64_t i = 0; i < N; i++) {
+            ASSERT_EQ(perm[i], i);
+        }
+    }
+}
+
+TEST(small_domain_prp, large_domains)
+{
+    const std::vector<uint64_t> sizes = {(1ULL << 32) - 1,
+                                         1ULL << 32,
+                                         (1ULL << 40) + 7,
+                                         1ULL << 63,
+                                         UINT64_MAX};
+
+    for (uint64_t N : sizes) {
+        SmallDomainPrp prp(N);
+
+        for (size_t i = 0; i < 1000; i++) {
+            uint64_t x;
+            sse::crypto::random_bytes(sizeof(x),
+                                      reinterpret_cast<uint8_t*>(&x));
+            x %= N;
+
+            const uint64_t y = prp.encrypt(x);
+            ASSERT_LT(y, N);
+            ASSERT_EQ(prp.decrypt(y), x);
+        }
+    }
+}
+
+TEST(small_domain_prp, batch)
+{
+    const std::vector<uint64_t> sizes = {3, 1000, 1000003, (1ULL << 40) + 7};
+
+    for (uint64_t N : sizes) {
+        SmallDomainPrp prp(N);
+
+        std::vector<uint64_t> in(1000);
+        for (auto& x : in) {
+            sse::crypto::random_bytes(sizeof(x),
+                                      reinterpret_cast<uint8_t*>(&x));
+            x %= N;
+        }
+
+        std::vector<uint64_t> out = prp.encrypt(in);
+        ASSERT_EQ(out.size(), in.size());
+        for (size_t i = 0; i < in.size(); i++) {
+            ASSERT_EQ(out[i], prp.encrypt(in[i]));
+        }
+        ASSERT_EQ(prp.decrypt(out), in);
+
+        // in place evaluation
+        std::vector<uint64_t> inplace(in);
+        prp.encrypt(inplace.data(), inplace.size(), inplace.data());
+        ASSERT_EQ(inplace, out);
+        prp.decrypt(inplace.data(), inplace.size(), inplace.data());
+        ASSERT_EQ(inplace, in);
+
+        // partial permutation tables
+        const uint64_t        first = N - std::min<uint64_t>(N, 100);
+        std::vector<uint64_t> table(N - first);
+        prp.permutation(first, table.size(), table.data());
+        for (size_t i = 0; i < table.size(); i++) {
+            ASSERT_EQ(table[i], prp.encrypt(first + i));
+        }
+    }
+}
+
+TEST(small_domain_prp, test_vectors)
+{
+    // regression vectors, with the key 00 01 02 ... 2f
+    const std::vector<std::pair<uint64_t, std::array<uint64_t, 4>>> vectors
+        = {{10, {{2, 1, 9, 0}}},
+           {1000000, {{138919, 579220, 659258, 209191}}},
+           {UINT64_MAX,
+            {{14449193436718875364ULL,
+              16002396003806668578ULL,
+              3376062455591082802ULL,
+              11914936161206587456ULL}}}};
+    const std::array<uint64_t, 4> inputs = {{0, 1, 2, 7}};
+
+    for (const auto& v : vectors) {
+        SmallDomainPrp prp(fixed_key(), v.first);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            EXPECT_EQ(prp.encrypt(inputs[i]), v.second[i]);
+        }
+    }
+}
+
+TEST(small_domain_prp, consistency)
+{
+    SmallDomainPrp prp_1(fixed_key(), 1000000);
+    SmallDomainPrp prp_2(fixed_key(), 1000000);
+    SmallDomainPrp prp_3(fixed_key(), 1000001);
+
+    size_t n_diff = 0;
+    for (uint64_t i = 0; i < 1000; i++) {
+        ASSERT_EQ(prp_1.encrypt(i), prp_2.encrypt(i));
+        if (prp_1.encrypt(i) != prp_3.encrypt(i)) {
+            n_diff++;
+        }
+    }
+    // the domain size is part of the tweak
+    ASSERT_GT(n_diff, 900);
+}
+
+TEST(small_domain_prp, exceptions)
+{
+    EXPECT_THROW(SmallDomainPrp(0), std::invalid_argument);
+
+    SmallDomainPrp prp(1000);
+    uint64_t       x = 1000;
+
+    EXPECT_THROW(prp.encrypt(1000), std::invalid_argument);
+    EXPECT_THROW(prp.decrypt(UINT64_MAX), std::invalid_argument);
+    EXPECT_THROW(prp.encrypt(std::vector<uint64_t>({1, 2, 1000})),
+                 std::invalid_argument);
+    EXPECT_THROW(prp.decrypt(std::vector<uint64_t>({1000, 2, 3})),
+                 std::invalid_argument);
+    EXPECT_THROW(prp.encrypt(nullptr, 1, &x), std::invalid_argument);
+    EXPECT_THROW(prp.encrypt(&x, 1, nullptr), std::invalid_argument);
+    EXPECT_THROW(prp.decrypt(nullptr, 1, &x), std::invalid_argument);
+    EXPECT_THROW(prp.decrypt(&x, 1, nullptr), std::invalid_argument);
+    EXPECT_THROW(prp.permutation(0, 1, nullptr), std::invalid_argument);
+    EXPECT_THROW(prp.permutation(999, 2, &x), std::invalid_argument);
+    EXPECT_THROW(prp.permutation(0, 1001, &x), std::invalid_argument);
+
+    // the input is left untouched when an exception is thrown
+    std::vector<uint64_t> v = {1, 2, 3, 1000};
+    EXPECT_THROW(prp.encrypt(v.data(), v.size(), v.data()),
+                 std::invalid_argument);
+    ASSERT_EQ(v, std::vector<uint64_t>({1, 2, 3, 1000}));
+}
+
+#else
+#warning SmallDomainPrp is disabled (requires support of AES instructions)
+#endif
@@ -18,13 +18,17 @@
 // along with libsse_crypto.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include "../src/random.hpp"
 #include "../src/tdp.hpp"
+#include "../src/tdp_impl/rsa_multi_buffer.hpp"
 #include "../src/tdp_impl/tdp_impl_mbedtls.hpp"
 #include "../src/tdp_impl/tdp_impl_openssl.hpp"
 
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -46,6 +50,19 @@ using namespace std;
 
 #define TDP_IMPL_DET_GEN_TEST_COUNT 30
 
+#define TDP_IMPL_CONCURRENT_EVAL_THREADS 4
+#define TDP_IMPL_CONCURRENT_EVAL_TEST_COUNT 30
+
+#define TDP_IMPL_BATCH_TEST_COUNT 5
+#define TDP_BATCH_SIZE 17
+
+#define TDP_IMPL_CHAIN_TEST_COUNT 5
+#define TDP_CHAIN_LENGTH 37
+
+#define TDP_IMPL_EVAL_MULT_TEST_COUNT 5
+
+#define RSA_MULTI_BUFFER_TEST_COUNT 10
+
 #define POOL_COUNT 20
 #define INV_MULT_COUNT 100
 
@@ -661,6 +678,177 @@ static void test_tdp_impl_exceptions()
                  std::invalid_argument);
 }
 
+// Evaluations of a TDP shared by several threads
+template<typename TDP, typename TDP_INV>
+static void test_tdp_impl_concurrent_eval(const size_t thread_count,
+                                          const size_t test_count)
+{
+    TDP_INV   tdp_inv;
+    const TDP tdp(tdp_inv.public_key());
+
+    std::vector<std::thread> threads;
+    // not a std::vector<bool>: every thread writes its own result
+    std::vector<int> results(thread_count, 0);
+
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&tdp, &tdp_inv, &results, t, test_count]() {
+            int success = 1;
+            for (size_t i = 0; i < test_count; i++) {
+                auto sample = tdp_inv.sample_array();
+                if (tdp_inv.invert(tdp.eval(sample)) != sample) {
+                    success = 0;
+                }
+            }
+            results[t] = success;
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    for (size_t t = 0; t < thread_count; t++) {
+        ASSERT_EQ(results[t], 1);
+    }
+}
+
+// Batch evaluations and inversions must match the message-per-message
+// operations
+template<typename TDP, typename TDP_INV>
+static void test_tdp_impl_batch(const size_t test_count)
+{
+    constexpr size_t kSize = sse::crypto::Tdp::kMessageSize;
+
+    for (size_t i = 0; i < test_count; i++) {
+        TDP_INV tdp_inv;
+        TDP     tdp(tdp_inv.public_key());
+
+        std::vector<std::array<uint8_t, kSize>> samples(TDP_BATCH_SIZE);
+        std::vector<std::array<uint8_t, kSize>> enc(TDP_BATCH_SIZE);
+        std::vector<std::array<uint8_t, kSize>> dec(TDP_BATCH_SIZE);
+        for (auto& s : samples) {
+            s = tdp.sample_array();
+        }
+
+        tdp.eval_batch(samples.data(), enc.data(), TDP_BATCH_SIZE);
+        for (size_t j = 0; j < TDP_BATCH_SIZE; j++) {
+            ASSERT_EQ(enc[j], tdp.eval(samples[j]));
+        }
+
+        tdp_inv.eval_batch(samples.data(), dec.data(), TDP_BATCH_SIZE);
+        ASSERT_EQ(enc, dec);
+
+        tdp_inv.invert_batch(enc.data(), dec.data(), TDP_BATCH_SIZE);
+        ASSERT_EQ(samples, dec);
+
+        // in place
+        tdp_inv.invert_batch(enc.data(), enc.data(), TDP_BATCH_SIZE);
+        ASSERT_EQ(samples, enc);
+        tdp.eval_batch(enc.data(), enc.data(), TDP_BATCH_SIZE);
+        tdp_inv.invert_batch(enc.data(), enc.data(), 1);
+        ASSERT_EQ(samples[0], enc[0]);
+
+        // empty batch
+        tdp.eval_batch(samples.data(), enc.data(), 0);
+        tdp_inv.invert_batch(samples.data(), enc.data(), 0);
+    }
+}
+
+// A chain must give the same elements as repeated evaluations
+template<typename TDP, typename TDP_INV>
+static void test_tdp_impl_chain(const size_t test_count)
+{
+    constexpr size_t kSize = sse::crypto::Tdp::kMessageSize;
+
+    for (size_t i = 0; i < test_count; i++) {
+        TDP_INV tdp_inv;
+        TDP     tdp(tdp_inv.public_key());
+
+        auto start = tdp.sample_array();
+        if (i == 0) {
+            // larger than the modulus
+            start.fill(0xFF);
+        }
+
+        std::vector<std::array<uint8_t, kSize>> chain;
+        tdp.eval_chain(start,
+                       TDP_CHAIN_LENGTH,
+                       [&chain](const std::array<uint8_t, kSize>& elt) {
+                           chain.push_back(elt);
+                       });
+        ASSERT_EQ(chain.size(), TDP_CHAIN_LENGTH);
+
+        std::array<uint8_t, kSize> v = start;
+        for (size_t j = 0; j < TDP_CHAIN_LENGTH; j++) {
+            v = tdp.eval(v);
+            ASSERT_EQ(chain[j], v);
+        }
+
+        // the chain can be walked back with the inverse
+        std::vector<std::array<uint8_t, kSize>> inv_chain;
+        tdp_inv.eval_chain(start,
+                           2,
+                           [&inv_chain](const std::array<uint8_t, kSize>& elt) {
+                               inv_chain.push_back(elt);
+                           });
+        ASSERT_EQ(inv_chain.size(), 2);
+        ASSERT_EQ(inv_chain[0], chain[0]);
+        ASSERT_EQ(tdp_inv.invert(inv_chain[1]), chain[0]);
+
+        // the callback can evaluate the TDP on the same thread
+        std::vector<std::array<uint8_t, kSize>> nested_chain;
+        tdp.eval_chain(
+            start,
+            TDP_CHAIN_LENGTH,
+            [&](const std::array<uint8_t, kSize>& elt) {
+                nested_chain.push_back(elt);
+                ASSERT_EQ(tdp.eval(elt), tdp_inv.eval(elt));
+                tdp.eval_batch(&chain[0], &v, 1);
+            });
+        ASSERT_EQ(nested_chain, chain);
+
+        size_t calls = 0;
+        tdp.eval_chain(start, 0, [&calls](const std::array<uint8_t, kSize>&) {
+            calls++;
+        });
+        ASSERT_EQ(calls, 0);
+    }
+}
+
+// Jumping in a chain must give the same elements as repeated evaluations
+template<typename TDP, typename TDP_INV>
+static void test_tdp_impl_eval_mult(const size_t test_count)
+{
+    constexpr size_t kSize = sse::crypto::Tdp::kMessageSize;
+
+    for (size_t i = 0; i < test_count; i++) {
+        TDP_INV tdp_inv;
+        TDP     tdp(tdp_inv.public_key());
+
+        auto start = tdp.sample_array();
+        if (i == 0) {
+            // larger than the modulus
+            start.fill(0xFF);
+        }
+
+        ASSERT_EQ(tdp_inv.eval_mult(start, 0), start);
+
+        std::array<uint8_t, kSize> v = start;
+        for (uint64_t j = 1; j <= TDP_CHAIN_LENGTH; j++) {
+            v = tdp.eval(v);
+            ASSERT_EQ(tdp_inv.eval_mult(start, j), v);
+        }
+
+        // orders larger than 32 bits
+        const uint64_t order = (1ULL << 40) + 3;
+        auto           jump  = tdp_inv.eval_mult(start, order);
+        ASSERT_EQ(tdp_inv.eval_mult(tdp_inv.eval_mult(start, 1ULL << 40), 3),
+                  jump);
+        ASSERT_EQ(tdp_inv.invert_mult(tdp_inv.eval_mult(v, 1ULL << 31),
+                                      1U << 31),
+                  v);
+    }
+}
+
 // Instantiate all the previous test templates
 #ifdef WITH_OPENSSL
 TEST(tdp_openssl_impl, correctness)
@@ -880,3 +1068,238 @@ TEST(tdp, exceptions)
                              sse::crypto::TdpMultPool,
                              false>();
 }
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, concurrent_eval)
+{
+    test_tdp_impl_concurrent_eval<sse::crypto::TdpImpl_OpenSSL,
+                                  sse::crypto::TdpInverseImpl_OpenSSL>(
+        TDP_IMPL_CONCURRENT_EVAL_THREADS, TDP_IMPL_CONCURRENT_EVAL_TEST_COUNT);
+}
+#endif
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, batch)
+{
+    test_tdp_impl_batch<sse::crypto::TdpImpl_OpenSSL,
+                        sse::crypto::TdpInverseImpl_OpenSSL>(
+        TDP_IMPL_BATCH_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, batch)
+{
+    test_tdp_impl_batch<sse::crypto::TdpImpl_mbedTLS,
+                        sse::crypto::TdpInverseImpl_mbedTLS>(
+        TDP_IMPL_BATCH_TEST_COUNT);
+}
+
+TEST(tdp, batch)
+{
+    test_tdp_impl_batch<sse::crypto::Tdp, sse::crypto::TdpInverse>(
+        TDP_TEST_COUNT);
+
+    sse::crypto::TdpInverse tdp_inv;
+    sse::crypto::Tdp        tdp(tdp_inv.public_key());
+
+    std::vector<std::array<uint8_t, sse::crypto::Tdp::kMessageSize>> samples(
+        TDP_BATCH_SIZE);
+    for (auto& s : samples) {
+        s = tdp.sample_array();
+    }
+
+    auto enc = tdp.eval_batch(samples);
+    ASSERT_EQ(enc.size(), samples.size());
+
+    // the results do not depend on the number of threads, even when there
+    // are more threads than messages
+    for (unsigned int threads : {0U, 2U, 4U, 64U}) {
+        ASSERT_EQ(tdp.eval_batch(samples, threads), enc);
+        ASSERT_EQ(tdp_inv.eval_batch(samples, threads), enc);
+        ASSERT_EQ(tdp_inv.invert_batch(enc, threads), samples);
+    }
+
+    ASSERT_TRUE(tdp.eval_batch({}, 4).empty());
+    ASSERT_TRUE(tdp_inv.invert_batch({}, 4).empty());
+
+    ASSERT_THROW(tdp.eval_batch(nullptr, enc.data(), 1),
+                 std::invalid_argument);
+    ASSERT_THROW(tdp_inv.eval_batch(samples.data(), nullptr, 1),
+                 std::invalid_argument);
+    ASSERT_THROW(tdp_inv.invert_batch(nullptr, nullptr, 1),
+                 std::invalid_argument);
+    tdp.eval_batch(nullptr, nullptr, 0);
+}
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, chain)
+{
+    test_tdp_impl_chain<sse::crypto::TdpImpl_OpenSSL,
+                        sse::crypto::TdpInverseImpl_OpenSSL>(
+        TDP_IMPL_CHAIN_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, chain)
+{
+    test_tdp_impl_chain<sse::crypto::TdpImpl_mbedTLS,
+                        sse::crypto::TdpInverseImpl_mbedTLS>(
+        TDP_IMPL_CHAIN_TEST_COUNT);
+}
+
+#ifdef WITH_OPENSSL
+TEST(tdp_openssl_impl, eval_mult)
+{
+    test_tdp_impl_eval_mult<sse::crypto::TdpImpl_OpenSSL,
+                            sse::crypto::TdpInverseImpl_OpenSSL>(
+        TDP_IMPL_EVAL_MULT_TEST_COUNT);
+}
+#endif
+
+TEST(tdp_mbedtls_impl, eval_mult)
+{
+    test_tdp_impl_eval_mult<sse::crypto::TdpImpl_mbedTLS,
+                            sse::crypto::TdpInverseImpl_mbedTLS>(
+        TDP_IMPL_EVAL_MULT_TEST_COUNT);
+}
+
+TEST(tdp, chain)
+{
+    test_tdp_impl_chain<sse::crypto::Tdp, sse::crypto::TdpInverse>(
+        TDP_TEST_COUNT);
+
+    sse::crypto::TdpInverse  tdp_inv;
+    sse::crypto::TdpMultPool pool(tdp_inv.public_key(), 2);
+
+    auto start = pool.sample_array();
+
+    std::array<uint8_t, sse::crypto::Tdp::kMessageSize> last;
+    pool.eval_chain(
+        start,
+        TDP_CHAIN_LENGTH,
+        [&last](const std::array<uint8_t, sse::crypto::Tdp::kMessageSize>& e) {
+            last = e;
+        });
+
+    std::array<uint8_t, sse::crypto::Tdp::kMessageSize> v = start;
+    for (size_t j = 0; j < TDP_CHAIN_LENGTH; j++) {
+        v = tdp_inv.eval(v);
+    }
+    ASSERT_EQ(last, v);
+}
+
+TEST(tdp, chain_parallel)
+{
+    constexpr size_t kSize = sse::crypto::TdpInverse::kMessageSize;
+
+    test_tdp_impl_eval_mult<sse::crypto::Tdp, sse::crypto::TdpInverse>(
+        TDP_TEST_COUNT);
+
+    sse::crypto::TdpInverse tdp_inv;
+
+    // long enough to be cut in 3 segments
+    const size_t n
+        = 3 * sse::crypto::TdpInverse::kMinChainSegmentLength + 5;
+    auto start = tdp_inv.sample_array();
+
+    std::vector<std::array<uint8_t, kSize>> chain;
+    tdp_inv.eval_chain(
+        start, n, [&chain](const std::array<uint8_t, kSize>& elt) {
+            chain.push_back(elt);
+        });
+
+    for (unsigned int threads : {1U, 3U, 0U, 64U}) {
+        ASSERT_EQ(tdp_inv.eval_chain_parallel(start, n, threads), chain);
+    }
+
+    // too short to be split
+    auto short_chain = tdp_inv.eval_chain_parallel(start, 5, 4);
+    chain.resize(5);
+    ASSERT_EQ(short_chain, chain);
+
+    ASSERT_TRUE(tdp_inv.eval_chain_parallel(start, 0).empty());
+}
+
+TEST(rsa_multi_buffer, eval)
+{
+    using sse::crypto::RsaMultiBuffer;
+    constexpr size_t kSize  = RsaMultiBuffer::kModulusSize;
+    constexpr size_t kLanes = RsaMultiBuffer::kLanes;
+
+    const uint8_t e[] = {0x01, 0x00, 0x01};
+
+    RsaMultiBuffer             mb;
+    std::array<uint8_t, kSize> n;
+
+    if (kLanes == 0) {
+        // no kernel in this build
+        n.fill(0xFF);
+        mb.set_key(n.data(), n.size(), e, sizeof(e));
+        ASSERT_FALSE(mb.enabled());
+        return;
+    }
+
+    mbedtls_mpi N, E, X;
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&X);
+    mbedtls_mpi_lset(&E, 65537);
+
+    for (size_t i = 0; i < RSA_MULTI_BUFFER_TEST_COUNT; i++) {
+        // the kernel works with any odd modulus of the right size
+        sse::crypto::random_bytes(n);
+        n[0] |= 0x80;
+        n[kSize - 1] |= 0x01;
+        mbedtls_mpi_read_binary(&N, n.data(), n.size());
+
+        mb.set_key(n.data(), n.size(), e, sizeof(e));
+        ASSERT_TRUE(mb.enabled());
+
+        std::vector<std::array<uint8_t, kSize>> in(kLanes);
+        std::vector<std::array<uint8_t, kSize>> out(kLanes);
+        for (auto& m : in) {
+            sse::crypto::random_bytes(m);
+        }
+        // 0, 1, N-1 and a number larger than N
+        in[0].fill(0x00);
+        in[1].fill(0x00);
+        in[1][kSize - 1] = 0x01;
+        in[2]            = n;
+        in[2][kSize - 1] ^= 0x01;
+        in[3].fill(0xFF);
+
+        mb.eval(in.data(), out.data(), kLanes);
+
+        for (size_t j = 0; j < kLanes; j++) {
+            std::array<uint8_t, kSize> expected;
+            mbedtls_mpi_read_binary(&X, in[j].data(), kSize);
+            mbedtls_mpi_mod_mpi(&X, &X, &N);
+            mbedtls_mpi_exp_mod(&X, &X, &E, &N, nullptr);
+            mbedtls_mpi_write_binary(&X, expected.data(), kSize);
+
+            ASSERT_EQ(out[j], expected);
+        }
+
+        // incomplete group, in place
+        mb.eval(in.data() + 1, in.data() + 1, kLanes - 1);
+        for (size_t j = 1; j < kLanes; j++) {
+            ASSERT_EQ(in[j], out[j]);
+        }
+    }
+
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&X);
+
+    // unsupported keys
+    const uint8_t e_3[] = {0x03};
+    mb.set_key(n.data(), n.size(), e_3, sizeof(e_3));
+    ASSERT_FALSE(mb.enabled());
+    mb.set_key(n.data() + 1, n.size() - 1, e, sizeof(e));
+    ASSERT_FALSE(mb.enabled());
+    n[kSize - 1] &= 0xFE;
+    mb.set_key(n.data(), n.size(), e, sizeof(e));
+    ASSERT_FALSE(mb.enabled());
+
+    ASSERT_THROW(mb.eval(nullptr, nullptr, 0), std::invalid_argument);
+}